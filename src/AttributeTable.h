@@ -0,0 +1,253 @@
+#pragma once
+
+/// Compile-time attribute descriptions for the project components.
+///
+/// A component lists its attributes once as a constexpr table, registers each of them against
+/// the table by name and finally hands the table to URHO3D_ATTRIBUTE_TABLE:
+///
+///     static constexpr AttributeDesc ROTATOR_ATTRIBUTES[] = {
+///         AttrVector3("Axis", 0.0f, 0.0f, 0.0f, AM_FILE),
+///         AttrFloat("Speed", DEFAULT_ROTATOR_SPEED, AM_FILE),
+///     };
+///
+///     URHO3D_TABLE_ATTRIBUTE(ROTATOR_ATTRIBUTES, "Axis", axis_);
+///     URHO3D_TABLE_ATTRIBUTE(ROTATOR_ATTRIBUTES, "Speed", speed_);
+///     URHO3D_ATTRIBUTE_TABLE(ROTATOR_ATTRIBUTES);
+///
+/// Names, defaults, modes and enum names come from the table only. An unknown name, a member or
+/// accessor type that doesn't match its descriptor, duplicate names or an enum/resource
+/// descriptor of the wrong type fail the build. The component exporter reads the registered
+/// tables directly instead of walking the reflection data of the context.
+
+#include <Urho3D/Core/Context.h>
+#include <Urho3D/Core/Variant.h>
+#include <Urho3D/Container/HashMap.h>
+#include <Urho3D/IO/Log.h>
+#include <Urho3D/Math/Color.h>
+#include <Urho3D/Math/Vector4.h>
+#include <Urho3D/Scene/Serializable.h>
+
+#include <type_traits>
+#include <utility>
+
+using namespace Urho3D;
+
+/// Editor hint of a number attribute, same order as the exporter's NodeSubType.
+enum AttributeSubType { AST_NONE, AST_PIXEL, AST_UNSIGNED, AST_FACTOR, AST_ANGLE, AST_TIME, AST_DISTANCE };
+
+/// Description of one attribute, everything in it is known at compile time.
+struct AttributeDesc{
+    const char* name_;
+    VariantType type_;
+    AttributeSubType subType_;
+    /// range of int and float attributes, none if min_ == max_
+    float min_;
+    float max_;
+    /// null terminated, only for VAR_INT
+    const char* const* enumNames_;
+    /// resource type of a VAR_RESOURCEREF
+    const char* refTypeName_;
+    /// bool, int, float, vector and color defaults
+    float default_[4];
+    /// VAR_STRING default
+    const char* defaultString_;
+    unsigned mode_;
+};
+
+constexpr AttributeDesc AttrBool(const char* name, bool value, unsigned mode = AM_DEFAULT)
+{
+    return AttributeDesc{name, VAR_BOOL, AST_NONE, 0.0f, 0.0f, nullptr, nullptr, {value ? 1.0f : 0.0f, 0.0f, 0.0f, 0.0f}, nullptr, mode};
+}
+
+constexpr AttributeDesc AttrInt(const char* name, int value, unsigned mode = AM_DEFAULT, AttributeSubType subType = AST_NONE, float min = 0.0f, float max = 0.0f)
+{
+    return AttributeDesc{name, VAR_INT, subType, min, max, nullptr, nullptr, {(float)value, 0.0f, 0.0f, 0.0f}, nullptr, mode};
+}
+
+constexpr AttributeDesc AttrFloat(const char* name, float value, unsigned mode = AM_DEFAULT, AttributeSubType subType = AST_NONE, float min = 0.0f, float max = 0.0f)
+{
+    return AttributeDesc{name, VAR_FLOAT, subType, min, max, nullptr, nullptr, {value, 0.0f, 0.0f, 0.0f}, nullptr, mode};
+}
+
+constexpr AttributeDesc AttrString(const char* name, const char* value, unsigned mode = AM_DEFAULT)
+{
+    return AttributeDesc{name, VAR_STRING, AST_NONE, 0.0f, 0.0f, nullptr, nullptr, {0.0f, 0.0f, 0.0f, 0.0f}, value, mode};
+}
+
+constexpr AttributeDesc AttrVector2(const char* name, float x, float y, unsigned mode = AM_DEFAULT)
+{
+    return AttributeDesc{name, VAR_VECTOR2, AST_NONE, 0.0f, 0.0f, nullptr, nullptr, {x, y, 0.0f, 0.0f}, nullptr, mode};
+}
+
+constexpr AttributeDesc AttrVector3(const char* name, float x, float y, float z, unsigned mode = AM_DEFAULT)
+{
+    return AttributeDesc{name, VAR_VECTOR3, AST_NONE, 0.0f, 0.0f, nullptr, nullptr, {x, y, z, 0.0f}, nullptr, mode};
+}
+
+constexpr AttributeDesc AttrVector4(const char* name, float x, float y, float z, float w, unsigned mode = AM_DEFAULT)
+{
+    return AttributeDesc{name, VAR_VECTOR4, AST_NONE, 0.0f, 0.0f, nullptr, nullptr, {x, y, z, w}, nullptr, mode};
+}
+
+constexpr AttributeDesc AttrColor(const char* name, float r, float g, float b, float a = 1.0f, unsigned mode = AM_DEFAULT)
+{
+    return AttributeDesc{name, VAR_COLOR, AST_NONE, 0.0f, 0.0f, nullptr, nullptr, {r, g, b, a}, nullptr, mode};
+}
+
+/// Int attribute shown as a dropdown of the names.
+constexpr AttributeDesc AttrEnum(const char* name, const char* const* enumNames, int value, unsigned mode = AM_DEFAULT)
+{
+    return AttributeDesc{name, VAR_INT, AST_NONE, 0.0f, 0.0f, enumNames, nullptr, {(float)value, 0.0f, 0.0f, 0.0f}, nullptr, mode};
+}
+
+/// Resource reference of the type refTypeName, "Animation", "Model", "Material", "Texture2D"...
+constexpr AttributeDesc AttrResourceRef(const char* name, const char* refTypeName, unsigned mode = AM_DEFAULT)
+{
+    return AttributeDesc{name, VAR_RESOURCEREF, AST_NONE, 0.0f, 0.0f, nullptr, refTypeName, {0.0f, 0.0f, 0.0f, 0.0f}, nullptr, mode};
+}
+
+/// The registered table of a type.
+struct AttributeTableView{
+    const AttributeDesc* descs_;
+    unsigned size_;
+};
+
+namespace AttributeTable {
+
+/// Variant type of a member or accessor type, undefined for types attributes can't have.
+template <class T> struct VariantTypeOf;
+template <> struct VariantTypeOf<bool> { static constexpr VariantType value = VAR_BOOL; };
+template <> struct VariantTypeOf<int> { static constexpr VariantType value = VAR_INT; };
+template <> struct VariantTypeOf<unsigned> { static constexpr VariantType value = VAR_INT; };
+template <> struct VariantTypeOf<float> { static constexpr VariantType value = VAR_FLOAT; };
+template <> struct VariantTypeOf<String> { static constexpr VariantType value = VAR_STRING; };
+template <> struct VariantTypeOf<Vector2> { static constexpr VariantType value = VAR_VECTOR2; };
+template <> struct VariantTypeOf<Vector3> { static constexpr VariantType value = VAR_VECTOR3; };
+template <> struct VariantTypeOf<Vector4> { static constexpr VariantType value = VAR_VECTOR4; };
+template <> struct VariantTypeOf<Color> { static constexpr VariantType value = VAR_COLOR; };
+template <> struct VariantTypeOf<ResourceRef> { static constexpr VariantType value = VAR_RESOURCEREF; };
+
+constexpr bool StrEqual(const char* a, const char* b)
+{
+    return *a == *b && (*a == '\0' || StrEqual(a + 1, b + 1));
+}
+
+/// Index of the entry name, N if there is none.
+template <unsigned N> constexpr unsigned IndexOf(const AttributeDesc (&table)[N], const char* name, unsigned i = 0)
+{
+    return i >= N || StrEqual(table[i].name_, name) ? i : IndexOf(table, name, i + 1);
+}
+
+template <unsigned N> constexpr bool Contains(const AttributeDesc (&table)[N], const char* name)
+{
+    return IndexOf(table, name) < N;
+}
+
+template <unsigned N> constexpr VariantType TypeOf(const AttributeDesc (&table)[N], const char* name)
+{
+    return table[IndexOf(table, name)].type_;
+}
+
+template <unsigned N> constexpr bool IsEnum(const AttributeDesc (&table)[N], const char* name)
+{
+    return table[IndexOf(table, name)].enumNames_ != nullptr;
+}
+
+constexpr bool IsValidEntry(const AttributeDesc& desc)
+{
+    return (desc.enumNames_ == nullptr || desc.type_ == VAR_INT)
+        && ((desc.refTypeName_ != nullptr) == (desc.type_ == VAR_RESOURCEREF))
+        && desc.min_ <= desc.max_;
+}
+
+template <unsigned N> constexpr bool IsUnique(const AttributeDesc (&table)[N], unsigned i, unsigned j)
+{
+    return j >= N || (!StrEqual(table[i].name_, table[j].name_) && IsUnique(table, i, j + 1));
+}
+
+template <unsigned N> constexpr bool IsValid(const AttributeDesc (&table)[N], unsigned i = 0)
+{
+    return i >= N || (IsValidEntry(table[i]) && IsUnique(table, i, i + 1) && IsValid(table, i + 1));
+}
+
+/// Default value of the descriptor as registered.
+inline Variant DefaultValue(const AttributeDesc& desc)
+{
+    switch (desc.type_){
+        case VAR_BOOL: return Variant(desc.default_[0] != 0.0f);
+        case VAR_INT: return Variant((int)desc.default_[0]);
+        case VAR_FLOAT: return Variant(desc.default_[0]);
+        case VAR_STRING: return Variant(String(desc.defaultString_ ? desc.defaultString_ : ""));
+        case VAR_VECTOR2: return Variant(Vector2(desc.default_));
+        case VAR_VECTOR3: return Variant(Vector3(desc.default_));
+        case VAR_VECTOR4: return Variant(Vector4(desc.default_));
+        case VAR_COLOR: return Variant(Color(desc.default_));
+        case VAR_RESOURCEREF: return Variant(ResourceRef(StringHash(desc.refTypeName_)));
+        default: return Variant::EMPTY;
+    }
+}
+
+inline AttributeInfo MakeInfo(const AttributeDesc& desc, const SharedPtr<AttributeAccessor>& accessor)
+{
+    return AttributeInfo(desc.type_, desc.name_, accessor, const_cast<const char**>(desc.enumNames_), DefaultValue(desc), desc.mode_);
+}
+
+inline HashMap<StringHash, AttributeTableView>& GetRegistry()
+{
+    static HashMap<StringHash, AttributeTableView> registry;
+    return registry;
+}
+
+/// Make the table of type known to the exporter. It has to describe all attributes that are
+/// registered for the type, in their order, otherwise the exporter keeps reading the context.
+template <unsigned N> void Register(Context* context, StringHash type, const AttributeDesc (&table)[N])
+{
+    const Vector<AttributeInfo>* attributes = context->GetAttributes(type);
+    bool complete = attributes && attributes->Size() == N;
+    for (unsigned i = 0; i < N && complete; ++i){
+        complete = (*attributes)[i].name_ == table[i].name_;
+    }
+    if (!complete){
+        URHO3D_LOGERRORF("[AttributeTable] the registered attributes of %s don't match its table", context->GetTypeName(type).CString());
+        GetRegistry().Erase(type);
+        return;
+    }
+    GetRegistry()[type] = AttributeTableView{table, N};
+}
+
+/// The table registered for type or null.
+inline const AttributeTableView* Find(StringHash type)
+{
+    auto it = GetRegistry().Find(type);
+    return it != GetRegistry().End() ? &it->second_ : nullptr;
+}
+
+}
+
+#define URHO3D_TABLE_CHECK(table, name, typeName) \
+    static_assert(AttributeTable::Contains(table, name), "\"" name "\" is not in " #table); \
+    static_assert(AttributeTable::TypeOf(table, name) == AttributeTable::VariantTypeOf<typeName>::value, "\"" name "\" does not have the type of its descriptor")
+
+/// Register the member variable as the attribute name of the table.
+#define URHO3D_TABLE_ATTRIBUTE(table, name, variable) \
+    URHO3D_TABLE_CHECK(table, name, std::decay<decltype(std::declval<ClassName&>().variable)>::type); \
+    context->RegisterAttribute<ClassName>(AttributeTable::MakeInfo(table[AttributeTable::IndexOf(table, name)], \
+        URHO3D_MAKE_MEMBER_ATTRIBUTE_ACCESSOR(std::decay<decltype(std::declval<ClassName&>().variable)>::type, variable)))
+
+/// Register the getter and setter as the attribute name of the table.
+#define URHO3D_TABLE_ACCESSOR_ATTRIBUTE(table, name, getFunction, setFunction, typeName) \
+    URHO3D_TABLE_CHECK(table, name, typeName); \
+    context->RegisterAttribute<ClassName>(AttributeTable::MakeInfo(table[AttributeTable::IndexOf(table, name)], \
+        URHO3D_MAKE_GET_SET_ATTRIBUTE_ACCESSOR(getFunction, setFunction, typeName)))
+
+/// Register the enum getter and setter as the attribute name of the table, which has to be an AttrEnum.
+#define URHO3D_TABLE_ENUM_ACCESSOR_ATTRIBUTE(table, name, getFunction, setFunction, typeName) \
+    URHO3D_TABLE_CHECK(table, name, int); \
+    static_assert(AttributeTable::IsEnum(table, name), "\"" name "\" is not an enum in " #table); \
+    context->RegisterAttribute<ClassName>(AttributeTable::MakeInfo(table[AttributeTable::IndexOf(table, name)], \
+        URHO3D_MAKE_GET_SET_ENUM_ATTRIBUTE_ACCESSOR(getFunction, setFunction, typeName)))
+
+/// Check the table and hand it to the exporter, after all its attributes are registered.
+#define URHO3D_ATTRIBUTE_TABLE(table) \
+    static_assert(AttributeTable::IsValid(table), #table " has duplicate names or descriptors that don't fit their type"); \
+    AttributeTable::Register(context, ClassName::GetTypeStatic(), table)
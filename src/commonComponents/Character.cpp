@@ -35,6 +35,24 @@
 #include <Urho3D/Urho3DAll.h>
 
 #include "Character.h"
+#include <AttributeTable.h>
+
+static constexpr AttributeDesc CHARACTER_ATTRIBUTES[] = {
+    AttrFloat("Controls Yaw", 0.0f, AM_FILE | AM_NOEDIT),
+    AttrFloat("Controls Pitch", 0.0f, AM_FILE | AM_NOEDIT),
+    AttrBool("On Ground", false, AM_FILE | AM_NOEDIT),
+    AttrBool("OK To Jump", true, AM_FILE | AM_NOEDIT),
+    AttrFloat("In Air Timer", 0.0f, AM_FILE | AM_NOEDIT),
+    AttrResourceRef("Animation Idle", "Animation"),
+    AttrResourceRef("Animation Run", "Animation"),
+    AttrResourceRef("Animation Jump", "Animation"),
+    AttrString("Head Bone", ""),
+    AttrFloat("MOVE_FORCE", DEFAULT_MOVE_FORCE),
+    AttrFloat("INAIR_MOVE_FORCE", DEFAULT_INAIR_MOVE_FORCE),
+    AttrFloat("JUMP_FORCE", DEFAULT_JUMP_FORCE),
+    AttrFloat("INAIR_THRESHOLD_TIME", DEFAULT_INAIR_THRESHOLD_TIME, AM_DEFAULT, AST_TIME),
+    AttrFloat("BRAKE_FORCE", DEFAULT_BRAKE_FORCE),
+};
 
 Character::Character(Context* context) :
     LogicComponent(context),
@@ -55,24 +73,23 @@ void Character::RegisterObject(Context* context)
 {
     context->RegisterFactory<Character>("game component");
 
-    // These macros register the class attributes to the Context for automatic load / save handling.
-    // We specify the Default attribute mode which means it will be used both for saving into file, and network replication
-    URHO3D_ATTRIBUTE("Controls Yaw", float, controls_.yaw_, 0.0f, AM_FILE | AM_NOEDIT);
-    URHO3D_ATTRIBUTE("Controls Pitch", float, controls_.pitch_, 0.0f, AM_FILE | AM_NOEDIT);
-    URHO3D_ATTRIBUTE("On Ground", bool, onGround_, false, AM_FILE |AM_NOEDIT);
-    URHO3D_ATTRIBUTE("OK To Jump", bool, okToJump_, true, AM_FILE | AM_NOEDIT);
-    URHO3D_ATTRIBUTE("In Air Timer", float, inAirTimer_, 0.0f, AM_FILE | AM_NOEDIT);
-    //URHO3D_ATTRIBUTE("Anim Run", String, animRun_, "", AM_DEFAULT);
-    URHO3D_MIXED_ACCESSOR_ATTRIBUTE("Animation Idle", GetAnimationIdle, SetAnimationIdle, ResourceRef, ResourceRef(Animation::GetTypeStatic()), AM_DEFAULT);
-    URHO3D_MIXED_ACCESSOR_ATTRIBUTE("Animation Run", GetAnimationRun, SetAnimationRun, ResourceRef, ResourceRef(Animation::GetTypeStatic()), AM_DEFAULT);
-    URHO3D_MIXED_ACCESSOR_ATTRIBUTE("Animation Jump", GetAnimationJump, SetAnimationJump, ResourceRef, ResourceRef(Animation::GetTypeStatic()), AM_DEFAULT);
-    URHO3D_ATTRIBUTE("Head Bone", String, headNodeName_, "", AM_DEFAULT);
-
-    URHO3D_ATTRIBUTE("MOVE_FORCE", float, MOVE_FORCE, DEFAULT_MOVE_FORCE, AM_DEFAULT);
-    URHO3D_ATTRIBUTE("INAIR_MOVE_FORCE", float, INAIR_MOVE_FORCE, DEFAULT_INAIR_MOVE_FORCE, AM_DEFAULT);
-    URHO3D_ATTRIBUTE("JUMP_FORCE", float, JUMP_FORCE, DEFAULT_JUMP_FORCE, AM_DEFAULT);
-    URHO3D_ATTRIBUTE("INAIR_THRESHOLD_TIME", float, INAIR_THRESHOLD_TIME, DEFAULT_INAIR_THRESHOLD_TIME, AM_DEFAULT);
-    URHO3D_ATTRIBUTE("BRAKE_FORCE", float, BRAKE_FORCE, DEFAULT_BRAKE_FORCE, AM_DEFAULT);
+    // names, defaults and modes are in CHARACTER_ATTRIBUTES, the registration is checked against it at compile time
+    URHO3D_TABLE_ATTRIBUTE(CHARACTER_ATTRIBUTES, "Controls Yaw", controls_.yaw_);
+    URHO3D_TABLE_ATTRIBUTE(CHARACTER_ATTRIBUTES, "Controls Pitch", controls_.pitch_);
+    URHO3D_TABLE_ATTRIBUTE(CHARACTER_ATTRIBUTES, "On Ground", onGround_);
+    URHO3D_TABLE_ATTRIBUTE(CHARACTER_ATTRIBUTES, "OK To Jump", okToJump_);
+    URHO3D_TABLE_ATTRIBUTE(CHARACTER_ATTRIBUTES, "In Air Timer", inAirTimer_);
+    URHO3D_TABLE_ACCESSOR_ATTRIBUTE(CHARACTER_ATTRIBUTES, "Animation Idle", GetAnimationIdle, SetAnimationIdle, ResourceRef);
+    URHO3D_TABLE_ACCESSOR_ATTRIBUTE(CHARACTER_ATTRIBUTES, "Animation Run", GetAnimationRun, SetAnimationRun, ResourceRef);
+    URHO3D_TABLE_ACCESSOR_ATTRIBUTE(CHARACTER_ATTRIBUTES, "Animation Jump", GetAnimationJump, SetAnimationJump, ResourceRef);
+    URHO3D_TABLE_ATTRIBUTE(CHARACTER_ATTRIBUTES, "Head Bone", headNodeName_);
+
+    URHO3D_TABLE_ATTRIBUTE(CHARACTER_ATTRIBUTES, "MOVE_FORCE", MOVE_FORCE);
+    URHO3D_TABLE_ATTRIBUTE(CHARACTER_ATTRIBUTES, "INAIR_MOVE_FORCE", INAIR_MOVE_FORCE);
+    URHO3D_TABLE_ATTRIBUTE(CHARACTER_ATTRIBUTES, "JUMP_FORCE", JUMP_FORCE);
+    URHO3D_TABLE_ATTRIBUTE(CHARACTER_ATTRIBUTES, "INAIR_THRESHOLD_TIME", INAIR_THRESHOLD_TIME);
+    URHO3D_TABLE_ATTRIBUTE(CHARACTER_ATTRIBUTES, "BRAKE_FORCE", BRAKE_FORCE);
+    URHO3D_ATTRIBUTE_TABLE(CHARACTER_ATTRIBUTES);
 }
 
 void Character::DelayedStart()
@@ -35,11 +35,11 @@ const unsigned CTRL_LEFT = 4;
 const unsigned CTRL_RIGHT = 8;
 const unsigned CTRL_JUMP = 16;
 
-const float DEFAULT_MOVE_FORCE = 0.8f;
-const float DEFAULT_INAIR_MOVE_FORCE = 0.02f;
-const float DEFAULT_BRAKE_FORCE = 0.2f;
-const float DEFAULT_JUMP_FORCE = 7.0f;
-const float DEFAULT_INAIR_THRESHOLD_TIME = 0.1f;
+constexpr float DEFAULT_MOVE_FORCE = 0.8f;
+constexpr float DEFAULT_INAIR_MOVE_FORCE = 0.02f;
+constexpr float DEFAULT_BRAKE_FORCE = 0.2f;
+constexpr float DEFAULT_JUMP_FORCE = 7.0f;
+constexpr float DEFAULT_INAIR_THRESHOLD_TIME = 0.1f;
 
 /// Character component, responsible for physical movement according to controls, as well as animation.
 class Character : public LogicComponent
@@ -1,15 +1,39 @@
 #include "GroupInstance.h"
+#include "GroupTemplateCache.h"
+
+#include <AttributeTable.h>
+
+static constexpr AttributeDesc GROUPINSTANCE_ATTRIBUTES[] = {
+    AttrBool("useInstancing", false),
+    AttrString("groupFilename", ""),
+    AttrVector3("groupOffset", 0.0f, 0.0f, 0.0f),
+};
 
 GroupInstance::GroupInstance(Context *ctx)
-    : Component(ctx), groupRoot(0)
+    : Component(ctx), useInstancing(false)
 {}
 
+GroupInstance::~GroupInstance()
+{
+    for (auto& instance : instances){
+        if (instance.first_ && instance.second_)
+            instance.first_->RemoveInstanceNode(instance.second_);
+    }
+}
+
 void GroupInstance::RegisterObject(Context *context)
 {
     context->RegisterFactory<GroupInstance>();
 
-    URHO3D_ACCESSOR_ATTRIBUTE("groupFilename", GetGroupFilename, SetGroupFilename, String, String::EMPTY, AM_DEFAULT);
-    URHO3D_ACCESSOR_ATTRIBUTE("groupOffset", GetGroupOffset, SetGroupOffset, Vector3, Vector3(0,0,0), AM_DEFAULT);
+    if (!context->GetSubsystem<GroupTemplateCache>()){
+        context->RegisterSubsystem(new GroupTemplateCache(context));
+    }
+
+    // before groupFilename so the group is created only once on load
+    URHO3D_TABLE_ACCESSOR_ATTRIBUTE(GROUPINSTANCE_ATTRIBUTES, "useInstancing", GetUseInstancing, SetUseInstancing, bool);
+    URHO3D_TABLE_ACCESSOR_ATTRIBUTE(GROUPINSTANCE_ATTRIBUTES, "groupFilename", GetGroupFilename, SetGroupFilename, String);
+    URHO3D_TABLE_ACCESSOR_ATTRIBUTE(GROUPINSTANCE_ATTRIBUTES, "groupOffset", GetGroupOffset, SetGroupOffset, Vector3);
+    URHO3D_ATTRIBUTE_TABLE(GROUPINSTANCE_ATTRIBUTES);
 }
 
 void GroupInstance::SetGroupFilename(const String &groupFilename)
@@ -17,22 +41,55 @@ void GroupInstance::SetGroupFilename(const String &groupFilename)
     if (groupFilename == this->groupFilename) return;
 
     this->groupFilename=groupFilename;
+    CreateGroup();
+}
 
-    FileSystem* fs = GetSubsystem<FileSystem>();
+void GroupInstance::SetUseInstancing(bool useInstancing)
+{
+    if (useInstancing == this->useInstancing) return;
 
-    ResourceCache* cache = GetSubsystem<ResourceCache>();
-    XMLFile* file = cache->GetResource<XMLFile>(groupFilename);
-    groupRoot = node_->CreateChild("group_root");
-    groupRoot->LoadXML(file->GetRoot());
-//    for (auto child : groupRoot->GetChildren()){
-//        node_->AddChild(child);
-//    }
-//    groupRoot->Remove();
+    this->useInstancing = useInstancing;
+    if (groupRoot){
+        CreateGroup();
+    }
 }
 
 void GroupInstance::SetGroupOffset(const Vector3& groupOffset){
-    for (Node* node : groupRoot->GetChildren()){
-        node->Translate(groupOffset*-1);
+    if (groupRoot){
+        // move by the difference only, the children might already be offset
+        for (Node* node : groupRoot->GetChildren()){
+            node->Translate(this->groupOffset-groupOffset);
+        }
     }
     this->groupOffset = groupOffset;
 }
+
+void GroupInstance::CreateGroup()
+{
+    RemoveGroup();
+
+    if (groupFilename.Empty() || !node_) return;
+
+    // the group file is parsed once and every instance is cloned from the cached prototype
+    GroupTemplateCache* templateCache = GetSubsystem<GroupTemplateCache>();
+    groupRoot = templateCache->Instantiate(groupFilename, node_, useInstancing, &instances);
+    if (groupRoot){
+        for (Node* node : groupRoot->GetChildren()){
+            node->Translate(groupOffset*-1);
+        }
+    }
+}
+
+void GroupInstance::RemoveGroup()
+{
+    for (auto& instance : instances){
+        if (instance.first_ && instance.second_)
+            instance.first_->RemoveInstanceNode(instance.second_);
+    }
+    instances.Clear();
+
+    if (groupRoot){
+        groupRoot->Remove();
+        groupRoot.Reset();
+    }
+}
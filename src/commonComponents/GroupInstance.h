@@ -9,6 +9,7 @@ public:
     static void RegisterObject(Context *context);
 
     GroupInstance(Context* ctx);
+    virtual ~GroupInstance() override;
 
     void SetGroupFilename(const String& grpInstanceName);
     const String& GetGroupFilename() const  { return groupFilename;}
@@ -16,11 +17,20 @@ public:
     const Vector3& GetGroupOffset() const  { return groupOffset;}
     void SetGroupOffset(const Vector3& groupOffset);
 
+    /// Render the plain StaticModels of the group through shared StaticModelGroups
+    void SetUseInstancing(bool useInstancing);
+    bool GetUseInstancing() const { return useInstancing;}
+
 private:
+    void CreateGroup();
+    void RemoveGroup();
+
     String groupFilename;
-    Node* groupRoot;
+    WeakPtr<Node> groupRoot;
     Vector3 groupOffset;
-
+    bool useInstancing;
+    /// instance nodes registered in the scene's StaticModelGroups
+    Vector<Pair<WeakPtr<StaticModelGroup>, WeakPtr<Node> > > instances;
 };
 
 
@@ -0,0 +1,191 @@
+#include "GroupTemplateCache.h"
+
+static const char* INSTANCING_NODE_NAME = "__groupInstancing";
+
+GroupTemplateCache::GroupTemplateCache(Context *ctx)
+    : Object(ctx)
+{
+}
+
+GroupTemplate* GroupTemplateCache::GetTemplate(const String& groupFilename)
+{
+    StringHash key(groupFilename);
+    auto it = templates_.Find(key);
+    if (it != templates_.End())
+        return it->second_;
+
+    ResourceCache* cache = GetSubsystem<ResourceCache>();
+    XMLFile* file = cache->GetResource<XMLFile>(groupFilename);
+    if (!file){
+        URHO3D_LOGERRORF("[GroupTemplateCache] could not load group:%s",groupFilename.CString());
+        return nullptr;
+    }
+
+    SharedPtr<GroupTemplate> groupTemplate = CreateTemplate(file);
+    if (!groupTemplate)
+        return nullptr;
+
+    templates_[key] = groupTemplate;
+    SubscribeToEvent(file, E_RELOADFINISHED, URHO3D_HANDLER(GroupTemplateCache, HandleReloadFinished));
+    return groupTemplate;
+}
+
+SharedPtr<GroupTemplate> GroupTemplateCache::CreateTemplate(XMLFile* file)
+{
+    if (!prototypeScene_){
+        prototypeScene_ = new Scene(context_);
+    }
+
+    Node* root = prototypeScene_->CreateChild("group_root");
+    if (!root->LoadXML(file->GetRoot())){
+        URHO3D_LOGERRORF("[GroupTemplateCache] could not parse group:%s",file->GetName().CString());
+        root->Remove();
+        return SharedPtr<GroupTemplate>();
+    }
+    if (root->GetName().Empty()){
+        root->SetName("group_root");
+    }
+
+    SharedPtr<GroupTemplate> groupTemplate(new GroupTemplate());
+    groupTemplate->fileName_ = file->GetName();
+    groupTemplate->position_ = root->GetPosition();
+    groupTemplate->rotation_ = root->GetRotation();
+    root->Save(groupTemplate->data_);
+
+    // strip the plain StaticModels for the instanced variant. derived types like
+    // AnimatedModel need their own node and stay as they are
+    PODVector<Node*> nodes;
+    CollectNodes(root, nodes);
+    for (unsigned i = 0; i < nodes.Size(); i++){
+        StaticModel* staticModel = nodes[i]->GetComponent<StaticModel>();
+        if (!staticModel || !staticModel->GetModel() || staticModel->IsTemporary())
+            continue;
+
+        GroupTemplate::InstancedModel instancedModel;
+        instancedModel.nodeIndex_ = i;
+        instancedModel.model_ = staticModel->GetModel();
+        for (unsigned j = 0; j < instancedModel.model_->GetNumGeometries(); j++){
+            instancedModel.materials_.Push(SharedPtr<Material>(staticModel->GetMaterial(j)));
+        }
+        instancedModel.castShadows_ = staticModel->GetCastShadows();
+        instancedModel.viewMask_ = staticModel->GetViewMask();
+        instancedModel.drawDistance_ = staticModel->GetDrawDistance();
+        groupTemplate->instancedModels_.Push(instancedModel);
+
+        staticModel->Remove();
+    }
+    if (!groupTemplate->instancedModels_.Empty()){
+        root->Save(groupTemplate->instancedData_);
+    }
+
+    root->Remove();
+
+    URHO3D_LOGINFOF("[GroupTemplateCache] parsed group %s (%u nodes, %u instanceable models)",file->GetName().CString(),
+                    nodes.Size(),groupTemplate->instancedModels_.Size());
+    return groupTemplate;
+}
+
+Node* GroupTemplateCache::Instantiate(const String& groupFilename, Node* parent, bool useInstancing,
+                                      Vector<Pair<WeakPtr<StaticModelGroup>, WeakPtr<Node> > >* instances)
+{
+    Scene* scene = parent ? parent->GetScene() : nullptr;
+    if (!scene)
+        return nullptr;
+
+    GroupTemplate* groupTemplate = GetTemplate(groupFilename);
+    if (!groupTemplate)
+        return nullptr;
+
+    // nested groups inside a prototype are thrown away after saving, no need to instance them
+    bool instanced = useInstancing && !groupTemplate->instancedModels_.Empty() && scene != prototypeScene_;
+    const VectorBuffer& data = instanced ? groupTemplate->instancedData_ : groupTemplate->data_;
+
+    MemoryBuffer buffer(data.GetData(), data.GetSize());
+    Node* root = scene->Instantiate(buffer, groupTemplate->position_, groupTemplate->rotation_, REPLICATED);
+    if (!root){
+        URHO3D_LOGERRORF("[GroupTemplateCache] could not instantiate group:%s",groupFilename.CString());
+        return nullptr;
+    }
+    parent->AddChild(root);
+    // the content is recreated from the group file on load, don't save it with the scene
+    root->SetTemporary(true);
+
+    if (instanced){
+        PODVector<Node*> nodes;
+        CollectNodes(root, nodes);
+        for (const GroupTemplate::InstancedModel& instancedModel : groupTemplate->instancedModels_){
+            if (instancedModel.nodeIndex_ >= nodes.Size())
+                continue;
+
+            Node* node = nodes[instancedModel.nodeIndex_];
+            StaticModelGroup* group = GetInstancingGroup(scene, instancedModel);
+            group->AddInstanceNode(node);
+            if (instances){
+                instances->Push(MakePair(WeakPtr<StaticModelGroup>(group), WeakPtr<Node>(node)));
+            }
+        }
+    }
+    return root;
+}
+
+StaticModelGroup* GroupTemplateCache::GetInstancingGroup(Scene* scene, const GroupTemplate::InstancedModel& instancedModel)
+{
+    Node* instancingNode = scene->GetChild(INSTANCING_NODE_NAME);
+    if (!instancingNode){
+        instancingNode = scene->CreateChild(INSTANCING_NODE_NAME, LOCAL);
+        instancingNode->SetTemporary(true);
+    }
+
+    PODVector<StaticModelGroup*> groups;
+    instancingNode->GetComponents<StaticModelGroup>(groups);
+    for (StaticModelGroup* group : groups){
+        if (group->GetModel() != instancedModel.model_ || group->GetCastShadows() != instancedModel.castShadows_ ||
+                group->GetViewMask() != instancedModel.viewMask_ || group->GetDrawDistance() != instancedModel.drawDistance_)
+            continue;
+
+        bool sameMaterials = true;
+        for (unsigned i = 0; i < instancedModel.materials_.Size(); i++){
+            if (group->GetMaterial(i) != instancedModel.materials_[i]){
+                sameMaterials = false;
+                break;
+            }
+        }
+        if (sameMaterials)
+            return group;
+    }
+
+    StaticModelGroup* group = instancingNode->CreateComponent<StaticModelGroup>(LOCAL);
+    group->SetModel(instancedModel.model_);
+    for (unsigned i = 0; i < instancedModel.materials_.Size(); i++){
+        group->SetMaterial(i, instancedModel.materials_[i]);
+    }
+    group->SetCastShadows(instancedModel.castShadows_);
+    group->SetViewMask(instancedModel.viewMask_);
+    group->SetDrawDistance(instancedModel.drawDistance_);
+    return group;
+}
+
+void GroupTemplateCache::CollectNodes(Node* node, PODVector<Node*>& dest)
+{
+    dest.Push(node);
+    for (Node* child : node->GetChildren()){
+        if (child->IsTemporary())
+            continue;
+        CollectNodes(child, dest);
+    }
+}
+
+void GroupTemplateCache::HandleReloadFinished(StringHash eventType, VariantMap& eventData)
+{
+    XMLFile* file = static_cast<XMLFile*>(GetEventSender());
+    if (!file)
+        return;
+
+    // instances created from now on use the new content
+    for (auto it = templates_.Begin(); it != templates_.End();){
+        if (it->second_->fileName_ == file->GetName())
+            it = templates_.Erase(it);
+        else
+            ++it;
+    }
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <Urho3D/Urho3DAll.h>
+
+/// A group file parsed once and kept as binary node data.
+struct GroupTemplate : public RefCounted
+{
+    /// StaticModel that is rendered through a StaticModelGroup in instanced mode
+    struct InstancedModel
+    {
+        /// index of the node in the depth-first order of CollectNodes
+        unsigned nodeIndex_;
+        SharedPtr<Model> model_;
+        Vector<SharedPtr<Material> > materials_;
+        bool castShadows_;
+        unsigned viewMask_;
+        float drawDistance_;
+    };
+
+    String fileName_;
+    Vector3 position_;
+    Quaternion rotation_;
+    /// the complete hierarchy
+    VectorBuffer data_;
+    /// the hierarchy without the StaticModels listed in instancedModels_
+    VectorBuffer instancedData_;
+    Vector<InstancedModel> instancedModels_;
+};
+
+/// Parses every group file only once and clones GroupInstance hierarchies from the
+/// binary prototype. Optionally the plain StaticModels of a group are not created
+/// per instance but registered in one StaticModelGroup per model and materials.
+class GroupTemplateCache : public Object
+{
+    URHO3D_OBJECT(GroupTemplateCache,Object);
+public:
+    GroupTemplateCache(Context* ctx);
+
+    /// Return the template of a group file. Parses the file on first use.
+    GroupTemplate* GetTemplate(const String& groupFilename);
+
+    /// Create the nodes of a group file under parent. In instanced mode the instance nodes
+    /// and the groups they were registered in are appended to instances.
+    Node* Instantiate(const String& groupFilename, Node* parent, bool useInstancing,
+                      Vector<Pair<WeakPtr<StaticModelGroup>, WeakPtr<Node> > >* instances = nullptr);
+
+    /// Depth-first list of node and its descendants. Temporary subtrees (nested groups) are skipped.
+    static void CollectNodes(Node* node, PODVector<Node*>& dest);
+
+private:
+    SharedPtr<GroupTemplate> CreateTemplate(XMLFile* file);
+    StaticModelGroup* GetInstancingGroup(Scene* scene, const GroupTemplate::InstancedModel& instancedModel);
+    void HandleReloadFinished(StringHash eventType, VariantMap& eventData);
+
+    /// scratch scene the group files are parsed into
+    SharedPtr<Scene> prototypeScene_;
+    HashMap<StringHash, SharedPtr<GroupTemplate> > templates_;
+};
@@ -1,6 +1,7 @@
 #include <Urho3D/Urho3DAll.h>
 
 #include "NavigationMesh.h"
+#include <AttributeTable.h>
 #include <Globals.h>
 
 static const char* typeNames[] =
@@ -12,9 +13,19 @@ static const char* typeNames[] =
 
 static const NavMeshType DEFAULT_NAVMESHTYPE = NAV_Static;
 static const int DEFAULT_TILESIZE=32;
-static const float DEFAULT_AGENT_HEIGHT=0.5f;
-static const float DEFAULT_AGENT_MAXCLIMB=0.25f;
-static const float DEFAULT_CELL_HEIGHT=0.05;
+static constexpr float DEFAULT_AGENT_HEIGHT=0.5f;
+static constexpr float DEFAULT_AGENT_MAXCLIMB=0.25f;
+static constexpr float DEFAULT_CELL_HEIGHT=0.05f;
+
+static constexpr AttributeDesc NAVIGATIONMESH_ATTRIBUTES[] = {
+    AttrEnum("Navmesh Type", typeNames, DEFAULT_NAVMESHTYPE),
+    AttrBool("activateNavigation", false),
+    AttrBool("showNavmesh", true),
+    AttrInt("tileSize", DEFAULT_TILESIZE, AM_DEFAULT, AST_UNSIGNED),
+    AttrFloat("agent height", DEFAULT_AGENT_HEIGHT, AM_DEFAULT, AST_DISTANCE),
+    AttrFloat("agent max climb", DEFAULT_AGENT_MAXCLIMB, AM_DEFAULT, AST_DISTANCE),
+    AttrFloat("cell height", DEFAULT_CELL_HEIGHT, AM_DEFAULT, AST_DISTANCE),
+};
 
 CNavigationMesh::CNavigationMesh(Context* context)
     : LogicComponent(context)
@@ -33,13 +44,14 @@ CNavigationMesh::CNavigationMesh(Context* context)
 void CNavigationMesh::RegisterObject(Context* context) {
     context->RegisterFactory<CNavigationMesh>("Sample Component");
     //URHO3D_ACCESSOR_ATTRIBUTE("Speed", GetSpeed, SetSpeed, float,1.5f,AM_DEFAULT);
-    URHO3D_ENUM_ACCESSOR_ATTRIBUTE("Navmesh Type",GetNavmeshType,SetNavmeshType,NavMeshType,typeNames,DEFAULT_NAVMESHTYPE,AM_DEFAULT);
-    URHO3D_ATTRIBUTE("activateNavigation", bool, activateNavigation, false, AM_DEFAULT);
-    URHO3D_ATTRIBUTE("showNavmesh", bool, showNavmesh, true, AM_DEFAULT);
-    URHO3D_ATTRIBUTE("tileSize", int, tileSize, DEFAULT_TILESIZE, AM_DEFAULT);
-    URHO3D_ATTRIBUTE("agent height", float, agentHeight, DEFAULT_AGENT_HEIGHT, AM_DEFAULT);
-    URHO3D_ATTRIBUTE("agent max climb", float, agentMaxClimb, DEFAULT_AGENT_MAXCLIMB, AM_DEFAULT);
-    URHO3D_ATTRIBUTE("cell height", float, cellHeight, DEFAULT_CELL_HEIGHT, AM_DEFAULT);
+    URHO3D_TABLE_ENUM_ACCESSOR_ATTRIBUTE(NAVIGATIONMESH_ATTRIBUTES, "Navmesh Type", GetNavmeshType, SetNavmeshType, NavMeshType);
+    URHO3D_TABLE_ATTRIBUTE(NAVIGATIONMESH_ATTRIBUTES, "activateNavigation", activateNavigation);
+    URHO3D_TABLE_ATTRIBUTE(NAVIGATIONMESH_ATTRIBUTES, "showNavmesh", showNavmesh);
+    URHO3D_TABLE_ATTRIBUTE(NAVIGATIONMESH_ATTRIBUTES, "tileSize", tileSize);
+    URHO3D_TABLE_ATTRIBUTE(NAVIGATIONMESH_ATTRIBUTES, "agent height", agentHeight);
+    URHO3D_TABLE_ATTRIBUTE(NAVIGATIONMESH_ATTRIBUTES, "agent max climb", agentMaxClimb);
+    URHO3D_TABLE_ATTRIBUTE(NAVIGATIONMESH_ATTRIBUTES, "cell height", cellHeight);
+    URHO3D_ATTRIBUTE_TABLE(NAVIGATIONMESH_ATTRIBUTES);
 }
 
 void CNavigationMesh::SetNavmeshType(NavMeshType type)
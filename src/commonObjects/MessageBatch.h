@@ -0,0 +1,95 @@
+#pragma once
+
+#include <Urho3D/IO/MemoryBuffer.h>
+#include <Urho3D/IO/VectorBuffer.h>
+
+using namespace Urho3D;
+
+/// A frame of a message, pointing into the received data.
+struct FrameView{
+    const char* data_;
+    unsigned size_;
+};
+
+/// Small messages of a frame packed into one envelope, so a chatty frame costs one send.
+///
+/// Every message is written as its frame count followed by each frame as size and bytes, all
+/// numbers as little endian uint32. The envelope is sent under the topic of its messages, so
+/// the subscription filters of the receivers still work, and unpacked on their side with
+/// Unpack().
+class MessageBatch {
+public:
+    /// Messages with more frames are not batched.
+    static const unsigned MAX_FRAMES = 16;
+
+    MessageBatch() : count_(0) {}
+
+    /// Start a message of numFrames, followed by that many AddFrame().
+    void BeginMessage(unsigned numFrames)
+    {
+        data_.WriteUInt(numFrames);
+        count_++;
+    }
+    void AddFrame(const void* data, unsigned size)
+    {
+        data_.WriteUInt(size);
+        if (size)
+            data_.Write(data, size);
+    }
+
+    /// Bytes a message of these frame sizes takes in the batch.
+    static unsigned GetRecordSize(unsigned numFrames, unsigned frameBytes) { return 4 + numFrames * 4 + frameBytes; }
+
+    const void* GetData() const { return data_.GetData(); }
+    unsigned GetSize() const { return data_.GetSize(); }
+    unsigned GetCount() const { return count_; }
+    bool Empty() const { return !count_; }
+    /// Reset after sending, the memory is kept for the next frame.
+    void Clear()
+    {
+        data_.Clear();
+        count_ = 0;
+    }
+
+    /// Call handler(const FrameView* frames, unsigned numFrames) for every message in a received
+    /// envelope, in the order they were added. Return false if the data is malformed, the
+    /// messages before that are handled.
+    template <class Handler> static bool Unpack(const void* data, unsigned size, Handler handler)
+    {
+        MemoryBuffer buffer(data, size);
+        FrameView frames[MAX_FRAMES];
+        unsigned numFrames;
+        while (!buffer.IsEof()){
+            if (!ReadMessage(buffer, frames, numFrames))
+                return false;
+            handler(frames, numFrames);
+        }
+        return true;
+    }
+
+    /// Read one message at the position of buffer into frames, which has room for maxFrames.
+    /// A message without frames is malformed, every message has at least its topic.
+    static bool ReadMessage(MemoryBuffer& buffer, FrameView* frames, unsigned& numFrames, unsigned maxFrames = MAX_FRAMES)
+    {
+        if (buffer.GetSize() - buffer.GetPosition() < 4)
+            return false;
+        numFrames = buffer.ReadUInt();
+        if (!numFrames || numFrames > maxFrames)
+            return false;
+        for (unsigned i = 0; i < numFrames; ++i){
+            if (buffer.GetSize() - buffer.GetPosition() < 4)
+                return false;
+            unsigned frameSize = buffer.ReadUInt();
+            if (buffer.GetSize() - buffer.GetPosition() < frameSize)
+                return false;
+            frames[i].data_ = reinterpret_cast<const char*>(buffer.GetData()) + buffer.GetPosition();
+            frames[i].size_ = frameSize;
+            buffer.Seek(buffer.GetPosition() + frameSize);
+        }
+        return true;
+    }
+
+private:
+    VectorBuffer data_;
+    unsigned count_;
+};
@@ -0,0 +1,150 @@
+#include "MessageLog.h"
+
+#include <Urho3D/Core/Context.h>
+#include <Urho3D/Core/Timer.h>
+#include <Urho3D/IO/Log.h>
+
+#include <cstring>
+
+// microseconds and frame in front of every message
+static const unsigned MESSAGE_HEADER_SIZE = 12;
+
+MessageLog::MessageLog(Context* context)
+    : context_(context)
+    , replayPosition_(0)
+    , replayFast_(false)
+    , replayStarted_(false)
+    , numReplayed_(0)
+{
+}
+
+MessageLog::~MessageLog()
+{
+    Close();
+}
+
+bool MessageLog::BeginRecording(const String& fileName)
+{
+    recordFile_ = new File(context_,fileName,FILE_WRITE);
+    if (!recordFile_->IsOpen()){
+        URHO3D_LOGERRORF("[MessageLog] can't write %s",fileName.CString());
+        recordFile_.Reset();
+        return false;
+    }
+    recordFile_->WriteFileID("URNL");
+    recordFile_->WriteUInt(VERSION);
+    recordTimer_.Reset();
+    URHO3D_LOGINFOF("[MessageLog] recording to %s",fileName.CString());
+    return true;
+}
+
+void MessageLog::Record(const FrameView* frames, unsigned numFrames)
+{
+    if (!recordFile_)
+        return;
+
+    unsigned long long time = recordTimer_.GetUSec(false);
+    recordFile_->Write(&time,sizeof(time));
+    recordFile_->WriteUInt(context_->GetSubsystem<Time>()->GetFrameNumber());
+    recordFile_->WriteUInt(numFrames);
+    for (unsigned i = 0; i < numFrames; ++i){
+        recordFile_->WriteUInt(frames[i].size_);
+        if (frames[i].size_){
+            recordFile_->Write(frames[i].data_,frames[i].size_);
+        }
+    }
+}
+
+bool MessageLog::BeginReplay(const String& fileName, bool fast)
+{
+    File file(context_,fileName,FILE_READ);
+    if (!file.IsOpen()){
+        URHO3D_LOGERRORF("[MessageLog] can't read %s",fileName.CString());
+        return false;
+    }
+    if (file.ReadFileID() != "URNL" || file.ReadUInt() != VERSION){
+        URHO3D_LOGERRORF("[MessageLog] %s is no message log of version %u",fileName.CString(),VERSION);
+        return false;
+    }
+
+    // all of it, the messages of the replay point into it
+    replayData_.Resize(file.GetSize() - file.GetPosition());
+    if (replayData_.Size() && file.Read(replayData_.Buffer(),replayData_.Size()) != replayData_.Size()){
+        URHO3D_LOGERRORF("[MessageLog] can't read %s",fileName.CString());
+        replayData_.Clear();
+        return false;
+    }
+    replayPosition_ = 0;
+    replayFast_ = fast;
+    replayStarted_ = false;
+    numReplayed_ = 0;
+    URHO3D_LOGINFOF("[MessageLog] replaying %s%s",fileName.CString(),fast ? " fast" : "");
+    return true;
+}
+
+bool MessageLog::PeekNext(unsigned long long& time, unsigned& frame) const
+{
+    if (replayData_.Size() - replayPosition_ < MESSAGE_HEADER_SIZE)
+        return false;
+    const unsigned char* header = replayData_.Buffer() + replayPosition_;
+    memcpy(&time,header,sizeof(time));
+    memcpy(&frame,header + sizeof(time),sizeof(frame));
+    return true;
+}
+
+unsigned MessageLog::Replay(const Handler& handler)
+{
+    // the time counts from the first frame that asks, not from loading
+    if (!replayStarted_){
+        replayTimer_.Reset();
+        replayStarted_ = true;
+    }
+    unsigned long long now = replayTimer_.GetUSec(false);
+
+    unsigned count = 0;
+    unsigned long long time;
+    unsigned frame;
+    unsigned replayFrame = 0;
+    if (replayFrames_.Empty())
+        replayFrames_.Resize(MessageBatch::MAX_FRAMES);
+    while (PeekNext(time,frame)){
+        if (replayFast_){
+            // the messages of one recorded frame
+            if (count && frame != replayFrame)
+                break;
+            replayFrame = frame;
+        }
+        else if (time > now){
+            break;
+        }
+
+        MemoryBuffer buffer(replayData_.Buffer() + replayPosition_,replayData_.Size() - replayPosition_);
+        buffer.Seek(MESSAGE_HEADER_SIZE);
+        // every frame takes at least its size, that bounds the count of a malformed message
+        unsigned numFrames = buffer.GetSize() - buffer.GetPosition() >= 4 ? buffer.ReadUInt() : 0;
+        if (numFrames > replayFrames_.Size() && numFrames <= (buffer.GetSize() - buffer.GetPosition()) / 4)
+            replayFrames_.Resize(numFrames);
+        buffer.Seek(MESSAGE_HEADER_SIZE);
+        if (!MessageBatch::ReadMessage(buffer,replayFrames_.Buffer(),numFrames,replayFrames_.Size())){
+            URHO3D_LOGERRORF("[MessageLog] malformed message at %u, replay stopped",replayPosition_);
+            replayPosition_ = replayData_.Size();
+            break;
+        }
+        replayPosition_ += buffer.GetPosition();
+
+        handler(replayFrames_.Buffer(),numFrames);
+        count++;
+    }
+    numReplayed_ += count;
+    return count;
+}
+
+void MessageLog::Close()
+{
+    if (recordFile_){
+        recordFile_->Close();
+        recordFile_.Reset();
+    }
+    replayData_.Clear();
+    replayPosition_ = 0;
+}
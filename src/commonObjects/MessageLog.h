@@ -0,0 +1,62 @@
+#pragma once
+
+#include <Urho3D/Container/Ptr.h>
+#include <Urho3D/Container/Str.h>
+#include <Urho3D/Container/Vector.h>
+#include <Urho3D/Core/Timer.h>
+#include <Urho3D/IO/File.h>
+
+#include "MessageBatch.h"
+
+#include <functional>
+
+using namespace Urho3D;
+
+/// Received network messages with the time they came in, written to a file to replay the session
+/// later without blender, e.g. under a profiler or as a benchmark.
+///
+/// The file starts with "URNL" and the version (uint32), followed by every message as the
+/// microseconds since the recording started (uint64), the frame it was received in (uint32)
+/// and the message itself in the layout of MessageBatch, with any number of frames.
+class MessageLog {
+public:
+    static const unsigned VERSION = 1;
+    typedef std::function<void(const FrameView* frames, unsigned numFrames)> Handler;
+
+    explicit MessageLog(Context* context);
+    ~MessageLog();
+
+    /// Write every message passed to Record() to fileName.
+    bool BeginRecording(const String& fileName);
+    void Record(const FrameView* frames, unsigned numFrames);
+    bool IsRecording() const { return recordFile_.NotNull(); }
+
+    /// Load a recording for Replay(). Fast replays a recorded frame per frame and skips the
+    /// time in between, otherwise the messages come at the time they were recorded.
+    bool BeginReplay(const String& fileName, bool fast);
+    /// Pass the messages that are due this frame to handler. Return how many.
+    unsigned Replay(const Handler& handler);
+    bool IsReplaying() const { return !replayData_.Empty(); }
+    /// All messages replayed, or the rest of the file is malformed.
+    bool IsReplayFinished() const { return replayPosition_ >= replayData_.Size(); }
+    unsigned GetNumReplayed() const { return numReplayed_; }
+
+    void Close();
+
+private:
+    /// Read the header of the next message, false at the end.
+    bool PeekNext(unsigned long long& time, unsigned& frame) const;
+
+    Context* context_;
+    SharedPtr<File> recordFile_;
+    HiresTimer recordTimer_;
+
+    PODVector<unsigned char> replayData_;
+    /// Frames of the replayed message, grown for messages with more than MessageBatch::MAX_FRAMES.
+    PODVector<FrameView> replayFrames_;
+    unsigned replayPosition_;
+    bool replayFast_;
+    bool replayStarted_;
+    HiresTimer replayTimer_;
+    unsigned numReplayed_;
+};
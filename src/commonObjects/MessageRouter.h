@@ -0,0 +1,200 @@
+#pragma once
+
+#include <Urho3D/Container/HashMap.h>
+#include <Urho3D/Container/List.h>
+#include <Urho3D/Container/Str.h>
+#include <Urho3D/Container/Vector.h>
+#include <Urho3D/Core/Variant.h>
+#include <Urho3D/Math/StringHash.h>
+
+#include <cstring>
+#include <functional>
+
+using namespace Urho3D;
+
+/// Words of a topic frame like "blender component-resync text", pointing into the frame.
+struct TopicTokens{
+    static const unsigned MAX_TOKENS = 4;
+
+    const char* begin_[MAX_TOKENS];
+    unsigned length_[MAX_TOKENS];
+    /// hash of each word, the same as MessageRouter::Hash() of it
+    unsigned hash_[MAX_TOKENS];
+    unsigned count_;
+
+    String ToString(unsigned index) const { return index < count_ ? String(begin_[index], length_[index]) : String::EMPTY; }
+    unsigned GetHash(unsigned index) const { return index < count_ ? hash_[index] : 0; }
+    bool Equals(unsigned index, const char* word) const
+    {
+        return index < count_ && String::CStringLength(word) == length_[index] && !strncmp(begin_[index], word, length_[index]);
+    }
+};
+
+/// Dispatch of network messages by topic and subtype.
+///
+/// Handlers subscribe to a topic and subtype, or to the subtype "*" which gets everything of
+/// the topic no other route took. Routes are found by hash, the topic frame is split without
+/// allocations and a message that has no route is rejected before anything of it is parsed.
+/// The key of a route is only 32 bits, routes whose keys collide share it and are told apart by
+/// their words.
+class MessageRouter {
+public:
+    /// route key and the message data
+    typedef std::function<void(StringHash, VariantMap&)> Handler;
+
+    struct Route{
+        /// "topic subtype"
+        String name_;
+        String topic_;
+        String subtype_;
+        StringHash key_;
+        Vector<Handler> handlers_;
+        /// messages dispatched to this route
+        unsigned count_ = 0;
+    };
+
+    MessageRouter() : unrouted_(0) {}
+
+    /// Hash of a topic word, case-sensitive unlike StringHash. 0 for an empty word.
+    static unsigned Hash(const char* begin, unsigned length)
+    {
+        if (!length)
+            return 0;
+        // fnv-1a
+        unsigned hash = 2166136261u;
+        for (unsigned i = 0; i < length; ++i){
+            hash = (hash ^ (unsigned char)begin[i]) * 16777619u;
+        }
+        return hash;
+    }
+
+    /// Key of the route topic/subtype, from the hashes of both words.
+    static StringHash GetRouteKey(unsigned topicHash, unsigned subtypeHash)
+    {
+        return StringHash(topicHash * 31u + subtypeHash);
+    }
+
+    static StringHash GetRouteKey(const String& topic, const String& subtype)
+    {
+        return GetRouteKey(Hash(topic.CString(), topic.Length()), Hash(subtype.CString(), subtype.Length()));
+    }
+
+    /// Split a topic frame at the spaces. Return false if it has more than MAX_TOKENS words, the first
+    /// ones are kept then.
+    static bool Tokenize(const char* data, unsigned size, TopicTokens& tokens)
+    {
+        tokens.count_ = 0;
+        unsigned start = 0;
+        for (unsigned i = 0; i <= size; ++i){
+            if (i < size && data[i] != ' ')
+                continue;
+            if (i > start){
+                if (tokens.count_ == TopicTokens::MAX_TOKENS)
+                    return false;
+                tokens.begin_[tokens.count_] = data + start;
+                tokens.length_[tokens.count_] = i - start;
+                tokens.hash_[tokens.count_] = Hash(data + start, i - start);
+                tokens.count_++;
+            }
+            start = i + 1;
+        }
+        return true;
+    }
+
+    /// Call handler for messages of topic and subtype, "*" for all subtypes without a route of their own.
+    void Subscribe(const String& topic, const String& subtype, const Handler& handler)
+    {
+        StringHash key = GetRouteKey(topic, subtype);
+        List<Route>& routes = routes_[key];
+        Route* route = FindRoute(routes, topic, subtype);
+        if (!route){
+            // list nodes stay where they are, the route returned by Find() is safe from a subscribing handler
+            routes.Push(Route());
+            route = &routes.Back();
+            route->name_ = topic + " " + subtype;
+            route->topic_ = topic;
+            route->subtype_ = subtype;
+            route->key_ = key;
+        }
+        route->handlers_.Push(handler);
+    }
+
+    /// Remove the route with all its handlers, not from one of its handlers.
+    void Unsubscribe(const String& topic, const String& subtype)
+    {
+        auto it = routes_.Find(GetRouteKey(topic, subtype));
+        if (it == routes_.End())
+            return;
+        for (auto route = it->second_.Begin(); route != it->second_.End(); ++route){
+            if (route->topic_ == topic && route->subtype_ == subtype){
+                it->second_.Erase(route);
+                break;
+            }
+        }
+        if (it->second_.Empty())
+            routes_.Erase(it);
+    }
+
+    /// Route of the message, the wildcard route of its topic if it has none, or null.
+    Route* Find(const TopicTokens& tokens)
+    {
+        unsigned topicHash = tokens.GetHash(0);
+        auto it = routes_.Find(GetRouteKey(topicHash, tokens.GetHash(1)));
+        if (it != routes_.End()){
+            for (Route& route : it->second_){
+                if (tokens.Equals(0, route.topic_.CString()) && tokens.Equals(1, route.subtype_.CString()))
+                    return &route;
+            }
+        }
+        it = routes_.Find(GetRouteKey(topicHash, Hash("*", 1)));
+        if (it != routes_.End()){
+            for (Route& route : it->second_){
+                if (route.subtype_ == "*" && tokens.Equals(0, route.topic_.CString()))
+                    return &route;
+            }
+        }
+        unrouted_++;
+        return nullptr;
+    }
+
+    /// Call the handlers of a route returned by Find().
+    void Dispatch(Route& route, VariantMap& data)
+    {
+        route.count_++;
+        // by index with a copy of the handler, a handler may subscribe more and grow the list
+        for (unsigned i = 0, numHandlers = route.handlers_.Size(); i < numHandlers; ++i){
+            Handler handler = route.handlers_[i];
+            handler(route.key_, data);
+        }
+    }
+
+    /// Messages of topic and subtype dispatched so far.
+    unsigned GetCount(const String& topic, const String& subtype) const
+    {
+        auto it = routes_.Find(GetRouteKey(topic, subtype));
+        if (it == routes_.End())
+            return 0;
+        for (const Route& route : it->second_){
+            if (route.topic_ == topic && route.subtype_ == subtype)
+                return route.count_;
+        }
+        return 0;
+    }
+    /// Messages that no route took.
+    unsigned GetUnroutedCount() const { return unrouted_; }
+    /// Routes by key, more than one only if their keys collide.
+    const HashMap<StringHash, List<Route> >& GetRoutes() const { return routes_; }
+
+private:
+    static Route* FindRoute(List<Route>& routes, const String& topic, const String& subtype)
+    {
+        for (Route& route : routes){
+            if (route.topic_ == topic && route.subtype_ == subtype)
+                return &route;
+        }
+        return nullptr;
+    }
+
+    HashMap<StringHash, List<Route> > routes_;
+    unsigned unrouted_;
+};
@@ -27,13 +27,23 @@
 #include <CommonEvents.h>
 #include <Urho3D/Resource/JSONFile.h>
 #include <Urho3D/Core/CoreEvents.h>
+#include <Urho3D/Core/Timer.h>
+#include <Urho3D/IO/Log.h>
 
+#include <cstring>
 
-PubSubMessage::PubSubMessage(Context* ctx, const zmq::multipart_t& msg)
+static const unsigned DEFAULT_MAX_MESSAGES_PER_FRAME = 256;
+static const unsigned DEFAULT_MAX_DRAIN_MSEC = 4;
+// second frame of a batch envelope, not valid text so it can't be a message of its own
+static const char BATCH_MARKER[] = "\002batch";
+
+PubSubMessage::PubSubMessage(Context* ctx, zmq::multipart_t&& msg)
     : ctx_(ctx)
+    , msg_(std::move(msg))
 {
-    msg_ = msg.clone();
-    topic_ = msg_.peekstr(0).c_str();
+    // peek() of a message without frames is out of bounds
+    if (!msg_.empty())
+        topic_ = msg_.peekstr(0).c_str();
 }
 
 
@@ -44,6 +54,13 @@ VectorBuffer PubSubMessage::PopData()
     return vbuf;
 }
 
+MemoryBuffer PubSubMessage::PopDataView()
+{
+    viewedParts_.push_back(msg_.pop());
+    const zmq::message_t& zmq_msg = viewedParts_.back();
+    return MemoryBuffer(zmq_msg.data(),zmq_msg.size());
+}
+
 String PubSubMessage::PopString()
 {
     String incomingString(msg_.popstr().c_str());
@@ -65,6 +82,12 @@ PubSubNetwork::PubSubNetwork(Context* context) :
     Object(context)
     ,running_(false)
     ,initialized_(false)
+    ,maxMessagesPerFrame_(DEFAULT_MAX_MESSAGES_PER_FRAME)
+    ,maxDrainMSec_(DEFAULT_MAX_DRAIN_MSEC)
+    ,rpc_(new RpcChannel(context,ctx))
+    ,batching_(false)
+    ,maxBatchSize_(DEFAULT_BATCH_SIZE)
+    ,log_(context)
 {
     SubscribeToEvent(E_BEGINFRAME, URHO3D_HANDLER(PubSubNetwork, HandleBeginFrame));
 }
@@ -97,21 +120,125 @@ void PubSubNetwork::InitNetwork(const String& host, const String& initialFilter,
 
 }
 
+void PubSubNetwork::InitRpc(const String& host, int port, const String& identity)
+{
+    rpc_->Connect("tcp://"+host+":"+String(port),identity);
+}
+
+void PubSubNetwork::SetDrainLimits(unsigned maxMessages, unsigned maxMSec)
+{
+    maxMessagesPerFrame_ = maxMessages;
+    maxDrainMSec_ = maxMSec;
+}
+
 void PubSubNetwork::CheckNetwork()
+{
+    if (log_.IsReplaying()){
+        log_.Replay([this](const FrameView* frames, unsigned numFrames){
+            HandleReceived(MakeMultipart(frames,numFrames));
+        });
+        return;
+    }
+
+    // drain the queue, so bursts don't pile up over several frames
+    HiresTimer timer;
+    for (unsigned count = 0; !maxMessagesPerFrame_ || count < maxMessagesPerFrame_; ++count){
+        if (maxDrainMSec_ && count && timer.GetUSec(false) >= maxDrainMSec_ * 1000LL)
+            break;
+
+        zmq::multipart_t multipart;
+        if (!multipart.recv(inSocket_, ZMQ_DONTWAIT))
+            break;
+
+        if (log_.IsRecording()){
+            // only messages with more frames than a batch takes need the heap, they are rare
+            FrameView stackFrames[MessageBatch::MAX_FRAMES];
+            PODVector<FrameView> heapFrames;
+            FrameView* frames = stackFrames;
+            if (multipart.size() > MessageBatch::MAX_FRAMES){
+                heapFrames.Resize(multipart.size());
+                frames = heapFrames.Buffer();
+            }
+            for (unsigned i = 0; i < multipart.size(); ++i){
+                const zmq::message_t* part = multipart.peek(i);
+                frames[i].data_ = part->data<char>();
+                frames[i].size_ = part->size();
+            }
+            log_.Record(frames,multipart.size());
+        }
+        HandleReceived(std::move(multipart));
+    }
+}
+
+zmq::multipart_t PubSubNetwork::MakeMultipart(const FrameView* frames, unsigned numFrames)
 {
     zmq::multipart_t multipart;
+    for (unsigned i = 0; i < numFrames; ++i){
+        multipart.add(zmq::message_t(frames[i].data_,frames[i].size_));
+    }
+    return multipart;
+}
+
+void PubSubNetwork::HandleReceived(zmq::multipart_t&& multipart)
+{
+    // a batch: topic, marker, the packed messages
+    if (multipart.size() == 3 && IsBatchMarker(*multipart.peek(1))){
+        const zmq::message_t* packed = multipart.peek(2);
+        bool valid = MessageBatch::Unpack(packed->data(),packed->size(),[this](const FrameView* frames, unsigned numFrames){
+            DispatchMessage(MakeMultipart(frames,numFrames));
+        });
+        if (!valid){
+            URHO3D_LOGERROR("[PubSubNetwork] malformed batch");
+        }
+        return;
+    }
+    DispatchMessage(std::move(multipart));
+}
+
+bool PubSubNetwork::StartRecording(const String& fileName)
+{
+    return log_.BeginRecording(fileName);
+}
 
-    auto ok = multipart.recv(inSocket_, ZMQ_DONTWAIT);
-    if (ok){
-        PubSubMessage msg(context_,multipart);
+bool PubSubNetwork::StartReplay(const String& fileName, bool fast)
+{
+    return log_.BeginReplay(fileName,fast);
+}
+
+void PubSubNetwork::DispatchMessage(zmq::multipart_t&& multipart)
+{
+    if (multipart.empty()){
+        URHO3D_LOGERROR("[PubSubNetwork] message without frames");
+        return;
+    }
+
+    // route by the first two words of the topic, before the frames move into the message
+    const zmq::message_t* topicMsg = multipart.peek(0);
+    TopicTokens tokens;
+    MessageRouter::Tokenize(topicMsg->data<char>(),topicMsg->size(),tokens);
+    MessageRouter::Route* route = router_.Find(tokens);
+    if (!route && !context_->GetEventReceivers(E_PUBSUB_MSG) && !context_->GetEventReceivers(this,E_PUBSUB_MSG))
+        return;
 
-        using namespace NSPubSubMessage;
+    PubSubMessage msg(context_,std::move(multipart));
+
+    using namespace NSPubSubMessage;
+    if (route){
         VariantMap map;
         map[P_TOPIC]=msg.GetTopic();
         map[P_MSG]=MakeCustomValue(&msg);
-        SendEvent(E_PUBSUB_MSG,map);
+        router_.Dispatch(*route,map);
+        return;
     }
+    VariantMap& map = GetEventDataMap();
+    map[P_TOPIC]=msg.GetTopic();
+    map[P_MSG]=MakeCustomValue(&msg);
+    SendEvent(E_PUBSUB_MSG,map);
+}
 
+void PubSubNetwork::Subscribe(const String& topic, const String& subtype, const MessageRouter::Handler& handler)
+{
+    router_.Subscribe(topic,subtype,handler);
 }
 
 void PubSubNetwork::HandleBeginFrame(StringHash eventType, VariantMap &eventData)
@@ -119,36 +246,103 @@ void PubSubNetwork::HandleBeginFrame(StringHash eventType, VariantMap &eventData
     CheckNetwork();
 }
 
+void PubSubNetwork::HandleEndFrame(StringHash eventType, VariantMap &eventData)
+{
+    Flush();
+}
+
 void PubSubNetwork::Close()
 {
+    rpc_->Close();
+    log_.Close();
+    Flush();
     inSocket_.close();
     outSocket_.close();
     ctx.close();
 }
 
-void PubSubNetwork::Send(const String& topic,const String& txtData,void* buffer,int length)
+void PubSubNetwork::SetBatching(bool enable, unsigned maxBatchSize)
 {
-    zmq::multipart_t multipart;
-    multipart.addstr(topic.CString());
-    multipart.addstr(txtData.CString());
-    if (buffer && length){
-        multipart.add(zmq::message_t(buffer,length));
+    if (!enable){
+        Flush();
+    }
+    batching_ = enable;
+    maxBatchSize_ = maxBatchSize;
+    if (enable){
+        SubscribeToEvent(E_ENDFRAME, URHO3D_HANDLER(PubSubNetwork, HandleEndFrame));
+    } else {
+        UnsubscribeFromEvent(E_ENDFRAME);
     }
-    multipart.send(outSocket_);
 }
-void PubSubNetwork::Send(const String& topic,const StringVector& txtData,void* buffer,int length)
+
+void PubSubNetwork::Flush()
+{
+    for (auto it = batches_.Begin(); it != batches_.End(); ++it){
+        if (!it->second_.Empty()){
+            SendBatch(it->first_,it->second_);
+        }
+    }
+}
+
+void PubSubNetwork::SendBatch(const String& topic, MessageBatch& batch)
 {
     zmq::multipart_t multipart;
+    multipart.add(zmq::message_t(topic.CString(),topic.Length()));
+    multipart.add(zmq::message_t(BATCH_MARKER,sizeof(BATCH_MARKER) - 1));
+    multipart.add(zmq::message_t(batch.GetData(),batch.GetSize()));
+    multipart.send(outSocket_);
+    batch.Clear();
+}
+
+bool PubSubNetwork::IsBatchMarker(const zmq::message_t& frame)
+{
+    return frame.size() == sizeof(BATCH_MARKER) - 1 && !memcmp(frame.data(),BATCH_MARKER,frame.size());
+}
+
+void PubSubNetwork::Post(const String& topic, const String* texts, unsigned numTexts, const void* buffer, unsigned length)
+{
+    unsigned numFrames = 1 + numTexts + (length ? 1 : 0);
+    unsigned frameBytes = topic.Length() + length;
+    for (unsigned i = 0; i < numTexts; ++i){
+        frameBytes += texts[i].Length();
+    }
+
+    if (batching_ && numFrames <= MessageBatch::MAX_FRAMES && MessageBatch::GetRecordSize(numFrames,frameBytes) < maxBatchSize_){
+        MessageBatch& batch = batches_[topic];
+        batch.BeginMessage(numFrames);
+        batch.AddFrame(topic.CString(),topic.Length());
+        for (unsigned i = 0; i < numTexts; ++i){
+            batch.AddFrame(texts[i].CString(),texts[i].Length());
+        }
+        if (length){
+            batch.AddFrame(buffer,length);
+        }
+        if (batch.GetSize() >= maxBatchSize_){
+            SendBatch(topic,batch);
+        }
+        return;
+    }
 
-    multipart.addstr(topic.CString());
-    for (const String  txt : txtData){
-        multipart.addstr(txt.CString());
+    // sent alone, after what is batched so far so a receiver gets it in order
+    Flush();
+    zmq::multipart_t multipart;
+    multipart.add(zmq::message_t(topic.CString(),topic.Length()));
+    for (unsigned i = 0; i < numTexts; ++i){
+        multipart.add(zmq::message_t(texts[i].CString(),texts[i].Length()));
     }
-    if (buffer && length){
+    if (length){
         multipart.add(zmq::message_t(buffer,length));
     }
     multipart.send(outSocket_);
+}
 
+void PubSubNetwork::Send(const String& topic,const String& txtData,void* buffer,int length)
+{
+    Post(topic,&txtData,1,buffer,buffer ? length : 0);
+}
+void PubSubNetwork::Send(const String& topic,const StringVector& txtData,void* buffer,int length)
+{
+    Post(topic,txtData.Buffer(),txtData.Size(),buffer,buffer ? length : 0);
 }
 
 //void PubSubNetwork::CreateScreenshot()
@@ -28,22 +28,36 @@
 #include <3rd/cppzmq/zmq.hpp>
 #include <3rd/cppzmq/zmq_addon.hpp>
 #include <Urho3D/Resource/JSONValue.h>
+#include <Urho3D/IO/MemoryBuffer.h>
+#include <Urho3D/IO/VectorBuffer.h>
+#include "MessageBatch.h"
+#include "MessageLog.h"
+#include "MessageRouter.h"
+#include "RpcChannel.h"
 
+#include <deque>
 
 using namespace Urho3D;
 
 
+/// A received multipart, only valid while E_PUBSUB_MSG or the handlers of its route run.
 class PubSubMessage {
 public:
-    PubSubMessage(Context* ctx,const zmq::multipart_t& msg);
+    /// Take over the frames of msg, nothing is copied.
+    PubSubMessage(Context* ctx,zmq::multipart_t&& msg);
 
     String PopString();
+    /// Copy of the next frame.
     VectorBuffer PopData();
+    /// Read-only view onto the next frame, no copy. It stays valid as long as the message.
+    MemoryBuffer PopDataView();
     JSONObject PopJson();
     inline const String& GetTopic() { return topic_;}
 private:
     Context* ctx_;
     zmq::multipart_t msg_;
+    /// frames handed out as views, a deque so they don't move (small frames are stored inline)
+    std::deque<zmq::message_t> viewedParts_;
     String topic_;
 };
 
@@ -60,20 +74,70 @@ public:
     static void RegisterObject(Context* context);
 
     void InitNetwork(const String& host,const String& initialFilter, int portIn, int portOut);
+    /// Connect the request/reply channel to the ROUTER at host:port, see RpcChannel.
+    void InitRpc(const String& host, int port, const String& identity);
+    RpcChannel* GetRpc() const { return rpc_; }
+    /// Receive what is queued, up to the limits of SetDrainLimits(). Each message goes to the handlers
+    /// of its route, see Subscribe(), or else as E_PUBSUB_MSG if anyone listens to it.
     void CheckNetwork();
+    /// Call handler for messages whose topic starts with "topic subtype", with the params of E_PUBSUB_MSG.
+    /// Subtype "*" takes all messages of the topic that have no route of their own.
+    void Subscribe(const String& topic, const String& subtype, const MessageRouter::Handler& handler);
+    /// Routes with their message counts.
+    const MessageRouter& GetRouter() const { return router_; }
+    /// Limit the messages handled per frame by count and time in milliseconds, 0 for no limit.
+    /// The rest stays queued for the next frame.
+    void SetDrainLimits(unsigned maxMessages, unsigned maxMSec);
     void Close();
     /// Handle begin frame event.
     void HandleBeginFrame(StringHash eventType, VariantMap& eventData);
     void Send(const String& topic,const String& txtData,void* buffer=0,int length=0);
     void Send(const String& topic,const StringVector& txtData,void* buffer=0,int length=0);
 
+    static const unsigned DEFAULT_BATCH_SIZE = 64 * 1024;
+    /// Pack the messages sent during a frame into one envelope per topic, see MessageBatch. A batch
+    /// is sent at the end of the frame or once it reaches maxBatchSize, bigger messages are sent
+    /// alone after the batches so the order stays. Received batches are always unpacked.
+    void SetBatching(bool enable, unsigned maxBatchSize = DEFAULT_BATCH_SIZE);
+    bool IsBatching() const { return batching_; }
+    /// Send the batched messages now.
+    void Flush();
+
+    /// Write every received multipart to fileName, see MessageLog.
+    bool StartRecording(const String& fileName);
+    /// Take the messages from a recording instead of the socket.
+    bool StartReplay(const String& fileName, bool fast);
+    bool IsReplaying() const { return log_.IsReplaying(); }
+    bool IsReplayFinished() const { return log_.IsReplayFinished(); }
+    const MessageLog& GetLog() const { return log_; }
+
 
 private:
+    /// Unpack a batch or dispatch the message.
+    void HandleReceived(zmq::multipart_t&& multipart);
+    /// Route a received message or send it as E_PUBSUB_MSG.
+    void DispatchMessage(zmq::multipart_t&& multipart);
+    static zmq::multipart_t MakeMultipart(const FrameView* frames, unsigned numFrames);
+    void HandleEndFrame(StringHash eventType, VariantMap& eventData);
+    /// Batch or send a message of the topic, text frames and an optional binary frame.
+    void Post(const String& topic, const String* texts, unsigned numTexts, const void* buffer, unsigned length);
+    void SendBatch(const String& topic, MessageBatch& batch);
+    static bool IsBatchMarker(const zmq::message_t& frame);
+
     bool running_;
     zmq::socket_t  inSocket_;
     zmq::socket_t  outSocket_;
     bool initialized_;
     zmq::context_t ctx;
+    unsigned maxMessagesPerFrame_;
+    unsigned maxDrainMSec_;
+    MessageRouter router_;
+    SharedPtr<RpcChannel> rpc_;
+    bool batching_;
+    unsigned maxBatchSize_;
+    /// by topic, kept over the frames so their memory is reused
+    HashMap<String, MessageBatch> batches_;
+    MessageLog log_;
 
 };
 
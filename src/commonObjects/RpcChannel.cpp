@@ -0,0 +1,257 @@
+//
+// Copyright (c) 2008-2019 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#include "RpcChannel.h"
+
+#include <zmq.hpp>
+#include <zmq_addon.hpp>
+#include <Urho3D/Core/CoreEvents.h>
+#include <Urho3D/Core/StringUtils.h>
+#include <Urho3D/IO/Log.h>
+
+#include <cstring>
+
+// messages handled per frame, the rest waits for the next one
+static const unsigned MAX_MESSAGES_PER_FRAME = 256;
+
+RpcChannel::RpcChannel(Context* context, zmq::context_t& zmqContext) :
+    Object(context)
+    ,zmqContext_(&zmqContext)
+    ,connected_(false)
+    ,nextId_(1)
+{
+    SubscribeToEvent(E_BEGINFRAME, URHO3D_HANDLER(RpcChannel, HandleBeginFrame));
+}
+
+RpcChannel::~RpcChannel()
+{
+    Close();
+}
+
+void RpcChannel::Connect(const String& endpoint, const String& identity)
+{
+    socket_ = zmq::socket_t(*zmqContext_, zmq::socket_type::dealer);
+    socket_.setsockopt(ZMQ_IDENTITY, identity.CString(), identity.Length());
+    // don't block the exit on replies nobody picks up
+    socket_.setsockopt(ZMQ_LINGER, 0);
+    socket_.connect(endpoint.CString());
+    connected_ = true;
+}
+
+void RpcChannel::Close()
+{
+    if (connected_){
+        socket_.close();
+        connected_ = false;
+    }
+    pendingCalls_.Clear();
+    openRequests_.Clear();
+    queuedReplies_.Clear();
+}
+
+unsigned RpcChannel::Call(const String& method, const String& meta, const void* data, unsigned size,
+                          const ReplyHandler& handler, unsigned timeoutMSec)
+{
+    if (!connected_)
+        return 0;
+
+    unsigned id = nextId_++;
+    if (!nextId_)
+        nextId_ = 1;
+
+    zmq::multipart_t multipart;
+    multipart.addstr("req");
+    multipart.addstr(String(id).CString());
+    multipart.addstr(method.CString());
+    multipart.addstr(meta.CString());
+    multipart.add(zmq::message_t(data,size));
+    if (!multipart.send(socket_, ZMQ_DONTWAIT)){
+        URHO3D_LOGERRORF("[RpcChannel] could not send request %s",method.CString());
+        return 0;
+    }
+
+    PendingCall& call = pendingCalls_[id];
+    call.handler_ = handler;
+    call.deadline_ = clock_.GetMSec(false) + timeoutMSec;
+    return id;
+}
+
+void RpcChannel::Cancel(unsigned id)
+{
+    pendingCalls_.Erase(id);
+}
+
+void RpcChannel::SetHandler(const String& method, const RequestHandler& handler)
+{
+    handlers_[StringHash(method)] = handler;
+}
+
+bool RpcChannel::Reply(unsigned id, RpcStatus status, const String& meta, const void* data, unsigned size)
+{
+    if (!openRequests_.Erase(id))
+        return false;
+    if (!connected_)
+        return false;
+
+    // behind queued replies it waits as well, the other side gets them in order
+    if (queuedReplies_.Empty() && TrySendReply(id,status,meta,data,size))
+        return true;
+
+    QueuedReply reply;
+    reply.id_ = id;
+    reply.status_ = status;
+    reply.meta_ = meta;
+    reply.data_.Resize(size);
+    if (size)
+        memcpy(reply.data_.Buffer(),data,size);
+    queuedReplies_.Push(reply);
+    URHO3D_LOGWARNINGF("[RpcChannel] socket busy, reply %u queued (%u waiting)",id,queuedReplies_.Size());
+    return true;
+}
+
+bool RpcChannel::TrySendReply(unsigned id, RpcStatus status, const String& meta, const void* data, unsigned size)
+{
+    // a multipart drops the frames it popped when the send fails, so only send once there is room
+    if (!(socket_.getsockopt<int>(ZMQ_EVENTS) & ZMQ_POLLOUT))
+        return false;
+
+    zmq::multipart_t multipart;
+    multipart.addstr("rep");
+    multipart.addstr(String(id).CString());
+    multipart.addstr(status == RPC_OK ? "ok" : "error");
+    multipart.addstr(meta.CString());
+    multipart.add(zmq::message_t(data,size));
+    if (!multipart.send(socket_, ZMQ_DONTWAIT)){
+        URHO3D_LOGERRORF("[RpcChannel] could not send reply %u",id);
+    }
+    return true;
+}
+
+void RpcChannel::SendQueuedReplies()
+{
+    while (!queuedReplies_.Empty()){
+        const QueuedReply& reply = queuedReplies_.Front();
+        if (!TrySendReply(reply.id_,reply.status_,reply.meta_,reply.data_.Buffer(),reply.data_.Size()))
+            return;
+        queuedReplies_.PopFront();
+    }
+}
+
+void RpcChannel::Update()
+{
+    if (!connected_)
+        return;
+
+    SendQueuedReplies();
+
+    for (unsigned count = 0; count < MAX_MESSAGES_PER_FRAME; ++count){
+        zmq::multipart_t multipart;
+        if (!multipart.recv(socket_, ZMQ_DONTWAIT))
+            break;
+
+        if (multipart.size() != 5){
+            URHO3D_LOGERRORF("[RpcChannel] wrong amount of frames: %i",(int)multipart.size());
+            continue;
+        }
+
+        String kind(multipart.popstr().c_str());
+        unsigned id = ToUInt(multipart.popstr().c_str());
+        String name(multipart.popstr().c_str());
+        zmq::message_t meta = multipart.pop();
+        zmq::message_t data = multipart.pop();
+
+        if (kind == "req"){
+            HandleRequest(id,name,meta,data);
+        }
+        else if (kind == "rep"){
+            HandleReply(id,name,meta,data);
+        }
+        else {
+            URHO3D_LOGERRORF("[RpcChannel] unknown message kind: %s",kind.CString());
+        }
+    }
+
+    CheckTimeouts();
+}
+
+void RpcChannel::HandleRequest(unsigned id, const String& method, const zmq::message_t& meta, const zmq::message_t& data)
+{
+    openRequests_.Insert(id);
+
+    auto it = handlers_.Find(StringHash(method));
+    if (it == handlers_.End()){
+        Reply(id,RPC_ERROR,"unknown method: "+method);
+        return;
+    }
+
+    RpcRequest request(id,method,String(meta.data<char>(),meta.size()),data.data(),data.size());
+    // a copy, the handler may set handlers
+    RequestHandler handler = it->second_;
+    handler(request);
+}
+
+void RpcChannel::HandleReply(unsigned id, const String& status, const zmq::message_t& meta, zmq::message_t& data)
+{
+    auto it = pendingCalls_.Find(id);
+    if (it == pendingCalls_.End()){
+        // timed out or cancelled before
+        URHO3D_LOGDEBUGF("[RpcChannel] reply without request: %u",id);
+        return;
+    }
+
+    ReplyHandler handler = it->second_.handler_;
+    pendingCalls_.Erase(it);
+
+    MemoryBuffer buffer(data.data(),data.size());
+    handler(id,status == "ok" ? RPC_OK : RPC_ERROR,String(meta.data<char>(),meta.size()),buffer);
+}
+
+void RpcChannel::CheckTimeouts()
+{
+    if (pendingCalls_.Empty())
+        return;
+
+    unsigned now = clock_.GetMSec(false);
+    PODVector<unsigned> expired;
+    for (auto it = pendingCalls_.Begin(); it != pendingCalls_.End(); ++it){
+        // wraps after 49 days, compared as difference
+        if ((int)(now - it->second_.deadline_) >= 0){
+            expired.Push(it->first_);
+        }
+    }
+
+    MemoryBuffer empty((const void*)nullptr,0);
+    for (unsigned id : expired){
+        auto it = pendingCalls_.Find(id);
+        // an earlier handler may have cancelled it
+        if (it == pendingCalls_.End())
+            continue;
+        ReplyHandler handler = it->second_.handler_;
+        pendingCalls_.Erase(it);
+        handler(id,RPC_TIMEOUT,String::EMPTY,empty);
+    }
+}
+
+void RpcChannel::HandleBeginFrame(StringHash eventType, VariantMap& eventData)
+{
+    Update();
+}
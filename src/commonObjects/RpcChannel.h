@@ -0,0 +1,138 @@
+//
+// Copyright (c) 2008-2019 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#pragma once
+
+#include <Urho3D/Core/Object.h>
+#include <Urho3D/Core/Timer.h>
+#include <Urho3D/Container/HashMap.h>
+#include <Urho3D/Container/HashSet.h>
+#include <Urho3D/Container/List.h>
+#include <Urho3D/IO/MemoryBuffer.h>
+#include <3rd/cppzmq/zmq.hpp>
+
+#include <functional>
+
+using namespace Urho3D;
+
+enum RpcStatus {
+    RPC_OK = 0,
+    RPC_ERROR,
+    /// no reply within the timeout of the call
+    RPC_TIMEOUT
+};
+
+/// A request of the other side, only valid while its handler runs. Keep id_ to reply later.
+struct RpcRequest{
+    RpcRequest(unsigned id, const String& method, const String& meta, const void* data, unsigned size) :
+        id_(id), method_(method), meta_(meta), data_(data,size) {}
+
+    unsigned id_;
+    String method_;
+    String meta_;
+    MemoryBuffer data_;
+};
+
+/// Requests and replies next to the pub/sub sockets, over a DEALER socket connected to the
+/// ROUTER of the other side. Every request carries a correlation id and gets exactly one
+/// reply with the same id, so the caller knows when its request is done and no one else
+/// sees it. Any number of requests can be outstanding on either side.
+///
+/// Frames of a request: "req", id, method, meta, data.
+/// Frames of a reply:   "rep", id, status ("ok" or "error"), meta, data.
+/// The ROUTER side additionally has the identity of the connection in front.
+///
+/// A reply the socket can't take right now is queued and sent in a later Update(), in order.
+class RpcChannel : public Object
+{
+    URHO3D_OBJECT(RpcChannel, Object);
+
+public:
+    /// The reply, data is only valid during the call. On timeout meta and data are empty.
+    typedef std::function<void(unsigned id, RpcStatus status, const String& meta, MemoryBuffer& data)> ReplyHandler;
+    /// Answer with Reply() now or later, e.g. once a frame is rendered.
+    typedef std::function<void(RpcRequest& request)> RequestHandler;
+
+    static const unsigned DEFAULT_TIMEOUT_MSEC = 5000;
+
+    /// zmqContext is the one of the network layer that owns the channel, Close() the channel before closing it.
+    RpcChannel(Context* context, zmq::context_t& zmqContext);
+    ~RpcChannel() override;
+
+    /// Connect to the ROUTER at endpoint. identity is how the other side addresses this end.
+    void Connect(const String& endpoint, const String& identity);
+    void Close();
+    bool IsConnected() const { return connected_; }
+
+    /// Send a request, handler gets the reply or RPC_TIMEOUT. Return the id of the request,
+    /// 0 if not connected.
+    unsigned Call(const String& method, const String& meta, const void* data, unsigned size,
+                  const ReplyHandler& handler, unsigned timeoutMSec = DEFAULT_TIMEOUT_MSEC);
+    /// Forget a request, its handler is not called anymore.
+    void Cancel(unsigned id);
+    unsigned GetNumPendingCalls() const { return pendingCalls_.Size(); }
+
+    /// Handle the requests of a method. Requests for a method without handler get an error reply.
+    void SetHandler(const String& method, const RequestHandler& handler);
+    /// Answer request id, once. Return false if there is no open request with this id or the
+    /// channel is not connected.
+    bool Reply(unsigned id, RpcStatus status, const String& meta, const void* data = nullptr, unsigned size = 0);
+    unsigned GetNumOpenRequests() const { return openRequests_.Size(); }
+    /// Replies waiting for room in the socket's queue.
+    unsigned GetNumQueuedReplies() const { return queuedReplies_.Size(); }
+
+    /// Receive what is queued, then time out the calls that waited too long. Called every frame.
+    void Update();
+
+private:
+    struct PendingCall{
+        ReplyHandler handler_;
+        unsigned deadline_;
+    };
+
+    struct QueuedReply{
+        unsigned id_;
+        RpcStatus status_;
+        String meta_;
+        PODVector<unsigned char> data_;
+    };
+
+    /// Return false if the socket can't take the reply now, it is not sent then.
+    bool TrySendReply(unsigned id, RpcStatus status, const String& meta, const void* data, unsigned size);
+    void SendQueuedReplies();
+    void HandleBeginFrame(StringHash eventType, VariantMap& eventData);
+    void HandleRequest(unsigned id, const String& method, const zmq::message_t& meta, const zmq::message_t& data);
+    void HandleReply(unsigned id, const String& status, const zmq::message_t& meta, zmq::message_t& data);
+    void CheckTimeouts();
+
+    zmq::context_t* zmqContext_;
+    zmq::socket_t socket_;
+    bool connected_;
+    unsigned nextId_;
+    /// time base of the deadlines
+    Timer clock_;
+    HashMap<unsigned, PendingCall> pendingCalls_;
+    HashMap<StringHash, RequestHandler> handlers_;
+    /// requests of the other side that are not answered yet
+    HashSet<unsigned> openRequests_;
+    List<QueuedReply> queuedReplies_;
+};
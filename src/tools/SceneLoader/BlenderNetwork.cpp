@@ -33,6 +33,10 @@ BlenderNetwork::BlenderNetwork(Context* context) :
     Object(context)
     ,running_(false)
     ,initialized_(false)
+    ,rpc_(new RpcChannel(context,ctx))
+    ,batching_(false)
+    ,maxBatchSize_(DEFAULT_BATCH_SIZE)
+    ,log_(context)
 {
     SubscribeToEvent(E_BEGINFRAME, URHO3D_HANDLER(BlenderNetwork, HandleBeginFrame));
 }
@@ -52,7 +56,7 @@ void BlenderNetwork::RegisterObject(Context* context)
 //    URHO3D_MIXED_ACCESSOR_ATTRIBUTE("Texture", GetTexture, SetTexture, ResourceRef, ResourceRef(Texture2D::GetTypeStatic()), AM_DEFAULT);
 }
 
-void BlenderNetwork::InitNetwork()
+void BlenderNetwork::InitNetwork(const String& rpcIdentity)
 {
     inSocket_ = zmq::socket_t(ctx, zmq::socket_type::sub);
     inSocket_.connect("tcp://localhost:5560");
@@ -63,114 +67,207 @@ void BlenderNetwork::InitNetwork()
     outSocket_ = zmq::socket_t(ctx, zmq::socket_type::pub);
     outSocket_.connect("tcp://localhost:5559");
 
+    rpc_->Connect("tcp://localhost:5561",rpcIdentity);
+    initialized_ = true;
 }
 
 void BlenderNetwork::CheckNetwork()
 {
-    zmq::multipart_t multipart;
+    if (log_.IsReplaying()){
+        log_.Replay([this](const FrameView* frames, unsigned numFrames){
+            HandleMessage(frames,numFrames,false);
+        });
+        return;
+    }
+    if (!initialized_)
+        return;
 
-    auto ok = multipart.recv(inSocket_);
-    zmq::message_t zmq_msg;
-    if (ok){
-        int mS = multipart.size();
+    zmq::multipart_t multipart;
+    if (!multipart.recv(inSocket_))
+        return;
 
-        if (mS != 3){
-            URHO3D_LOGERRORF("BlenderNetwork: WRONG AMOUNT OF MULTIPART_MSGs %i",mS);
-            return;
-        }
+    int mS = multipart.size();
+    if (mS != 3){
+        URHO3D_LOGERRORF("BlenderNetwork: WRONG AMOUNT OF MULTIPART_MSGs %i",mS);
+        return;
+    }
 
-        auto _topic = multipart.popstr();
-        auto _meta = multipart.popstr();
+    FrameView frames[3];
+    for (unsigned i = 0; i < 3; ++i){
+        const zmq::message_t* part = multipart.peek(i);
+        frames[i].data_ = part->data<char>();
+        frames[i].size_ = part->size();
+    }
+    // as received, batches are unpacked on replay again
+    log_.Record(frames,3);
+    HandleMessage(frames,3,false);
+}
 
-        Vector<String> topicSplit = String(_topic.c_str()).Split(' ');
+bool BlenderNetwork::StartRecording(const String& fileName)
+{
+    return log_.BeginRecording(fileName);
+}
 
-        if (topicSplit.Size() != 3){
-            URHO3D_LOGERRORF("BlenderNetwork: WRONG TOPIC-FORMAT! %s",_topic);
-            return;
-        }
+bool BlenderNetwork::StartReplay(const String& fileName, bool fast)
+{
+    return log_.BeginReplay(fileName,fast);
+}
 
-        auto topic = topicSplit[0];
-        auto subtype = topicSplit[1];
-        auto datatype = topicSplit[2];
-        auto meta = String(_meta.c_str());
-
-        using namespace BlenderConnect;
-        VariantMap map;
-        map[P_TOPIC]=topic;
-        map[P_SUBTYPE]=subtype;
-        map[P_DATATYPE]=datatype;
-
-        if (meta!=""){
-            JSONFile metaJson(context_);
-            metaJson.FromString(meta);
-            auto root = metaJson.GetRoot().GetObject();
-            map[P_META]=MakeCustomValue(root);
-        }
+void BlenderNetwork::HandleMessage(const FrameView* frames, unsigned numFrames, bool batched)
+{
+    // split the topic in place, nothing of the message is parsed until there is a route for it
+    TopicTokens tokens;
+    if (numFrames != 3 || !MessageRouter::Tokenize(frames[0].data_,frames[0].size_,tokens) || tokens.count_ != 3){
+        URHO3D_LOGERRORF("BlenderNetwork: WRONG TOPIC-FORMAT! %s",numFrames ? String(frames[0].data_,frames[0].size_).CString() : "");
+        return;
+    }
 
-        zmq_msg = multipart.pop();
-        if (datatype == "text"){
-            std::string data(zmq_msg.data<char>(),zmq_msg.size());
-            map[P_DATA] = String(data.c_str());
-            SendEvent(E_BLENDER_MSG,map);
-        }
-        else if (datatype == "json"){
-            std::string data(zmq_msg.data<char>(),zmq_msg.size());
-
-            JSONFile jsonFile(context_);
-            jsonFile.FromString(Urho3D::String(data.c_str()));
-            auto root = jsonFile.GetRoot().GetObject();
-           // CustomVariantValueImpl<JSONFile> val(jsonFile);
-            if (root.Contains("view_matrix")){
-                auto v = root["view_matrix"];
-                int a=0;
-            }
-            map[P_DATA]=MakeCustomValue(root);
-        } else {
-            URHO3D_LOGERRORF("BlenderNetwork: unsupported datatype:%s",datatype.CString());
+    if (!batched && tokens.Equals(1,"batch")){
+        bool valid = MessageBatch::Unpack(frames[2].data_,frames[2].size_,[this](const FrameView* batchFrames, unsigned numBatchFrames){
+            HandleMessage(batchFrames,numBatchFrames,true);
+        });
+        if (!valid){
+            URHO3D_LOGERROR("BlenderNetwork: malformed batch");
         }
-        SendEvent(E_BLENDER_MSG,map);
+        return;
+    }
 
+    MessageRouter::Route* route = router_.Find(tokens);
+    bool legacyReceivers = context_->GetEventReceivers(E_BLENDER_MSG) || context_->GetEventReceivers(this,E_BLENDER_MSG);
+    if (!route && !legacyReceivers)
+        return;
+
+    using namespace BlenderConnect;
+    VariantMap map;
+    map[P_TOPIC]=tokens.ToString(0);
+    map[P_SUBTYPE]=tokens.ToString(1);
+    map[P_DATATYPE]=tokens.ToString(2);
+
+    const FrameView& meta = frames[1];
+    if (meta.size_){
+        JSONFile metaJson(context_);
+        metaJson.FromString(String(meta.data_,meta.size_));
+        map[P_META]=MakeCustomValue(metaJson.GetRoot().GetObject());
+    }
 
+    const FrameView& data = frames[2];
+    if (tokens.Equals(2,"text")){
+        map[P_DATA] = String(data.data_,data.size_);
+    }
+    else if (tokens.Equals(2,"json")){
+        JSONFile jsonFile(context_);
+        jsonFile.FromString(String(data.data_,data.size_));
+        map[P_DATA]=MakeCustomValue(jsonFile.GetRoot().GetObject());
+    } else {
+        URHO3D_LOGERRORF("BlenderNetwork: unsupported datatype:%s",tokens.ToString(2).CString());
+    }
 
-      //  URHO3D_LOGINFOF("NETWORK:%s\n",recv_msg.c_str());
-        //URHO3D_LOGINFO("---NET--");
+    if (route){
+        router_.Dispatch(*route,map);
     } else {
-       //URHO3D_LOGINFO("NETWORK: no result");
+        SendEvent(E_BLENDER_MSG,map);
     }
 }
 
+void BlenderNetwork::Subscribe(const String& topic, const String& subtype, const MessageRouter::Handler& handler)
+{
+    router_.Subscribe(topic,subtype,handler);
+}
+
 void BlenderNetwork::HandleBeginFrame(StringHash eventType, VariantMap &eventData)
 {
     CheckNetwork();
 }
 
+void BlenderNetwork::HandleEndFrame(StringHash eventType, VariantMap &eventData)
+{
+    Flush();
+}
+
 void BlenderNetwork::Close()
 {
-    inSocket_.close();
-    outSocket_.close();
+    rpc_->Close();
+    log_.Close();
+    if (initialized_){
+        Flush();
+        inSocket_.close();
+        outSocket_.close();
+        initialized_ = false;
+    }
     ctx.close();
 }
 
-void BlenderNetwork::Send(const String& topic,const String& subtype, void *buffer,int length, const String& meta)
+void BlenderNetwork::SetBatching(bool enable, unsigned maxBatchSize)
+{
+    if (!enable){
+        Flush();
+    }
+    batching_ = enable;
+    maxBatchSize_ = maxBatchSize;
+    if (enable){
+        SubscribeToEvent(E_ENDFRAME, URHO3D_HANDLER(BlenderNetwork, HandleEndFrame));
+    } else {
+        UnsubscribeFromEvent(E_ENDFRAME);
+    }
+}
+
+void BlenderNetwork::Flush()
+{
+    for (auto it = batches_.Begin(); it != batches_.End(); ++it){
+        MessageBatch& batch = it->second_;
+        if (batch.Empty())
+            continue;
+        SendBatch(it->first_,batch);
+    }
+}
+
+void BlenderNetwork::SendBatch(const String& topic, MessageBatch& batch)
 {
+    String topicFrame = topic+" batch bin";
     zmq::multipart_t multipart;
-    multipart.addstr((topic+" "+subtype+" bin").CString());
-    multipart.addstr(meta.CString());
-    multipart.add(zmq::message_t(buffer,length));
+    multipart.add(zmq::message_t(topicFrame.CString(),topicFrame.Length()));
+    multipart.add(zmq::message_t());
+    multipart.add(zmq::message_t(batch.GetData(),batch.GetSize()));
     multipart.send(outSocket_);
+    batch.Clear();
 }
 
-void BlenderNetwork::Send(const String& topic,const String& subtype, const String& txtData, const String& meta)
+void BlenderNetwork::Post(const String& topic, const String& topicFrame, const String& meta, const void* data, unsigned size)
 {
+    if (!initialized_)
+        return;
+
+    if (batching_ && MessageBatch::GetRecordSize(3,topicFrame.Length()+meta.Length()+size) < maxBatchSize_){
+        MessageBatch& batch = batches_[topic];
+        batch.BeginMessage(3);
+        batch.AddFrame(topicFrame.CString(),topicFrame.Length());
+        batch.AddFrame(meta.CString(),meta.Length());
+        batch.AddFrame(data,size);
+        if (batch.GetSize() >= maxBatchSize_){
+            SendBatch(topic,batch);
+        }
+        return;
+    }
+
+    // sent alone, after what is batched so far so a receiver gets it in order
+    Flush();
     zmq::multipart_t multipart;
-//    multipart.push(zmq::message_t(topic.CString(),topic.Length()));
-//    multipart.push(zmq::message_t(txtData.CString(),topic.Length()));
-    multipart.addstr((topic+" "+subtype+" text").CString());
-    multipart.addstr(meta.CString());
-    multipart.addstr(txtData.CString());
+    multipart.add(zmq::message_t(topicFrame.CString(),topicFrame.Length()));
+    multipart.add(zmq::message_t(meta.CString(),meta.Length()));
+    multipart.add(zmq::message_t(data,size));
     multipart.send(outSocket_);
 }
 
+void BlenderNetwork::Send(const String& topic,const String& subtype, void *buffer,int length, const String& meta)
+{
+    Post(topic,topic+" "+subtype+" bin",meta,buffer,length);
+}
+
+void BlenderNetwork::Send(const String& topic,const String& subtype, const String& txtData, const String& meta)
+{
+    Post(topic,topic+" "+subtype+" text",meta,txtData.CString(),txtData.Length());
+}
+
 //void BlenderNetwork::CreateScreenshot()
 //{
 //    if (additionalResourcePath=="") return;
@@ -26,6 +26,10 @@
 #include <Urho3D/Scene/LogicComponent.h>
 #include <Urho3D/Graphics/AnimationController.h>
 #include <3rd/cppzmq/zmq.hpp>
+#include <commonObjects/MessageBatch.h>
+#include <commonObjects/MessageLog.h>
+#include <commonObjects/MessageRouter.h>
+#include <commonObjects/RpcChannel.h>
 
 using namespace Urho3D;
 
@@ -44,18 +48,60 @@ public:
     /// Register object factory and attributes.
     static void RegisterObject(Context* context);
 
-    void InitNetwork();
+    /// Connect to blender. Until then nothing is received and Send() does nothing. rpcIdentity is
+    /// the name blender addresses the requests to this runtime with.
+    void InitNetwork(const String& rpcIdentity = "runtime");
+    /// Receive a message and pass it to the handlers of its route, see Subscribe(). Messages without
+    /// a route are sent as E_BLENDER_MSG if anyone listens to it, otherwise they are dropped unparsed.
     void CheckNetwork();
+    /// Call handler for messages "topic subtype datatype", with the params of E_BLENDER_MSG. Subtype
+    /// "*" takes all messages of the topic that have no route of their own.
+    void Subscribe(const String& topic, const String& subtype, const MessageRouter::Handler& handler);
+    /// Routes with their message counts.
+    const MessageRouter& GetRouter() const { return router_; }
+    /// Requests from and to blender that get exactly one reply, next to the broadcasts.
+    RpcChannel* GetRpc() const { return rpc_; }
     void Close();
     /// Handle begin frame event.
     void HandleBeginFrame(StringHash eventType, VariantMap& eventData);
     void Send(const String& topic,const String& subtype,const String& txtData, const String& meta="");
     void Send(const String& topic,const String& subtype,void* buffer,int length, const String& meta="");
+
+    static const unsigned DEFAULT_BATCH_SIZE = 64 * 1024;
+    /// Pack the messages sent during a frame into one "<topic> batch bin" envelope per topic, see
+    /// MessageBatch. A batch is sent at the end of the frame or once it reaches maxBatchSize, bigger
+    /// messages are sent alone after the batches so the order stays. Batches from blender are
+    /// always unpacked.
+    void SetBatching(bool enable, unsigned maxBatchSize = DEFAULT_BATCH_SIZE);
+    bool IsBatching() const { return batching_; }
+    /// Send the batched messages now.
+    void Flush();
+
+    /// Write every message from blender to fileName, see MessageLog.
+    bool StartRecording(const String& fileName);
+    /// Take the messages from a recording instead of blender. Meant for a loader that is not
+    /// connected, everything sent is dropped.
+    bool StartReplay(const String& fileName, bool fast);
+    bool IsReplaying() const { return log_.IsReplaying(); }
+    bool IsReplayFinished() const { return log_.IsReplayFinished(); }
+    const MessageLog& GetLog() const { return log_; }
 private:
+    void HandleMessage(const FrameView* frames, unsigned numFrames, bool batched);
+    void HandleEndFrame(StringHash eventType, VariantMap& eventData);
+    /// Batch or send a message of topic frame, meta and data.
+    void Post(const String& topic, const String& topicFrame, const String& meta, const void* data, unsigned size);
+    void SendBatch(const String& topic, MessageBatch& batch);
+
     bool running_;
     zmq::socket_t  inSocket_;
     zmq::socket_t  outSocket_;
     bool initialized_;
     zmq::context_t ctx;
-
+    MessageRouter router_;
+    SharedPtr<RpcChannel> rpc_;
+    bool batching_;
+    unsigned maxBatchSize_;
+    /// by topic, kept over the frames so their memory is reused
+    HashMap<String, MessageBatch> batches_;
+    MessageLog log_;
 };
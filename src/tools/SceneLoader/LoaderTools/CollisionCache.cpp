@@ -0,0 +1,399 @@
+#include "CollisionCache.h"
+#include "LoaderCache.h"
+
+#include <Urho3D/Container/ArrayPtr.h>
+#include <Urho3D/Container/HashMap.h>
+#include <Urho3D/Container/HashSet.h>
+#include <Urho3D/Core/Context.h>
+#include <Urho3D/Core/WorkQueue.h>
+#include <Urho3D/Graphics/Geometry.h>
+#include <Urho3D/Graphics/IndexBuffer.h>
+#include <Urho3D/Graphics/Model.h>
+#include <Urho3D/Graphics/StaticModel.h>
+#include <Urho3D/Graphics/VertexBuffer.h>
+#include <Urho3D/IO/File.h>
+#include <Urho3D/IO/FileSystem.h>
+#include <Urho3D/IO/Log.h>
+#include <Urho3D/Physics/CollisionShape.h>
+#include <Urho3D/Physics/PhysicsWorld.h>
+#include <Urho3D/Scene/Node.h>
+#include <Urho3D/Scene/Scene.h>
+
+#include <Bullet/BulletCollision/CollisionShapes/btBvhTriangleMeshShape.h>
+#include <Bullet/BulletCollision/CollisionShapes/btOptimizedBvh.h>
+#include <Bullet/BulletCollision/CollisionShapes/btTriangleIndexVertexArray.h>
+#include <Bullet/BulletCollision/CollisionShapes/btTriangleInfoMap.h>
+#include <Bullet/LinearMath/btAlignedAllocator.h>
+
+// bump this whenever the file layout or the bullet version changes
+static const unsigned COLLISION_CACHE_VERSION = 1;
+// the triangle count above which CollisionShape builds the bvh without quantization
+static const unsigned QUANTIZE_MAX_TRIANGLES = 1000000;
+// the thresholds and the count in front of the edge infos, and the size of one edge info
+static const unsigned INFO_MAP_HEADER_SIZE = 28;
+static const unsigned TRIANGLE_INFO_SIZE = 20;
+
+/// The triangles of a model's lod level for bullet, the same that CollisionShape builds its
+/// bvh from. Urho3D keeps its own interface private, so the cache has this one.
+class CachedMeshInterface : public btTriangleIndexVertexArray
+{
+public:
+    CachedMeshInterface(Model* model, unsigned lodLevel)
+    {
+        unsigned numTriangles = 0;
+        for (unsigned i = 0; i < model->GetNumGeometries(); i++){
+            Geometry* geometry = model->GetGeometry(i,lodLevel);
+            if (!geometry)
+                continue;
+
+            SharedArrayPtr<unsigned char> vertexData;
+            SharedArrayPtr<unsigned char> indexData;
+            unsigned vertexSize;
+            unsigned indexSize;
+            const PODVector<VertexElement>* elements;
+            geometry->GetRawDataShared(vertexData,vertexSize,indexData,indexSize,elements);
+            if (!vertexData || !indexData || !elements || VertexBuffer::GetElementOffset(*elements,TYPE_VECTOR3,SEM_POSITION) != 0)
+                continue;
+
+            // keep the data alive while bullet points into it
+            dataArrays_.Push(vertexData);
+            dataArrays_.Push(indexData);
+
+            btIndexedMesh mesh;
+            mesh.m_numTriangles = geometry->GetIndexCount() / 3;
+            mesh.m_triangleIndexBase = &indexData[geometry->GetIndexStart() * indexSize];
+            mesh.m_triangleIndexStride = 3 * indexSize;
+            mesh.m_numVertices = 0;
+            mesh.m_vertexBase = vertexData;
+            mesh.m_vertexStride = vertexSize;
+            mesh.m_indexType = indexSize == sizeof(unsigned short) ? PHY_SHORT : PHY_INTEGER;
+            mesh.m_vertexType = PHY_FLOAT;
+            m_indexedMeshes.push_back(mesh);
+            numTriangles += mesh.m_numTriangles;
+        }
+        useQuantize_ = numTriangles <= QUANTIZE_MAX_TRIANGLES;
+    }
+
+    bool useQuantize_;
+
+private:
+    Vector<SharedArrayPtr<unsigned char> > dataArrays_;
+};
+
+/// Triangle-mesh shape whose bvh was restored in place from a cache file. It owns its mesh
+/// interface and the buffer of the bvh, TriangleMeshData only knows the shape.
+class CachedTriangleMeshShape : public btBvhTriangleMeshShape
+{
+public:
+    CachedTriangleMeshShape(CachedMeshInterface* meshInterface, void* bvhBuffer, btOptimizedBvh* bvh)
+        : btBvhTriangleMeshShape(meshInterface,meshInterface->useQuantize_,false),
+          meshInterface_(meshInterface),
+          bvhBuffer_(bvhBuffer)
+    {
+        // the shape does not own a bvh set like this
+        setOptimizedBvh(bvh);
+    }
+
+    ~CachedTriangleMeshShape() override
+    {
+        btAlignedFree(bvhBuffer_);
+    }
+
+private:
+    UniquePtr<CachedMeshInterface> meshInterface_;
+    void* bvhBuffer_;
+};
+
+/// All lod levels of one model that need a fresh build. Handled by one worker,
+/// as the lod levels share vertex data whose refcounts are not thread-safe.
+struct CollisionBuildJob
+{
+    SharedPtr<Model> model_;
+    PODVector<unsigned> lodLevels_;
+    Vector<SharedPtr<TriangleMeshData> > results_;
+};
+
+static void BuildCollisionGeometryWork(const WorkItem* item, unsigned threadIndex)
+{
+    auto* job = reinterpret_cast<CollisionBuildJob*>(item->aux_);
+    for (unsigned lodLevel : job->lodLevels_){
+        job->results_.Push(SharedPtr<TriangleMeshData>(new TriangleMeshData(job->model_,lodLevel)));
+    }
+}
+
+static bool HasDynamicBuffers(Model* model, unsigned lodLevel)
+{
+    for (unsigned i = 0; i < model->GetNumGeometries(); i++){
+        Geometry* geometry = model->GetGeometry(i,lodLevel);
+        if (!geometry)
+            continue;
+        for (unsigned j = 0; j < geometry->GetNumVertexBuffers(); j++){
+            VertexBuffer* buffer = geometry->GetVertexBuffer(j);
+            if (buffer && buffer->IsDynamic())
+                return true;
+        }
+        IndexBuffer* buffer = geometry->GetIndexBuffer();
+        if (buffer && buffer->IsDynamic())
+            return true;
+    }
+    return false;
+}
+
+CollisionCache::CollisionCache(Context* context)
+    : Object(context)
+{
+}
+
+void CollisionCache::ProcessSetMeshNodes(const PODVector<Node*>& nodes)
+{
+    typedef Pair<Model*, unsigned> GeometryKey;
+
+    PODVector<CollisionShape*> shapes;
+    PODVector<Model*> models;
+    HashSet<GeometryKey> handled;
+    HashMap<Model*, unsigned> jobIndices;
+    Vector<CollisionBuildJob> jobs;
+    HashMap<Model*, PhysicsWorld*> physicsWorlds;
+
+    for (Node* node : nodes){
+        CollisionShape* shape = node->GetComponent<CollisionShape>();
+        if (!shape || shape->GetShapeType() != SHAPE_TRIANGLEMESH)
+            continue;
+
+        StaticModel* staticModel = node->GetComponent<StaticModel>();
+        if (!staticModel || !staticModel->GetModel()){
+            URHO3D_LOGWARNINGF("[CollisionCache] setmesh node %s has no model",node->GetName().CString());
+            continue;
+        }
+
+        Model* model = staticModel->GetModel();
+        shapes.Push(shape);
+        models.Push(model);
+
+        PhysicsWorld* physicsWorld = node->GetScene() ? node->GetScene()->GetComponent<PhysicsWorld>() : nullptr;
+        GeometryKey key = MakePair(model,shape->GetLodLevel());
+        if (!physicsWorld || handled.Contains(key) || HasDynamicBuffers(model,key.second_))
+            continue;
+        handled.Insert(key);
+
+        auto& triMeshCache = physicsWorld->GetTriMeshCache();
+        if (triMeshCache.Contains(key))
+            continue;
+
+        SharedPtr<TriangleMeshData> data = LoadGeometry(model,key.second_,GetCacheFileName(model,key.second_));
+        if (data){
+            triMeshCache[key] = data;
+            continue;
+        }
+
+        // not cached yet: build it on the workers
+        physicsWorlds[model] = physicsWorld;
+        auto jobIt = jobIndices.Find(model);
+        if (jobIt == jobIndices.End()){
+            jobIndices[model] = jobs.Size();
+            jobs.Resize(jobs.Size()+1);
+            jobs.Back().model_ = model;
+            jobs.Back().lodLevels_.Push(key.second_);
+        } else {
+            jobs[jobIt->second_].lodLevels_.Push(key.second_);
+        }
+    }
+
+    if (!jobs.Empty()){
+        WorkQueue* queue = GetSubsystem<WorkQueue>();
+        // jobs must not be resized from here on, the work items point into it
+        for (CollisionBuildJob& job : jobs){
+            SharedPtr<WorkItem> item = queue->GetFreeItem();
+            item->workFunction_ = BuildCollisionGeometryWork;
+            item->aux_ = &job;
+            item->priority_ = M_MAX_UNSIGNED;
+            queue->AddWorkItem(item);
+        }
+        queue->Complete(M_MAX_UNSIGNED);
+
+        for (CollisionBuildJob& job : jobs){
+            PhysicsWorld* physicsWorld = physicsWorlds[job.model_];
+            for (unsigned i = 0; i < job.lodLevels_.Size(); i++){
+                unsigned lodLevel = job.lodLevels_[i];
+                physicsWorld->GetTriMeshCache()[MakePair(job.model_.Get(),lodLevel)] = job.results_[i];
+                SaveGeometry(job.results_[i],GetCacheFileName(job.model_,lodLevel));
+            }
+        }
+        URHO3D_LOGINFOF("[CollisionCache] built collision geometry for %u models",jobs.Size());
+    }
+
+    // all geometry is in the physics world's cache now, so this won't build anything
+    for (unsigned i = 0; i < shapes.Size(); i++){
+        shapes[i]->SetModel(models[i]);
+    }
+}
+
+String CollisionCache::GetCacheFileName(Model* model, unsigned lodLevel)
+{
+    unsigned long long hash = LoaderCache::Hash(&lodLevel,sizeof(lodLevel));
+
+    for (unsigned i = 0; i < model->GetNumGeometries(); i++){
+        Geometry* geometry = model->GetGeometry(i,lodLevel);
+        if (!geometry)
+            continue;
+
+        const unsigned char* vertexData;
+        const unsigned char* indexData;
+        unsigned vertexSize;
+        unsigned indexSize;
+        const PODVector<VertexElement>* elements;
+        geometry->GetRawData(vertexData,vertexSize,indexData,indexSize,elements);
+        if (!vertexData)
+            continue;
+
+        hash = LoaderCache::Hash(vertexData+geometry->GetVertexStart()*vertexSize,geometry->GetVertexCount()*vertexSize,hash);
+        if (indexData){
+            hash = LoaderCache::Hash(indexData+geometry->GetIndexStart()*indexSize,geometry->GetIndexCount()*indexSize,hash);
+        }
+    }
+
+    return LoaderCache::GetDir(context_,"collision")+LoaderCache::HashToString(hash)+".col";
+}
+
+SharedPtr<TriangleMeshData> CollisionCache::LoadGeometry(Model* model, unsigned lodLevel, const String& fileName)
+{
+    if (!GetSubsystem<FileSystem>()->FileExists(fileName))
+        return SharedPtr<TriangleMeshData>();
+
+    File file(context_,fileName,FILE_READ);
+    if (file.ReadFileID() != "UCOL" || file.ReadUInt() != COLLISION_CACHE_VERSION){
+        URHO3D_LOGWARNINGF("[CollisionCache] ignoring outdated cache file %s",fileName.CString());
+        return SharedPtr<TriangleMeshData>();
+    }
+
+    bool useQuantize = file.ReadBool();
+    unsigned bvhSize = file.ReadUInt();
+    if (bvhSize > file.GetSize() - file.GetPosition()){
+        URHO3D_LOGWARNINGF("[CollisionCache] ignoring truncated cache file %s",fileName.CString());
+        return SharedPtr<TriangleMeshData>();
+    }
+
+    // the interface only references the model's shadow data
+    UniquePtr<CachedMeshInterface> meshInterface(new CachedMeshInterface(model,lodLevel));
+    if (meshInterface->useQuantize_ != useQuantize)
+        return SharedPtr<TriangleMeshData>();
+
+    void* bvhBuffer = btAlignedAlloc(bvhSize,16);
+    btOptimizedBvh* bvh = nullptr;
+    if (file.Read(bvhBuffer,bvhSize) == bvhSize)
+        bvh = btOptimizedBvh::deSerializeInPlace(bvhBuffer,bvhSize,false);
+    if (!bvh){
+        btAlignedFree(bvhBuffer);
+        return SharedPtr<TriangleMeshData>();
+    }
+    UniquePtr<btBvhTriangleMeshShape> shape(new CachedTriangleMeshShape(meshInterface.Detach(),bvhBuffer,bvh));
+
+    if (file.GetSize() - file.GetPosition() < INFO_MAP_HEADER_SIZE){
+        URHO3D_LOGWARNINGF("[CollisionCache] ignoring truncated cache file %s",fileName.CString());
+        return SharedPtr<TriangleMeshData>();
+    }
+    UniquePtr<btTriangleInfoMap> infoMap(new btTriangleInfoMap());
+    infoMap->m_convexEpsilon = file.ReadFloat();
+    infoMap->m_planarEpsilon = file.ReadFloat();
+    infoMap->m_equalVertexThreshold = file.ReadFloat();
+    infoMap->m_edgeDistanceThreshold = file.ReadFloat();
+    infoMap->m_maxEdgeAngleThreshold = file.ReadFloat();
+    infoMap->m_zeroAreaThreshold = file.ReadFloat();
+
+    unsigned numInfos = file.ReadUInt();
+    if (numInfos > (file.GetSize() - file.GetPosition()) / TRIANGLE_INFO_SIZE){
+        URHO3D_LOGWARNINGF("[CollisionCache] ignoring truncated cache file %s",fileName.CString());
+        return SharedPtr<TriangleMeshData>();
+    }
+    for (unsigned i = 0; i < numInfos; i++){
+        int key = file.ReadInt();
+        btTriangleInfo info;
+        info.m_flags = file.ReadInt();
+        info.m_edgeV0V1Angle = file.ReadFloat();
+        info.m_edgeV1V2Angle = file.ReadFloat();
+        info.m_edgeV2V0Angle = file.ReadFloat();
+        infoMap->insert(key,info);
+    }
+
+    // built on the single triangle of the proxy, then its shape and edge info are swapped for
+    // the restored ones. the proxy's own interface stays unused
+    SharedPtr<TriangleMeshData> data(new TriangleMeshData(GetProxyModel(),0));
+    shape->setTriangleInfoMap(infoMap.Get());
+    data->shape_.Reset(shape.Detach());
+    data->infoMap_.Reset(infoMap.Detach());
+    return data;
+}
+
+bool CollisionCache::SaveGeometry(TriangleMeshData* data, const String& fileName)
+{
+    btOptimizedBvh* bvh = data->shape_->getOptimizedBvh();
+    btTriangleInfoMap* infoMap = data->infoMap_.Get();
+    if (!bvh || !infoMap)
+        return false;
+
+    unsigned bvhSize = bvh->calculateSerializeBufferSize();
+    void* buffer = btAlignedAlloc(bvhSize,16);
+    bool serialized = bvh->serializeInPlace(buffer,bvhSize,false);
+
+    File file(context_);
+    if (!serialized || !file.Open(fileName,FILE_WRITE)){
+        URHO3D_LOGWARNINGF("[CollisionCache] could not write %s",fileName.CString());
+        btAlignedFree(buffer);
+        return false;
+    }
+
+    file.WriteFileID("UCOL");
+    file.WriteUInt(COLLISION_CACHE_VERSION);
+    file.WriteBool(data->shape_->usesQuantizedAabbCompression());
+    file.WriteUInt(bvhSize);
+    file.Write(buffer,bvhSize);
+    btAlignedFree(buffer);
+
+    file.WriteFloat(infoMap->m_convexEpsilon);
+    file.WriteFloat(infoMap->m_planarEpsilon);
+    file.WriteFloat(infoMap->m_equalVertexThreshold);
+    file.WriteFloat(infoMap->m_edgeDistanceThreshold);
+    file.WriteFloat(infoMap->m_maxEdgeAngleThreshold);
+    file.WriteFloat(infoMap->m_zeroAreaThreshold);
+
+    file.WriteUInt(infoMap->size());
+    for (int i = 0; i < infoMap->size(); i++){
+        const btTriangleInfo* info = infoMap->getAtIndex(i);
+        file.WriteInt(infoMap->getKeyAtIndex(i).getUid1());
+        file.WriteInt(info->m_flags);
+        file.WriteFloat(info->m_edgeV0V1Angle);
+        file.WriteFloat(info->m_edgeV1V2Angle);
+        file.WriteFloat(info->m_edgeV2V0Angle);
+    }
+    return true;
+}
+
+Model* CollisionCache::GetProxyModel()
+{
+    if (proxyModel_)
+        return proxyModel_;
+
+    static const float vertices[] = { 0.0f,0.0f,0.0f, 1.0f,0.0f,0.0f, 0.0f,0.0f,1.0f };
+    static const unsigned short indices[] = { 0,1,2 };
+
+    SharedPtr<VertexBuffer> vertexBuffer(new VertexBuffer(context_));
+    vertexBuffer->SetShadowed(true);
+    vertexBuffer->SetSize(3,MASK_POSITION);
+    vertexBuffer->SetData(vertices);
+
+    SharedPtr<IndexBuffer> indexBuffer(new IndexBuffer(context_));
+    indexBuffer->SetShadowed(true);
+    indexBuffer->SetSize(3,false);
+    indexBuffer->SetData(indices);
+
+    SharedPtr<Geometry> geometry(new Geometry(context_));
+    geometry->SetVertexBuffer(0,vertexBuffer);
+    geometry->SetIndexBuffer(indexBuffer);
+    geometry->SetDrawRange(TRIANGLE_LIST,0,3);
+
+    proxyModel_ = new Model(context_);
+    proxyModel_->SetNumGeometries(1);
+    proxyModel_->SetGeometry(0,0,geometry);
+    proxyModel_->SetBoundingBox(BoundingBox(Vector3::ZERO,Vector3::ONE));
+    return proxyModel_;
+}
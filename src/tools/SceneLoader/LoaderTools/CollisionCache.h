@@ -0,0 +1,41 @@
+#pragma once
+
+#include <Urho3D/Core/Object.h>
+#include <Urho3D/Container/Ptr.h>
+#include <Urho3D/Container/Str.h>
+#include <Urho3D/Container/Vector.h>
+
+namespace Urho3D {
+    class Context;
+    class Model;
+    class Node;
+    class PhysicsWorld;
+    struct TriangleMeshData;
+}
+
+using namespace Urho3D;
+
+/// Persistent cache for the bullet triangle-mesh data of "setmesh" nodes.
+/// Building the BVH and the internal edge info of big terrain meshes is the most
+/// expensive part of loading a scene. The built data is written to disk keyed by
+/// the model's geometry hash and lod level and restored instead of rebuilt on
+/// the next start or scene reload. Geometry that is not cached yet is built on
+/// the worker threads.
+class CollisionCache : public Object {
+    URHO3D_OBJECT(CollisionCache, Object);
+public:
+    explicit CollisionCache(Context* context);
+
+    /// Assign the StaticModel's model to the SHAPE_TRIANGLEMESH CollisionShape of each node.
+    void ProcessSetMeshNodes(const PODVector<Node*>& nodes);
+
+private:
+    /// Restore cached triangle-mesh data. Returns null if there is no valid cache file.
+    SharedPtr<TriangleMeshData> LoadGeometry(Model* model, unsigned lodLevel, const String& fileName);
+    bool SaveGeometry(TriangleMeshData* data, const String& fileName);
+    String GetCacheFileName(Model* model, unsigned lodLevel);
+    Model* GetProxyModel();
+
+    /// single triangle model used to construct TriangleMeshData without building a real BVH
+    SharedPtr<Model> proxyModel_;
+};
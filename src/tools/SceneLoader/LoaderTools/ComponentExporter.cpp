@@ -1,11 +1,20 @@
 #include "ComponentExporter.h"
+#include "LoaderCache.h"
+#include "JSONStreamWriter.h"
+#include "ExportDiff.h"
 
 #include "base64.h"
+#include <AttributeTable.h>
 #include <Urho3D/Container/Sort.h>
+#include <Urho3D/Core/Timer.h>
+#include <Urho3D/Core/WorkQueue.h>
+#include <Urho3D/Resource/XMLFile.h>
 #include <Urho3D/Resource/ResourceCache.h>
 #include <Urho3D/Resource/JSONFile.h>
+#include <Urho3D/IO/Compression.h>
 #include <Urho3D/IO/File.h>
 #include <Urho3D/IO/FileSystem.h>
+#include <Urho3D/IO/VectorBuffer.h>
 #include <Urho3D/Graphics/Material.h>
 #include <Urho3D/Graphics/Technique.h>
 #include <Urho3D/IO/Log.h>
@@ -14,12 +23,50 @@
 #include <Urho3D/Core/Object.h>
 #include <Urho3D/Core/Context.h>
 
+// bump this whenever the export format changes, so cached exports are written again
+static const unsigned EXPORT_VERSION = 2;
+
+// attribute tables hand their subtypes over as NodeSubType
+static_assert((int)Urho3DNodeTreeExporter::ST_DISTANCE == (int)AST_DISTANCE, "AttributeSubType is out of sync with NodeSubType");
+
+/// Same fields as Urho3DNodeTreeExporter::NodeAddEnumElement(), written straight to the stream.
+static void WriteEnumElement(JSONStreamWriter& writer, const String& id, const String& name, const String& descr, const String& icon, const String& number = "0", const String& category = "")
+{
+    writer.StartObject();
+    writer.Member("id",id);
+    writer.Member("name",name==""?id:name);
+    writer.Member("description",descr==""?id:descr);
+    writer.Member("icon",icon);
+    writer.Member("number",number);
+    if (category!="")
+        writer.Member("category",category);
+    writer.EndObject();
+}
+
 Urho3DNodeTreeExporter::Urho3DNodeTreeExporter(Context* context, ExportMode exportMode)
     : Object(context),
-      m_exportMode(exportMode)
+      m_exportMode(exportMode),
+      m_cacheLoaded(false),
+      m_exportDataSize(0),
+      m_exportHash(0),
+      m_exportFingerprint(0),
+      m_exportVersion(0),
+      m_patchDataSize(0),
+      m_asyncUnchanged(false),
+      m_asyncSuccess(false),
+      m_hasPending(false)
 {
 }
 
+Urho3DNodeTreeExporter::~Urho3DNodeTreeExporter()
+{
+    // the worker still points to this exporter
+    WorkQueue* queue = GetSubsystem<WorkQueue>();
+    if (m_asyncItem && queue){
+        queue->Complete(0);
+    }
+}
+
 void Urho3DNodeTreeExporter::AddComponentHashToFilterList(const StringHash& componentHash)
 {
     m_listOfComponents.Insert(componentHash);
@@ -45,97 +92,241 @@ bool CompareString(const String& a,const String& b){
     return a < b;
 }
 
+/// Folders of one kind of resource and the extension that counts, files are matched by prefix.
+struct FileCategory{
+    const Vector<String>* folders;
+    const char* extension;
+    Vector<String>* dest;
+};
+
+/// Return the part of file below folder, or empty if it is not in there.
+static String StripFolder(const String& file, const String& folder)
+{
+    unsigned length = folder.EndsWith("/") ? folder.Length() : folder.Length() + 1;
+    if (file.Length() <= length || !file.StartsWith(folder) || file[length-1] != '/')
+        return String::EMPTY;
+    return file.Substring(length);
+}
+
 void Urho3DNodeTreeExporter::ProcessFileSystem()
 {
-    ResourceCache* cache = GetSubsystem<ResourceCache>();
     FileSystem* fs = GetSubsystem<FileSystem>();
 
     materialFiles.Clear();
     techniqueFiles.Clear();
     textureFiles.Clear();
     modelFiles.Clear();
-
-    for (String resDir : cache->GetResourceDirs()){
-        Vector<String> dirFiles;
-        for (String path : m_materialFolders){
-            String dir = resDir+path;
-            fs->ScanDir(dirFiles,dir,"*.xml",SCAN_FILES,true);
-            for (String foundMaterial : dirFiles){
-                auto materialResourceName = path+"/"+foundMaterial;
-                Material* material = cache->GetResource<Material>(materialResourceName);
-                if (material){
-                    materialFiles.Push(materialResourceName);
+    animationFiles.Clear();
+
+    const FileCategory categories[] = {
+        {&m_materialFolders,".xml",&materialFiles},
+        {&m_techniqueFolders,".xml",&techniqueFiles},
+        // all files with .mdl extension are considered a mesh
+        {&m_modelFolders,".mdl",&modelFiles},
+        {&m_animationFolders,".ani",&animationFiles}
+    };
+    static const char* textureExtensions[] = {".jpg",".png",".dds"};
+    const unsigned numTextureExtensions = sizeof(textureExtensions) / sizeof(textureExtensions[0]);
+    const unsigned numCategories = sizeof(categories) / sizeof(categories[0]);
+
+    // a name that is in several resource dirs is listed once, the first dir has it like in the ResourceCache
+    HashSet<String> listed[numCategories];
+    HashSet<String> listedTextures;
+
+    // runs on a worker for ExportAsync, so only list the files here. materials and techniques
+    // are checked in ValidateResourceFiles() once it is clear the export has to be written.
+    // every resource dir is walked once (and only again once something in it changed), the
+    // files are then sorted into the configured folders in a single pass over the listing
+    for (String resDir : m_resourceDirs){
+        const Vector<String>& files = m_cache.ListFiles(fs,resDir);
+
+        // textures keep their order: per folder, jpgs first, then pngs, then dds
+        Vector<Vector<ExportPath> > textures(m_textureFolders.Size() * numTextureExtensions);
+
+        for (const String& file : files){
+            for (unsigned c = 0; c < numCategories; ++c){
+                const FileCategory& category = categories[c];
+                if (!file.EndsWith(category.extension,false))
+                    continue;
+                for (const String& path : *category.folders){
+                    String name = StripFolder(file,path);
+                    String resourceName = path+"/"+name;
+                    if (!name.Empty() && !listed[c].Contains(resourceName)){
+                        listed[c].Insert(resourceName);
+                        category.dest->Push(resourceName);
+                    }
                 }
             }
-        }
 
-
-        // grab techniques from the specified technique folders
-        for (String path : m_techniqueFolders){
-            String dir = resDir+path;
-            fs->ScanDir(dirFiles,dir,"*.xml",SCAN_FILES,true);
-            for (String foundTechnique : dirFiles){
-                auto techiqueResourceName = path+"/"+foundTechnique;
-                Technique* technique = cache->GetResource<Technique>(techiqueResourceName);
-                if (technique){
-                    techniqueFiles.Push(techiqueResourceName);
+            for (unsigned e = 0; e < numTextureExtensions; ++e){
+                if (!file.EndsWith(textureExtensions[e],false))
+                    continue;
+                for (unsigned i = 0; i < m_textureFolders.Size(); ++i){
+                    const String& path = m_textureFolders[i];
+                    String name = StripFolder(file,path);
+                    String resourceName = path+"/"+name;
+                    if (name.Empty() || listedTextures.Contains(resourceName))
+                        continue;
+                    listedTextures.Insert(resourceName);
+                    ExportPath p;
+                    p.absFilepath = resDir+resourceName;
+                    p.resFilepath = resourceName;
+                    textures[i * numTextureExtensions + e].Push(p);
                 }
             }
         }
 
+        for (const Vector<ExportPath>& group : textures){
+            textureFiles.Push(group);
+        }
+    }
 
-        // grab models from the specified model folder. all files with .mdl extension are considered a mesh
-        for (String path : m_modelFolders){
-            String dir = resDir+path;
-            fs->ScanDir(dirFiles,dir,"*.mdl",SCAN_FILES,true);
-            for (String foundModel : dirFiles){
-                auto modelResourceName = path+"/"+foundModel;
-                modelFiles.Push(modelResourceName);
-            }
+    Sort(materialFiles.Begin(),materialFiles.End(),CompareString);
+    Sort(techniqueFiles.Begin(),techniqueFiles.End(),CompareString);
+   // Sort(textureFiles.Begin(),techniqueFiles.End(),CompareString);
+    Sort(modelFiles.Begin(),modelFiles.End(),CompareString);
+    Sort(animationFiles.Begin(),animationFiles.End(),CompareString);
+}
+
+/// Return the file of the first resource dir that has resourceName, like the ResourceCache would.
+static String FindResourceFile(FileSystem* fs, const Vector<String>& resourceDirs, const String& resourceName)
+{
+    for (const String& resDir : resourceDirs){
+        if (fs->FileExists(resDir+resourceName))
+            return resDir+resourceName;
+    }
+    return String::EMPTY;
+}
+
+/// Check the root element instead of loading the resource, which is only possible on the main thread.
+static bool HasXMLRoot(Context* context, const String& fileName, const String& rootName)
+{
+    File file(context,fileName,FILE_READ);
+    XMLFile xml(context);
+    return file.IsOpen() && xml.Load(file) && xml.GetRoot().GetName() == rootName;
+}
+
+bool Urho3DNodeTreeExporter::CheckXMLResource(const String& resourceName, const String& rootName)
+{
+    FileSystem* fs = GetSubsystem<FileSystem>();
+    String fileName = FindResourceFile(fs,m_resourceDirs,resourceName);
+    unsigned modified = fs->GetLastModifiedTime(fileName);
+
+    int cached = m_cache.GetFileCheck(fileName,modified);
+    if (cached != -1)
+        return cached == 1;
+
+    bool valid = HasXMLRoot(context_,fileName,rootName);
+    m_cache.SetFileCheck(fileName,modified,valid);
+    return valid;
+}
+
+void Urho3DNodeTreeExporter::ValidateResourceFiles()
+{
+    Vector<String> validFiles;
+    for (const String& material : materialFiles){
+        if (CheckXMLResource(material,"material")){
+            validFiles.Push(material);
         }
+    }
+    materialFiles = validFiles;
 
-        for (String path : m_animationFolders){
-            String dir = resDir+path;
-            fs->ScanDir(dirFiles,dir,"*.ani",SCAN_FILES,true);
-            for (String foundAnim : dirFiles){
-                auto animResourceName = path+"/"+foundAnim;
-                animationFiles.Push(animResourceName);
-            }
+    validFiles.Clear();
+    for (const String& technique : techniqueFiles){
+        if (CheckXMLResource(technique,"technique")){
+            validFiles.Push(technique);
         }
+    }
+    techniqueFiles = validFiles;
+}
 
-        // grab textures from the specified texture folders
-        for (String path : m_textureFolders){
-            String dir = resDir+path;
-            fs->ScanDir(dirFiles,dir,"*.jpg",SCAN_FILES,true);
-            for (String foundTexture : dirFiles){
-                ExportPath p;
-                p.absFilepath = dir +"/"+foundTexture;
-                p.resFilepath = path+"/"+foundTexture;
-                textureFiles.Push(p);
-            }
-            fs->ScanDir(dirFiles,dir,"*.png",SCAN_FILES,true);
-            for (String foundTexture : dirFiles){
-                ExportPath p;
-                p.absFilepath = dir +"/"+foundTexture;
-                p.resFilepath = path+"/"+foundTexture;
-                textureFiles.Push(p);
-            }
-            fs->ScanDir(dirFiles,dir,"*.dds",SCAN_FILES,true);
-            for (String foundTexture : dirFiles){
-                ExportPath p;
-                p.absFilepath = dir +"/"+foundTexture;
-                p.resFilepath = path+"/"+foundTexture;
-                textureFiles.Push(p);
-            }
+static unsigned long long HashType(const ExportedType& type, unsigned long long hash)
+{
+    hash = LoaderCache::Hash(type.typeName,hash);
+    hash = LoaderCache::Hash(type.category,hash);
+    for (const ExportedAttribute& attr : type.attributes){
+        hash = LoaderCache::Hash(attr.name,hash);
+        hash = LoaderCache::Hash(&attr.type,sizeof(attr.type),hash);
+        hash = LoaderCache::Hash(attr.defaultValue,hash);
+        hash = LoaderCache::Hash(attr.refTypeName,hash);
+        for (const String& enumName : attr.enumNames){
+            hash = LoaderCache::Hash(enumName,hash);
         }
+        hash = LoaderCache::Hash(&attr.subType,sizeof(attr.subType),hash);
+        hash = LoaderCache::Hash(&attr.min,sizeof(attr.min),hash);
+        hash = LoaderCache::Hash(&attr.max,sizeof(attr.max),hash);
+    }
+    return hash;
+}
 
+static unsigned long long HashList(const Vector<String>& list, unsigned long long hash = LoaderCache::HASH_SEED)
+{
+    for (const String& entry : list){
+        hash = LoaderCache::Hash(entry,hash);
     }
+    return hash;
+}
 
-    Sort(materialFiles.Begin(),materialFiles.End(),CompareString);
-    Sort(techniqueFiles.Begin(),techniqueFiles.End(),CompareString);
-   // Sort(textureFiles.Begin(),techniqueFiles.End(),CompareString);
-    Sort(modelFiles.Begin(),modelFiles.End(),CompareString);
-    Sort(animationFiles.Begin(),animationFiles.End(),CompareString);
+static unsigned long long HashList(const Vector<ExportPath>& list, unsigned long long hash = LoaderCache::HASH_SEED)
+{
+    for (const ExportPath& entry : list){
+        hash = LoaderCache::Hash(entry.absFilepath,hash);
+        hash = LoaderCache::Hash(entry.resFilepath,hash);
+    }
+    return hash;
+}
+
+/// Return the id of the shared enum table listing the resources of that type, or null if there is none.
+static const char* GetEnumTableId(const String& refTypeName)
+{
+    if (refTypeName == "Model")
+        return "models";
+    if (refTypeName == "Animation")
+        return "animations";
+    if (refTypeName == "Texture2D")
+        return "textures";
+    if (refTypeName == "Material")
+        return "materials";
+    return nullptr;
+}
+
+unsigned long long Urho3DNodeTreeExporter::CalculateFingerprint()
+{
+    FileSystem* fs = GetSubsystem<FileSystem>();
+
+    unsigned long long hash = LoaderCache::Hash(&EXPORT_VERSION,sizeof(EXPORT_VERSION));
+    for (const ExportedType& type : m_types){
+        hash = HashType(type,hash);
+    }
+
+    // materials and techniques are validated by content, for the rest the names are enough
+    for (const String& material : materialFiles){
+        unsigned modified = fs->GetLastModifiedTime(FindResourceFile(fs,m_resourceDirs,material));
+        hash = LoaderCache::Hash(material,hash);
+        hash = LoaderCache::Hash(&modified,sizeof(modified),hash);
+    }
+    for (const String& technique : techniqueFiles){
+        unsigned modified = fs->GetLastModifiedTime(FindResourceFile(fs,m_resourceDirs,technique));
+        hash = LoaderCache::Hash(technique,hash);
+        hash = LoaderCache::Hash(&modified,sizeof(modified),hash);
+    }
+    hash = HashList(textureFiles,hash);
+    hash = HashList(modelFiles,hash);
+    hash = HashList(animationFiles,hash);
+    hash = LoaderCache::Hash(m_thumbnailAtlas,hash);
+    hash = LoaderCache::Hash(m_thumbnailIndex,hash);
+    return HashCustomUIFiles(hash);
+}
+
+unsigned long long Urho3DNodeTreeExporter::HashCustomUIFiles(unsigned long long hash)
+{
+    FileSystem* fs = GetSubsystem<FileSystem>();
+    for (const String& customUIFilename : m_customUIFilenames){
+        hash = LoaderCache::Hash(customUIFilename,hash);
+        unsigned long long contentHash = fs->FileExists(customUIFilename) ? LoaderCache::HashFile(context_,customUIFilename) : 0;
+        hash = LoaderCache::Hash(&contentHash,sizeof(contentHash),hash);
+    }
+    return hash;
 }
 
 JSONObject Urho3DNodeTreeExporter::ExportMaterials()
@@ -408,8 +599,8 @@ void Urho3DNodeTreeExporter::NodeAddProp(JSONObject &node, const String &name, N
 
     switch (type){
         case NT_BOOL: prop["type"] = "bool"; break;
-        case NT_INT: prop["type"] = "int"; if (min>max) {prop["min"]=(int)min; prop["max"]=(int)max;}break;
-        case NT_FLOAT: prop["type"] = "float"; if (min>max) {prop["min"]=min; prop["max"]=max;}prop["precision"]=precission;break;
+        case NT_INT: prop["type"] = "int"; if (min<max) {prop["min"]=(int)min; prop["max"]=(int)max;}break;
+        case NT_FLOAT: prop["type"] = "float"; if (min<max) {prop["min"]=min; prop["max"]=max;}prop["precision"]=precission;break;
         case NT_VECTOR2: prop["type"] = "vector2"; break;
         case NT_VECTOR3: prop["type"] = "vector3"; break;
         case NT_VECTOR4: prop["type"] = "vector4"; break;
@@ -461,6 +652,24 @@ void Urho3DNodeTreeExporter::NodeAddPropEnum(JSONObject &node, const String &nam
     node["props"]=props;
 }
 
+void Urho3DNodeTreeExporter::NodeAddPropEnumRef(JSONObject &node, const String &name, const String &tableId, bool categorized,const String &defaultValue)
+{
+    JSONObject prop;
+    prop["name"]=name;
+    prop["type"]="enum";
+    prop["elements_ref"]=tableId;
+    prop["default"]=defaultValue;
+    prop["use_category"]=categorized?"True":"False";
+
+    if (!node.Contains("props")){
+        JSONArray propsArray;
+        node["props"]=propsArray;
+    }
+
+    JSONArray props = node["props"].GetArray();
+    props.Push(prop);
+    node["props"]=props;
+}
 
 void Urho3DNodeTreeExporter::NodeAddEnumElement(JSONArray &elements, const String &id, const String &name, const String &descr, const String &icon, const String& number, const String& category)
 {
@@ -544,202 +753,201 @@ String  Urho3DNodeTreeExporter::GetTypeCategory(const StringHash& hash,const Str
     return defaultValue;
 }
 
-JSONObject Urho3DNodeTreeExporter::ExportComponents()
+void Urho3DNodeTreeExporter::TakeSnapshot()
 {
-    const HashMap<StringHash, SharedPtr<ObjectFactory> >& objFactories = context_->GetObjectFactories();
-
-    auto values = objFactories.Values();
-
-    JSONObject tree;
-
-    String treeID = "urho3dcomponents";
+    m_resourceDirs = GetSubsystem<ResourceCache>()->GetResourceDirs();
+    m_types.Clear();
 
-    tree["id"]=treeID;
-    tree["name"]="Tree "+treeID;
-    tree["icon"]="OUTLINER_OB_GROUP_INSTANCE";
-
-    JSONArray nodes;
+    const HashMap<StringHash, SharedPtr<ObjectFactory> >& objFactories = context_->GetObjectFactories();
 
-    Vector<Pair<String, unsigned> > sortedTypes;
-    for (unsigned i = 0; i < values.Size(); ++i)
+    Vector<String> sortedTypes;
+    for (auto it = objFactories.Begin(); it != objFactories.End(); ++it)
     {
-        SharedPtr<ObjectFactory> val = values.At(i);
+        SharedPtr<ObjectFactory> val = it->second_;
+        if (val.Null())
+            continue;
 
         // apply black- /whitelist-Filter
         if (    (InBlacklistMode() && (m_listOfComponents.Contains(val->GetType()) || CheckSuperTypes(val->GetTypeInfo())) )
              || (InWhiteListMode() && (!m_listOfComponents.Contains(val->GetType()) && !CheckSuperTypes(val->GetTypeInfo()) )) )
             continue;
 
-        if (val.NotNull())
-        {
-            sortedTypes.Push(MakePair(val->GetTypeName(), i));
-        }
+        sortedTypes.Push(val->GetTypeName());
     }
-    Sort(sortedTypes.Begin(), sortedTypes.End());
-
-    const HashMap<StringHash, SharedPtr<ObjectFactory> >& all = context_->GetObjectFactories();
-
-    for (int i=0;i < sortedTypes.Size(); i++){
-
-        auto objectFactoryName = sortedTypes[i].first_;
-        JSONObject node;
+    Sort(sortedTypes.Begin(), sortedTypes.End(), CompareString);
 
-        SharedPtr<ObjectFactory> val = *all[StringHash(objectFactoryName)];
+    for (const String& objectFactoryName : sortedTypes){
+        SharedPtr<ObjectFactory> val = *objFactories[StringHash(objectFactoryName)];
 
+        ExportedType type;
+        type.typeName = val->GetTypeName();
         if (val->GetTypeInfo()->IsTypeOf(Component::GetTypeInfoStatic())){
-       //     URHO3D_LOGINFOF("TYPE:%s\n",val->GetTypeName().CString());
-            node["category"]=GetTypeCategory(val->GetTypeInfo()->GetType(),"Misc");
-        } else {
-       //     URHO3D_LOGINFOF("NO COMPONENT: TYPE:%s\n",val->GetTypeName().CString());
+            type.category = GetTypeCategory(val->GetTypeInfo()->GetType(),"Misc");
         }
 
-        node["id"]=treeID+"__"+val->GetTypeName().Replaced(" ","_");
-        node["name"]=val->GetTypeName();
-
-        JSONArray props;
+        // project components describe their attributes at compile time, nothing to look up
+        if (const AttributeTableView* table = AttributeTable::Find(val->GetType())){
+            for (unsigned i = 0; i < table->size_; i++){
+                const AttributeDesc& desc = table->descs_[i];
+                if (desc.mode_ & AM_NOEDIT)
+                    continue;
+
+                ExportedAttribute exported;
+                exported.name = desc.name_;
+                exported.type = desc.type_;
+                exported.defaultValue = AttributeTable::DefaultValue(desc).ToString();
+                if (desc.refTypeName_){
+                    exported.refTypeName = desc.refTypeName_;
+                }
+                if (desc.enumNames_){
+                    for (int idx = 0; desc.enumNames_[idx] != NULL; idx++){
+                        exported.enumNames.Push(desc.enumNames_[idx]);
+                    }
+                }
+                exported.subType = desc.subType_;
+                exported.min = desc.min_;
+                exported.max = desc.max_;
+                type.attributes.Push(exported);
+            }
+            m_types.Push(type);
+            continue;
+        }
 
         auto attrs = context_->GetAttributes(val->GetTypeInfo()->GetType());
         if (attrs){
-            for (int j = 0;j<attrs->Size();j++){
-                auto attr = attrs->At(j);
-              //  URHO3D_LOGINFOF("\tattr:%s\n", attr.name_.CString());
-
-
+            for (const AttributeInfo& attr : *attrs){
                 if (attr.mode_ & AM_NOEDIT)
                     continue; // ignore no-edit attributes
 
-                JSONObject prop;
-
-                // work around to use new prop-helpers
-                bool alreadyAdded = false;
-
-                prop["name"] = attr.name_;
-                switch (attr.type_){
-                    case VAR_BOOL :
-                        NodeAddProp(node, attr.name_,NT_BOOL,attr.defaultValue_.ToString()); break;
-                    case VAR_INT : {
-                        if (!attr.enumNames_) {
-                            NodeAddProp(node, attr.name_,NT_INT,attr.defaultValue_.ToString());
-                        } else {
-                            JSONArray elements;
-                            for (int idx = 0; attr.enumNames_[idx] != NULL; idx++)
-                            {
-                                NodeAddEnumElement(elements,attr.enumNames_[idx],attr.enumNames_[idx]);
-                            }
-                            NodeAddPropEnum(node, attr.name_, elements,false,attr.defaultValue_.ToString());
-                        }
-                        break;
+                ExportedAttribute exported;
+                exported.name = attr.name_;
+                exported.type = attr.type_;
+                exported.defaultValue = attr.defaultValue_.ToString();
+                if (attr.type_ == VAR_RESOURCEREF && attr.defaultValue_.GetResourceRef().type_){
+                    exported.refTypeName = context_->GetTypeName(attr.defaultValue_.GetResourceRef().type_);
+                }
+                if (attr.enumNames_){
+                    for (int idx = 0; attr.enumNames_[idx] != NULL; idx++){
+                        exported.enumNames.Push(attr.enumNames_[idx]);
                     }
+                }
+                type.attributes.Push(exported);
+            }
+        }
+        m_types.Push(type);
+    }
+}
 
-                    case VAR_FLOAT :
-                        NodeAddProp(node, attr.name_,NT_FLOAT,attr.defaultValue_.ToString());break;
-                    case VAR_STRING :
-                        NodeAddProp(node, attr.name_,NT_STRING,attr.defaultValue_.ToString());break;
-                    case VAR_COLOR :
-                        NodeAddProp(node, attr.name_,NT_COLOR,attr.defaultValue_.ToString());break;
-                    case VAR_VECTOR2 :
-                        NodeAddProp(node, attr.name_,NT_VECTOR2,attr.defaultValue_.ToString());break;
-                    case VAR_VECTOR3 :
-                        NodeAddProp(node, attr.name_,NT_VECTOR3,attr.defaultValue_.ToString());break;
-                    case VAR_VECTOR4 :
-                        NodeAddProp(node, attr.name_,NT_VECTOR4,attr.defaultValue_.ToString());break;
-
-                    case VAR_RESOURCEREF :
-                        prop["type"]="string";
-                        if (!attr.defaultValue_.GetResourceRef().type_){
-                            prop["default"]="REF_UNKNOWN";
-                        } else {
-                            auto typeName = context_->GetTypeName(attr.defaultValue_.GetResourceRef().type_);
-                            if (typeName=="Model"){
-                                // dropdown to choose techniques available from the resource-path
-                                JSONArray enumElems;
-                                NodeAddEnumElement(enumElems,"None","None","No Mesh","MESH");
-                                NodeAddEnumElement(enumElems,"__Node-Mesh","Node-Mesh","The node's current mesh","MESH","1");
-
-                                for (String model : modelFiles){
-                                    StringHash hash(model);
-                                    String id(hash.Value() % 10000000);
-
-                                    NodeAddEnumElement(enumElems,"Model;"+model,model,"Model "+model,"MESH",id);
-                                }
-
-                                NodeAddPropEnum(node,attr.name_,enumElems,true,"0");
-                                alreadyAdded = true;
-                            }
-                            else if (typeName == "Animation")
-                            {
-                                // dropdown to choose techniques available from the resource-path
-                                JSONArray enumElems;
-                                NodeAddEnumElement(enumElems,"none","None","No Animation","ANIM");
-
-                                for (String anim : animationFiles){
-                                    StringHash hash(anim);
-                                    String id(hash.Value() % 10000000);
-
-                                    NodeAddEnumElement(enumElems,"Animation;"+anim,anim,"Animation "+anim,"ANIM",id);
-                                }
-
-                                NodeAddPropEnum(node,attr.name_,enumElems,true,"0");
-                                alreadyAdded = true;
-
-                            }
-                            else if (typeName == "Texture2D")
-                            {
-                                // dropdown to choose textures available from the resource-path
-                                JSONArray enumElems;
-                                NodeAddEnumElement(enumElems,"none","None","No Texture","TEXTURE");
-
-                                for (ExportPath tex : textureFiles){
-                                    StringHash hash(tex.resFilepath);
-                                    String id(hash.Value() % 10000000);
-
-                                    NodeAddEnumElement(enumElems,"Texture;"+tex.resFilepath,tex.resFilepath,tex.absFilepath,"TEXTURE",id);
-                                }
-
-                                NodeAddPropEnum(node,attr.name_,enumElems,true,"0");
-                                alreadyAdded = true;
-
-                            }
-                            else if (typeName == "Material")
-                            {
-                                // dropdown to choose techniques available from the resource-path
-                                JSONArray enumElems;
-                                NodeAddEnumElement(enumElems,"none","None","No Material","MATERIAL");
-
-                                for (String mat : materialFiles){
-                                    StringHash hash(mat);
-                                    String id(hash.Value() % 10000000);
-
-                                    NodeAddEnumElement(enumElems,"Material;"+mat,mat,"Material "+mat,"MATERIAL",id);
-                                }
-
-                                NodeAddPropEnum(node,attr.name_,enumElems,true,"0");
-                                alreadyAdded = true;
-
-                            }
-                        }
-                    break;
-                    default:
-                        URHO3D_LOGINFOF("[%s] Skipping attribute:%s",val->GetTypeName().CString(),attr.name_.CString());
-                        continue;
+void Urho3DNodeTreeExporter::ExportComponents(JSONStreamWriter& writer)
+{
+    String treeID = "urho3dcomponents";
 
-                }
+    writer.StartObject();
+    writer.Member("id",treeID);
+    writer.Member("name","Tree "+treeID);
+    writer.Member("icon","OUTLINER_OB_GROUP_INSTANCE");
 
-            }
+    // every node is written as soon as it is done, only one of them is in memory at a time
+    writer.Key("nodes");
+    writer.StartArray();
+
+    // resource dropdowns only reference the tables in globalData, so a node only changes with its type
+    for (const ExportedType& type : m_types){
+        unsigned long long hash = HashType(type,LoaderCache::Hash(&EXPORT_VERSION,sizeof(EXPORT_VERSION)));
+
+        String key = "type:"+type.typeName;
+        if (const JSONValue* cached = m_cache.GetSection(key,hash)){
+            writer.Value(*cached);
+        } else {
+            JSONObject node = ExportComponentNode(type);
+            m_cache.SetSection(key,hash,node);
+            writer.Value(node);
         }
+    }
+    writer.EndArray();
+    writer.EndObject();
+}
 
-        nodes.Push(node);
+JSONObject Urho3DNodeTreeExporter::ExportComponentNode(const ExportedType& type)
+{
+    const String treeID = "urho3dcomponents";
+    JSONObject node;
 
+    if (!type.category.Empty()){
+        node["category"]=type.category;
     }
-    tree["nodes"]=nodes;
-    return tree;
+
+    node["id"]=treeID+"__"+type.typeName.Replaced(" ","_");
+    node["name"]=type.typeName;
+
+    for (const ExportedAttribute& attr : type.attributes){
+        JSONObject prop;
+
+        // work around to use new prop-helpers
+        bool alreadyAdded = false;
+
+        prop["name"] = attr.name;
+        switch (attr.type){
+            case VAR_BOOL :
+                NodeAddProp(node, attr.name,NT_BOOL,attr.defaultValue); break;
+            case VAR_INT : {
+                if (attr.enumNames.Empty()) {
+                    NodeAddProp(node, attr.name,NT_INT,attr.defaultValue,(NodeSubType)attr.subType,3,attr.min,attr.max);
+                } else {
+                    JSONArray elements;
+                    for (const String& enumName : attr.enumNames)
+                    {
+                        NodeAddEnumElement(elements,enumName,enumName);
+                    }
+                    NodeAddPropEnum(node, attr.name, elements,false,attr.defaultValue);
+                }
+                break;
+            }
+
+            case VAR_FLOAT :
+                NodeAddProp(node, attr.name,NT_FLOAT,attr.defaultValue,(NodeSubType)attr.subType,3,attr.min,attr.max);break;
+            case VAR_STRING :
+                NodeAddProp(node, attr.name,NT_STRING,attr.defaultValue);break;
+            case VAR_COLOR :
+                NodeAddProp(node, attr.name,NT_COLOR,attr.defaultValue);break;
+            case VAR_VECTOR2 :
+                NodeAddProp(node, attr.name,NT_VECTOR2,attr.defaultValue);break;
+            case VAR_VECTOR3 :
+                NodeAddProp(node, attr.name,NT_VECTOR3,attr.defaultValue);break;
+            case VAR_VECTOR4 :
+                NodeAddProp(node, attr.name,NT_VECTOR4,attr.defaultValue);break;
+
+            case VAR_RESOURCEREF :
+                prop["type"]="string";
+                if (attr.refTypeName.Empty()){
+                    prop["default"]="REF_UNKNOWN";
+                } else {
+                    // the file lists are shared by all properties, see ExportEnumTables()
+                    const char* tableId = GetEnumTableId(attr.refTypeName);
+                    if (tableId){
+                        NodeAddPropEnumRef(node,attr.name,tableId,true,"0");
+                        alreadyAdded = true;
+                    }
+                }
+            break;
+            default:
+                URHO3D_LOGINFOF("[%s] Skipping attribute:%s",type.typeName.CString(),attr.name.CString());
+                continue;
+
+        }
+
+    }
+
+    return node;
 }
 
-JSONObject Urho3DNodeTreeExporter::ExportGlobalData(){
-    JSONObject globalData;
+void Urho3DNodeTreeExporter::ExportGlobalData(JSONStreamWriter& writer)
+{
+    writer.StartObject();
 
     // dropdown to choose techniques available from the resource-path
-    JSONArray techniques;
+    writer.Key("techniques");
+    writer.StartArray();
     for (String techniqueName : techniqueFiles){
         StringHash hash(techniqueName);
         String id(hash.Value() % 10000000);
@@ -752,36 +960,316 @@ JSONObject Urho3DNodeTreeExporter::ExportGlobalData(){
         }
 
 
-        NodeAddEnumElement(techniques,techniqueName,techniqueName,"Technique "+techniqueName,"COLOR",id,category);
+        WriteEnumElement(writer,techniqueName,techniqueName,"Technique "+techniqueName,"COLOR",id,category);
     }
-    globalData["techniques"] = techniques;
+    writer.EndArray();
 
-    JSONArray textures;
+    writer.Key("textures");
+    writer.StartArray();
     for (ExportPath texture : textureFiles){
         StringHash hash(texture.resFilepath);
         String id(hash.Value() % 10000000);
 
-        NodeAddEnumElement(textures,texture.resFilepath,texture.resFilepath,texture.absFilepath,"COLOR",id);
+        WriteEnumElement(writer,texture.resFilepath,texture.resFilepath,texture.absFilepath,"COLOR",id);
+    }
+    writer.EndArray();
+
+    writer.Key("enumTables");
+    ExportEnumTables(writer);
+
+    // previews for the texture dropdowns, see ThumbnailBuilder
+    if (!m_thumbnailAtlas.Empty()){
+        writer.Key("thumbnails");
+        writer.StartObject();
+        writer.Member("atlas",m_thumbnailAtlas);
+        writer.Member("index",m_thumbnailIndex);
+        writer.EndObject();
     }
-    globalData["textures"] = textures;
 
-    return globalData;
+    writer.EndObject();
 }
 
-void Urho3DNodeTreeExporter::Export(String filename)
+void Urho3DNodeTreeExporter::ExportEnumTables(JSONStreamWriter& writer)
 {
+    writer.StartObject();
+
+    writer.Key("models");
+    writer.StartArray();
+    WriteEnumElement(writer,"None","None","No Mesh","MESH");
+    WriteEnumElement(writer,"__Node-Mesh","Node-Mesh","The node's current mesh","MESH","1");
+    for (String model : modelFiles){
+        StringHash hash(model);
+        String id(hash.Value() % 10000000);
+
+        WriteEnumElement(writer,"Model;"+model,model,"Model "+model,"MESH",id);
+    }
+    writer.EndArray();
+
+    writer.Key("animations");
+    writer.StartArray();
+    WriteEnumElement(writer,"none","None","No Animation","ANIM");
+    for (String anim : animationFiles){
+        StringHash hash(anim);
+        String id(hash.Value() % 10000000);
+
+        WriteEnumElement(writer,"Animation;"+anim,anim,"Animation "+anim,"ANIM",id);
+    }
+    writer.EndArray();
+
+    writer.Key("textures");
+    writer.StartArray();
+    WriteEnumElement(writer,"none","None","No Texture","TEXTURE");
+    for (ExportPath tex : textureFiles){
+        StringHash hash(tex.resFilepath);
+        String id(hash.Value() % 10000000);
+
+        WriteEnumElement(writer,"Texture;"+tex.resFilepath,tex.resFilepath,tex.absFilepath,"TEXTURE",id);
+    }
+    writer.EndArray();
+
+    writer.Key("materials");
+    writer.StartArray();
+    WriteEnumElement(writer,"none","None","No Material","MATERIAL");
+    for (String mat : materialFiles){
+        StringHash hash(mat);
+        String id(hash.Value() % 10000000);
+
+        WriteEnumElement(writer,"Material;"+mat,mat,"Material "+mat,"MATERIAL",id);
+    }
+    writer.EndArray();
+
+    writer.EndObject();
+}
+
+bool Urho3DNodeTreeExporter::Export(const String& filename)
+{
+    TakeSnapshot();
+    bool unchanged;
+    return ExportSnapshot(filename,unchanged);
+}
+
+void Urho3DNodeTreeExporter::ExportAsync(const String& filename)
+{
+    if (m_asyncItem){
+        m_hasPending = true;
+        m_pendingFilename = filename;
+        return;
+    }
+
+    // the worker gets its own exporter with a copy of the settings and the snapshot
+    SharedPtr<Urho3DNodeTreeExporter> exporter(new Urho3DNodeTreeExporter(context_,m_exportMode));
+    exporter->m_listOfComponents = m_listOfComponents;
+    exporter->m_listOfSuperClasses = m_listOfSuperClasses;
+    exporter->m_materialFolders = m_materialFolders;
+    exporter->m_techniqueFolders = m_techniqueFolders;
+    exporter->m_textureFolders = m_textureFolders;
+    exporter->m_modelFolders = m_modelFolders;
+    exporter->m_animationFolders = m_animationFolders;
+    exporter->m_customUIFilenames = m_customUIFilenames;
+    exporter->m_thumbnailAtlas = m_thumbnailAtlas;
+    exporter->m_thumbnailIndex = m_thumbnailIndex;
+    exporter->TakeSnapshot();
+    // lent to the worker until it is done
+    exporter->m_cache.Swap(m_cache);
+    exporter->m_cacheLoaded = m_cacheLoaded;
+    exporter->m_exportData.Swap(m_exportData);
+    exporter->m_exportDataSize = m_exportDataSize;
+    exporter->m_exportHash = m_exportHash;
+    exporter->m_exportFingerprint = m_exportFingerprint;
+    exporter->m_exportVersion = m_exportVersion;
+    exporter->m_patchData.Swap(m_patchData);
+    exporter->m_patchDataSize = m_patchDataSize;
+    exporter->m_sentExport = m_sentExport;
+
+    m_asyncExporter = exporter;
+    m_asyncFilename = filename;
+    m_asyncUnchanged = false;
+    m_asyncSuccess = false;
+
+    WorkQueue* queue = GetSubsystem<WorkQueue>();
+    m_asyncItem = queue->GetFreeItem();
+    m_asyncItem->workFunction_ = ExportWork;
+    m_asyncItem->aux_ = this;
+    // lowest priority, so the Complete() calls of the loaders don't wait for the export
+    m_asyncItem->priority_ = 0;
+    m_asyncItem->sendEvent_ = true;
+    SubscribeToEvent(queue,E_WORKITEMCOMPLETED,URHO3D_HANDLER(Urho3DNodeTreeExporter,HandleWorkItemCompleted));
+    queue->AddWorkItem(m_asyncItem);
+}
+
+void Urho3DNodeTreeExporter::ExportWork(const WorkItem* item, unsigned threadIndex)
+{
+    Urho3DNodeTreeExporter* exporter = static_cast<Urho3DNodeTreeExporter*>(item->aux_);
+    exporter->m_asyncSuccess = exporter->m_asyncExporter->ExportSnapshot(exporter->m_asyncFilename,exporter->m_asyncUnchanged);
+}
+
+void Urho3DNodeTreeExporter::HandleWorkItemCompleted(StringHash eventType, VariantMap& eventData)
+{
+    if (!m_asyncItem || eventData[WorkItemCompleted::P_ITEM].GetPtr() != m_asyncItem.Get())
+        return;
+
+    String filename = m_asyncFilename;
+    bool unchanged = m_asyncUnchanged;
+    bool success = m_asyncSuccess;
+    m_cache.Swap(m_asyncExporter->m_cache);
+    m_cacheLoaded = m_asyncExporter->m_cacheLoaded;
+    m_exportData.Swap(m_asyncExporter->m_exportData);
+    m_exportDataSize = m_asyncExporter->m_exportDataSize;
+    m_exportHash = m_asyncExporter->m_exportHash;
+    m_exportFingerprint = m_asyncExporter->m_exportFingerprint;
+    m_exportVersion = m_asyncExporter->m_exportVersion;
+    m_patchData.Swap(m_asyncExporter->m_patchData);
+    m_patchDataSize = m_asyncExporter->m_patchDataSize;
+    m_sentExport = m_asyncExporter->m_sentExport;
+    m_asyncItem.Reset();
+    m_asyncExporter.Reset();
+
+    using namespace ComponentExportFinished;
+    VariantMap& data = GetEventDataMap();
+    data[P_SUCCESS] = success;
+    data[P_FILENAME] = filename;
+    data[P_UNCHANGED] = unchanged;
+    SendEvent(E_COMPONENTEXPORTFINISHED,data);
+
+    if (m_hasPending){
+        String pendingFilename = m_pendingFilename;
+        m_hasPending = false;
+        m_pendingFilename.Clear();
+        ExportAsync(pendingFilename);
+    }
+}
+
+bool Urho3DNodeTreeExporter::ExportSnapshot(const String& filename, bool& unchanged)
+{
+    HiresTimer timer;
+    String cacheFileName = LoaderCache::GetDir(context_,"export") + "index.json";
+    if (!m_cacheLoaded){
+        m_cache.Load(context_,cacheFileName);
+        m_cacheLoaded = true;
+    }
 
     ProcessFileSystem();
 
-    auto materialTree = ExportMaterials();
-    auto componentTree = ExportComponents();
-    auto globalData = ExportGlobalData();
-    trees.Clear();
-    trees.Push(componentTree);
-    trees.Push(materialTree);
+    unsigned long long fingerprintHash = CalculateFingerprint();
+    if (filename.Empty())
+        return ExportSnapshotToMemory(fingerprintHash,cacheFileName,unchanged);
+
+    // skip the export if the file still matches what would be written
+    FileSystem* fs = GetSubsystem<FileSystem>();
+    String fingerprint = LoaderCache::HashToString(fingerprintHash);
+    String fingerprintFileName = LoaderCache::GetDir(context_,"export") + LoaderCache::HashToString(LoaderCache::Hash(filename)) + ".txt";
+    if (fs->FileExists(filename) && fs->FileExists(fingerprintFileName)){
+        File fingerprintFile(context_,fingerprintFileName,FILE_READ);
+        if (fingerprintFile.ReadLine() == fingerprint){
+            URHO3D_LOGINFOF("[ComponentExporter] %s is up to date",filename.CString());
+            // rescanned folder listings are still worth keeping
+            m_cache.Save(context_,cacheFileName);
+            unchanged = true;
+            return true;
+        }
+    }
+    unchanged = false;
+
+    File file(context_,filename,FILE_WRITE);
+    if (!file.IsOpen() || !WriteExport(file)){
+        URHO3D_LOGERRORF("[ComponentExporter] could not write %s",filename.CString());
+        return false;
+    }
+    file.Close();
+
+    File fingerprintFile(context_,fingerprintFileName,FILE_WRITE);
+    fingerprintFile.WriteLine(fingerprint);
+    m_cache.Save(context_,cacheFileName);
+
+    URHO3D_LOGINFOF("[ComponentExporter] exported %s in %.2fms",filename.CString(),timer.GetUSec(false) / 1000.0f);
+    return true;
+}
+
+/// Compress src into an lz4 block.
+static bool CompressBuffer(const VectorBuffer& src, PODVector<unsigned char>& dest)
+{
+    dest.Resize(EstimateCompressBound(src.GetSize()));
+    unsigned compressedSize = src.GetSize() ? CompressData(&dest[0],src.GetData(),src.GetSize()) : 0;
+    dest.Resize(compressedSize);
+    return compressedSize != 0;
+}
+
+bool Urho3DNodeTreeExporter::ExportSnapshotToMemory(unsigned long long fingerprint, const String& cacheFileName, bool& unchanged)
+{
+    HiresTimer timer;
+    if (!m_exportData.Empty() && fingerprint == m_exportFingerprint){
+        m_cache.Save(context_,cacheFileName);
+        unchanged = true;
+        return true;
+    }
+
+    VectorBuffer json;
+    if (!WriteExport(json))
+        return false;
+
+    // touched files can still give the same json
+    unsigned long long hash = LoaderCache::Hash(json.GetData(),json.GetSize());
+    m_exportFingerprint = fingerprint;
+    m_cache.Save(context_,cacheFileName);
+    if (!m_exportData.Empty() && hash == m_exportHash){
+        unchanged = true;
+        return true;
+    }
+    unchanged = false;
+
+    // lz4 block, blender needs the uncompressed size to unpack it
+    if (!CompressBuffer(json,m_exportData)){
+        URHO3D_LOGERROR("[ComponentExporter] could not compress the export");
+        return false;
+    }
+    m_exportDataSize = json.GetSize();
+    m_exportHash = hash;
+
+    // the patch against the previous version, for clients that have that one
+    json.Seek(0);
+    SharedPtr<JSONFile> document(new JSONFile(context_));
+    document->BeginLoad(json);
+    m_patchData.Clear();
+    m_patchDataSize = 0;
+    if (m_sentExport){
+        JSONValue patch = ExportDiff::Diff(m_sentExport->GetRoot(),document->GetRoot());
+        VectorBuffer patchJson;
+        {
+            JSONStreamWriter writer(patchJson,String::EMPTY);
+            writer.Value(patch);
+        }
+        if (CompressBuffer(patchJson,m_patchData)){
+            m_patchDataSize = patchJson.GetSize();
+        }
+    }
+    m_sentExport = document;
+    m_exportVersion++;
+
+    URHO3D_LOGINFOF("[ComponentExporter] exported version %u, %u bytes (%u compressed, patch %u) in %.2fms",
+                    m_exportVersion,m_exportDataSize,m_exportData.Size(),m_patchData.Size(),timer.GetUSec(false) / 1000.0f);
+    return true;
+}
+
+bool Urho3DNodeTreeExporter::WriteExport(Serializer& dest)
+{
+    FileSystem* fs = GetSubsystem<FileSystem>();
+    ValidateResourceFiles();
+
+    // only the sections whose inputs changed are generated again, see ExportComponents() for the components.
+    // globalData is only lists of files, streaming it is cheaper than keeping a copy
+    unsigned long long versionHash = LoaderCache::Hash(&EXPORT_VERSION,sizeof(EXPORT_VERSION));
+    unsigned long long texturesHash = HashList(textureFiles,versionHash);
+
+    unsigned long long materialsHash = HashList(materialFiles,HashList(techniqueFiles,texturesHash));
+    const JSONValue* cachedMaterialTree = m_cache.GetSection("materials",materialsHash);
+    if (!cachedMaterialTree){
+        m_cache.SetSection("materials",materialsHash,ExportMaterials());
+        cachedMaterialTree = m_cache.GetSection("materials",materialsHash);
+    }
 
-    if (!m_customUIFilenames.Empty()){
-        FileSystem* fs = GetSubsystem<FileSystem>();
+    unsigned long long customUIHash = HashCustomUIFiles(versionHash);
+    const JSONValue* cachedCustomUIs = m_cache.GetSection("customUI",customUIHash);
+    if (!cachedCustomUIs && !m_customUIFilenames.Empty()){
         JSONArray jsonCustomUIs;
         for (auto m_customUIFilename : m_customUIFilenames)
         {
@@ -795,27 +1283,41 @@ void Urho3DNodeTreeExporter::Export(String filename)
                     String line = file.ReadLine()+"\n";
                     allText += line;
                 }
-                URHO3D_LOGINFO("READ FILE:");
-                URHO3D_LOGINFO(allText.CString());
-
-                auto e = base64_encode(reinterpret_cast<const unsigned char*>(allText.CString()),allText.Length());
-                String enc(e.c_str());
-                String dec(base64_decode(enc.CString()).c_str());
-
 
+                String enc;
+                enc.Resize(base64_encoded_size(allText.Length()));
+                if (!enc.Empty()){
+                    base64_encode(reinterpret_cast<const unsigned char*>(allText.CString()),allText.Length(),&enc[0]);
+                }
                 jsonCustomUIs.Push(enc);
             }
         }
-        fileRoot["customUI"] = jsonCustomUIs;
+        m_cache.SetSection("customUI",customUIHash,jsonCustomUIs);
+        cachedCustomUIs = m_cache.GetSection("customUI",customUIHash);
     }
 
-    fileRoot["trees"]=trees;
-    fileRoot["globalData"]=globalData;
-
-    JSONFile file(context_);
-    file.GetRoot() = fileRoot;
-    file.SaveFile(filename);
+    // the document is streamed to dest as it is generated, the layout (and the bytes) are
+    // the same as of a JSONFile with {customUI, trees: [components, materials], globalData}
+    JSONStreamWriter writer(dest);
+    writer.StartObject();
+    if (cachedCustomUIs){
+        writer.Member("customUI",*cachedCustomUIs);
+    }
+    writer.Key("trees");
+    writer.StartArray();
+    ExportComponents(writer);
+    writer.Value(*cachedMaterialTree);
+    writer.EndArray();
+    writer.Key("globalData");
+    ExportGlobalData(writer);
+    writer.EndObject();
+    return writer.Flush();
+}
 
+void Urho3DNodeTreeExporter::SetThumbnailAtlas(const String& atlasFileName, const String& indexFileName)
+{
+    m_thumbnailAtlas = atlasFileName;
+    m_thumbnailIndex = indexFileName;
 }
 
 void Urho3DNodeTreeExporter::AddCustomUIFile(const String &filename)
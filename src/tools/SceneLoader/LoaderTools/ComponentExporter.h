@@ -1,25 +1,62 @@
 #pragma once
 
 #include <Urho3D/Core/Object.h>
+#include <Urho3D/Core/Variant.h>
 #include <Urho3D/Math/StringHash.h>
 #include <Urho3D/Container/Str.h>
 #include <Urho3D/Container/HashSet.h>
+#include <Urho3D/Resource/JSONFile.h>
 #include <Urho3D/Resource/JSONValue.h>
 
+#include "ExportCache.h"
+
 //#define BTH_DEBUG
 
 namespace Urho3D {
     class Context;
-
+    class Serializer;
+    class WorkItem;
 }
 
 using namespace Urho3D;
 
+class JSONStreamWriter;
+
+/// Sent on the main thread when an ExportAsync() finished, also if it failed.
+URHO3D_EVENT(E_COMPONENTEXPORTFINISHED, ComponentExportFinished)
+{
+    URHO3D_PARAM(P_SUCCESS, Success); // bool, false if the export could not be written
+    URHO3D_PARAM(P_FILENAME, Filename); // String, empty for an export to memory
+    URHO3D_PARAM(P_UNCHANGED, Unchanged); // bool, the existing export was still valid and not written again
+}
+
 struct ExportPath{
     String resFilepath;
     String absFilepath;
 };
 
+/// Reflection data of an exported attribute, copied on the main thread.
+struct ExportedAttribute{
+    String name;
+    VariantType type;
+    String defaultValue;
+    /// type name of a resource-ref attribute's default value
+    String refTypeName;
+    Vector<String> enumNames;
+    /// editor hint and range, only attribute tables have them (see AttributeTable.h)
+    unsigned subType = 0;
+    float min = 0.0f;
+    float max = 0.0f;
+};
+
+/// Reflection data of an exported object type, copied on the main thread.
+struct ExportedType{
+    String typeName;
+    /// empty for non-components
+    String category;
+    Vector<ExportedAttribute> attributes;
+};
+
 
 class Urho3DNodeTreeExporter : public Object {
     URHO3D_OBJECT(Urho3DNodeTreeExporter, Object);
@@ -27,6 +64,7 @@ public:
     enum ExportMode { WhiteList, BlackList };
 
     Urho3DNodeTreeExporter(Context* context,ExportMode mode=BlackList);
+    ~Urho3DNodeTreeExporter() override;
 
     void AddComponentHashToFilterList(const StringHash& componentHash);
     // add/discard components that have this component as superclass
@@ -37,18 +75,48 @@ public:
     void AddTextureFolder(const String& folder);
     void AddAnimationFolder(const String& folder);
     void AddModelFolder(const String& folder);
-
-    void Export(String filename);
-
-    JSONObject ExportComponents();
+    const Vector<String>& GetMaterialFolders() const { return m_materialFolders; }
+    const Vector<String>& GetModelFolders() const { return m_modelFolders; }
+    const Vector<String>& GetTextureFolders() const { return m_textureFolders; }
+
+    /// Export on the calling thread, return false if filename could not be written.
+    bool Export(const String& filename);
+    /// Export on a worker thread and send E_COMPONENTEXPORTFINISHED when done. The export is skipped
+    /// if the reflection data and the resource folders did not change since filename was written.
+    /// A request while an export is running is started after it, only the last one is kept.
+    /// An empty filename exports to memory, see GetExportData().
+    void ExportAsync(const String& filename);
+    bool IsExporting() const { return m_asyncItem.NotNull(); }
+
+    /// The last export to memory as lz4 block, empty if there was none.
+    const PODVector<unsigned char>& GetExportData() const { return m_exportData; }
+    /// Size of the json before compression.
+    unsigned GetExportDataSize() const { return m_exportDataSize; }
+    /// Hash of the json, the same export always has the same hash.
+    unsigned long long GetExportHash() const { return m_exportHash; }
+    /// Counts the exports to memory whose json changed, starting with 1.
+    unsigned GetExportVersion() const { return m_exportVersion; }
+    /// ExportDiff patch from the previous version to the current one as lz4 block, empty for the first version.
+    const PODVector<unsigned char>& GetPatchData() const { return m_patchData; }
+    unsigned GetPatchDataSize() const { return m_patchDataSize; }
+
+    /// Copy the reflection data and resource dirs the export works on. Needs the main thread.
+    void TakeSnapshot();
+
+    void ExportComponents(JSONStreamWriter& writer);
+    JSONObject ExportComponentNode(const ExportedType& type);
     JSONObject ExportMaterials();
-    JSONObject ExportGlobalData();
+    void ExportGlobalData(JSONStreamWriter& writer);
+    /// The resource lists (models, animations, textures, materials) that enum props reference by id.
+    void ExportEnumTables(JSONStreamWriter& writer);
 
     inline void SetExportMode(ExportMode mode){ m_exportMode = mode; }
     inline bool InBlacklistMode() { return m_exportMode == BlackList; }
     inline bool InWhiteListMode() { return m_exportMode == WhiteList; }
 
     void AddCustomUIFile(const String& filename);
+    /// Reference the texture preview atlas and its index from globalData["thumbnails"].
+    void SetThumbnailAtlas(const String& atlasFileName, const String& indexFileName);
 
 
     // don't change the NT_ positions at least not Vectors and colors
@@ -59,6 +127,8 @@ public:
     void NodeSetData(JSONObject& node,const String& id,const String& name,const String category="misc");
     void NodeAddProp(JSONObject& node, const String& name, NodeType type, const String& defaultValue, NodeSubType subType=ST_NONE, int precission=3, float min=0.0f, float max=0.0f);
     void NodeAddPropEnum(JSONObject& node,const String& name,JSONArray& elements, bool categorized=false,const String& defaultValue="0",bool isPreview=false);
+    /// Enum prop whose elements are the table tableId of globalData["enumTables"].
+    void NodeAddPropEnumRef(JSONObject& node,const String& name,const String& tableId, bool categorized=false,const String& defaultValue="0");
     void NodeAddEnumElement(JSONArray& elementsArray, const String& id,const String& name="",const String& descr="",const String& icon="COLOR",const String& number="0",const String& category="");
     void NodeAddInputSocket(JSONObject& node,const String& name, NodeSocketType type);
     void NodeAddOutputSocket(JSONObject& node,const String& name, NodeSocketType type);
@@ -66,13 +136,26 @@ private:
     void NodeAddSocket(JSONObject& node,const String& name, NodeSocketType type, bool isInputSocket);
 
     void ProcessFileSystem();
+    /// Drop material and technique files whose xml root does not match.
+    void ValidateResourceFiles();
+    bool CheckXMLResource(const String& resourceName, const String& rootName);
+    unsigned long long HashCustomUIFiles(unsigned long long hash);
+    /// Hash of everything the export depends on. Call after ProcessFileSystem.
+    unsigned long long CalculateFingerprint();
+    /// Export from the snapshot. unchanged is set if the existing file is still valid.
+    bool ExportSnapshot(const String& filename, bool& unchanged);
+    /// Export into m_exportData. unchanged is set if it still matches the fingerprint.
+    bool ExportSnapshotToMemory(unsigned long long fingerprint, const String& cacheFileName, bool& unchanged);
+    /// Stream the whole export json to dest.
+    bool WriteExport(Serializer& dest);
+
+    static void ExportWork(const WorkItem* item, unsigned threadIndex);
+    void HandleWorkItemCompleted(StringHash eventType, VariantMap& eventData);
 
     bool CheckSuperTypes(const TypeInfo* type);
     String GetTypeCategory(const StringHash& hash,const String& defaultValue);
 
 
-    JSONObject fileRoot;
-    JSONArray trees;
 
     ExportMode m_exportMode;
     HashSet<StringHash> m_listOfComponents;
@@ -83,10 +166,41 @@ private:
     Vector<String> m_modelFolders;
     Vector<String> m_animationFolders;
     Vector<String> m_customUIFilenames;
+    String m_thumbnailAtlas;
+    String m_thumbnailIndex;
 
     Vector<String> materialFiles;
     Vector<String> techniqueFiles;
     Vector<ExportPath> textureFiles;
     Vector<String> modelFiles;
     Vector<String> animationFiles;
+
+    // snapshot
+    Vector<String> m_resourceDirs;
+    Vector<ExportedType> m_types;
+
+    // folder listings and generated sections of the previous exports, loaded on first use
+    ExportCache m_cache;
+    bool m_cacheLoaded;
+
+    // last export to memory
+    PODVector<unsigned char> m_exportData;
+    unsigned m_exportDataSize;
+    unsigned long long m_exportHash;
+    unsigned long long m_exportFingerprint;
+    unsigned m_exportVersion;
+    PODVector<unsigned char> m_patchData;
+    unsigned m_patchDataSize;
+    /// the current version, the base of the next patch. only shared with the worker, never changed
+    SharedPtr<JSONFile> m_sentExport;
+
+    // the running async export. the worker has its own exporter, so this one stays usable
+    SharedPtr<Urho3DNodeTreeExporter> m_asyncExporter;
+    SharedPtr<WorkItem> m_asyncItem;
+    String m_asyncFilename;
+    bool m_asyncUnchanged;
+    bool m_asyncSuccess;
+    // a request that came in while the export ran. the filename is empty for memory exports
+    bool m_hasPending;
+    String m_pendingFilename;
 };
@@ -0,0 +1,171 @@
+#include "DirectoryScanner.h"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include <Urho3D/Container/Sort.h>
+#include <Urho3D/IO/FileSystem.h>
+#include <Urho3D/Math/MathDefs.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+
+struct Entry{
+    String name_;
+    bool isDir_ = false;
+    unsigned modified_ = 0;
+};
+
+#ifdef _WIN32
+
+/// FILETIME to seconds since 1970, the way _stat reports it
+unsigned ToUnixTime(const FILETIME& time)
+{
+    unsigned long long ticks = ((unsigned long long)time.dwHighDateTime << 32) | time.dwLowDateTime;
+    return (unsigned)((ticks - 116444736000000000ULL) / 10000000ULL);
+}
+
+/// The find data already has the times of the subdirs, no extra call needed.
+bool ReadDir(const String& path, Vector<Entry>& entries)
+{
+    WIN32_FIND_DATAW data;
+    HANDLE find = FindFirstFileExW(WString(GetNativePath(path + "*")).CString(),FindExInfoBasic,&data,FindExSearchNameMatch,nullptr,FIND_FIRST_EX_LARGE_FETCH);
+    if (find == INVALID_HANDLE_VALUE)
+        return false;
+
+    do {
+        String name(data.cFileName);
+        if (name.StartsWith("."))
+            continue;
+        Entry entry;
+        entry.name_ = name;
+        entry.isDir_ = (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0;
+        // junctions and links to dirs are not followed, they could lead back up the tree
+        if (entry.isDir_ && (data.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT))
+            continue;
+        if (entry.isDir_)
+            entry.modified_ = ToUnixTime(data.ftLastWriteTime);
+        entries.Push(entry);
+    } while (FindNextFileW(find,&data));
+    FindClose(find);
+    return true;
+}
+
+#else
+
+/// d_type tells files from dirs for free on most file systems, only dirs (and links) get a stat.
+/// Links to files are listed like the file, links to dirs are not followed, they could lead
+/// back up the tree.
+bool ReadDir(const String& path, Vector<Entry>& entries)
+{
+    DIR* dir = opendir(path.CString());
+    if (!dir)
+        return false;
+
+    int fd = dirfd(dir);
+    while (dirent* de = readdir(dir)){
+        if (de->d_name[0] == '.')
+            continue;
+
+        Entry entry;
+        entry.name_ = de->d_name;
+        bool needStat = de->d_type == DT_DIR || de->d_type == DT_LNK || de->d_type == DT_UNKNOWN;
+        if (needStat){
+            struct stat st;
+            if (fstatat(fd,de->d_name,&st,AT_SYMLINK_NOFOLLOW) != 0)
+                continue;
+            if (S_ISLNK(st.st_mode) && (fstatat(fd,de->d_name,&st,0) != 0 || S_ISDIR(st.st_mode)))
+                continue;
+            entry.isDir_ = S_ISDIR(st.st_mode);
+            if (entry.isDir_)
+                entry.modified_ = (unsigned)st.st_mtime;
+        }
+        entries.Push(entry);
+    }
+    closedir(dir);
+    return true;
+}
+
+#endif
+
+/// Depth-first walk of root + relDir, relDir is empty or ends with a slash.
+void Walk(const String& root, const String& relDir, DirectoryListing& listing)
+{
+    Vector<Entry> entries;
+    if (!ReadDir(root + relDir,entries))
+        return;
+
+    for (const Entry& entry : entries){
+        String relPath = relDir + entry.name_;
+        if (entry.isDir_){
+            listing.dirs_[relPath] = entry.modified_;
+            Walk(root,relPath + "/",listing);
+        } else {
+            listing.files_.Push(relPath);
+        }
+    }
+}
+
+}
+
+bool DirectoryScanner::Scan(const String& root, DirectoryListing& listing, unsigned maxThreads)
+{
+    listing.files_.Clear();
+    listing.dirs_.Clear();
+
+    String rootPath = AddTrailingSlash(root);
+    Vector<Entry> entries;
+    if (!ReadDir(rootPath,entries))
+        return false;
+
+    Vector<String> subDirs;
+    for (const Entry& entry : entries){
+        if (entry.isDir_){
+            listing.dirs_[entry.name_] = entry.modified_;
+            subDirs.Push(entry.name_ + "/");
+        } else {
+            listing.files_.Push(entry.name_);
+        }
+    }
+
+    // every thread takes the next top-level subtree until none is left. resource dirs are
+    // usually split into a handful of big folders (Models, Textures, ...), so that balances well enough
+    unsigned numThreads = maxThreads ? maxThreads : std::thread::hardware_concurrency();
+    numThreads = Clamp(numThreads,1U,subDirs.Size() ? subDirs.Size() : 1U);
+
+    Vector<DirectoryListing> partial(subDirs.Size());
+    std::atomic<unsigned> next(0);
+    auto worker = [&](){
+        for (unsigned i = next++; i < subDirs.Size(); i = next++){
+            Walk(rootPath,subDirs[i],partial[i]);
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (unsigned i = 1; i < numThreads; ++i){
+        threads.emplace_back(worker);
+    }
+    worker();
+    for (std::thread& thread : threads){
+        thread.join();
+    }
+
+    for (DirectoryListing& subListing : partial){
+        listing.files_.Push(subListing.files_);
+        for (auto it = subListing.dirs_.Begin(); it != subListing.dirs_.End(); ++it){
+            listing.dirs_[it->first_] = it->second_;
+        }
+    }
+    Sort(listing.files_.Begin(),listing.files_.End());
+    return true;
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <Urho3D/Container/HashMap.h>
+#include <Urho3D/Container/Str.h>
+#include <Urho3D/Container/Vector.h>
+
+using namespace Urho3D;
+
+/// Everything below a folder, as found by a single walk.
+struct DirectoryListing{
+    /// files relative to the root, '/'-separated and sorted
+    Vector<String> files_;
+    /// subdirs relative to the root -> modification time (same unit as FileSystem::GetLastModifiedTime)
+    HashMap<String, unsigned> dirs_;
+};
+
+/// Recursive directory walk straight on top of the os (readdir / FindFirstFile). Unlike
+/// FileSystem::ScanDir it returns files and dirs in one go, never stats plain files and walks
+/// the subtrees of the root on several threads. Hidden files and folders are skipped, links
+/// to folders are not followed.
+/// Plain std::threads are used as it is called from WorkQueue items, which can't wait on
+/// other work items.
+class DirectoryScanner {
+public:
+    /// Walk root. maxThreads 0 uses one thread per core. Returns false if root can't be read.
+    static bool Scan(const String& root, DirectoryListing& listing, unsigned maxThreads = 0);
+};
@@ -0,0 +1,189 @@
+#include "ExportCache.h"
+#include "DirectoryScanner.h"
+#include "LoaderCache.h"
+
+#include <cstdlib>
+#include <ctime>
+
+#include <Urho3D/Core/Context.h>
+#include <Urho3D/IO/File.h>
+#include <Urho3D/IO/FileSystem.h>
+#include <Urho3D/IO/Log.h>
+#include <Urho3D/Resource/JSONFile.h>
+
+// bump this whenever the layout of the cache file changes
+static const int EXPORT_CACHE_VERSION = 2;
+
+ExportCache::ExportCache()
+    : dirty_(false)
+{
+}
+
+const Vector<String>& ExportCache::ListFiles(FileSystem* fs, const String& dir)
+{
+    String path = AddTrailingSlash(dir);
+    Folder& folder = folders_[path];
+
+    // a folder that does not exist (yet) has time 0. The times are in seconds, a folder modified
+    // in the second of the scan may have changed after it without a new time, so it is rescanned.
+    bool upToDate = folder.scanned_ && folder.modified_ < folder.scanTime_ && fs->GetLastModifiedTime(path) == folder.modified_;
+    for (auto it = folder.subDirs_.Begin(); upToDate && it != folder.subDirs_.End(); ++it){
+        upToDate = it->second_ < folder.scanTime_ && fs->GetLastModifiedTime(path + it->first_) == it->second_;
+    }
+    if (upToDate)
+        return folder.files_;
+
+    folder.scanned_ = true;
+    folder.scanTime_ = (unsigned)time(nullptr);
+    folder.modified_ = fs->GetLastModifiedTime(path);
+    folder.subDirs_.Clear();
+    folder.files_.Clear();
+    if (folder.modified_){
+        DirectoryListing listing;
+        DirectoryScanner::Scan(path,listing);
+        folder.subDirs_ = listing.dirs_;
+        folder.files_.Swap(listing.files_);
+    }
+    dirty_ = true;
+    return folder.files_;
+}
+
+int ExportCache::GetFileCheck(const String& fileName, unsigned modified) const
+{
+    auto it = fileChecks_.Find(fileName);
+    if (it == fileChecks_.End() || it->second_.modified_ != modified)
+        return -1;
+    return it->second_.valid_ ? 1 : 0;
+}
+
+void ExportCache::SetFileCheck(const String& fileName, unsigned modified, bool valid)
+{
+    FileCheck& check = fileChecks_[fileName];
+    check.modified_ = modified;
+    check.valid_ = valid;
+    dirty_ = true;
+}
+
+const JSONValue* ExportCache::GetSection(const String& key, unsigned long long hash) const
+{
+    auto it = sections_.Find(key);
+    return it != sections_.End() && it->second_.hash_ == hash ? &it->second_.value_ : nullptr;
+}
+
+void ExportCache::SetSection(const String& key, unsigned long long hash, const JSONValue& value)
+{
+    Section& section = sections_[key];
+    section.hash_ = hash;
+    section.value_ = value;
+    dirty_ = true;
+}
+
+bool ExportCache::Load(Context* context, const String& fileName)
+{
+    if (!context->GetSubsystem<FileSystem>()->FileExists(fileName))
+        return false;
+
+    JSONFile json(context);
+    if (!json.LoadFile(fileName) || json.GetRoot().Get("version").GetInt() != EXPORT_CACHE_VERSION){
+        URHO3D_LOGWARNINGF("[ExportCache] ignoring outdated or broken cache %s",fileName.CString());
+        return false;
+    }
+    const JSONValue& root = json.GetRoot();
+
+    folders_.Clear();
+    const JSONObject& folders = root.Get("folders").GetObject();
+    for (auto it = folders.Begin(); it != folders.End(); ++it){
+        Folder& folder = folders_[it->first_];
+        folder.scanned_ = true;
+        folder.scanTime_ = it->second_.Get("scanned").GetUInt();
+        folder.modified_ = it->second_.Get("modified").GetUInt();
+        const JSONObject& subDirs = it->second_.Get("subDirs").GetObject();
+        for (auto dir = subDirs.Begin(); dir != subDirs.End(); ++dir){
+            folder.subDirs_[dir->first_] = dir->second_.GetUInt();
+        }
+        for (const JSONValue& file : it->second_.Get("files").GetArray()){
+            folder.files_.Push(file.GetString());
+        }
+    }
+
+    fileChecks_.Clear();
+    const JSONObject& fileChecks = root.Get("fileChecks").GetObject();
+    for (auto it = fileChecks.Begin(); it != fileChecks.End(); ++it){
+        SetFileCheck(it->first_,it->second_.Get("modified").GetUInt(),it->second_.Get("valid").GetBool());
+    }
+
+    sections_.Clear();
+    const JSONObject& sections = root.Get("sections").GetObject();
+    for (auto it = sections.Begin(); it != sections.End(); ++it){
+        unsigned long long hash = std::strtoull(it->second_.Get("hash").GetString().CString(),nullptr,16);
+        SetSection(it->first_,hash,it->second_.Get("value"));
+    }
+
+    dirty_ = false;
+    return true;
+}
+
+bool ExportCache::Save(Context* context, const String& fileName)
+{
+    if (!dirty_)
+        return true;
+
+    JSONValue folders;
+    for (auto it = folders_.Begin(); it != folders_.End(); ++it){
+        JSONValue subDirs;
+        for (auto dir = it->second_.subDirs_.Begin(); dir != it->second_.subDirs_.End(); ++dir){
+            subDirs[dir->first_] = dir->second_;
+        }
+        JSONArray files;
+        for (const String& file : it->second_.files_){
+            files.Push(file);
+        }
+        JSONValue folder;
+        folder["scanned"] = it->second_.scanTime_;
+        folder["modified"] = it->second_.modified_;
+        folder["subDirs"] = subDirs;
+        folder["files"] = files;
+        folders[it->first_] = folder;
+    }
+
+    JSONValue fileChecks;
+    for (auto it = fileChecks_.Begin(); it != fileChecks_.End(); ++it){
+        JSONValue check;
+        check["modified"] = it->second_.modified_;
+        check["valid"] = it->second_.valid_;
+        fileChecks[it->first_] = check;
+    }
+
+    JSONValue sections;
+    for (auto it = sections_.Begin(); it != sections_.End(); ++it){
+        JSONValue section;
+        section["hash"] = LoaderCache::HashToString(it->second_.hash_);
+        section["value"] = it->second_.value_;
+        sections[it->first_] = section;
+    }
+
+    JSONFile json(context);
+    JSONValue& root = json.GetRoot();
+    root["version"] = EXPORT_CACHE_VERSION;
+    root["folders"] = folders;
+    root["fileChecks"] = fileChecks;
+    root["sections"] = sections;
+    // no indentation, nobody reads this but the exporter
+    File file(context,fileName,FILE_WRITE);
+    if (!file.IsOpen() || !json.Save(file,String::EMPTY)){
+        URHO3D_LOGWARNINGF("[ExportCache] could not write %s",fileName.CString());
+        return false;
+    }
+    dirty_ = false;
+    return true;
+}
+
+void ExportCache::Swap(ExportCache& other)
+{
+    folders_.Swap(other.folders_);
+    fileChecks_.Swap(other.fileChecks_);
+    sections_.Swap(other.sections_);
+    bool dirty = dirty_;
+    dirty_ = other.dirty_;
+    other.dirty_ = dirty;
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <Urho3D/Container/HashMap.h>
+#include <Urho3D/Container/Str.h>
+#include <Urho3D/Container/Vector.h>
+#include <Urho3D/Resource/JSONValue.h>
+
+namespace Urho3D {
+    class Context;
+    class FileSystem;
+}
+
+using namespace Urho3D;
+
+/// What the component exporter keeps between exports (and runs, see Load/Save): the file
+/// listings of the resource folders, the results of the material/technique checks and the
+/// generated json sections, each with the hash of the inputs it was generated from.
+class ExportCache {
+public:
+    ExportCache();
+
+    /// List all files below dir (relative to it, sorted). Only rescans if dir or one of its subdirs was modified since,
+    /// or in the same second as the last scan.
+    const Vector<String>& ListFiles(FileSystem* fs, const String& dir);
+
+    /// Return the cached result of a file check, or -1 if the file was modified since.
+    int GetFileCheck(const String& fileName, unsigned modified) const;
+    void SetFileCheck(const String& fileName, unsigned modified, bool valid);
+
+    /// Return the cached section generated from inputs with that hash, or null.
+    const JSONValue* GetSection(const String& key, unsigned long long hash) const;
+    void SetSection(const String& key, unsigned long long hash, const JSONValue& value);
+
+    bool Load(Context* context, const String& fileName);
+    /// Write the cache if anything changed since it was loaded or saved.
+    bool Save(Context* context, const String& fileName);
+
+    void Swap(ExportCache& other);
+
+private:
+    struct Folder{
+        bool scanned_ = false;
+        /// when the listing was taken, in seconds like the modification times
+        unsigned scanTime_ = 0;
+        unsigned modified_ = 0;
+        /// modification times of all subdirs, a new file in any of them changes its time
+        HashMap<String, unsigned> subDirs_;
+        Vector<String> files_;
+    };
+
+    struct FileCheck{
+        unsigned modified_ = 0;
+        bool valid_ = false;
+    };
+
+    struct Section{
+        unsigned long long hash_ = 0;
+        JSONValue value_;
+    };
+
+    HashMap<String, Folder> folders_;
+    HashMap<String, FileCheck> fileChecks_;
+    HashMap<String, Section> sections_;
+    bool dirty_;
+};
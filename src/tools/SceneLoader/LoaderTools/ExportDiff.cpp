@@ -0,0 +1,244 @@
+#include "ExportDiff.h"
+
+namespace
+{
+
+/// How the lists of each level are keyed: nodes by id with their props, props by name with
+/// their enum elements, elements by id and compared whole.
+struct ListLevel{
+    const char* idKey;
+    const char* childList;
+};
+
+const ListLevel LIST_LEVELS[] = {
+    {"id","props"},
+    {"name","elements"},
+    {"id",nullptr}
+};
+const unsigned LEVEL_NODES = 0;
+const unsigned LEVEL_ELEMENTS = 2;
+
+/// Deep comparison, arrays and objects of different sizes are rejected before their members are looked at.
+bool IsEqual(const JSONValue& a, const JSONValue& b)
+{
+    if (a.GetValueType() != b.GetValueType())
+        return false;
+
+    switch (a.GetValueType()){
+        case JSON_BOOL:
+            return a.GetBool() == b.GetBool();
+        case JSON_NUMBER:
+            return a.GetDouble() == b.GetDouble();
+        case JSON_STRING:
+            return a.GetString() == b.GetString();
+        case JSON_ARRAY: {
+            const JSONArray& arrayA = a.GetArray();
+            const JSONArray& arrayB = b.GetArray();
+            if (arrayA.Size() != arrayB.Size())
+                return false;
+            for (unsigned i = 0; i < arrayA.Size(); ++i){
+                if (!IsEqual(arrayA[i],arrayB[i]))
+                    return false;
+            }
+            return true;
+        }
+        case JSON_OBJECT: {
+            const JSONObject& objectA = a.GetObject();
+            const JSONObject& objectB = b.GetObject();
+            if (objectA.Size() != objectB.Size())
+                return false;
+            for (auto it = objectA.Begin(); it != objectA.End(); ++it){
+                auto other = objectB.Find(it->first_);
+                if (other == objectB.End() || !IsEqual(it->second_,other->second_))
+                    return false;
+            }
+            return true;
+        }
+        default:
+            return true;
+    }
+}
+
+JSONValue DiffList(const JSONArray& base, const JSONArray& current, unsigned level);
+
+/// Diff of an entry that exists in both lists, only called for levels with a child list.
+JSONValue DiffEntry(const JSONValue& base, const JSONValue& current, unsigned level)
+{
+    const ListLevel& listLevel = LIST_LEVELS[level];
+    JSONValue diff;
+    diff[listLevel.idKey] = current.Get(listLevel.idKey);
+
+    JSONValue fields;
+    const JSONObject& currentObject = current.GetObject();
+    for (auto it = currentObject.Begin(); it != currentObject.End(); ++it){
+        const JSONValue& baseValue = base.Get(it->first_);
+        if (it->first_ == listLevel.childList && baseValue.IsArray() && it->second_.IsArray()){
+            JSONValue childDiff = DiffList(baseValue.GetArray(),it->second_.GetArray(),level + 1);
+            if (!childDiff.IsNull()){
+                diff[it->first_] = childDiff;
+            }
+        }
+        else if (!base.Contains(it->first_) || !IsEqual(baseValue,it->second_)){
+            fields[it->first_] = it->second_;
+        }
+    }
+    if (!fields.IsNull()){
+        diff["fields"] = fields;
+    }
+
+    JSONArray removedFields;
+    const JSONObject& baseObject = base.GetObject();
+    for (auto it = baseObject.Begin(); it != baseObject.End(); ++it){
+        if (!current.Contains(it->first_)){
+            removedFields.Push(it->first_);
+        }
+    }
+    if (!removedFields.Empty()){
+        diff["removedFields"] = removedFields;
+    }
+    return diff;
+}
+
+/// Return null if the lists are the same.
+JSONValue DiffList(const JSONArray& base, const JSONArray& current, unsigned level)
+{
+    const ListLevel& listLevel = LIST_LEVELS[level];
+
+    HashMap<String, unsigned> baseIndices;
+    for (unsigned i = 0; i < base.Size(); ++i){
+        baseIndices[base[i].Get(listLevel.idKey).GetString()] = i;
+    }
+
+    JSONArray added;
+    JSONArray changed;
+    HashMap<String, unsigned> currentIndices;
+    // ids that are in both lists, to see if their order changed
+    Vector<unsigned> keptBaseIndices;
+    for (unsigned i = 0; i < current.Size(); ++i){
+        const String& id = current[i].Get(listLevel.idKey).GetString();
+        currentIndices[id] = i;
+
+        auto baseIt = baseIndices.Find(id);
+        if (baseIt == baseIndices.End()){
+            JSONValue entry;
+            entry["index"] = i;
+            entry["value"] = current[i];
+            added.Push(entry);
+            continue;
+        }
+
+        keptBaseIndices.Push(baseIt->second_);
+        const JSONValue& baseEntry = base[baseIt->second_];
+        if (!IsEqual(baseEntry,current[i])){
+            changed.Push(listLevel.childList ? DiffEntry(baseEntry,current[i],level) : current[i]);
+        }
+    }
+
+    JSONArray removed;
+    for (const JSONValue& baseEntry : base){
+        const String& id = baseEntry.Get(listLevel.idKey).GetString();
+        if (!currentIndices.Contains(id)){
+            removed.Push(id);
+        }
+    }
+
+    bool reordered = false;
+    for (unsigned i = 1; i < keptBaseIndices.Size() && !reordered; ++i){
+        reordered = keptBaseIndices[i] < keptBaseIndices[i-1];
+    }
+
+    if (added.Empty() && changed.Empty() && removed.Empty() && !reordered)
+        return JSONValue();
+
+    JSONValue diff;
+    if (!added.Empty())
+        diff["added"] = added;
+    if (!removed.Empty())
+        diff["removed"] = removed;
+    if (!changed.Empty())
+        diff["changed"] = changed;
+    if (reordered){
+        // the full order, the client sorts by it after applying the rest
+        JSONArray order;
+        for (const JSONValue& entry : current){
+            order.Push(entry.Get(listLevel.idKey));
+        }
+        diff["order"] = order;
+    }
+    return diff;
+}
+
+/// Trees of an export by their id.
+HashMap<String, const JSONValue*> GetTrees(const JSONValue& document)
+{
+    HashMap<String, const JSONValue*> trees;
+    for (const JSONValue& tree : document.Get("trees").GetArray()){
+        trees[tree.Get("id").GetString()] = &tree;
+    }
+    return trees;
+}
+
+}
+
+JSONValue ExportDiff::Diff(const JSONValue& base, const JSONValue& current)
+{
+    JSONValue patch;
+
+    JSONValue trees;
+    HashMap<String, const JSONValue*> baseTrees = GetTrees(base);
+    HashMap<String, const JSONValue*> currentTrees = GetTrees(current);
+    for (auto it = currentTrees.Begin(); it != currentTrees.End(); ++it){
+        auto baseIt = baseTrees.Find(it->first_);
+        const JSONArray& baseNodes = baseIt != baseTrees.End() ? baseIt->second_->Get("nodes").GetArray() : JSONValue::emptyArray;
+        JSONValue treeDiff = DiffList(baseNodes,it->second_->Get("nodes").GetArray(),LEVEL_NODES);
+        if (!treeDiff.IsNull()){
+            trees[it->first_] = treeDiff;
+        }
+    }
+    for (auto it = baseTrees.Begin(); it != baseTrees.End(); ++it){
+        if (!currentTrees.Contains(it->first_)){
+            trees[it->first_] = DiffList(it->second_->Get("nodes").GetArray(),JSONValue::emptyArray,LEVEL_NODES);
+        }
+    }
+    if (!trees.IsNull()){
+        patch["trees"] = trees;
+    }
+
+    const JSONValue& baseGlobal = base.Get("globalData");
+    const JSONValue& currentGlobal = current.Get("globalData");
+    JSONValue globalData;
+    for (const char* list : {"techniques","textures"}){
+        JSONValue listDiff = DiffList(baseGlobal.Get(list).GetArray(),currentGlobal.Get(list).GetArray(),LEVEL_ELEMENTS);
+        if (!listDiff.IsNull()){
+            globalData[list] = listDiff;
+        }
+    }
+    JSONValue enumTables;
+    const JSONValue& baseTables = baseGlobal.Get("enumTables");
+    const JSONObject& currentTables = currentGlobal.Get("enumTables").GetObject();
+    for (auto it = currentTables.Begin(); it != currentTables.End(); ++it){
+        JSONValue tableDiff = DiffList(baseTables.Get(it->first_).GetArray(),it->second_.GetArray(),LEVEL_ELEMENTS);
+        if (!tableDiff.IsNull()){
+            enumTables[it->first_] = tableDiff;
+        }
+    }
+    if (!enumTables.IsNull()){
+        globalData["enumTables"] = enumTables;
+    }
+    if (!IsEqual(baseGlobal.Get("thumbnails"),currentGlobal.Get("thumbnails"))){
+        globalData["thumbnails"] = currentGlobal.Get("thumbnails");
+    }
+    if (!globalData.IsNull()){
+        patch["globalData"] = globalData;
+    }
+
+    if (!IsEqual(base.Get("customUI"),current.Get("customUI"))){
+        patch["customUI"] = current.Contains("customUI") ? current.Get("customUI") : JSONValue(JSONValue::emptyArray);
+    }
+    return patch;
+}
+
+bool ExportDiff::IsEmpty(const JSONValue& patch)
+{
+    return !patch.Contains("trees") && !patch.Contains("globalData") && !patch.Contains("customUI");
+}
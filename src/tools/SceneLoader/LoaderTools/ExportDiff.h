@@ -0,0 +1,23 @@
+#pragma once
+
+#include <Urho3D/Resource/JSONValue.h>
+
+using namespace Urho3D;
+
+/// Structural diff of two component exports, so blender only has to touch what changed.
+///
+/// The patch mirrors the export: "trees" holds one list diff per tree id (of its nodes by "id"),
+/// "globalData" one per list (techniques, textures and every enum table), "customUI" is only
+/// there if it changed and then is the full new value. A list diff is
+///     {"added": [{"index": <position in the new list>, "value": <entry>}],
+///      "removed": [<id>], "changed": [<entry diff>]}
+/// A changed node lists its props by "name" the same way, a changed prop its enum "elements"
+/// by "id", globalData "thumbnails" is sent whole when it changed. An entry diff has the id, "fields" with the other members that changed (full
+/// values) and the list diffs. Changed enum elements are sent whole.
+class ExportDiff {
+public:
+    /// Return the patch that turns base into current, both full exports.
+    static JSONValue Diff(const JSONValue& base, const JSONValue& current);
+    /// Return whether the patch changes anything.
+    static bool IsEmpty(const JSONValue& patch);
+};
@@ -0,0 +1,187 @@
+#include "JSONStreamWriter.h"
+
+#include <Urho3D/IO/Serializer.h>
+
+#include <rapidjson/prettywriter.h>
+
+namespace
+{
+
+/// rapidjson output stream on top of a Serializer
+class SerializerStream {
+public:
+    typedef char Ch;
+
+    explicit SerializerStream(Serializer& dest)
+        : dest_(dest),
+          size_(0),
+          failed_(false)
+    {
+    }
+
+    void Put(char c)
+    {
+        if (size_ == BUFFER_SIZE)
+            Flush();
+        buffer_[size_++] = c;
+    }
+
+    void Flush()
+    {
+        if (size_ && dest_.Write(buffer_,size_) != size_)
+            failed_ = true;
+        size_ = 0;
+    }
+
+    bool HasFailed() const { return failed_; }
+
+private:
+    static const unsigned BUFFER_SIZE = 64 * 1024;
+
+    Serializer& dest_;
+    char buffer_[BUFFER_SIZE];
+    unsigned size_;
+    bool failed_;
+};
+
+}
+
+struct JSONStreamWriter::Impl{
+    explicit Impl(Serializer& dest)
+        : stream_(dest),
+          writer_(stream_)
+    {
+    }
+
+    /// The same mapping JSONFile uses to convert to rapidjson values.
+    void Write(const JSONValue& value)
+    {
+        switch (value.GetValueType()){
+            case JSON_NULL:
+                writer_.Null();
+                break;
+            case JSON_BOOL:
+                writer_.Bool(value.GetBool());
+                break;
+            case JSON_NUMBER:
+                switch (value.GetNumberType()){
+                    case JSONNT_INT:
+                        writer_.Int(value.GetInt());
+                        break;
+                    case JSONNT_UINT:
+                        writer_.Uint(value.GetUInt());
+                        break;
+                    default:
+                        writer_.Double(value.GetDouble());
+                        break;
+                }
+                break;
+            case JSON_STRING:
+                writer_.String(value.GetCString());
+                break;
+            case JSON_ARRAY:
+                writer_.StartArray();
+                for (const JSONValue& element : value.GetArray()){
+                    Write(element);
+                }
+                writer_.EndArray();
+                break;
+            case JSON_OBJECT: {
+                writer_.StartObject();
+                const JSONObject& object = value.GetObject();
+                for (auto it = object.Begin(); it != object.End(); ++it){
+                    writer_.Key(it->first_.CString());
+                    Write(it->second_);
+                }
+                writer_.EndObject();
+                break;
+            }
+        }
+    }
+
+    SerializerStream stream_;
+    rapidjson::PrettyWriter<SerializerStream> writer_;
+};
+
+JSONStreamWriter::JSONStreamWriter(Serializer& dest, const String& indentation)
+    : impl_(new Impl(dest))
+{
+    // same as JSONFile::Save()
+    impl_->writer_.SetIndent(!indentation.Empty() ? indentation.Front() : '\0', indentation.Length());
+}
+
+JSONStreamWriter::~JSONStreamWriter()
+{
+    Flush();
+}
+
+void JSONStreamWriter::StartObject()
+{
+    impl_->writer_.StartObject();
+}
+
+void JSONStreamWriter::EndObject()
+{
+    impl_->writer_.EndObject();
+}
+
+void JSONStreamWriter::StartArray()
+{
+    impl_->writer_.StartArray();
+}
+
+void JSONStreamWriter::EndArray()
+{
+    impl_->writer_.EndArray();
+}
+
+void JSONStreamWriter::Key(const String& key)
+{
+    impl_->writer_.Key(key.CString());
+}
+
+void JSONStreamWriter::Value(const String& value)
+{
+    impl_->writer_.String(value.CString());
+}
+
+void JSONStreamWriter::Value(const char* value)
+{
+    impl_->writer_.String(value);
+}
+
+void JSONStreamWriter::Value(bool value)
+{
+    impl_->writer_.Bool(value);
+}
+
+void JSONStreamWriter::Value(int value)
+{
+    impl_->writer_.Int(value);
+}
+
+void JSONStreamWriter::Value(unsigned value)
+{
+    impl_->writer_.Uint(value);
+}
+
+void JSONStreamWriter::Value(double value)
+{
+    impl_->writer_.Double(value);
+}
+
+void JSONStreamWriter::Value(const JSONValue& value)
+{
+    impl_->Write(value);
+}
+
+bool JSONStreamWriter::Flush()
+{
+    impl_->stream_.Flush();
+    return !impl_->stream_.HasFailed();
+}
+
+bool JSONStreamWriter::IsComplete() const
+{
+    return impl_->writer_.IsComplete();
+}
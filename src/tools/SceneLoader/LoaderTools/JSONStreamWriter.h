@@ -0,0 +1,54 @@
+#pragma once
+
+#include <memory>
+
+#include <Urho3D/Container/Str.h>
+#include <Urho3D/Resource/JSONValue.h>
+
+namespace Urho3D {
+    class Serializer;
+}
+
+using namespace Urho3D;
+
+/// Writes json straight to a Serializer (File, VectorBuffer, ...) while it is produced, without
+/// building a JSONValue tree first. Uses the same rapidjson pretty writer as JSONFile, so the
+/// output is byte for byte what JSONFile::Save() writes for the equivalent tree with the same
+/// indentation. The output is buffered and written in chunks.
+class JSONStreamWriter {
+public:
+    explicit JSONStreamWriter(Serializer& dest, const String& indentation = "\t");
+    /// Flushes what is left.
+    ~JSONStreamWriter();
+
+    void StartObject();
+    void EndObject();
+    void StartArray();
+    void EndArray();
+    void Key(const String& key);
+
+    void Value(const String& value);
+    void Value(const char* value);
+    void Value(bool value);
+    void Value(int value);
+    void Value(unsigned value);
+    void Value(double value);
+    /// Write a whole subtree, numbers keep their int/uint/double type like in JSONFile.
+    void Value(const JSONValue& value);
+
+    /// Shorthand for Key() followed by Value().
+    template <class T> void Member(const String& key, const T& value)
+    {
+        Key(key);
+        Value(value);
+    }
+
+    /// Write the buffered output. Returns false if the Serializer failed at any point.
+    bool Flush();
+    /// Return whether the root value is closed.
+    bool IsComplete() const;
+
+private:
+    struct Impl;
+    std::unique_ptr<Impl> impl_;
+};
@@ -0,0 +1,75 @@
+#include "LoaderCache.h"
+
+#include <cstdio>
+
+#include <Urho3D/Core/Context.h>
+#include <Urho3D/IO/File.h>
+#include <Urho3D/IO/FileSystem.h>
+#include <Urho3D/IO/Log.h>
+
+String LoaderCache::rootDir_;
+
+void LoaderCache::SetRootDir(const String& dir)
+{
+    rootDir_ = dir.Empty() ? String::EMPTY : AddTrailingSlash(dir) + ".urho3d_cache/";
+}
+
+String LoaderCache::GetDir(Context* context, const String& subDir)
+{
+    FileSystem* fs = context->GetSubsystem<FileSystem>();
+
+    String root = rootDir_;
+    if (root.Empty()){
+        root = fs->GetAppPreferencesDir("urho3d", "cache");
+    }
+
+    // CreateDir is not recursive, so make sure the root exists first
+    if (!fs->DirExists(root)){
+        fs->CreateDir(root);
+    }
+
+    String dir = AddTrailingSlash(root + subDir);
+    if (!fs->DirExists(dir) && !fs->CreateDir(dir)){
+        URHO3D_LOGERRORF("[LoaderCache] could not create cache dir:%s",dir.CString());
+    }
+    return dir;
+}
+
+unsigned long long LoaderCache::Hash(const void* data, unsigned size, unsigned long long hash)
+{
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    for (unsigned i = 0; i < size; i++){
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+unsigned long long LoaderCache::Hash(const String& str, unsigned long long hash)
+{
+    return Hash(str.CString(),str.Length(),hash);
+}
+
+unsigned long long LoaderCache::HashFile(Context* context, const String& fileName)
+{
+    File file(context);
+    if (!file.Open(fileName,FILE_READ))
+        return 0;
+
+    unsigned long long hash = HASH_SEED;
+    unsigned char buffer[64 * 1024];
+    while (!file.IsEof()){
+        unsigned read = file.Read(buffer,sizeof(buffer));
+        if (!read)
+            break;
+        hash = Hash(buffer,read,hash);
+    }
+    return hash;
+}
+
+String LoaderCache::HashToString(unsigned long long hash)
+{
+    char buffer[17];
+    snprintf(buffer,sizeof(buffer),"%016llx",hash);
+    return String(buffer);
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <Urho3D/Container/Str.h>
+
+namespace Urho3D {
+    class Context;
+}
+
+using namespace Urho3D;
+
+/// Location of the on-disk caches the loader keeps next to the working directory.
+class LoaderCache {
+public:
+    /// Set the directory all caches are created in. Empty uses the app preferences dir.
+    static void SetRootDir(const String& dir);
+    static const String& GetRootDir() { return rootDir_; }
+
+    /// Return (and create if needed) the cache directory for subDir, with trailing slash.
+    static String GetDir(Context* context, const String& subDir);
+
+    static const unsigned long long HASH_SEED = 14695981039346656037ull;
+    /// FNV-1a hash of a memory block. Pass the previous result as hash to chain blocks.
+    static unsigned long long Hash(const void* data, unsigned size, unsigned long long hash = HASH_SEED);
+    static unsigned long long Hash(const String& str, unsigned long long hash = HASH_SEED);
+    /// Hash the content of a file. Returns 0 if the file could not be read.
+    static unsigned long long HashFile(Context* context, const String& fileName);
+    /// Hex representation used to name cache files.
+    static String HashToString(unsigned long long hash);
+
+private:
+    static String rootDir_;
+};
@@ -0,0 +1,568 @@
+#include "LodBuilder.h"
+#include "LoaderCache.h"
+
+#include <algorithm>
+
+#include <Urho3D/Container/HashMap.h>
+#include <Urho3D/Core/Context.h>
+#include <Urho3D/Core/Timer.h>
+#include <Urho3D/Core/WorkQueue.h>
+#include <Urho3D/Graphics/Geometry.h>
+#include <Urho3D/Graphics/IndexBuffer.h>
+#include <Urho3D/Graphics/Model.h>
+#include <Urho3D/Graphics/VertexBuffer.h>
+#include <Urho3D/IO/File.h>
+#include <Urho3D/IO/FileSystem.h>
+#include <Urho3D/IO/Log.h>
+#include <Urho3D/Resource/ResourceCache.h>
+#include <Urho3D/Resource/ResourceEvents.h>
+
+// bump this whenever the simplifier changes its output
+static const unsigned LOD_CACHE_VERSION = 1;
+// triangle ratio of each lod level relative to the source geometry
+static const float LOD_RATIOS[] = { 0.5f, 0.25f, 0.125f };
+static const unsigned MAX_LOD_LEVELS = sizeof(LOD_RATIOS) / sizeof(LOD_RATIOS[0]);
+// geometries below this are not worth simplifying
+static const unsigned MIN_LOD_TRIANGLES = 64;
+
+/// Symmetric 4x4 error quadric of the planes around a vertex.
+struct Quadric
+{
+    double a_[10] = {};
+
+    void AddPlane(double a, double b, double c, double d, double weight)
+    {
+        a_[0] += weight * a * a; a_[1] += weight * a * b; a_[2] += weight * a * c; a_[3] += weight * a * d;
+        a_[4] += weight * b * b; a_[5] += weight * b * c; a_[6] += weight * b * d;
+        a_[7] += weight * c * c; a_[8] += weight * c * d;
+        a_[9] += weight * d * d;
+    }
+
+    void Add(const Quadric& rhs)
+    {
+        for (unsigned i = 0; i < 10; i++)
+            a_[i] += rhs.a_[i];
+    }
+
+    double Evaluate(const Vector3& v) const
+    {
+        double x = v.x_, y = v.y_, z = v.z_;
+        return a_[0] * x * x + 2 * a_[1] * x * y + 2 * a_[2] * x * z + 2 * a_[3] * x +
+               a_[4] * y * y + 2 * a_[5] * y * z + 2 * a_[6] * y +
+               a_[7] * z * z + 2 * a_[8] * z + a_[9];
+    }
+};
+
+struct EdgeCollapse
+{
+    double cost_;
+    unsigned from_;
+    unsigned to_;
+
+    // std heaps keep the largest element on top, we want the cheapest
+    bool operator <(const EdgeCollapse& rhs) const { return cost_ > rhs.cost_; }
+};
+
+/// Half-edge collapse simplifier. Vertices are only ever moved onto other existing vertices,
+/// so the simplified triangles can keep using the source vertex buffer. Vertices on open borders
+/// and on uv/normal seams (same position, different vertex) are locked.
+static void SimplifyIndices(const PODVector<Vector3>& positions, const PODVector<unsigned>& indices,
+                            unsigned targetTriangles, PODVector<unsigned>& dest)
+{
+    unsigned numVertices = positions.Size();
+    unsigned numTriangles = indices.Size() / 3;
+
+    PODVector<unsigned> triangles(indices);
+    PODVector<unsigned char> removed(numTriangles);
+    PODVector<unsigned char> locked(numVertices);
+    PODVector<unsigned> remap(numVertices);
+    Vector<PODVector<unsigned> > vertexTriangles(numVertices);
+    PODVector<Quadric> quadrics(numVertices);
+
+    for (unsigned i = 0; i < numVertices; i++){
+        remap[i] = i;
+        locked[i] = 0;
+        quadrics[i] = Quadric();
+    }
+
+    // seams: the same position used by more than one vertex
+    HashMap<unsigned long long, unsigned> positionVertex;
+    for (unsigned i = 0; i < numTriangles * 3; i++){
+        unsigned v = triangles[i];
+        unsigned long long key = LoaderCache::Hash(&positions[v], sizeof(Vector3));
+        auto it = positionVertex.Find(key);
+        if (it == positionVertex.End())
+            positionVertex[key] = v;
+        else if (it->second_ != v && positions[it->second_] == positions[v]){
+            locked[v] = 1;
+            locked[it->second_] = 1;
+        }
+    }
+
+    // borders: edges that only belong to one triangle
+    HashMap<unsigned long long, unsigned> edgeUse;
+    for (unsigned t = 0; t < numTriangles; t++){
+        removed[t] = 0;
+        for (unsigned j = 0; j < 3; j++){
+            unsigned a = triangles[t * 3 + j];
+            unsigned b = triangles[t * 3 + (j + 1) % 3];
+            unsigned long long key = ((unsigned long long)Min(a, b) << 32) | Max(a, b);
+            edgeUse[key]++;
+            vertexTriangles[a].Push(t);
+        }
+    }
+    for (auto it = edgeUse.Begin(); it != edgeUse.End(); ++it){
+        if (it->second_ == 1){
+            locked[(unsigned)(it->first_ >> 32)] = 1;
+            locked[(unsigned)(it->first_ & 0xffffffff)] = 1;
+        }
+    }
+
+    // area weighted plane quadrics
+    for (unsigned t = 0; t < numTriangles; t++){
+        const Vector3& p0 = positions[triangles[t * 3]];
+        const Vector3& p1 = positions[triangles[t * 3 + 1]];
+        const Vector3& p2 = positions[triangles[t * 3 + 2]];
+        Vector3 normal = (p1 - p0).CrossProduct(p2 - p0);
+        float area = normal.Length();
+        if (area < M_EPSILON)
+            continue;
+        normal /= area;
+        double d = -normal.DotProduct(p0);
+        for (unsigned j = 0; j < 3; j++)
+            quadrics[triangles[t * 3 + j]].AddPlane(normal.x_, normal.y_, normal.z_, d, area);
+    }
+
+    auto collapseCost = [&](unsigned from, unsigned to) {
+        Quadric q = quadrics[from];
+        q.Add(quadrics[to]);
+        return q.Evaluate(positions[to]);
+    };
+
+    PODVector<EdgeCollapse> heap;
+    auto pushCollapse = [&](unsigned from, unsigned to) {
+        if (locked[from] || from == to)
+            return;
+        EdgeCollapse collapse = { collapseCost(from, to), from, to };
+        heap.Push(collapse);
+        std::push_heap(heap.Buffer(), heap.Buffer() + heap.Size());
+    };
+
+    for (unsigned t = 0; t < numTriangles; t++){
+        for (unsigned j = 0; j < 3; j++){
+            unsigned a = triangles[t * 3 + j];
+            unsigned b = triangles[t * 3 + (j + 1) % 3];
+            pushCollapse(a, b);
+            pushCollapse(b, a);
+        }
+    }
+
+    unsigned liveTriangles = numTriangles;
+    while (liveTriangles > targetTriangles && !heap.Empty()){
+        std::pop_heap(heap.Buffer(), heap.Buffer() + heap.Size());
+        EdgeCollapse collapse = heap.Back();
+        heap.Pop();
+
+        unsigned from = collapse.from_;
+        unsigned to = collapse.to_;
+        if (remap[from] != from || remap[to] != to)
+            continue;
+
+        // costs are updated lazily. re-queue if the neighbourhood changed since it was pushed
+        double cost = collapseCost(from, to);
+        if (cost > collapse.cost_ * 1.001 + 1e-12){
+            pushCollapse(from, to);
+            continue;
+        }
+
+        // the vertices must still be connected and no triangle may flip
+        bool connected = false;
+        bool flips = false;
+        for (unsigned t : vertexTriangles[from]){
+            if (removed[t])
+                continue;
+            unsigned* tri = &triangles[t * 3];
+            if (tri[0] == to || tri[1] == to || tri[2] == to){
+                connected = true;
+                continue;
+            }
+            Vector3 before = (positions[tri[1]] - positions[tri[0]]).CrossProduct(positions[tri[2]] - positions[tri[0]]);
+            Vector3 p[3];
+            for (unsigned j = 0; j < 3; j++)
+                p[j] = positions[tri[j] == from ? to : tri[j]];
+            Vector3 after = (p[1] - p[0]).CrossProduct(p[2] - p[0]);
+            if (before.DotProduct(after) <= 0.0f){
+                flips = true;
+                break;
+            }
+        }
+        if (!connected || flips)
+            continue;
+
+        for (unsigned t : vertexTriangles[from]){
+            if (removed[t])
+                continue;
+            unsigned* tri = &triangles[t * 3];
+            if (tri[0] == to || tri[1] == to || tri[2] == to){
+                removed[t] = 1;
+                liveTriangles--;
+                continue;
+            }
+            for (unsigned j = 0; j < 3; j++){
+                if (tri[j] == from)
+                    tri[j] = to;
+            }
+            vertexTriangles[to].Push(t);
+        }
+        quadrics[to].Add(quadrics[from]);
+        remap[from] = to;
+        vertexTriangles[from].Clear();
+
+        for (unsigned t : vertexTriangles[to]){
+            if (removed[t])
+                continue;
+            for (unsigned j = 0; j < 3; j++){
+                unsigned other = triangles[t * 3 + j];
+                pushCollapse(to, other);
+                pushCollapse(other, to);
+            }
+        }
+    }
+
+    dest.Clear();
+    for (unsigned t = 0; t < numTriangles; t++){
+        if (!removed[t]){
+            dest.Push(triangles[t * 3]);
+            dest.Push(triangles[t * 3 + 1]);
+            dest.Push(triangles[t * 3 + 2]);
+        }
+    }
+}
+
+/// Source data of one geometry, copied so the workers never touch the model.
+struct LodGeometryJob
+{
+    unsigned geometryIndex_;
+    /// first vertex the local indices are relative to
+    unsigned vertexBase_;
+    PODVector<Vector3> positions_;
+    PODVector<unsigned> indices_;
+    /// local indices of each generated lod level
+    Vector<PODVector<unsigned> > lodIndices_;
+};
+
+struct LodModelJob
+{
+    SharedPtr<Model> model_;
+    String resourceName_;
+    String cacheFileName_;
+    Vector<LodGeometryJob> geometries_;
+    unsigned numLevels_;
+};
+
+static void BuildLodWork(const WorkItem* item, unsigned threadIndex)
+{
+    auto* job = reinterpret_cast<LodModelJob*>(item->aux_);
+    for (LodGeometryJob& geometry : job->geometries_){
+        unsigned sourceTriangles = geometry.indices_.Size() / 3;
+        const PODVector<unsigned>* previous = &geometry.indices_;
+        for (unsigned level = 0; level < job->numLevels_; level++){
+            unsigned target = Max((unsigned)(sourceTriangles * LOD_RATIOS[level]), 1U);
+            PODVector<unsigned> lod;
+            // simplify from the previous level, that's faster and keeps the levels consistent
+            SimplifyIndices(geometry.positions_, *previous, target, lod);
+            // stop once the locked vertices don't allow to get any simpler
+            if (lod.Empty() || lod.Size() * 100 > previous->Size() * 95)
+                break;
+            geometry.lodIndices_.Push(lod);
+            previous = &geometry.lodIndices_.Back();
+        }
+    }
+}
+
+/// Copy positions and indices of lod 0 of a geometry. Returns false if it can't be simplified.
+static bool ExtractGeometry(Geometry* geometry, LodGeometryJob& job)
+{
+    if (!geometry || geometry->GetPrimitiveType() != TRIANGLE_LIST || geometry->GetIndexCount() < MIN_LOD_TRIANGLES * 3)
+        return false;
+
+    IndexBuffer* indexBuffer = geometry->GetIndexBuffer();
+    if (!indexBuffer || !indexBuffer->GetShadowData())
+        return false;
+
+    VertexBuffer* positionBuffer = nullptr;
+    const VertexElement* position = nullptr;
+    for (unsigned i = 0; i < geometry->GetNumVertexBuffers(); i++){
+        VertexBuffer* buffer = geometry->GetVertexBuffer(i);
+        if (buffer && buffer->GetShadowData() && (position = buffer->GetElement(SEM_POSITION))){
+            positionBuffer = buffer;
+            break;
+        }
+    }
+    if (!positionBuffer || position->type_ != TYPE_VECTOR3)
+        return false;
+
+    const unsigned char* indexData = indexBuffer->GetShadowData();
+    bool largeIndices = indexBuffer->GetIndexSize() == sizeof(unsigned);
+    unsigned start = geometry->GetIndexStart();
+    unsigned count = geometry->GetIndexCount();
+
+    unsigned minVertex = M_MAX_UNSIGNED;
+    unsigned maxVertex = 0;
+    job.indices_.Resize(count);
+    for (unsigned i = 0; i < count; i++){
+        unsigned index = largeIndices ? ((const unsigned*)indexData)[start + i] : ((const unsigned short*)indexData)[start + i];
+        job.indices_[i] = index;
+        minVertex = Min(minVertex, index);
+        maxVertex = Max(maxVertex, index);
+    }
+    if (maxVertex >= positionBuffer->GetVertexCount())
+        return false;
+
+    job.vertexBase_ = minVertex;
+    for (unsigned i = 0; i < count; i++)
+        job.indices_[i] -= minVertex;
+
+    unsigned vertexSize = positionBuffer->GetVertexSize();
+    const unsigned char* vertexData = positionBuffer->GetShadowData() + position->offset_;
+    job.positions_.Resize(maxVertex - minVertex + 1);
+    for (unsigned v = minVertex; v <= maxVertex; v++)
+        job.positions_[v - minVertex] = *reinterpret_cast<const Vector3*>(vertexData + v * vertexSize);
+    return true;
+}
+
+/// Add the generated lod levels to the model. One new index buffer per lod level holds all its geometries.
+static void ApplyLods(Context* context, LodModelJob& job, const PODVector<float>& distances)
+{
+    Model* model = job.model_;
+    Vector<SharedPtr<IndexBuffer> > indexBuffers = model->GetIndexBuffers();
+    PODVector<unsigned> numLevels(model->GetNumGeometries());
+    for (unsigned i = 0; i < numLevels.Size(); i++)
+        numLevels[i] = 1;
+
+    for (unsigned level = 0; level < job.numLevels_; level++){
+        PODVector<unsigned> levelIndices;
+        PODVector<unsigned> starts;
+        bool largeIndices = false;
+        for (const LodGeometryJob& geometry : job.geometries_){
+            starts.Push(levelIndices.Size());
+            if (level >= geometry.lodIndices_.Size())
+                continue;
+            for (unsigned index : geometry.lodIndices_[level]){
+                unsigned vertex = index + geometry.vertexBase_;
+                largeIndices |= vertex > 0xffff;
+                levelIndices.Push(vertex);
+            }
+        }
+        if (levelIndices.Empty())
+            break;
+
+        SharedPtr<IndexBuffer> indexBuffer(new IndexBuffer(context));
+        indexBuffer->SetShadowed(true);
+        indexBuffer->SetSize(levelIndices.Size(), largeIndices);
+        if (largeIndices){
+            indexBuffer->SetData(levelIndices.Buffer());
+        }
+        else {
+            PODVector<unsigned short> shortIndices(levelIndices.Size());
+            for (unsigned i = 0; i < levelIndices.Size(); i++)
+                shortIndices[i] = (unsigned short)levelIndices[i];
+            indexBuffer->SetData(shortIndices.Buffer());
+        }
+        indexBuffers.Push(indexBuffer);
+
+        for (unsigned g = 0; g < job.geometries_.Size(); g++){
+            const LodGeometryJob& geometryJob = job.geometries_[g];
+            if (level >= geometryJob.lodIndices_.Size())
+                continue;
+
+            Geometry* source = model->GetGeometry(geometryJob.geometryIndex_, 0);
+            SharedPtr<Geometry> geometry(new Geometry(context));
+            geometry->SetNumVertexBuffers(source->GetNumVertexBuffers());
+            for (unsigned i = 0; i < source->GetNumVertexBuffers(); i++)
+                geometry->SetVertexBuffer(i, source->GetVertexBuffer(i));
+            geometry->SetIndexBuffer(indexBuffer);
+            geometry->SetDrawRange(TRIANGLE_LIST, starts[g], geometryJob.lodIndices_[level].Size());
+            geometry->SetLodDistance(distances[level]);
+
+            unsigned& geometryLevels = numLevels[geometryJob.geometryIndex_];
+            model->SetNumGeometryLodLevels(geometryJob.geometryIndex_, geometryLevels + 1);
+            model->SetGeometry(geometryJob.geometryIndex_, geometryLevels, geometry);
+            geometryLevels++;
+        }
+    }
+    model->SetIndexBuffers(indexBuffers);
+}
+
+LodBuilder::LodBuilder(Context* context)
+    : Object(context)
+{
+    lodDistances_.Push(15.0f);
+    lodDistances_.Push(40.0f);
+    lodDistances_.Push(90.0f);
+}
+
+void LodBuilder::SetLodDistances(const PODVector<float>& distances)
+{
+    lodDistances_.Clear();
+    for (unsigned i = 0; i < distances.Size() && i < MAX_LOD_LEVELS; i++){
+        lodDistances_.Push(distances[i]);
+    }
+}
+
+void LodBuilder::SetLodDistances(const String& distances)
+{
+    PODVector<float> values;
+    for (const String& value : distances.Split(',')){
+        values.Push(ToFloat(value.Trimmed()));
+    }
+    SetLodDistances(values);
+}
+
+void LodBuilder::ProcessModelFolders(const Vector<String>& folders)
+{
+    ResourceCache* cache = GetSubsystem<ResourceCache>();
+    FileSystem* fs = GetSubsystem<FileSystem>();
+
+    Vector<String> resourceNames;
+    for (const String& resDir : cache->GetResourceDirs()){
+        for (const String& folder : folders){
+            Vector<String> dirFiles;
+            fs->ScanDir(dirFiles,resDir+folder,"*.mdl",SCAN_FILES,true);
+            for (const String& file : dirFiles){
+                String resourceName = folder+"/"+file;
+                if (!resourceNames.Contains(resourceName))
+                    resourceNames.Push(resourceName);
+            }
+        }
+    }
+    ProcessModels(resourceNames);
+}
+
+void LodBuilder::ProcessModels(const Vector<String>& resourceNames)
+{
+    if (lodDistances_.Empty())
+        return;
+
+    HiresTimer timer;
+    ResourceCache* cache = GetSubsystem<ResourceCache>();
+    unsigned numCached = 0;
+
+    Vector<LodModelJob> jobs;
+    for (const String& resourceName : resourceNames){
+        String cacheFileName = GetCacheFileName(resourceName);
+        if (cacheFileName.Empty())
+            continue;
+
+        if (LoadCached(resourceName,cacheFileName)){
+            numCached++;
+            continue;
+        }
+
+        Model* model = cache->GetResource<Model>(resourceName);
+        if (!model)
+            continue;
+
+        LodModelJob job;
+        job.model_ = model;
+        job.resourceName_ = resourceName;
+        job.cacheFileName_ = cacheFileName;
+        job.numLevels_ = lodDistances_.Size();
+
+        bool hasLods = false;
+        for (unsigned i = 0; i < model->GetNumGeometries(); i++){
+            if (model->GetNumGeometryLodLevels(i) > 1){
+                hasLods = true;
+                break;
+            }
+        }
+        // models that come with their own lod levels are left alone
+        if (!hasLods){
+            for (unsigned i = 0; i < model->GetNumGeometries(); i++){
+                LodGeometryJob geometryJob;
+                geometryJob.geometryIndex_ = i;
+                if (ExtractGeometry(model->GetGeometry(i,0),geometryJob))
+                    job.geometries_.Push(geometryJob);
+            }
+        }
+        if (job.geometries_.Empty())
+            continue;
+
+        jobs.Push(job);
+    }
+
+    if (!jobs.Empty()){
+        WorkQueue* queue = GetSubsystem<WorkQueue>();
+        // jobs must not be resized from here on, the work items point into it
+        for (LodModelJob& job : jobs){
+            SharedPtr<WorkItem> item = queue->GetFreeItem();
+            item->workFunction_ = BuildLodWork;
+            item->aux_ = &job;
+            item->priority_ = M_MAX_UNSIGNED;
+            queue->AddWorkItem(item);
+        }
+        queue->Complete(M_MAX_UNSIGNED);
+
+        for (LodModelJob& job : jobs){
+            ApplyLods(context_,job,lodDistances_);
+
+            File file(context_,job.cacheFileName_,FILE_WRITE);
+            if (!file.IsOpen() || !job.model_->Save(file)){
+                URHO3D_LOGWARNINGF("[LodBuilder] could not write lod cache for %s",job.resourceName_.CString());
+            }
+            // drawables using the model pick up the new lod levels
+            job.model_->SendEvent(E_RELOADFINISHED);
+        }
+    }
+
+    URHO3D_LOGINFOF("[LodBuilder] %u models: %u from cache, %u generated in %.2fms",resourceNames.Size(),numCached,
+                    jobs.Size(),timer.GetUSec(false)/1000.0f);
+}
+
+bool LodBuilder::LoadCached(const String& resourceName, const String& cacheFileName)
+{
+    if (!GetSubsystem<FileSystem>()->FileExists(cacheFileName))
+        return false;
+
+    ResourceCache* cache = GetSubsystem<ResourceCache>();
+    File file(context_,cacheFileName,FILE_READ);
+
+    // an already loaded model is replaced in place, so its users see the change
+    SharedPtr<Model> model(cache->GetExistingResource<Model>(resourceName));
+    bool existing = model.NotNull();
+    if (!existing)
+        model = new Model(context_);
+
+    if (!model->Load(file)){
+        URHO3D_LOGWARNINGF("[LodBuilder] lod cache of %s is broken",resourceName.CString());
+        return false;
+    }
+    model->SetName(resourceName);
+
+    if (existing)
+        model->SendEvent(E_RELOADFINISHED);
+    else
+        cache->AddManualResource(model);
+    return true;
+}
+
+String LodBuilder::GetCacheFileName(const String& resourceName)
+{
+    SharedPtr<File> file = GetSubsystem<ResourceCache>()->GetFile(resourceName,false);
+    if (file.Null())
+        return String::EMPTY;
+
+    unsigned long long hash = LoaderCache::HASH_SEED;
+    unsigned char buffer[64 * 1024];
+    while (!file->IsEof()){
+        unsigned read = file->Read(buffer,sizeof(buffer));
+        if (!read)
+            break;
+        hash = LoaderCache::Hash(buffer,read,hash);
+    }
+    // the same source with other distances is another cache entry
+    hash = LoaderCache::Hash(lodDistances_.Buffer(),lodDistances_.Size()*sizeof(float),hash);
+    hash = LoaderCache::Hash(&LOD_CACHE_VERSION,sizeof(LOD_CACHE_VERSION),hash);
+
+    return LoaderCache::GetDir(context_,"lod")+LoaderCache::HashToString(hash)+".mdl";
+}
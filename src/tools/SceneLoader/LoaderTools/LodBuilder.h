@@ -0,0 +1,42 @@
+#pragma once
+
+#include <Urho3D/Core/Object.h>
+#include <Urho3D/Container/Ptr.h>
+#include <Urho3D/Container/Str.h>
+#include <Urho3D/Container/Vector.h>
+
+namespace Urho3D {
+    class Context;
+    class Model;
+}
+
+using namespace Urho3D;
+
+/// Generates simplified lod levels for models without any and keeps them in the
+/// on-disk cache keyed by the hash of the source file. The models are put into the
+/// ResourceCache under their original name, so StaticModels pick up the lod levels
+/// without changes to the scene. Only index buffers are generated, all lod levels
+/// share the vertex buffers of the source model.
+class LodBuilder : public Object {
+    URHO3D_OBJECT(LodBuilder, Object);
+public:
+    explicit LodBuilder(Context* context);
+
+    /// Set the view distances the lod levels switch at. 1-3 values, one lod level each.
+    void SetLodDistances(const PODVector<float>& distances);
+    /// Parse distances from a comma separated list (e.g. "15,40,90")
+    void SetLodDistances(const String& distances);
+    const PODVector<float>& GetLodDistances() const { return lodDistances_; }
+
+    /// Process all .mdl files in the folders of every resource dir.
+    void ProcessModelFolders(const Vector<String>& folders);
+    /// Process models by resource name. Models that are already loaded get their lod levels in place.
+    void ProcessModels(const Vector<String>& resourceNames);
+
+private:
+    /// Replace the model's geometries with the cached lod version. Returns false if there is none.
+    bool LoadCached(const String& resourceName, const String& cacheFileName);
+    String GetCacheFileName(const String& resourceName);
+
+    PODVector<float> lodDistances_;
+};
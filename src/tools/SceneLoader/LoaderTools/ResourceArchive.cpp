@@ -0,0 +1,331 @@
+#include "ResourceArchive.h"
+#include "LoaderCache.h"
+
+#include <Urho3D/Core/Context.h>
+#include <Urho3D/Core/Timer.h>
+#include <Urho3D/IO/File.h>
+#include <Urho3D/IO/FileSystem.h>
+#include <Urho3D/IO/Log.h>
+#include <Urho3D/IO/PackageFile.h>
+#include <Urho3D/Math/MathDefs.h>
+#include <Urho3D/Resource/ResourceCache.h>
+#include <Urho3D/Resource/ResourceEvents.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// entries start at page boundaries, so each one can be mapped and read in whole pages
+static const unsigned ARCHIVE_ALIGNMENT = 4096;
+
+/// Routes archive entries whose loose file changed to that file.
+class ArchiveRouter : public ResourceRouter
+{
+    URHO3D_OBJECT(ArchiveRouter, ResourceRouter);
+public:
+    ArchiveRouter(Context* context, ResourceArchive* archive)
+        : ResourceRouter(context),
+          archive_(archive)
+    {
+    }
+
+    void Route(String& name, ResourceRequest requestType) override
+    {
+        if (requestType != RESOURCE_GETFILE || !archive_)
+            return;
+
+        String changedFileName = archive_->GetChangedFileName(name);
+        if (!changedFileName.Empty())
+            name = changedFileName;
+    }
+
+private:
+    WeakPtr<ResourceArchive> archive_;
+};
+
+static void WritePadding(File& file)
+{
+    static const unsigned char zeros[ARCHIVE_ALIGNMENT] = {0};
+    unsigned remainder = file.GetPosition() % ARCHIVE_ALIGNMENT;
+    if (remainder)
+        file.Write(zeros,ARCHIVE_ALIGNMENT - remainder);
+}
+
+ResourceArchive::ResourceArchive(Context* context)
+    : Object(context),
+      mappedData_(nullptr),
+      mappedSize_(0),
+      archiveTime_(0),
+#ifdef _WIN32
+      fileHandle_(INVALID_HANDLE_VALUE),
+      mappingHandle_(nullptr)
+#else
+      fileHandle_(-1)
+#endif
+{
+}
+
+ResourceArchive::~ResourceArchive()
+{
+    Unmount();
+}
+
+bool ResourceArchive::Pack(const String& dir, const String& archiveFileName)
+{
+    HiresTimer timer;
+    FileSystem* fs = GetSubsystem<FileSystem>();
+    String root = AddTrailingSlash(dir);
+
+    Vector<String> scanned;
+    fs->ScanDir(scanned,root,"*",SCAN_FILES,true);
+
+    // the loader cache (and with it the default archive) is a dot-folder, as are vcs folders
+    Vector<String> names;
+    for (const String& name : scanned){
+        if (name.StartsWith(".") || name.Contains("/.") || root + name == archiveFileName)
+            continue;
+        names.Push(name);
+    }
+    Sort(names.Begin(),names.End());
+
+    File archive(context_,archiveFileName,FILE_WRITE);
+    if (!archive.IsOpen()){
+        URHO3D_LOGERRORF("[ResourceArchive] could not write %s",archiveFileName.CString());
+        return false;
+    }
+
+    // same layout as the PackageTool writes: id, file count, checksum, then name/offset/size/checksum per entry
+    unsigned headerSize = 12;
+    for (const String& name : names){
+        headerSize += name.Length() + 1 + 12;
+    }
+    Vector<PackageEntry> entries(names.Size());
+    archive.Seek(headerSize);
+    WritePadding(archive);
+
+    unsigned checksum = 0;
+    PODVector<unsigned char> buffer;
+    for (unsigned i = 0; i < names.Size(); i++){
+        File source(context_,root + names[i],FILE_READ);
+        if (!source.IsOpen()){
+            URHO3D_LOGERRORF("[ResourceArchive] could not read %s",names[i].CString());
+            return false;
+        }
+        buffer.Resize(source.GetSize());
+        if (buffer.Size() && source.Read(&buffer[0],buffer.Size()) != buffer.Size()){
+            URHO3D_LOGERRORF("[ResourceArchive] could not read %s",names[i].CString());
+            return false;
+        }
+
+        PackageEntry& entry = entries[i];
+        entry.offset_ = archive.GetPosition();
+        entry.size_ = buffer.Size();
+        entry.checksum_ = 0;
+        for (unsigned char c : buffer){
+            entry.checksum_ = SDBMHash(entry.checksum_,c);
+            checksum = SDBMHash(checksum,c);
+        }
+        if (buffer.Size())
+            archive.Write(&buffer[0],buffer.Size());
+        WritePadding(archive);
+    }
+    unsigned archiveSize = archive.GetPosition();
+
+    archive.Seek(0);
+    archive.WriteFileID("UPAK");
+    archive.WriteUInt(names.Size());
+    archive.WriteUInt(checksum);
+    for (unsigned i = 0; i < names.Size(); i++){
+        archive.WriteString(names[i]);
+        archive.WriteUInt(entries[i].offset_);
+        archive.WriteUInt(entries[i].size_);
+        archive.WriteUInt(entries[i].checksum_);
+    }
+
+    URHO3D_LOGINFOF("[ResourceArchive] packed %u files of %s into %s (%uKB) in %.2fms",names.Size(),root.CString()
+                    ,archiveFileName.CString(),archiveSize / 1024,timer.GetUSec(false) / 1000.0f);
+    return true;
+}
+
+bool ResourceArchive::Mount(const String& archiveFileName)
+{
+    Unmount();
+
+    SharedPtr<PackageFile> package(new PackageFile(context_));
+    if (!package->Open(archiveFileName)){
+        URHO3D_LOGWARNINGF("[ResourceArchive] could not open %s",archiveFileName.CString());
+        return false;
+    }
+
+    String nativeFileName = GetNativePath(archiveFileName);
+#ifdef _WIN32
+    fileHandle_ = CreateFileW(WString(nativeFileName).CString(),GENERIC_READ,FILE_SHARE_READ,nullptr,OPEN_EXISTING,FILE_ATTRIBUTE_NORMAL,nullptr);
+    LARGE_INTEGER fileSize;
+    if (fileHandle_ != INVALID_HANDLE_VALUE && GetFileSizeEx(fileHandle_,&fileSize) && fileSize.QuadPart > 0){
+        mappingHandle_ = CreateFileMappingW(fileHandle_,nullptr,PAGE_READONLY,0,0,nullptr);
+        if (mappingHandle_){
+            mappedData_ = static_cast<unsigned char*>(MapViewOfFile(mappingHandle_,FILE_MAP_READ,0,0,0));
+            mappedSize_ = (unsigned)fileSize.QuadPart;
+        }
+    }
+#else
+    fileHandle_ = open(nativeFileName.CString(),O_RDONLY);
+    struct stat fileStat;
+    if (fileHandle_ != -1 && fstat(fileHandle_,&fileStat) == 0 && fileStat.st_size > 0){
+        void* data = mmap(nullptr,fileStat.st_size,PROT_READ,MAP_PRIVATE,fileHandle_,0);
+        if (data != MAP_FAILED){
+            mappedData_ = static_cast<unsigned char*>(data);
+            mappedSize_ = (unsigned)fileStat.st_size;
+        }
+    }
+#endif
+    if (!mappedData_){
+        URHO3D_LOGWARNINGF("[ResourceArchive] could not map %s",archiveFileName.CString());
+        Unmount();
+        return false;
+    }
+
+    const HashMap<String, PackageEntry>& packageEntries = package->GetEntries();
+    for (auto it = packageEntries.Begin(); it != packageEntries.End(); ++it){
+        const PackageEntry& packageEntry = it->second_;
+        if (packageEntry.offset_ + packageEntry.size_ > mappedSize_){
+            URHO3D_LOGWARNINGF("[ResourceArchive] %s is truncated",archiveFileName.CString());
+            Unmount();
+            return false;
+        }
+        ArchiveEntry& entry = entries_[StringHash(it->first_)];
+        entry.offset_ = packageEntry.offset_;
+        entry.size_ = packageEntry.size_;
+    }
+
+    // the loose files are compared with this on their first request, see GetChangedFileName()
+    archiveTime_ = GetSubsystem<FileSystem>()->GetLastModifiedTime(archiveFileName);
+
+    // in front of every other package, packages are searched before the resource dirs
+    ResourceCache* cache = GetSubsystem<ResourceCache>();
+    package_ = package;
+    cache->AddPackageFile(package_,0);
+    router_ = new ArchiveRouter(context_,this);
+    cache->AddResourceRouter(router_);
+    SubscribeToEvent(E_FILECHANGED,URHO3D_HANDLER(ResourceArchive,HandleFileChanged));
+
+    URHO3D_LOGINFOF("[ResourceArchive] mounted %s with %u files",archiveFileName.CString(),entries_.Size());
+    return true;
+}
+
+void ResourceArchive::Unmount()
+{
+    ResourceCache* cache = GetSubsystem<ResourceCache>();
+    if (cache && package_){
+        // the loaded resources stay, only the source of later loads changes
+        cache->RemovePackageFile(package_,false);
+    }
+    if (cache && router_){
+        cache->RemoveResourceRouter(router_);
+    }
+    package_.Reset();
+    router_.Reset();
+    UnsubscribeFromEvent(E_FILECHANGED);
+
+#ifdef _WIN32
+    if (mappedData_)
+        UnmapViewOfFile(mappedData_);
+    if (mappingHandle_)
+        CloseHandle(mappingHandle_);
+    if (fileHandle_ != INVALID_HANDLE_VALUE)
+        CloseHandle(fileHandle_);
+    mappingHandle_ = nullptr;
+    fileHandle_ = INVALID_HANDLE_VALUE;
+#else
+    if (mappedData_)
+        munmap(mappedData_,mappedSize_);
+    if (fileHandle_ != -1)
+        close(fileHandle_);
+    fileHandle_ = -1;
+#endif
+    mappedData_ = nullptr;
+    mappedSize_ = 0;
+    archiveTime_ = 0;
+    entries_.Clear();
+    changedFiles_.Clear();
+}
+
+const unsigned char* ResourceArchive::GetData(const String& resourceName, unsigned& size)
+{
+    if (!mappedData_)
+        return nullptr;
+
+    auto it = entries_.Find(StringHash(resourceName));
+    if (it == entries_.End() || !GetChangedFileName(resourceName).Empty())
+        return nullptr;
+
+    size = it->second_.size_;
+    return mappedData_ + it->second_.offset_;
+}
+
+String ResourceArchive::GetChangedFileName(const String& resourceName)
+{
+    auto it = changedFiles_.Find(resourceName);
+    if (it != changedFiles_.End())
+        return it->second_;
+    if (!mappedData_ || !entries_.Contains(StringHash(resourceName)))
+        return String::EMPTY;
+
+    // checked on the first request instead of on mounting, that would stat every loose file.
+    // mtimes only have seconds, so the same second as the archive counts as newer
+    FileSystem* fs = GetSubsystem<FileSystem>();
+    String fileName = GetSubsystem<ResourceCache>()->GetResourceFileName(resourceName);
+    if (!fileName.Empty() && fs->GetLastModifiedTime(fileName) >= archiveTime_){
+        URHO3D_LOGINFOF("[ResourceArchive] %s changed since packing, reading it from disk",resourceName.CString());
+    } else {
+        fileName.Clear();
+    }
+    changedFiles_[resourceName] = fileName;
+    return fileName;
+}
+
+bool ResourceArchive::Read(Context* context, const String& resourceName, const std::function<bool(Deserializer&)>& reader)
+{
+    ResourceCache* cache = context->GetSubsystem<ResourceCache>();
+    ResourceArchive* archive = context->GetSubsystem<ResourceArchive>();
+
+    // the archive is only used if no router (cooked textures, changed files) sends the request elsewhere
+    String routedName = resourceName;
+    for (unsigned i = 0; ResourceRouter* router = cache->GetResourceRouter(i); i++){
+        router->Route(routedName,RESOURCE_GETFILE);
+    }
+    unsigned size = 0;
+    const unsigned char* data = archive && routedName == resourceName ? archive->GetData(resourceName,size) : nullptr;
+    if (data){
+        ArchiveBuffer buffer(data,size,resourceName);
+        return reader(buffer);
+    }
+
+    SharedPtr<File> file = cache->GetFile(resourceName,false);
+    return file && reader(*file);
+}
+
+String ResourceArchive::GetDefaultFileName(Context* context)
+{
+    return LoaderCache::GetDir(context,"archive") + "resources.upak";
+}
+
+void ResourceArchive::HandleFileChanged(StringHash eventType, VariantMap& eventData)
+{
+    using namespace FileChanged;
+    String resourceName = eventData[P_RESOURCENAME].GetString();
+    if (!entries_.Contains(StringHash(resourceName)))
+        return;
+    auto it = changedFiles_.Find(resourceName);
+    if (it != changedFiles_.End() && !it->second_.Empty())
+        return;
+
+    changedFiles_[resourceName] = eventData[P_FILENAME].GetString();
+    // the ResourceCache reloaded the resource before sending the event, but still from the archive
+    GetSubsystem<ResourceCache>()->ReloadResourceWithDependencies(resourceName);
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <Urho3D/Core/Object.h>
+#include <Urho3D/Container/HashMap.h>
+#include <Urho3D/Container/Ptr.h>
+#include <Urho3D/Container/Str.h>
+#include <Urho3D/IO/MemoryBuffer.h>
+
+#include <functional>
+
+namespace Urho3D {
+    class Context;
+    class Deserializer;
+    class PackageFile;
+    class ResourceRouter;
+}
+
+using namespace Urho3D;
+
+/// Read-only view of an archive entry. Keeps the resource name, some resources pick their format by it.
+class ArchiveBuffer : public MemoryBuffer {
+public:
+    ArchiveBuffer(const void* data, unsigned size, const String& name)
+        : MemoryBuffer(data,size),
+          name_(name)
+    {
+    }
+
+    const String& GetName() const override { return name_; }
+
+private:
+    String name_;
+};
+
+/// Packs a resource dir into a single archive and serves resources from it. The archive is
+/// a regular Urho3D package (UPAK) whose entries start at page boundaries, so it is registered
+/// with the ResourceCache like any other package and can also be memory-mapped to hand out
+/// the data without copying. Resources whose loose file is newer than the archive or changes
+/// while it is mounted are routed to the loose files again, so hot-reload keeps working. The
+/// loose file of an entry is only looked at once it is requested.
+///
+/// ResourceCache::GetResource always reads through a File. Only the ResourcePreloader and the
+/// reads that go through Read() get the mapped data.
+class ResourceArchive : public Object {
+    URHO3D_OBJECT(ResourceArchive, Object);
+public:
+    explicit ResourceArchive(Context* context);
+    ~ResourceArchive() override;
+
+    /// Pack every file below dir (hidden files and folders excluded) into archiveFileName.
+    bool Pack(const String& dir, const String& archiveFileName);
+
+    /// Map the archive and put it in front of the loose files of the ResourceCache.
+    bool Mount(const String& archiveFileName);
+    void Unmount();
+    bool IsMounted() const { return mappedData_ != nullptr; }
+
+    /// Return the mapped data of a resource, or null if it is not in the archive or the loose file changed since.
+    const unsigned char* GetData(const String& resourceName, unsigned& size);
+    /// Return the loose file that replaces a changed archive entry, or empty.
+    String GetChangedFileName(const String& resourceName);
+
+    /// Pass the resource to reader, from the mapped archive if it has the resource unchanged
+    /// and no router sends it elsewhere, else as a file of the ResourceCache.
+    static bool Read(Context* context, const String& resourceName, const std::function<bool(Deserializer&)>& reader);
+
+    /// Default location of the archive in the loader cache.
+    static String GetDefaultFileName(Context* context);
+
+private:
+    struct ArchiveEntry{
+        unsigned offset_;
+        unsigned size_;
+    };
+
+    void HandleFileChanged(StringHash eventType, VariantMap& eventData);
+
+    HashMap<StringHash, ArchiveEntry> entries_;
+    /// archive entries checked so far, resource name -> absolute name of the loose file that
+    /// replaces it, empty if the archive is up to date
+    HashMap<String, String> changedFiles_;
+    SharedPtr<PackageFile> package_;
+    SharedPtr<ResourceRouter> router_;
+
+    unsigned char* mappedData_;
+    unsigned mappedSize_;
+    unsigned archiveTime_;
+#ifdef _WIN32
+    void* fileHandle_;
+    void* mappingHandle_;
+#else
+    int fileHandle_;
+#endif
+};
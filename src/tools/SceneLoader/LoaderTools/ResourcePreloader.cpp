@@ -0,0 +1,304 @@
+#include "ResourcePreloader.h"
+#include "LoaderCache.h"
+#include "ResourceArchive.h"
+#include "StartupProfiler.h"
+
+#include <Urho3D/Core/Context.h>
+#include <Urho3D/Core/Timer.h>
+#include <Urho3D/Core/WorkQueue.h>
+#include <Urho3D/Graphics/Animation.h>
+#include <Urho3D/Graphics/Material.h>
+#include <Urho3D/Graphics/Model.h>
+#include <Urho3D/Graphics/Texture2D.h>
+#include <Urho3D/IO/File.h>
+#include <Urho3D/IO/FileSystem.h>
+#include <Urho3D/IO/Log.h>
+#include <Urho3D/Resource/ResourceCache.h>
+#include <Urho3D/Resource/XMLFile.h>
+
+// bump this whenever the manifest layout or the scan changes
+static const unsigned MANIFEST_VERSION = 1;
+
+/// One resource to load. Resource and file are created on the main thread, the worker only runs BeginLoad.
+/// Resources of a mounted archive are read from the mapped memory instead of a file.
+struct PreloadJob{
+    SharedPtr<Resource> resource_;
+    SharedPtr<File> file_;
+    const unsigned char* data_ = nullptr;
+    unsigned size_ = 0;
+    bool success_ = false;
+    // for the startup profiler
+    long long begin_ = 0;
+    long long end_ = 0;
+    unsigned thread_ = 0;
+};
+
+static void PreloadWork(const WorkItem* item, unsigned threadIndex)
+{
+    PreloadJob* job = static_cast<PreloadJob*>(item->aux_);
+    job->begin_ = StartupProfiler::GetTime();
+    job->thread_ = threadIndex;
+    if (job->data_){
+        ArchiveBuffer buffer(job->data_,job->size_,job->resource_->GetName());
+        job->success_ = job->resource_->BeginLoad(buffer);
+    } else {
+        job->success_ = job->resource_->BeginLoad(*job->file_);
+    }
+    job->end_ = StartupProfiler::GetTime();
+}
+
+static bool IsPreloadType(StringHash type)
+{
+    return type == Model::GetTypeStatic() || type == Animation::GetTypeStatic()
+            || type == Texture2D::GetTypeStatic() || type == Material::GetTypeStatic();
+}
+
+ResourcePreloader::ResourcePreloader(Context* context)
+    : Object(context)
+{
+}
+
+void ResourcePreloader::PreloadScene(const String& sceneResourceName)
+{
+    HiresTimer timer;
+    String manifestFileName = GetManifestFileName(sceneResourceName);
+
+    Vector<ResourceRef> resources;
+    bool cached = LoadManifest(manifestFileName,resources);
+    if (!cached){
+        HashSet<StringHash> visited;
+        Vector<String> dependencies;
+        ScanFile(sceneResourceName,resources,visited,dependencies);
+        SaveManifest(manifestFileName,resources,dependencies);
+    }
+    long long scanTime = timer.GetUSec(true);
+
+    Preload(resources);
+
+    URHO3D_LOGINFOF("[ResourcePreloader] %s: %u resources in manifest (%s %.2fms) preloaded in %.2fms",sceneResourceName.CString()
+                    ,resources.Size(),cached ? "cached" : "scanned",scanTime / 1000.0f,timer.GetUSec(false) / 1000.0f);
+}
+
+void ResourcePreloader::Preload(const Vector<ResourceRef>& resources)
+{
+    ResourceCache* cache = GetSubsystem<ResourceCache>();
+
+    // materials resolve their textures in EndLoad, so those have to be in the cache first
+    Vector<ResourceRef> firstWave;
+    Vector<ResourceRef> materials;
+    HashSet<StringHash> added;
+    for (const ResourceRef& ref : resources){
+        if (!IsPreloadType(ref.type_) || ref.name_.Empty())
+            continue;
+        if (!added.Insert(StringHash(ref.name_) + ref.type_).second_)
+            continue;
+        if (cache->GetExistingResource(ref.type_,ref.name_))
+            continue;
+
+        if (ref.type_ == Material::GetTypeStatic()){
+            materials.Push(ref);
+        } else {
+            firstWave.Push(ref);
+        }
+    }
+
+    unsigned numLoaded = LoadWave(firstWave);
+    numLoaded += LoadWave(materials);
+    unsigned numFailed = firstWave.Size() + materials.Size() - numLoaded;
+    if (numFailed){
+        URHO3D_LOGWARNINGF("[ResourcePreloader] %u resources could not be preloaded, the scene will load them itself",numFailed);
+    }
+}
+
+unsigned ResourcePreloader::LoadWave(const Vector<ResourceRef>& resources)
+{
+    if (resources.Empty())
+        return 0;
+
+    ResourceCache* cache = GetSubsystem<ResourceCache>();
+    WorkQueue* queue = GetSubsystem<WorkQueue>();
+    ResourceArchive* archive = GetSubsystem<ResourceArchive>();
+
+    // jobs must not be resized once the work items point into it
+    Vector<PreloadJob> jobs;
+    jobs.Reserve(resources.Size());
+    for (const ResourceRef& ref : resources){
+        SharedPtr<Resource> resource;
+        resource.DynamicCast(context_->CreateObject(ref.type_));
+        if (resource.Null())
+            continue;
+
+        PreloadJob job;
+        // the archive is only used if no router (cooked textures, changed files) sends the request elsewhere
+        String routedName = ref.name_;
+        for (unsigned i = 0; ResourceRouter* router = cache->GetResourceRouter(i); i++){
+            router->Route(routedName,RESOURCE_GETFILE);
+        }
+        if (archive && routedName == ref.name_){
+            job.data_ = archive->GetData(ref.name_,job.size_);
+        }
+        if (!job.data_){
+            job.file_ = cache->GetFile(ref.name_,false);
+            if (job.file_.Null())
+                continue;
+        }
+
+        resource->SetName(ref.name_);
+        // lets the resources do the expensive part (decoding, mip levels) inside BeginLoad
+        resource->SetAsyncLoadState(ASYNC_LOADING);
+
+        job.resource_ = resource;
+        jobs.Push(job);
+    }
+
+    for (PreloadJob& job : jobs){
+        SharedPtr<WorkItem> item = queue->GetFreeItem();
+        item->workFunction_ = PreloadWork;
+        item->aux_ = &job;
+        item->priority_ = M_MAX_UNSIGNED;
+        queue->AddWorkItem(item);
+    }
+    queue->Complete(M_MAX_UNSIGNED);
+
+    // gpu uploads have to happen on the main thread
+    StartupProfiler* profiler = GetSubsystem<StartupProfiler>();
+    unsigned numLoaded = 0;
+    for (PreloadJob& job : jobs){
+        job.file_.Reset();
+        long long endLoadBegin = StartupProfiler::GetTime();
+        bool success = job.success_ && job.resource_->EndLoad();
+        job.resource_->SetAsyncLoadState(ASYNC_DONE);
+        if (profiler && profiler->IsEnabled()){
+            profiler->AddResourceLoad(job.resource_->GetType(),job.resource_->GetName(),job.begin_,job.end_,job.thread_);
+            profiler->AddResourceLoad(job.resource_->GetType(),job.resource_->GetName(),endLoadBegin,StartupProfiler::GetTime(),0);
+        }
+        if (!success)
+            continue;
+
+        cache->AddManualResource(job.resource_);
+        numLoaded++;
+    }
+    return numLoaded;
+}
+
+void ResourcePreloader::ScanFile(const String& resourceName, Vector<ResourceRef>& dest, HashSet<StringHash>& visited, Vector<String>& dependencies)
+{
+    if (!visited.Insert(StringHash("file:"+resourceName)).second_)
+        return;
+
+    XMLFile xml(context_);
+    if (!ResourceArchive::Read(context_,resourceName,[&xml](Deserializer& source){ return xml.Load(source); })){
+        URHO3D_LOGWARNINGF("[ResourcePreloader] could not read %s",resourceName.CString());
+        return;
+    }
+    dependencies.Push(resourceName);
+    ScanElement(xml.GetRoot(),dest,visited,dependencies);
+}
+
+void ResourcePreloader::ScanElement(const XMLElement& element, Vector<ResourceRef>& dest, HashSet<StringHash>& visited, Vector<String>& dependencies)
+{
+    for (XMLElement child = element.GetChild(); child; child = child.GetNext()){
+        if (child.GetName() == "attribute"){
+            String name = child.GetAttribute("name");
+            String value = child.GetAttribute("value");
+
+            // ResourceRef and ResourceRefList are written as "Type;name;name..."
+            if (value.Contains(';')){
+                Vector<String> parts = value.Split(';',true);
+                StringHash type(parts[0]);
+                if (IsPreloadType(type)){
+                    for (unsigned i = 1; i < parts.Size(); i++){
+                        AddReference(type,parts[i],dest,visited,dependencies);
+                    }
+                }
+            }
+            // group instances pull in the resources of their group file
+            else if (name == "groupFilename" && !value.Empty()){
+                ScanFile(value,dest,visited,dependencies);
+            }
+        }
+        else {
+            ScanElement(child,dest,visited,dependencies);
+        }
+    }
+}
+
+void ResourcePreloader::AddReference(StringHash type, const String& name, Vector<ResourceRef>& dest, HashSet<StringHash>& visited, Vector<String>& dependencies)
+{
+    if (name.Empty() || !visited.Insert(StringHash(name) + type).second_)
+        return;
+
+    dest.Push(ResourceRef(type,name));
+
+    if (type != Material::GetTypeStatic())
+        return;
+
+    // textures of the material. xml textures are cube maps, 3d textures or arrays, leave those to the material
+    XMLFile xml(context_);
+    if (!ResourceArchive::Read(context_,name,[&xml](Deserializer& source){ return xml.Load(source); }))
+        return;
+
+    dependencies.Push(name);
+    for (XMLElement texture = xml.GetRoot().GetChild("texture"); texture; texture = texture.GetNext("texture")){
+        String textureName = texture.GetAttribute("name");
+        if (!textureName.Empty() && GetExtension(textureName) != ".xml"){
+            AddReference(Texture2D::GetTypeStatic(),textureName,dest,visited,dependencies);
+        }
+    }
+}
+
+bool ResourcePreloader::LoadManifest(const String& fileName, Vector<ResourceRef>& dest)
+{
+    if (!GetSubsystem<FileSystem>()->FileExists(fileName))
+        return false;
+
+    File file(context_,fileName,FILE_READ);
+    if (!file.IsOpen() || file.ReadLine() != "URMF "+String(MANIFEST_VERSION))
+        return false;
+
+    // the manifest is stale as soon as the scene, one of its group files or a material changed
+    Vector<ResourceRef> resources;
+    while (!file.IsEof()){
+        Vector<String> parts = file.ReadLine().Split(';');
+        if (parts.Size() != 3)
+            continue;
+
+        if (parts[0] == "D"){
+            if (GetModifiedTime(parts[1]) != ToUInt(parts[2]))
+                return false;
+        }
+        else if (parts[0] == "R"){
+            resources.Push(ResourceRef(StringHash(parts[1]),parts[2]));
+        }
+    }
+    dest.Push(resources);
+    return true;
+}
+
+void ResourcePreloader::SaveManifest(const String& fileName, const Vector<ResourceRef>& resources, const Vector<String>& dependencies)
+{
+    File file(context_,fileName,FILE_WRITE);
+    if (!file.IsOpen()){
+        URHO3D_LOGWARNINGF("[ResourcePreloader] could not write manifest %s",fileName.CString());
+        return;
+    }
+
+    file.WriteLine("URMF "+String(MANIFEST_VERSION));
+    for (const String& dependency : dependencies){
+        file.WriteLine("D;"+dependency+";"+String(GetModifiedTime(dependency)));
+    }
+    for (const ResourceRef& ref : resources){
+        file.WriteLine("R;"+context_->GetTypeName(ref.type_)+";"+ref.name_);
+    }
+}
+
+String ResourcePreloader::GetManifestFileName(const String& sceneResourceName)
+{
+    return LoaderCache::GetDir(context_,"manifests") + LoaderCache::HashToString(LoaderCache::Hash(sceneResourceName)) + ".txt";
+}
+
+unsigned ResourcePreloader::GetModifiedTime(const String& resourceName)
+{
+    String fileName = GetSubsystem<ResourceCache>()->GetResourceFileName(resourceName);
+    return fileName.Empty() ? 0 : GetSubsystem<FileSystem>()->GetLastModifiedTime(fileName);
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <Urho3D/Core/Object.h>
+#include <Urho3D/Container/HashSet.h>
+#include <Urho3D/Container/Str.h>
+#include <Urho3D/Container/Vector.h>
+#include <Urho3D/Core/Variant.h>
+
+namespace Urho3D {
+    class Context;
+    class XMLElement;
+}
+
+using namespace Urho3D;
+
+/// Loads the models, animations, textures and materials a scene references on the worker
+/// threads before the scene is instantiated, so that Scene::LoadXML finds them in the
+/// ResourceCache instead of loading them one after another. The list of resources (the
+/// manifest) is derived from the scene xml, followed into group files and materials, and
+/// cached so later runs can start loading right away.
+class ResourcePreloader : public Object {
+    URHO3D_OBJECT(ResourcePreloader, Object);
+public:
+    explicit ResourcePreloader(Context* context);
+
+    /// Preload everything the scene (e.g. "Scenes/Scene.xml") references.
+    void PreloadScene(const String& sceneResourceName);
+    /// Load the resources in parallel. Resources that are already loaded or of unsupported type are skipped.
+    /// Textures, models and animations go first, so the materials find their textures.
+    void Preload(const Vector<ResourceRef>& resources);
+
+private:
+    /// Collect the references of a scene or object xml. Group files and materials are followed.
+    void ScanFile(const String& resourceName, Vector<ResourceRef>& dest, HashSet<StringHash>& visited, Vector<String>& dependencies);
+    void ScanElement(const XMLElement& element, Vector<ResourceRef>& dest, HashSet<StringHash>& visited, Vector<String>& dependencies);
+    void AddReference(StringHash type, const String& name, Vector<ResourceRef>& dest, HashSet<StringHash>& visited, Vector<String>& dependencies);
+
+    bool LoadManifest(const String& fileName, Vector<ResourceRef>& dest);
+    void SaveManifest(const String& fileName, const Vector<ResourceRef>& resources, const Vector<String>& dependencies);
+    String GetManifestFileName(const String& sceneResourceName);
+    unsigned GetModifiedTime(const String& resourceName);
+
+    /// Load one group of resources on the worker threads.
+    unsigned LoadWave(const Vector<ResourceRef>& resources);
+};
@@ -0,0 +1,300 @@
+#include "SceneCache.h"
+#include "LoaderCache.h"
+#include "ResourceArchive.h"
+#include "ResourcePreloader.h"
+#include "StaticBatcher.h"
+
+#include <Urho3D/Container/HashSet.h>
+#include <Urho3D/Core/Context.h>
+#include <Urho3D/Graphics/Material.h>
+#include <Urho3D/Graphics/Renderer.h>
+#include <Urho3D/Graphics/Texture.h>
+#include <Urho3D/Graphics/Viewport.h>
+#include <Urho3D/IO/File.h>
+#include <Urho3D/IO/FileSystem.h>
+#include <Urho3D/IO/Log.h>
+#include <Urho3D/IO/PackageFile.h>
+#include <Urho3D/Resource/ResourceCache.h>
+#include <Urho3D/Scene/Component.h>
+#include <Urho3D/Scene/Node.h>
+#include <Urho3D/Scene/Scene.h>
+
+// components can't tell their real size, so use a rough per-component estimate
+static const unsigned COMPONENT_BYTES_ESTIMATE = 256;
+static const unsigned long long DEFAULT_MEMORY_BUDGET = 512ull * 1024 * 1024;
+
+SceneCache::SceneCache(Context* context)
+    : Object(context),
+      memoryBudget_(DEFAULT_MEMORY_BUDGET),
+      useCounter_(0)
+{
+}
+
+Scene* SceneCache::GetScene(const String& resourceName)
+{
+    auto it = entries_.Find(resourceName);
+    if (it != entries_.End()){
+        it->second_.lastUse_ = ++useCounter_;
+        return it->second_.scene_;
+    }
+
+    Scene* scene = LoadScene(resourceName);
+    if (!scene)
+        return nullptr;
+
+    Entry& entry = entries_[resourceName];
+    entry.resourceName_ = resourceName;
+    entry.scene_ = scene;
+    entry.lastUse_ = ++useCounter_;
+    entry.memory_ = CalculateMemoryInfo(scene);
+
+    URHO3D_LOGINFOF("[SceneCache] loaded %s nodes:%u components:%u resources:%u ~%.2fMB",resourceName.CString(),
+                    entry.memory_.numNodes_,entry.memory_.numComponents_,entry.memory_.numResources_,
+                    entry.memory_.GetTotal()/(1024.0f*1024.0f));
+    return scene;
+}
+
+Scene* SceneCache::ReloadScene(const String& resourceName)
+{
+    auto it = entries_.Find(resourceName);
+    if (it == entries_.End())
+        return nullptr;
+
+    Scene* scene = it->second_.scene_;
+    if (StaticBatcher* batcher = GetSubsystem<StaticBatcher>())
+        batcher->ClearScene(scene);
+    if (!ResourceArchive::Read(context_,resourceName,[scene](Deserializer& source){ return scene->LoadXML(source); })){
+        URHO3D_LOGERRORF("[SceneCache] could not reload scene:%s",resourceName.CString());
+        return nullptr;
+    }
+    it->second_.lastUse_ = ++useCounter_;
+    it->second_.memory_ = CalculateMemoryInfo(scene);
+    return scene;
+}
+
+Scene* SceneCache::LoadScene(const String& resourceName)
+{
+    SharedPtr<Scene> scene(new Scene(context_));
+
+    // the binary cache references the same resources, so both paths profit
+    if (ResourcePreloader* preloader = GetSubsystem<ResourcePreloader>())
+        preloader->PreloadScene(resourceName);
+
+    String sourceFileName = GetSourceFileName(resourceName);
+    String binaryFileName = GetBinaryFileName(sourceFileName,resourceName);
+    if (IsBinaryValid(sourceFileName,binaryFileName)){
+        File file(context_,binaryFileName,FILE_READ);
+        if (scene->Load(file)){
+            URHO3D_LOGINFOF("[SceneCache] %s restored from binary cache",resourceName.CString());
+            return scene.Detach();
+        }
+        URHO3D_LOGWARNINGF("[SceneCache] binary cache of %s is broken. Falling back to xml",resourceName.CString());
+        scene = new Scene(context_);
+    }
+
+    if (!ResourceArchive::Read(context_,resourceName,[&scene](Deserializer& source){ return scene->LoadXML(source); })){
+        URHO3D_LOGERRORF("[SceneCache] could not load scene:%s",resourceName.CString());
+        return nullptr;
+    }
+
+    // written now, before the loader adds lights, cameras and batches to the scene
+    if (!sourceFileName.Empty()){
+        File binaryFile(context_,binaryFileName,FILE_WRITE);
+        if (!binaryFile.IsOpen() || !scene->Save(binaryFile)){
+            URHO3D_LOGWARNINGF("[SceneCache] could not write binary cache for %s",resourceName.CString());
+        }
+    }
+    return scene.Detach();
+}
+
+void SceneCache::SetMemoryBudget(unsigned long long budget)
+{
+    memoryBudget_ = budget;
+    EnforceBudget();
+}
+
+void SceneCache::UpdateMemoryInfo(const String& resourceName)
+{
+    auto it = entries_.Find(resourceName);
+    if (it != entries_.End()){
+        it->second_.memory_ = CalculateMemoryInfo(it->second_.scene_);
+    }
+}
+
+const SceneMemoryInfo* SceneCache::GetMemoryInfo(const String& resourceName) const
+{
+    auto it = entries_.Find(resourceName);
+    return it != entries_.End() ? &it->second_.memory_ : nullptr;
+}
+
+unsigned long long SceneCache::GetTotalMemoryUse() const
+{
+    unsigned long long total = 0;
+    HashSet<const Resource*> counted;
+    for (auto it = entries_.Begin(); it != entries_.End(); ++it){
+        const SceneMemoryInfo& memory = it->second_.memory_;
+        total += memory.nodeBytes_ + memory.componentBytes_;
+        for (auto res = memory.resources_.Begin(); res != memory.resources_.End(); ++res){
+            if (!counted.Contains(res->first_)){
+                counted.Insert(res->first_);
+                total += res->second_;
+            }
+        }
+    }
+    return total;
+}
+
+bool SceneCache::IsInUse(const Entry& entry) const
+{
+    // the entry holds one reference, every other one is a user like a ViewRenderer
+    if (entry.scene_->Refs() > 1)
+        return true;
+
+    // viewports only hold weak references to their scene
+    if (Renderer* renderer = GetSubsystem<Renderer>()){
+        for (unsigned i = 0; i < renderer->GetNumViewports(); ++i){
+            Viewport* viewport = renderer->GetViewport(i);
+            if (viewport && viewport->GetScene() == entry.scene_)
+                return true;
+        }
+    }
+    return false;
+}
+
+void SceneCache::EnforceBudget()
+{
+    if (memoryBudget_ == 0)
+        return;
+
+    bool evicted = false;
+    while (GetTotalMemoryUse() > memoryBudget_){
+        // find the least recently used scene that nobody else holds on to
+        Entry* candidate = nullptr;
+        for (auto it = entries_.Begin(); it != entries_.End(); ++it){
+            Entry& entry = it->second_;
+            if (IsInUse(entry))
+                continue;
+            if (!candidate || entry.lastUse_ < candidate->lastUse_)
+                candidate = &entry;
+        }
+        if (!candidate)
+            break;
+
+        Evict(*candidate);
+        evicted = true;
+    }
+
+    if (evicted){
+        // free the models, materials and textures only the evicted scenes used
+        GetSubsystem<ResourceCache>()->ReleaseAllResources(false);
+    }
+}
+
+void SceneCache::Evict(Entry& entry)
+{
+    // the binary cache was written when the scene was loaded from xml, nothing of the runtime
+    // state is saved. the batcher only has to let go of its batches
+    String resourceName = entry.resourceName_;
+    if (StaticBatcher* batcher = GetSubsystem<StaticBatcher>())
+        batcher->ClearScene(entry.scene_);
+
+    URHO3D_LOGINFOF("[SceneCache] evicting %s (~%.2fMB)",resourceName.CString(),entry.memory_.GetTotal()/(1024.0f*1024.0f));
+    entries_.Erase(resourceName);
+}
+
+String SceneCache::GetSourceFileName(const String& resourceName) const
+{
+    ResourceCache* cache = GetSubsystem<ResourceCache>();
+    String fileName = cache->GetResourceFileName(resourceName);
+    if (!fileName.Empty())
+        return fileName;
+
+    for (PackageFile* package : cache->GetPackageFiles()){
+        if (package->Exists(resourceName))
+            return package->GetName();
+    }
+    return String::EMPTY;
+}
+
+String SceneCache::GetBinaryFileName(const String& sourceFileName, const String& resourceName) const
+{
+    // the absolute source path keeps the scenes of different projects apart in the shared cache dir
+    unsigned long long hash = LoaderCache::Hash(resourceName,LoaderCache::Hash(sourceFileName));
+    return LoaderCache::GetDir(context_,"scenes")+LoaderCache::HashToString(hash)+".bin";
+}
+
+bool SceneCache::IsBinaryValid(const String& sourceFileName, const String& binaryFileName) const
+{
+    FileSystem* fs = GetSubsystem<FileSystem>();
+    if (sourceFileName.Empty() || !fs->FileExists(binaryFileName))
+        return false;
+
+    // the times are in seconds, a source saved in the second of the binary may be newer
+    return fs->GetLastModifiedTime(binaryFileName) > fs->GetLastModifiedTime(sourceFileName);
+}
+
+SceneMemoryInfo SceneCache::CalculateMemoryInfo(Scene* scene)
+{
+    SceneMemoryInfo info;
+    if (!scene)
+        return info;
+
+    ResourceCache* cache = scene->GetSubsystem<ResourceCache>();
+    HashSet<Resource*> resources;
+
+    PODVector<Node*> nodes;
+    scene->GetChildren(nodes,true);
+    nodes.Push(scene);
+
+    for (Node* node : nodes){
+        for (Component* component : node->GetComponents()){
+            info.numComponents_++;
+
+            const Vector<AttributeInfo>* attributes = component->GetAttributes();
+            if (!attributes)
+                continue;
+
+            for (unsigned i = 0; i < attributes->Size(); i++){
+                const AttributeInfo& attr = attributes->At(i);
+                if (attr.type_ == VAR_RESOURCEREF){
+                    ResourceRef ref = component->GetAttribute(i).GetResourceRef();
+                    if (Resource* res = cache->GetExistingResource(ref.type_,ref.name_))
+                        resources.Insert(res);
+                }
+                else if (attr.type_ == VAR_RESOURCEREFLIST){
+                    ResourceRefList refList = component->GetAttribute(i).GetResourceRefList();
+                    for (const String& name : refList.names_){
+                        if (Resource* res = cache->GetExistingResource(refList.type_,name))
+                            resources.Insert(res);
+                    }
+                }
+            }
+        }
+    }
+
+    // materials keep their textures alive as well
+    PODVector<Resource*> materialTextures;
+    for (Resource* res : resources){
+        if (auto* material = dynamic_cast<Material*>(res)){
+            const HashMap<TextureUnit, SharedPtr<Texture> >& textures = material->GetTextures();
+            for (auto it = textures.Begin(); it != textures.End(); ++it){
+                if (it->second_)
+                    materialTextures.Push(it->second_);
+            }
+        }
+    }
+    for (Resource* texture : materialTextures){
+        resources.Insert(texture);
+    }
+
+    for (Resource* res : resources){
+        info.resourceBytes_ += res->GetMemoryUse();
+        info.resources_[res] = res->GetMemoryUse();
+    }
+
+    info.numNodes_ = nodes.Size();
+    info.numResources_ = resources.Size();
+    info.nodeBytes_ = (unsigned long long)nodes.Size() * sizeof(Node);
+    info.componentBytes_ = (unsigned long long)info.numComponents_ * COMPONENT_BYTES_ESTIMATE;
+    return info;
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <Urho3D/Core/Object.h>
+#include <Urho3D/Container/HashMap.h>
+#include <Urho3D/Container/Ptr.h>
+#include <Urho3D/Container/Str.h>
+
+namespace Urho3D {
+    class Context;
+    class Resource;
+    class Scene;
+}
+
+using namespace Urho3D;
+
+/// Approximate memory a loaded scene keeps resident.
+struct SceneMemoryInfo{
+    unsigned numNodes_ = 0;
+    unsigned numComponents_ = 0;
+    unsigned numResources_ = 0;
+    unsigned long long nodeBytes_ = 0;
+    unsigned long long componentBytes_ = 0;
+    /// memory of models, materials and textures referenced by the scene's drawables
+    unsigned long long resourceBytes_ = 0;
+    /// the bytes per resource, so resources shared by scenes can be counted once. the keys
+    /// are only compared, never dereferenced
+    HashMap<const Resource*, unsigned long long> resources_;
+
+    unsigned long long GetTotal() const { return nodeBytes_ + componentBytes_ + resourceBytes_; }
+};
+
+/// Keeps the scenes requested by blender resident within a memory budget.
+/// Scenes that are not referenced by anyone else (e.g. a ViewRenderer) and not shown in a
+/// viewport of the Renderer are evicted least recently used first. Scenes loaded from xml are
+/// written to a binary cache right away, so that they can be re-loaded quickly once they are
+/// requested again.
+class SceneCache : public Object {
+    URHO3D_OBJECT(SceneCache, Object);
+public:
+    explicit SceneCache(Context* context);
+
+    /// Return the scene for the resource name (e.g. "Scenes/Scene.xml"), loading it if not resident.
+    Scene* GetScene(const String& resourceName);
+    /// Reload a resident scene from its xml-file. Returns null if the scene is not resident.
+    Scene* ReloadScene(const String& resourceName);
+    bool IsResident(const String& resourceName) const { return entries_.Contains(resourceName); }
+
+    /// Set the budget in bytes. 0 disables eviction.
+    void SetMemoryBudget(unsigned long long budget);
+    unsigned long long GetMemoryBudget() const { return memoryBudget_; }
+
+    /// Recalculate the memory info of a resident scene.
+    void UpdateMemoryInfo(const String& resourceName);
+    const SceneMemoryInfo* GetMemoryInfo(const String& resourceName) const;
+    /// Memory of all resident scenes, resources they share are counted once.
+    unsigned long long GetTotalMemoryUse() const;
+
+    /// Evict unreferenced scenes until the resident scenes fit into the budget.
+    void EnforceBudget();
+
+    static SceneMemoryInfo CalculateMemoryInfo(Scene* scene);
+
+private:
+    struct Entry{
+        String resourceName_;
+        SharedPtr<Scene> scene_;
+        unsigned lastUse_;
+        SceneMemoryInfo memory_;
+    };
+
+    Scene* LoadScene(const String& resourceName);
+    bool IsInUse(const Entry& entry) const;
+    void Evict(Entry& entry);
+    /// The xml-file of the scene, or the package that contains it. Empty if neither is known.
+    String GetSourceFileName(const String& resourceName) const;
+    String GetBinaryFileName(const String& sourceFileName, const String& resourceName) const;
+    bool IsBinaryValid(const String& sourceFileName, const String& binaryFileName) const;
+
+    HashMap<StringHash, Entry> entries_;
+    unsigned long long memoryBudget_;
+    unsigned useCounter_;
+};
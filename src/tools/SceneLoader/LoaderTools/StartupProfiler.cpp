@@ -0,0 +1,481 @@
+#include "StartupProfiler.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <new>
+
+#include <Urho3D/Container/HashSet.h>
+#include <Urho3D/Core/Context.h>
+#include <Urho3D/Core/CoreEvents.h>
+#include <Urho3D/Engine/Engine.h>
+#include <Urho3D/IO/Log.h>
+#include <Urho3D/Resource/JSONFile.h>
+#include <Urho3D/Resource/ResourceCache.h>
+
+#ifdef _WIN32
+#include <malloc.h>
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+// taken during static initialization, which is as close to process start as we get.
+// HiresTimer can't be used this early, it is only calibrated once the Time subsystem exists
+static const std::chrono::steady_clock::time_point processStart = std::chrono::steady_clock::now();
+
+#ifdef URHO3D_STARTUP_PROFILER
+static std::atomic<bool> countAllocations(false);
+static std::atomic<unsigned long long> allocationCount(0);
+
+// only built with URHO3D_STARTUP_PROFILER, every allocation of the process goes through these.
+// the replacements only count, the memory still comes from malloc. Every replaceable form is
+// replaced, a form left out would allocate from the runtime's heap and free into ours
+static void* CountedMalloc(std::size_t size)
+{
+    if (countAllocations.load(std::memory_order_relaxed))
+        allocationCount.fetch_add(1,std::memory_order_relaxed);
+    return std::malloc(size ? size : 1);
+}
+
+void* operator new(std::size_t size)
+{
+    void* ptr = CountedMalloc(size);
+    if (!ptr)
+        throw std::bad_alloc();
+    return ptr;
+}
+
+void* operator new[](std::size_t size)
+{
+    return operator new(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+    return CountedMalloc(size);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept
+{
+    return CountedMalloc(size);
+}
+
+void operator delete(void* ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr, std::size_t) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, const std::nothrow_t&) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept
+{
+    std::free(ptr);
+}
+
+#ifdef __cpp_aligned_new
+// over-aligned types, memory that free() can't release on windows
+static void* CountedAlignedMalloc(std::size_t size, std::align_val_t alignment)
+{
+    if (countAllocations.load(std::memory_order_relaxed))
+        allocationCount.fetch_add(1,std::memory_order_relaxed);
+    std::size_t align = (std::size_t)alignment;
+#ifdef _WIN32
+    return _aligned_malloc(size ? size : 1,align);
+#else
+    void* ptr = nullptr;
+    if (posix_memalign(&ptr,align < sizeof(void*) ? sizeof(void*) : align,size ? size : 1) != 0)
+        return nullptr;
+    return ptr;
+#endif
+}
+
+static void AlignedFree(void* ptr)
+{
+#ifdef _WIN32
+    _aligned_free(ptr);
+#else
+    std::free(ptr);
+#endif
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment)
+{
+    void* ptr = CountedAlignedMalloc(size,alignment);
+    if (!ptr)
+        throw std::bad_alloc();
+    return ptr;
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment)
+{
+    return operator new(size,alignment);
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+    return CountedAlignedMalloc(size,alignment);
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+    return CountedAlignedMalloc(size,alignment);
+}
+
+void operator delete(void* ptr, std::align_val_t) noexcept
+{
+    AlignedFree(ptr);
+}
+
+void operator delete[](void* ptr, std::align_val_t) noexcept
+{
+    AlignedFree(ptr);
+}
+
+void operator delete(void* ptr, std::size_t, std::align_val_t) noexcept
+{
+    AlignedFree(ptr);
+}
+
+void operator delete[](void* ptr, std::size_t, std::align_val_t) noexcept
+{
+    AlignedFree(ptr);
+}
+
+void operator delete(void* ptr, std::align_val_t, const std::nothrow_t&) noexcept
+{
+    AlignedFree(ptr);
+}
+
+void operator delete[](void* ptr, std::align_val_t, const std::nothrow_t&) noexcept
+{
+    AlignedFree(ptr);
+}
+#endif
+#endif
+
+/// Cpu time of the whole process (all threads) in milliseconds.
+static double GetCpuTime()
+{
+#ifdef _WIN32
+    FILETIME creationTime, exitTime, kernelTime, userTime;
+    if (!GetProcessTimes(GetCurrentProcess(),&creationTime,&exitTime,&kernelTime,&userTime))
+        return 0.0;
+    unsigned long long kernel = ((unsigned long long)kernelTime.dwHighDateTime << 32) | kernelTime.dwLowDateTime;
+    unsigned long long user = ((unsigned long long)userTime.dwHighDateTime << 32) | userTime.dwLowDateTime;
+    // 100ns ticks
+    return (kernel + user) / 10000.0;
+#else
+    timespec time;
+    if (clock_gettime(CLOCK_PROCESS_CPUTIME_ID,&time) != 0)
+        return 0.0;
+    return time.tv_sec * 1000.0 + time.tv_nsec / 1000000.0;
+#endif
+}
+
+StartupProfiler::StartupProfiler(Context* context)
+    : Object(context),
+      enabled_(false),
+      phaseOpen_(false)
+{
+}
+
+void StartupProfiler::SetEnabled(bool enable, const String& reportFileName)
+{
+    enabled_ = enable;
+    reportFileName_ = reportFileName;
+#ifdef URHO3D_STARTUP_PROFILER
+    countAllocations.store(enable);
+#endif
+    if (enable){
+        SubscribeToEvent(E_ENDFRAME,URHO3D_HANDLER(StartupProfiler,HandleEndFrame));
+    } else {
+        UnsubscribeFromEvent(E_ENDFRAME);
+    }
+}
+
+void StartupProfiler::BeginPhase(const String& name)
+{
+    if (!enabled_)
+        return;
+
+    EndPhase();
+
+    Phase phase;
+    phase.name_ = name;
+    TakeResourceSnapshot(phase.resourcesBegin_);
+    phase.allocationsBegin_ = GetAllocationCount();
+    phase.cpuBegin_ = GetCpuTime();
+    phase.begin_ = GetTime();
+    phases_.Push(phase);
+    phaseOpen_ = true;
+}
+
+void StartupProfiler::EndPhase()
+{
+    if (!enabled_ || !phaseOpen_)
+        return;
+
+    Phase& phase = phases_.Back();
+    phase.end_ = GetTime();
+    phase.cpuEnd_ = GetCpuTime();
+    phase.allocationsEnd_ = GetAllocationCount();
+    TakeResourceSnapshot(phase.resourcesEnd_);
+    phaseOpen_ = false;
+}
+
+void StartupProfiler::BeginTask(const String& name)
+{
+    if (!enabled_)
+        return;
+
+    Task task;
+    task.name_ = name;
+    task.begin_ = GetTime();
+    tasks_.Push(task);
+}
+
+void StartupProfiler::EndTask(const String& name)
+{
+    if (!enabled_)
+        return;
+
+    for (Task& task : tasks_){
+        if (task.name_ == name && task.end_ < 0){
+            task.end_ = GetTime();
+            return;
+        }
+    }
+}
+
+bool StartupProfiler::HasOpenTasks() const
+{
+    for (const Task& task : tasks_){
+        if (task.end_ < 0)
+            return true;
+    }
+    return false;
+}
+
+void StartupProfiler::AddResourceLoad(StringHash type, const String& name, long long begin, long long end, unsigned thread)
+{
+    if (!enabled_)
+        return;
+
+    ResourceLoad load;
+    load.type_ = type;
+    load.name_ = name;
+    load.begin_ = begin;
+    load.end_ = end;
+    load.thread_ = thread;
+    resourceLoads_.Push(load);
+}
+
+long long StartupProfiler::GetTime()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - processStart).count();
+}
+
+unsigned long long StartupProfiler::GetAllocationCount()
+{
+#ifdef URHO3D_STARTUP_PROFILER
+    return allocationCount.load(std::memory_order_relaxed);
+#else
+    return 0;
+#endif
+}
+
+void StartupProfiler::TakeResourceSnapshot(HashMap<StringHash, ResourceStats>& dest)
+{
+    ResourceCache* cache = GetSubsystem<ResourceCache>();
+    if (!cache)
+        return;
+
+    const HashMap<StringHash, ResourceGroup>& groups = cache->GetAllResources();
+    for (auto it = groups.Begin(); it != groups.End(); ++it){
+        ResourceStats& stats = dest[it->first_];
+        stats.count_ = it->second_.resources_.Size();
+        stats.memory_ = it->second_.memoryUse_;
+    }
+}
+
+bool StartupProfiler::WriteReport(const String& fileName)
+{
+    EndPhase();
+
+    JSONArray events;
+    JSONObject summary;
+
+    JSONValue processName;
+    processName["name"] = "process_name";
+    processName["ph"] = "M";
+    processName["pid"] = 1;
+    processName["args"]["name"] = "SceneLoader startup";
+    events.Push(processName);
+
+    for (const Phase& phase : phases_){
+        JSONValue args;
+        args["cpuMs"] = phase.cpuEnd_ - phase.cpuBegin_;
+#ifdef URHO3D_STARTUP_PROFILER
+        args["allocations"] = (double)(phase.allocationsEnd_ - phase.allocationsBegin_);
+#endif
+
+        // resources that got loaded during the phase
+        JSONValue resources;
+        for (auto it = phase.resourcesEnd_.Begin(); it != phase.resourcesEnd_.End(); ++it){
+            auto before = phase.resourcesBegin_.Find(it->first_);
+            unsigned countBefore = before != phase.resourcesBegin_.End() ? before->second_.count_ : 0;
+            unsigned long long memoryBefore = before != phase.resourcesBegin_.End() ? before->second_.memory_ : 0;
+            if (it->second_.count_ <= countBefore)
+                continue;
+
+            JSONValue stats;
+            stats["count"] = it->second_.count_ - countBefore;
+            stats["memoryKB"] = (double)(it->second_.memory_ - memoryBefore) / 1024.0;
+            resources[context_->GetTypeName(it->first_)] = stats;
+        }
+        args["resources"] = resources;
+
+        JSONValue event;
+        event["name"] = phase.name_;
+        event["cat"] = "phase";
+        event["ph"] = "X";
+        event["pid"] = 1;
+        event["tid"] = 0;
+        event["ts"] = (double)phase.begin_;
+        event["dur"] = (double)(phase.end_ - phase.begin_);
+        event["args"] = args;
+        events.Push(event);
+
+        JSONValue phaseSummary;
+        phaseSummary["wallMs"] = (phase.end_ - phase.begin_) / 1000.0;
+        phaseSummary["cpuMs"] = phase.cpuEnd_ - phase.cpuBegin_;
+#ifdef URHO3D_STARTUP_PROFILER
+        phaseSummary["allocations"] = (double)(phase.allocationsEnd_ - phase.allocationsBegin_);
+#endif
+        summary[phase.name_] = phaseSummary;
+    }
+
+    // individual resource loads, one track per thread, plus the totals per type
+    struct TypeTotal{
+        unsigned count_ = 0;
+        long long time_ = 0;
+    };
+    HashMap<StringHash, TypeTotal> loadsByType;
+    HashSet<unsigned> threads;
+    for (const ResourceLoad& load : resourceLoads_){
+        JSONValue event;
+        event["name"] = load.name_;
+        event["cat"] = context_->GetTypeName(load.type_);
+        event["ph"] = "X";
+        event["pid"] = 1;
+        event["tid"] = load.thread_;
+        event["ts"] = (double)load.begin_;
+        event["dur"] = (double)(load.end_ - load.begin_);
+        events.Push(event);
+
+        TypeTotal& total = loadsByType[load.type_];
+        total.count_++;
+        total.time_ += load.end_ - load.begin_;
+        threads.Insert(load.thread_);
+    }
+    for (auto it = threads.Begin(); it != threads.End(); ++it){
+        JSONValue threadName;
+        threadName["name"] = "thread_name";
+        threadName["ph"] = "M";
+        threadName["pid"] = 1;
+        threadName["tid"] = *it;
+        threadName["args"]["name"] = *it == 0 ? String("main") : "worker " + String(*it);
+        events.Push(threadName);
+    }
+
+    // background tasks on a track after the workers
+    unsigned taskThread = 0;
+    for (auto it = threads.Begin(); it != threads.End(); ++it)
+        taskThread = Max(taskThread,*it + 1);
+    long long end = phases_.Empty() ? 0 : phases_.Back().end_;
+    JSONObject taskSummary;
+    for (const Task& task : tasks_){
+        long long taskEnd = task.end_ < 0 ? GetTime() : task.end_;
+        JSONValue event;
+        event["name"] = task.name_;
+        event["cat"] = "task";
+        event["ph"] = "X";
+        event["pid"] = 1;
+        event["tid"] = taskThread;
+        event["ts"] = (double)task.begin_;
+        event["dur"] = (double)(taskEnd - task.begin_);
+        events.Push(event);
+
+        JSONValue stats;
+        stats["wallMs"] = (taskEnd - task.begin_) / 1000.0;
+        taskSummary[task.name_] = stats;
+        end = Max(end,taskEnd);
+    }
+    if (!tasks_.Empty()){
+        JSONValue threadName;
+        threadName["name"] = "thread_name";
+        threadName["ph"] = "M";
+        threadName["pid"] = 1;
+        threadName["tid"] = taskThread;
+        threadName["args"]["name"] = "tasks";
+        events.Push(threadName);
+    }
+
+    JSONObject resourceSummary;
+    for (auto it = loadsByType.Begin(); it != loadsByType.End(); ++it){
+        JSONValue stats;
+        stats["count"] = it->second_.count_;
+        stats["loadMs"] = it->second_.time_ / 1000.0;
+        resourceSummary[context_->GetTypeName(it->first_)] = stats;
+    }
+
+    JSONValue otherData;
+    otherData["totalMs"] = end / 1000.0;
+    otherData["phases"] = summary;
+    otherData["tasks"] = taskSummary;
+    otherData["resourceLoads"] = resourceSummary;
+
+    JSONFile json(context_);
+    JSONValue& root = json.GetRoot();
+    root["traceEvents"] = events;
+    root["displayTimeUnit"] = "ms";
+    root["otherData"] = otherData;
+    if (!json.SaveFile(fileName)){
+        URHO3D_LOGERRORF("[StartupProfiler] could not write %s",fileName.CString());
+        return false;
+    }
+
+    URHO3D_LOGINFOF("[StartupProfiler] startup took %.2fms, report written to %s",end / 1000.0,fileName.CString());
+    return true;
+}
+
+void StartupProfiler::HandleEndFrame(StringHash eventType, VariantMap& eventData)
+{
+    // the first frame ends the last phase, the report waits for the tasks still running
+    EndPhase();
+    if (HasOpenTasks())
+        return;
+
+    WriteReport(reportFileName_);
+    SetEnabled(false,reportFileName_);
+    GetSubsystem<Engine>()->Exit();
+}
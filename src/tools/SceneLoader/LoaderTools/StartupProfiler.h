@@ -0,0 +1,90 @@
+#pragma once
+
+#include <Urho3D/Core/Object.h>
+#include <Urho3D/Container/HashMap.h>
+#include <Urho3D/Container/Str.h>
+#include <Urho3D/Container/Vector.h>
+
+namespace Urho3D {
+    class Context;
+}
+
+using namespace Urho3D;
+
+/// Breaks the startup of the loader down into phases. Each phase records wall-clock and cpu
+/// time, the number of heap allocations (only in builds with URHO3D_STARTUP_PROFILER) and the
+/// resources that got loaded during it, grouped by type. Resource loads on the worker threads
+/// and background tasks show up as separate tracks. Once the first frame is rendered and every
+/// task ended, the report is written as chrome-trace json (chrome://tracing, perfetto) and the
+/// application exits.
+class StartupProfiler : public Object {
+    URHO3D_OBJECT(StartupProfiler, Object);
+public:
+    explicit StartupProfiler(Context* context);
+
+    /// Start recording. Allocations are only counted while enabled.
+    void SetEnabled(bool enable, const String& reportFileName);
+    bool IsEnabled() const { return enabled_; }
+
+    /// Start a new phase, ending the current one.
+    void BeginPhase(const String& name);
+    void EndPhase();
+
+    /// Start work that runs next to the phases, e.g. on a worker. The report waits for EndTask().
+    void BeginTask(const String& name);
+    void EndTask(const String& name);
+
+    /// Record the load of a single resource. Times are from GetTime(), thread 0 is the main thread.
+    void AddResourceLoad(StringHash type, const String& name, long long begin, long long end, unsigned thread);
+
+    /// Microseconds since process start. Can be called from any thread.
+    static long long GetTime();
+    /// Number of heap allocations while enabled, 0 without URHO3D_STARTUP_PROFILER.
+    static unsigned long long GetAllocationCount();
+
+    bool WriteReport(const String& fileName);
+
+private:
+    struct ResourceStats{
+        unsigned count_ = 0;
+        unsigned long long memory_ = 0;
+    };
+
+    struct Phase{
+        String name_;
+        long long begin_ = 0;
+        long long end_ = 0;
+        double cpuBegin_ = 0.0;
+        double cpuEnd_ = 0.0;
+        unsigned long long allocationsBegin_ = 0;
+        unsigned long long allocationsEnd_ = 0;
+        HashMap<StringHash, ResourceStats> resourcesBegin_;
+        HashMap<StringHash, ResourceStats> resourcesEnd_;
+    };
+
+    struct Task{
+        String name_;
+        long long begin_ = 0;
+        /// -1 while running
+        long long end_ = -1;
+    };
+
+    struct ResourceLoad{
+        StringHash type_;
+        String name_;
+        long long begin_;
+        long long end_;
+        unsigned thread_;
+    };
+
+    bool HasOpenTasks() const;
+    void TakeResourceSnapshot(HashMap<StringHash, ResourceStats>& dest);
+    void HandleEndFrame(StringHash eventType, VariantMap& eventData);
+
+    bool enabled_;
+    String reportFileName_;
+    Vector<Phase> phases_;
+    bool phaseOpen_;
+    Vector<Task> tasks_;
+    Vector<ResourceLoad> resourceLoads_;
+};
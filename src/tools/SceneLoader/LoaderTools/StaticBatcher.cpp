@@ -0,0 +1,579 @@
+#include "StaticBatcher.h"
+#include "LoaderCache.h"
+
+#include <Urho3D/Core/Context.h>
+#include <Urho3D/Core/CoreEvents.h>
+#include <Urho3D/Core/Timer.h>
+#include <Urho3D/Graphics/AnimatedModel.h>
+#include <Urho3D/Graphics/AnimationController.h>
+#include <Urho3D/Graphics/Geometry.h>
+#include <Urho3D/Graphics/IndexBuffer.h>
+#include <Urho3D/Graphics/Material.h>
+#include <Urho3D/Graphics/Model.h>
+#include <Urho3D/Graphics/Renderer.h>
+#include <Urho3D/Graphics/VertexBuffer.h>
+#include <Urho3D/IO/Log.h>
+#include <Urho3D/Physics/CollisionShape.h>
+#include <Urho3D/Physics/RigidBody.h>
+#include <Urho3D/Scene/LogicComponent.h>
+#include <Urho3D/Scene/Node.h>
+#include <Urho3D/Scene/Scene.h>
+#include <Urho3D/Scene/SceneEvents.h>
+
+static const char* BATCH_ROOT_NAME = "__staticBatches";
+
+StaticBatchModel::StaticBatchModel(Context* context)
+    : StaticModel(context)
+{
+}
+
+void StaticBatchModel::OnMarkedDirty(Node* node)
+{
+    if (node == node_){
+        StaticModel::OnMarkedDirty(node);
+        return;
+    }
+    // one of the merged nodes moved. the batch can't follow, give the node back
+    if (StaticBatcher* batcher = GetSubsystem<StaticBatcher>())
+        batcher->QueueUnmerge(node);
+}
+
+bool StaticBatcher::BatchKey::operator ==(const BatchKey& rhs) const
+{
+    return material_ == rhs.material_ && elementMask_ == rhs.elementMask_ && vertexSize_ == rhs.vertexSize_ &&
+            cell_ == rhs.cell_ && castShadows_ == rhs.castShadows_ && viewMask_ == rhs.viewMask_ &&
+            lightMask_ == rhs.lightMask_ && zoneMask_ == rhs.zoneMask_ && drawDistance_ == rhs.drawDistance_;
+}
+
+unsigned StaticBatcher::BatchKey::ToHash() const
+{
+    unsigned long long hash = LoaderCache::Hash(&material_,sizeof(material_));
+    hash = LoaderCache::Hash(&elementMask_,sizeof(elementMask_),hash);
+    hash = LoaderCache::Hash(&cell_,sizeof(cell_),hash);
+    hash = LoaderCache::Hash(&viewMask_,sizeof(viewMask_),hash);
+    return (unsigned)(hash ^ (hash >> 32)) + (castShadows_ ? 1 : 0);
+}
+
+StaticBatcher::StaticBatcher(Context* context)
+    : Object(context)
+{
+    SubscribeToEvent(E_UPDATE, URHO3D_HANDLER(StaticBatcher, HandleUpdate));
+}
+
+// identifies the vertex layout of a buffer, elements with the same layout can be merged
+static unsigned GetElementHash(VertexBuffer* buffer)
+{
+    unsigned long long hash = LoaderCache::HASH_SEED;
+    for (const VertexElement& element : buffer->GetElements()){
+        unsigned values[3] = { (unsigned)element.type_, (unsigned)element.semantic_, (unsigned)element.index_ };
+        hash = LoaderCache::Hash(values,sizeof(values),hash);
+    }
+    return (unsigned)(hash ^ (hash >> 32));
+}
+
+static bool IsBatchableGeometry(Geometry* geometry)
+{
+    if (!geometry || geometry->GetPrimitiveType() != TRIANGLE_LIST || geometry->GetNumVertexBuffers() != 1)
+        return false;
+
+    VertexBuffer* vertexBuffer = geometry->GetVertexBuffer(0);
+    IndexBuffer* indexBuffer = geometry->GetIndexBuffer();
+    if (!vertexBuffer || !indexBuffer || !vertexBuffer->GetShadowData() || !indexBuffer->GetShadowData())
+        return false;
+
+    // positions, normals and tangents get transformed, so they need a known format
+    const VertexElement* position = vertexBuffer->GetElement(SEM_POSITION);
+    const VertexElement* normal = vertexBuffer->GetElement(SEM_NORMAL);
+    const VertexElement* tangent = vertexBuffer->GetElement(SEM_TANGENT);
+    if (!position || position->type_ != TYPE_VECTOR3)
+        return false;
+    if (normal && normal->type_ != TYPE_VECTOR3)
+        return false;
+    if (tangent && tangent->type_ != TYPE_VECTOR4)
+        return false;
+    return geometry->GetIndexCount() > 0;
+}
+
+static float Determinant(const Matrix3& m)
+{
+    return m.m00_ * (m.m11_ * m.m22_ - m.m12_ * m.m21_) -
+           m.m01_ * (m.m10_ * m.m22_ - m.m12_ * m.m20_) +
+           m.m02_ * (m.m10_ * m.m21_ - m.m11_ * m.m20_);
+}
+
+bool StaticBatcher::IsStatic(Node* node) const
+{
+    Scene* scene = node->GetScene();
+    for (Node* current = node; current && current != scene; current = current->GetParent()){
+        if (current->HasTag("dynamic"))
+            return false;
+
+        for (Component* component : current->GetComponents()){
+            if (component->IsInstanceOf<LogicComponent>() || component->IsInstanceOf<AnimatedModel>() ||
+                    component->IsInstanceOf<AnimationController>())
+                return false;
+
+            if (auto* body = dynamic_cast<RigidBody*>(component)){
+                if (body->GetMass() > 0.0f || body->IsKinematic())
+                    return false;
+            }
+        }
+    }
+    return true;
+}
+
+bool StaticBatcher::IsEligible(StaticModel* staticModel) const
+{
+    // exact type only, derived drawables do their own thing
+    if (staticModel->GetType() != StaticModel::GetTypeStatic() || !staticModel->IsEnabledEffective() || staticModel->IsTemporary())
+        return false;
+
+    Model* model = staticModel->GetModel();
+    if (!model || !model->GetNumGeometries())
+        return false;
+
+    // apart from collision the node must not carry anything that might move or change it
+    Node* node = staticModel->GetNode();
+    for (Component* component : node->GetComponents()){
+        if (component != staticModel && !component->IsInstanceOf<CollisionShape>() && !component->IsInstanceOf<RigidBody>())
+            return false;
+    }
+
+    // all geometries have to go into batches, otherwise the model can't be disabled.
+    // models with lod levels keep their own drawable
+    for (unsigned i = 0; i < model->GetNumGeometries(); i++){
+        if (model->GetNumGeometryLodLevels(i) != 1 || !IsBatchableGeometry(model->GetGeometry(i,0)))
+            return false;
+    }
+
+    return IsStatic(node);
+}
+
+StaticBatchStats StaticBatcher::BatchScene(Scene* scene, float cellSize)
+{
+    StaticBatchStats stats;
+    if (!scene)
+        return stats;
+
+    HiresTimer timer;
+    ClearScene(scene);
+
+    cellSize = Max(cellSize, 1.0f);
+
+    SceneBatches& sceneBatches = scenes_[scene];
+    sceneBatches.scene_ = scene;
+    sceneBatches.cellSize_ = cellSize;
+
+    PODVector<StaticModel*> staticModels;
+    scene->GetComponents<StaticModel>(staticModels,true);
+
+    HashMap<BatchKey, SharedPtr<Batch> > batches;
+    for (StaticModel* staticModel : staticModels){
+        if (!IsEligible(staticModel))
+            continue;
+
+        Node* node = staticModel->GetNode();
+        Vector3 center = staticModel->GetWorldBoundingBox().Center();
+        IntVector3 cell(FloorToInt(center.x_ / cellSize), FloorToInt(center.y_ / cellSize), FloorToInt(center.z_ / cellSize));
+
+        Model* model = staticModel->GetModel();
+        for (unsigned i = 0; i < model->GetNumGeometries(); i++){
+            VertexBuffer* vertexBuffer = model->GetGeometry(i,0)->GetVertexBuffer(0);
+
+            BatchKey key;
+            key.material_ = staticModel->GetMaterial(i);
+            key.elementMask_ = GetElementHash(vertexBuffer);
+            key.vertexSize_ = vertexBuffer->GetVertexSize();
+            key.cell_ = cell;
+            key.castShadows_ = staticModel->GetCastShadows();
+            key.viewMask_ = staticModel->GetViewMask();
+            key.lightMask_ = staticModel->GetLightMask();
+            key.zoneMask_ = staticModel->GetZoneMask();
+            key.drawDistance_ = staticModel->GetDrawDistance();
+
+            SharedPtr<Batch>& batch = batches[key];
+            if (!batch){
+                batch = new Batch();
+                batch->key_ = key;
+                batch->material_ = key.material_;
+            }
+
+            BatchSource source;
+            source.model_ = staticModel;
+            source.node_ = node;
+            source.geometry_ = i;
+            batch->sources_.Push(source);
+
+            PODVector<Batch*>& nodeBatches = sceneBatches.nodeBatches_[node];
+            if (!nodeBatches.Contains(batch.Get()))
+                nodeBatches.Push(batch);
+            stats.numSourceGeometries_++;
+        }
+        stats.numNodes_++;
+    }
+
+    if (batches.Empty()){
+        scenes_.Erase(scene);
+        return stats;
+    }
+
+    sceneBatches.root_ = scene->CreateChild(BATCH_ROOT_NAME,LOCAL);
+    sceneBatches.root_->SetTemporary(true);
+
+    for (auto it = batches.Begin(); it != batches.End(); ++it){
+        Batch* batch = it->second_;
+        batch->node_ = sceneBatches.root_->CreateChild("batch",LOCAL);
+
+        auto* drawable = new StaticBatchModel(context_);
+        batch->node_->AddComponent(drawable,0,LOCAL);
+        drawable->SetTemporary(true);
+        batch->drawable_ = drawable;
+
+        if (!BuildBatch(batch)){
+            batch->node_->Remove();
+            continue;
+        }
+        sceneBatches.batches_.Push(SharedPtr<Batch>(batch));
+    }
+
+    // forget batches that came out empty, they die with the local map
+    for (auto it = sceneBatches.nodeBatches_.Begin(); it != sceneBatches.nodeBatches_.End(); ++it){
+        PODVector<Batch*>& nodeBatches = it->second_;
+        for (unsigned i = nodeBatches.Size() - 1; i < nodeBatches.Size(); i--){
+            if (!sceneBatches.batches_.Contains(SharedPtr<Batch>(nodeBatches[i])))
+                nodeBatches.Erase(i);
+        }
+    }
+
+    // disable the originals only after all batches exist, they are still needed for the merge
+    for (auto it = sceneBatches.nodeBatches_.Begin(); it != sceneBatches.nodeBatches_.End(); ++it){
+        Node* node = it->first_;
+        for (Batch* batch : it->second_){
+            for (const BatchSource& source : batch->sources_){
+                if (source.node_ == node && source.model_)
+                    source.model_->SetEnabled(false);
+            }
+            // get notified when the node is moved
+            node->AddListener(batch->drawable_);
+        }
+    }
+
+    SubscribeToEvent(scene, E_NODEREMOVED, URHO3D_HANDLER(StaticBatcher, HandleNodeRemoved));
+    SubscribeToEvent(scene, E_COMPONENTREMOVED, URHO3D_HANDLER(StaticBatcher, HandleComponentRemoved));
+
+    stats.numBatches_ = sceneBatches.batches_.Size();
+    URHO3D_LOGINFOF("[StaticBatcher] merged %u nodes: %u draw calls -> %u batches (cell size %.1f) in %.2fms",
+                    stats.numNodes_,stats.numSourceGeometries_,stats.numBatches_,cellSize,timer.GetUSec(false)/1000.0f);
+    return stats;
+}
+
+bool StaticBatcher::BuildBatch(Batch* batch)
+{
+    // count what's left to merge
+    unsigned numVertices = 0;
+    unsigned numIndices = 0;
+    unsigned vertexSize = batch->key_.vertexSize_;
+    PODVector<VertexElement> elements;
+
+    for (const BatchSource& source : batch->sources_){
+        if (!source.model_ || !source.node_)
+            continue;
+        Geometry* geometry = source.model_->GetModel()->GetGeometry(source.geometry_,0);
+        if (elements.Empty())
+            elements = geometry->GetVertexBuffer(0)->GetElements();
+
+        // the referenced vertex range is taken from the indices, not every exporter fills in the vertex range
+        IndexBuffer* indexBuffer = geometry->GetIndexBuffer();
+        const unsigned char* indexData = indexBuffer->GetShadowData();
+        unsigned indexSize = indexBuffer->GetIndexSize();
+        unsigned minVertex = M_MAX_UNSIGNED;
+        unsigned maxVertex = 0;
+        for (unsigned i = geometry->GetIndexStart(); i < geometry->GetIndexStart() + geometry->GetIndexCount(); i++){
+            unsigned index = indexSize == sizeof(unsigned) ? ((const unsigned*)indexData)[i] : ((const unsigned short*)indexData)[i];
+            minVertex = Min(minVertex,index);
+            maxVertex = Max(maxVertex,index);
+        }
+        numVertices += maxVertex - minVertex + 1;
+        numIndices += geometry->GetIndexCount();
+    }
+
+    if (!numVertices || !numIndices)
+        return false;
+
+    bool largeIndices = numVertices > 0xffff;
+
+    PODVector<unsigned char> vertexData(numVertices * vertexSize);
+    PODVector<unsigned char> indexData(numIndices * (largeIndices ? sizeof(unsigned) : sizeof(unsigned short)));
+    BoundingBox boundingBox;
+
+    unsigned vertexOffset = 0;
+    unsigned indexOffset = 0;
+    for (const BatchSource& source : batch->sources_){
+        if (!source.model_ || !source.node_)
+            continue;
+
+        Geometry* geometry = source.model_->GetModel()->GetGeometry(source.geometry_,0);
+        VertexBuffer* srcVertexBuffer = geometry->GetVertexBuffer(0);
+        IndexBuffer* srcIndexBuffer = geometry->GetIndexBuffer();
+        const unsigned char* srcIndexData = srcIndexBuffer->GetShadowData();
+        unsigned srcIndexSize = srcIndexBuffer->GetIndexSize();
+        unsigned indexStart = geometry->GetIndexStart();
+        unsigned indexCount = geometry->GetIndexCount();
+
+        auto srcIndex = [&](unsigned i) -> unsigned {
+            return srcIndexSize == sizeof(unsigned) ? ((const unsigned*)srcIndexData)[i] : ((const unsigned short*)srcIndexData)[i];
+        };
+
+        unsigned minVertex = M_MAX_UNSIGNED;
+        unsigned maxVertex = 0;
+        for (unsigned i = indexStart; i < indexStart + indexCount; i++){
+            minVertex = Min(minVertex,srcIndex(i));
+            maxVertex = Max(maxVertex,srcIndex(i));
+        }
+        unsigned sourceVertices = maxVertex - minVertex + 1;
+
+        // copy the vertices and move positions, normals and tangents into world space
+        unsigned char* dest = &vertexData[vertexOffset * vertexSize];
+        memcpy(dest, srcVertexBuffer->GetShadowData() + minVertex * vertexSize, sourceVertices * vertexSize);
+
+        const Matrix3x4& transform = source.node_->GetWorldTransform();
+        Matrix3 rotationScale = transform.ToMatrix3();
+        Matrix3 normalMatrix = rotationScale.Inverse().Transpose();
+        bool flipWinding = Determinant(rotationScale) < 0.0f;
+
+        const VertexElement* position = srcVertexBuffer->GetElement(SEM_POSITION);
+        const VertexElement* normal = srcVertexBuffer->GetElement(SEM_NORMAL);
+        const VertexElement* tangent = srcVertexBuffer->GetElement(SEM_TANGENT);
+
+        for (unsigned v = 0; v < sourceVertices; v++){
+            unsigned char* vertex = dest + v * vertexSize;
+
+            Vector3& pos = *reinterpret_cast<Vector3*>(vertex + position->offset_);
+            pos = transform * pos;
+            boundingBox.Merge(pos);
+
+            if (normal){
+                Vector3& nrm = *reinterpret_cast<Vector3*>(vertex + normal->offset_);
+                nrm = (normalMatrix * nrm).Normalized();
+            }
+            if (tangent){
+                Vector4& tan = *reinterpret_cast<Vector4*>(vertex + tangent->offset_);
+                Vector3 tan3 = (rotationScale * Vector3(tan.x_, tan.y_, tan.z_)).Normalized();
+                tan = Vector4(tan3, flipWinding ? -tan.w_ : tan.w_);
+            }
+        }
+
+        // rebase the indices. mirrored nodes get their triangles flipped to keep the front faces
+        for (unsigned i = 0; i < indexCount; i += 3){
+            unsigned tri[3] = { srcIndex(indexStart + i), srcIndex(indexStart + i + 1), srcIndex(indexStart + i + 2) };
+            if (flipWinding)
+                Swap(tri[1], tri[2]);
+            for (unsigned j = 0; j < 3; j++){
+                unsigned index = tri[j] - minVertex + vertexOffset;
+                if (largeIndices)
+                    ((unsigned*)indexData.Buffer())[indexOffset + i + j] = index;
+                else
+                    ((unsigned short*)indexData.Buffer())[indexOffset + i + j] = (unsigned short)index;
+            }
+        }
+
+        vertexOffset += sourceVertices;
+        indexOffset += indexCount;
+    }
+
+    SharedPtr<VertexBuffer> vertexBuffer(new VertexBuffer(context_));
+    vertexBuffer->SetShadowed(true);
+    vertexBuffer->SetSize(numVertices, elements);
+    vertexBuffer->SetData(vertexData.Buffer());
+
+    SharedPtr<IndexBuffer> indexBuffer(new IndexBuffer(context_));
+    indexBuffer->SetShadowed(true);
+    indexBuffer->SetSize(numIndices, largeIndices);
+    indexBuffer->SetData(indexData.Buffer());
+
+    SharedPtr<Geometry> geometry(new Geometry(context_));
+    geometry->SetVertexBuffer(0, vertexBuffer);
+    geometry->SetIndexBuffer(indexBuffer);
+    geometry->SetDrawRange(TRIANGLE_LIST, 0, numIndices);
+
+    SharedPtr<Model> model(new Model(context_));
+    model->SetNumGeometries(1);
+    model->SetNumGeometryLodLevels(0, 1);
+    model->SetGeometry(0, 0, geometry);
+    Vector<SharedPtr<VertexBuffer> > vertexBuffers;
+    vertexBuffers.Push(vertexBuffer);
+    Vector<SharedPtr<IndexBuffer> > indexBuffers;
+    indexBuffers.Push(indexBuffer);
+    model->SetVertexBuffers(vertexBuffers, PODVector<unsigned>(), PODVector<unsigned>());
+    model->SetIndexBuffers(indexBuffers);
+    // the batch node stays at the origin, so the model's box is the world box
+    model->SetBoundingBox(boundingBox);
+
+    StaticBatchModel* drawable = batch->drawable_;
+    drawable->SetModel(model);
+    drawable->SetMaterial(batch->material_);
+    drawable->SetCastShadows(batch->key_.castShadows_);
+    drawable->SetViewMask(batch->key_.viewMask_);
+    drawable->SetLightMask(batch->key_.lightMask_);
+    drawable->SetZoneMask(batch->key_.zoneMask_);
+    drawable->SetDrawDistance(batch->key_.drawDistance_);
+    batch->dirty_ = false;
+    return true;
+}
+
+void StaticBatcher::Unmerge(Node* node)
+{
+    Scene* scene = node ? node->GetScene() : nullptr;
+    auto sceneIt = scenes_.Find(scene);
+    if (sceneIt == scenes_.End())
+        return;
+
+    SceneBatches& sceneBatches = sceneIt->second_;
+
+    auto it = sceneBatches.nodeBatches_.Find(node);
+    if (it == sceneBatches.nodeBatches_.End())
+        return;
+
+    for (Batch* batch : it->second_){
+        for (unsigned i = batch->sources_.Size() - 1; i < batch->sources_.Size(); i--){
+            BatchSource& source = batch->sources_[i];
+            if (source.node_ != node)
+                continue;
+            if (source.model_)
+                source.model_->SetEnabled(true);
+            batch->sources_.Erase(i);
+        }
+        // rebuilding creates gpu buffers, so it is left for the next update
+        batch->dirty_ = true;
+    }
+    sceneBatches.nodeBatches_.Erase(it);
+
+    URHO3D_LOGDEBUGF("[StaticBatcher] un-merged node %s",node->GetName().CString());
+}
+
+void StaticBatcher::QueueUnmerge(Node* node)
+{
+    pendingUnmerge_.Push(WeakPtr<Node>(node));
+}
+
+void StaticBatcher::UpdateDirtyBatches()
+{
+    for (auto it = scenes_.Begin(); it != scenes_.End();){
+        SceneBatches& sceneBatches = it->second_;
+        if (!sceneBatches.scene_){
+            it = scenes_.Erase(it);
+            continue;
+        }
+
+        for (unsigned i = sceneBatches.batches_.Size() - 1; i < sceneBatches.batches_.Size(); i--){
+            Batch* batch = sceneBatches.batches_[i];
+            if (!batch->dirty_)
+                continue;
+            if (!batch->drawable_ || !BuildBatch(batch)){
+                if (batch->node_)
+                    batch->node_->Remove();
+                sceneBatches.batches_.Erase(i);
+            }
+        }
+        ++it;
+    }
+}
+
+void StaticBatcher::ClearScene(Scene* scene)
+{
+    auto it = scenes_.Find(scene);
+    if (it == scenes_.End())
+        return;
+
+    UnsubscribeFromEvent(scene, E_NODEREMOVED);
+    UnsubscribeFromEvent(scene, E_COMPONENTREMOVED);
+
+    SceneBatches& sceneBatches = it->second_;
+    for (Batch* batch : sceneBatches.batches_){
+        for (const BatchSource& source : batch->sources_){
+            if (source.model_)
+                source.model_->SetEnabled(true);
+        }
+    }
+    if (sceneBatches.root_)
+        sceneBatches.root_->Remove();
+
+    scenes_.Erase(it);
+}
+
+void StaticBatcher::BatchSceneMeasured(Scene* scene, float cellSize, unsigned frames)
+{
+    measurement_ = Measurement();
+    measurement_.scene_ = scene;
+    measurement_.cellSize_ = cellSize;
+    measurement_.frames_ = Max(frames, 1U);
+    SubscribeToEvent(E_ENDFRAME, URHO3D_HANDLER(StaticBatcher, HandleEndFrame));
+}
+
+void StaticBatcher::HandleEndFrame(StringHash eventType, VariantMap& eventData)
+{
+    if (!measurement_.scene_){
+        UnsubscribeFromEvent(E_ENDFRAME);
+        return;
+    }
+
+    unsigned phase = measurement_.batched_ ? 1 : 0;
+    measurement_.drawCalls_[phase] += GetSubsystem<Renderer>()->GetNumBatches();
+    measurement_.frameTime_[phase] += GetSubsystem<Time>()->GetTimeStep();
+
+    if (++measurement_.frame_ < measurement_.frames_)
+        return;
+
+    measurement_.frame_ = 0;
+    if (!measurement_.batched_){
+        measurement_.stats_ = BatchScene(measurement_.scene_, measurement_.cellSize_);
+        measurement_.batched_ = true;
+        return;
+    }
+
+    float frames = (float)measurement_.frames_;
+    URHO3D_LOGINFOF("[StaticBatcher] %u nodes in %u batches. draw calls: %.0f -> %.0f frame time: %.2fms -> %.2fms",
+                    measurement_.stats_.numNodes_,measurement_.stats_.numBatches_,
+                    measurement_.drawCalls_[0]/frames,measurement_.drawCalls_[1]/frames,
+                    measurement_.frameTime_[0]*1000.0f/frames,measurement_.frameTime_[1]*1000.0f/frames);
+
+    measurement_.scene_.Reset();
+    UnsubscribeFromEvent(E_ENDFRAME);
+}
+
+void StaticBatcher::HandleUpdate(StringHash eventType, VariantMap& eventData)
+{
+    if (!pendingUnmerge_.Empty()){
+        Vector<WeakPtr<Node> > pending;
+        pending.Swap(pendingUnmerge_);
+        for (Node* node : pending){
+            if (node)
+                Unmerge(node);
+        }
+    }
+    UpdateDirtyBatches();
+}
+
+void StaticBatcher::HandleNodeRemoved(StringHash eventType, VariantMap& eventData)
+{
+    using namespace NodeRemoved;
+    Node* node = static_cast<Node*>(eventData[P_NODE].GetPtr());
+    if (!node)
+        return;
+
+    // the node might be destroyed before the next update, so un-merge it and its children right away
+    PODVector<Node*> nodes;
+    node->GetChildren(nodes,true);
+    nodes.Push(node);
+    for (Node* child : nodes){
+        Unmerge(child);
+    }
+}
+
+void StaticBatcher::HandleComponentRemoved(StringHash eventType, VariantMap& eventData)
+{
+    using namespace ComponentRemoved;
+    auto* component = static_cast<Component*>(eventData[P_COMPONENT].GetPtr());
+    if (component && component->GetType() == StaticModel::GetTypeStatic())
+        Unmerge(component->GetNode());
+}
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <Urho3D/Core/Object.h>
+#include <Urho3D/Container/HashMap.h>
+#include <Urho3D/Container/Ptr.h>
+#include <Urho3D/Container/Vector.h>
+#include <Urho3D/Graphics/StaticModel.h>
+#include <Urho3D/Math/Vector3.h>
+
+namespace Urho3D {
+    class Context;
+    class Material;
+    class Model;
+    class Node;
+    class Scene;
+}
+
+using namespace Urho3D;
+
+/// Numbers of one batching pass.
+struct StaticBatchStats{
+    unsigned numNodes_ = 0;
+    /// draw calls of the merged StaticModels (one per geometry)
+    unsigned numSourceGeometries_ = 0;
+    unsigned numBatches_ = 0;
+};
+
+/// StaticModel drawing the merged geometry of a batch. Listens to the source nodes
+/// and hands them back to the batcher as soon as one of them is moved.
+class StaticBatchModel : public StaticModel {
+    URHO3D_OBJECT(StaticBatchModel, StaticModel);
+public:
+    explicit StaticBatchModel(Context* context);
+
+protected:
+    void OnMarkedDirty(Node* node) override;
+};
+
+/// Merges the geometry of static, non-animated StaticModels that share material,
+/// vertex layout and render settings into one model per spatial cell. The original
+/// StaticModels are disabled and remembered, so that single nodes can be un-merged
+/// again when they are edited or removed.
+class StaticBatcher : public Object {
+    URHO3D_OBJECT(StaticBatcher, Object);
+public:
+    explicit StaticBatcher(Context* context);
+
+    /// Batch the scene. Already batched scenes are un-merged first.
+    StaticBatchStats BatchScene(Scene* scene, float cellSize = DEFAULT_CELL_SIZE);
+    /// Batch the scene after rendering frames normally and log draw calls and frame time before and after.
+    void BatchSceneMeasured(Scene* scene, float cellSize = DEFAULT_CELL_SIZE, unsigned frames = 60);
+    /// Restore all original StaticModels of the scene and remove its batches.
+    void ClearScene(Scene* scene);
+
+    /// Take the node out of its batches and render it on its own again. The node stays un-merged
+    /// until the scene is batched again.
+    void Unmerge(Node* node);
+    /// Unmerge the node at the next update. Safe to call while the scene is being modified.
+    void QueueUnmerge(Node* node);
+
+    static constexpr float DEFAULT_CELL_SIZE = 64.0f;
+
+private:
+    struct BatchKey{
+        Material* material_;
+        unsigned elementMask_;
+        unsigned vertexSize_;
+        IntVector3 cell_;
+        bool castShadows_;
+        unsigned viewMask_;
+        unsigned lightMask_;
+        unsigned zoneMask_;
+        float drawDistance_;
+
+        bool operator ==(const BatchKey& rhs) const;
+        unsigned ToHash() const;
+    };
+
+    struct BatchSource{
+        WeakPtr<StaticModel> model_;
+        WeakPtr<Node> node_;
+        unsigned geometry_;
+    };
+
+    struct Batch : public RefCounted{
+        BatchKey key_;
+        SharedPtr<Material> material_;
+        WeakPtr<Node> node_;
+        WeakPtr<StaticBatchModel> drawable_;
+        Vector<BatchSource> sources_;
+        bool dirty_ = false;
+    };
+
+    struct SceneBatches{
+        WeakPtr<Scene> scene_;
+        WeakPtr<Node> root_;
+        float cellSize_ = DEFAULT_CELL_SIZE;
+        Vector<SharedPtr<Batch> > batches_;
+        HashMap<Node*, PODVector<Batch*> > nodeBatches_;
+    };
+
+    bool IsEligible(StaticModel* staticModel) const;
+    bool IsStatic(Node* node) const;
+    /// (Re)create the merged model of the batch from its remaining sources. Returns false if the batch is empty.
+    bool BuildBatch(Batch* batch);
+    void UpdateDirtyBatches();
+
+    void HandleUpdate(StringHash eventType, VariantMap& eventData);
+    void HandleNodeRemoved(StringHash eventType, VariantMap& eventData);
+    void HandleComponentRemoved(StringHash eventType, VariantMap& eventData);
+    void HandleEndFrame(StringHash eventType, VariantMap& eventData);
+
+    HashMap<Scene*, SceneBatches> scenes_;
+    Vector<WeakPtr<Node> > pendingUnmerge_;
+
+    /// frame measurement of BatchSceneMeasured
+    struct Measurement{
+        WeakPtr<Scene> scene_;
+        float cellSize_ = DEFAULT_CELL_SIZE;
+        unsigned frames_ = 0;
+        unsigned frame_ = 0;
+        bool batched_ = false;
+        unsigned long long drawCalls_[2] = {0, 0};
+        float frameTime_[2] = {0.0f, 0.0f};
+        StaticBatchStats stats_;
+    } measurement_;
+};
@@ -0,0 +1,583 @@
+#include "TextureCooker.h"
+#include "LoaderCache.h"
+
+#include <cstring>
+
+#include <Urho3D/Core/Context.h>
+#include <Urho3D/Core/Timer.h>
+#include <Urho3D/Core/WorkQueue.h>
+#include <Urho3D/IO/File.h>
+#include <Urho3D/IO/FileSystem.h>
+#include <Urho3D/IO/Log.h>
+#include <Urho3D/IO/MemoryBuffer.h>
+#include <Urho3D/IO/VectorBuffer.h>
+#include <Urho3D/Resource/Image.h>
+#include <Urho3D/Resource/ResourceCache.h>
+#include <Urho3D/Resource/XMLFile.h>
+
+// bump this whenever the encoder changes its output
+static const unsigned TEXTURE_COOK_VERSION = 1;
+// decoded images are kept until their batch is written, so limit how many are in flight
+static const unsigned TEXTURES_PER_BATCH = 16;
+static const char* INDEX_FILE_NAME = "index.bin";
+
+static const unsigned DDSD_CAPS = 0x1;
+static const unsigned DDSD_HEIGHT = 0x2;
+static const unsigned DDSD_WIDTH = 0x4;
+static const unsigned DDSD_PIXELFORMAT = 0x1000;
+static const unsigned DDSD_MIPMAPCOUNT = 0x20000;
+static const unsigned DDSD_LINEARSIZE = 0x80000;
+static const unsigned DDPF_FOURCC = 0x4;
+static const unsigned DDSCAPS_COMPLEX = 0x8;
+static const unsigned DDSCAPS_TEXTURE = 0x1000;
+static const unsigned DDSCAPS_MIPMAP = 0x400000;
+
+/// Routes requests for cooked textures to the dds file in the cache.
+class TextureCookRouter : public ResourceRouter
+{
+    URHO3D_OBJECT(TextureCookRouter, ResourceRouter);
+public:
+    TextureCookRouter(Context* context, TextureCooker* cooker)
+        : ResourceRouter(context),
+          cooker_(cooker)
+    {
+    }
+
+    void Route(String& name, ResourceRequest requestType) override
+    {
+        if (requestType != RESOURCE_GETFILE || !cooker_)
+            return;
+        if (!name.EndsWith(".png",false) && !name.EndsWith(".jpg",false) && !name.EndsWith(".jpeg",false))
+            return;
+
+        String cookedFileName = cooker_->GetCookedFileName(name);
+        if (!cookedFileName.Empty())
+            name = cookedFileName;
+    }
+
+private:
+    WeakPtr<TextureCooker> cooker_;
+};
+
+/// One texture to cook. The image object is created on the main thread, the workers only touch raw memory.
+struct TextureCookJob
+{
+    String resourceName_;
+    String sourceFileName_;
+    unsigned sourceModified_;
+    SharedPtr<File> source_;
+    SharedPtr<Image> image_;
+    FileSystem* fileSystem_;
+    String cacheDir_;
+
+    // results
+    String cookedFileName_;
+    bool upToDate_ = false;
+    bool skipped_ = false;
+    bool readFailed_ = false;
+    VectorBuffer dds_;
+};
+
+static void ReadBlock(const unsigned char* rgba, unsigned width, unsigned height, unsigned bx, unsigned by, unsigned char* block)
+{
+    // pixels outside of the image repeat the edge
+    for (unsigned y = 0; y < 4; y++){
+        unsigned py = Min(by * 4 + y, height - 1);
+        for (unsigned x = 0; x < 4; x++){
+            unsigned px = Min(bx * 4 + x, width - 1);
+            memcpy(block + (y * 4 + x) * 4, rgba + (py * width + px) * 4, 4);
+        }
+    }
+}
+
+static unsigned short ToRGB565(int r, int g, int b)
+{
+    return (unsigned short)(((r >> 3) << 11) | ((g >> 2) << 5) | (b >> 3));
+}
+
+static void FromRGB565(unsigned short color, int* rgb)
+{
+    int r = (color >> 11) & 31;
+    int g = (color >> 5) & 63;
+    int b = color & 31;
+    rgb[0] = (r << 3) | (r >> 2);
+    rgb[1] = (g << 2) | (g >> 4);
+    rgb[2] = (b << 3) | (b >> 2);
+}
+
+/// DXT1 color block. Endpoints are the inset bounding box of the block colors, its diagonal
+/// flipped to follow the correlation of the channels.
+static void EncodeColorBlock(const unsigned char* block, unsigned char* dest)
+{
+    int minColor[3] = { 255, 255, 255 };
+    int maxColor[3] = { 0, 0, 0 };
+    int mean[3] = { 0, 0, 0 };
+    for (unsigned i = 0; i < 16; i++){
+        for (unsigned c = 0; c < 3; c++){
+            int value = block[i * 4 + c];
+            minColor[c] = Min(minColor[c], value);
+            maxColor[c] = Max(maxColor[c], value);
+            mean[c] += value;
+        }
+    }
+
+    int covGR = 0;
+    int covBR = 0;
+    for (unsigned i = 0; i < 16; i++){
+        int r = block[i * 4] * 16 - mean[0];
+        covGR += r * (block[i * 4 + 1] * 16 - mean[1]);
+        covBR += r * (block[i * 4 + 2] * 16 - mean[2]);
+    }
+    if (covGR < 0)
+        Swap(minColor[1], maxColor[1]);
+    if (covBR < 0)
+        Swap(minColor[2], maxColor[2]);
+
+    for (unsigned c = 0; c < 3; c++){
+        int inset = (maxColor[c] - minColor[c]) / 16;
+        maxColor[c] = Clamp(maxColor[c] - inset, 0, 255);
+        minColor[c] = Clamp(minColor[c] + inset, 0, 255);
+    }
+
+    unsigned short color0 = ToRGB565(maxColor[0], maxColor[1], maxColor[2]);
+    unsigned short color1 = ToRGB565(minColor[0], minColor[1], minColor[2]);
+    // four color mode needs color0 > color1
+    if (color0 < color1)
+        Swap(color0, color1);
+
+    unsigned indices = 0;
+    if (color0 != color1){
+        int palette[4][3];
+        FromRGB565(color0, palette[0]);
+        FromRGB565(color1, palette[1]);
+        for (unsigned c = 0; c < 3; c++){
+            palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+            palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+        }
+
+        for (unsigned i = 0; i < 16; i++){
+            unsigned best = 0;
+            int bestDistance = M_MAX_INT;
+            for (unsigned p = 0; p < 4; p++){
+                int dr = block[i * 4] - palette[p][0];
+                int dg = block[i * 4 + 1] - palette[p][1];
+                int db = block[i * 4 + 2] - palette[p][2];
+                int distance = dr * dr + dg * dg + db * db;
+                if (distance < bestDistance){
+                    bestDistance = distance;
+                    best = p;
+                }
+            }
+            indices |= best << (i * 2);
+        }
+    }
+
+    dest[0] = (unsigned char)(color0 & 0xff);
+    dest[1] = (unsigned char)(color0 >> 8);
+    dest[2] = (unsigned char)(color1 & 0xff);
+    dest[3] = (unsigned char)(color1 >> 8);
+    for (unsigned i = 0; i < 4; i++)
+        dest[4 + i] = (unsigned char)(indices >> (i * 8));
+}
+
+/// DXT5 alpha block with the 8 value palette between the block's min and max alpha.
+static void EncodeAlphaBlock(const unsigned char* block, unsigned char* dest)
+{
+    int minAlpha = 255;
+    int maxAlpha = 0;
+    for (unsigned i = 0; i < 16; i++){
+        minAlpha = Min(minAlpha, (int)block[i * 4 + 3]);
+        maxAlpha = Max(maxAlpha, (int)block[i * 4 + 3]);
+    }
+
+    dest[0] = (unsigned char)maxAlpha;
+    dest[1] = (unsigned char)minAlpha;
+
+    unsigned long long indices = 0;
+    if (maxAlpha != minAlpha){
+        int palette[8];
+        palette[0] = maxAlpha;
+        palette[1] = minAlpha;
+        for (int p = 1; p < 7; p++)
+            palette[p + 1] = ((7 - p) * maxAlpha + p * minAlpha) / 7;
+
+        for (unsigned i = 0; i < 16; i++){
+            int alpha = block[i * 4 + 3];
+            unsigned best = 0;
+            int bestDistance = M_MAX_INT;
+            for (unsigned p = 0; p < 8; p++){
+                int distance = Abs(alpha - palette[p]);
+                if (distance < bestDistance){
+                    bestDistance = distance;
+                    best = p;
+                }
+            }
+            indices |= (unsigned long long)best << (i * 3);
+        }
+    }
+    for (unsigned i = 0; i < 6; i++)
+        dest[2 + i] = (unsigned char)(indices >> (i * 8));
+}
+
+/// Next mip level with a 2x2 box filter.
+static void Downsample(const PODVector<unsigned char>& src, unsigned width, unsigned height, PODVector<unsigned char>& dest)
+{
+    unsigned newWidth = Max(width / 2, 1U);
+    unsigned newHeight = Max(height / 2, 1U);
+    dest.Resize(newWidth * newHeight * 4);
+    for (unsigned y = 0; y < newHeight; y++){
+        unsigned y0 = Min(y * 2, height - 1);
+        unsigned y1 = Min(y * 2 + 1, height - 1);
+        for (unsigned x = 0; x < newWidth; x++){
+            unsigned x0 = Min(x * 2, width - 1);
+            unsigned x1 = Min(x * 2 + 1, width - 1);
+            for (unsigned c = 0; c < 4; c++){
+                unsigned sum = src[(y0 * width + x0) * 4 + c] + src[(y0 * width + x1) * 4 + c] +
+                               src[(y1 * width + x0) * 4 + c] + src[(y1 * width + x1) * 4 + c];
+                dest[(y * newWidth + x) * 4 + c] = (unsigned char)((sum + 2) / 4);
+            }
+        }
+    }
+}
+
+static void WriteDDS(unsigned width, unsigned height, bool alpha, const Vector<PODVector<unsigned char> >& levels, VectorBuffer& dest)
+{
+    unsigned blockSize = alpha ? 16 : 8;
+
+    dest.WriteFileID("DDS ");
+    dest.WriteUInt(124);
+    dest.WriteUInt(DDSD_CAPS | DDSD_HEIGHT | DDSD_WIDTH | DDSD_PIXELFORMAT | DDSD_MIPMAPCOUNT | DDSD_LINEARSIZE);
+    dest.WriteUInt(height);
+    dest.WriteUInt(width);
+    dest.WriteUInt(Max((width + 3) / 4, 1U) * Max((height + 3) / 4, 1U) * blockSize);
+    dest.WriteUInt(0); // depth
+    dest.WriteUInt(levels.Size());
+    for (unsigned i = 0; i < 11; i++)
+        dest.WriteUInt(0);
+
+    // pixel format
+    dest.WriteUInt(32);
+    dest.WriteUInt(DDPF_FOURCC);
+    dest.WriteFileID(alpha ? "DXT5" : "DXT1");
+    for (unsigned i = 0; i < 5; i++)
+        dest.WriteUInt(0);
+
+    dest.WriteUInt(DDSCAPS_TEXTURE | DDSCAPS_MIPMAP | DDSCAPS_COMPLEX);
+    for (unsigned i = 0; i < 4; i++)
+        dest.WriteUInt(0);
+
+    for (const PODVector<unsigned char>& level : levels)
+        dest.Write(level.Buffer(), level.Size());
+}
+
+static void CookTextureWork(const WorkItem* item, unsigned threadIndex)
+{
+    auto* job = reinterpret_cast<TextureCookJob*>(item->aux_);
+
+    PODVector<unsigned char> fileData(job->source_->GetSize());
+    if (fileData.Size() && job->source_->Read(fileData.Buffer(), fileData.Size()) != fileData.Size()){
+        job->skipped_ = true;
+        job->readFailed_ = true;
+        return;
+    }
+
+    unsigned long long hash = LoaderCache::Hash(fileData.Buffer(), fileData.Size());
+    hash = LoaderCache::Hash(&TEXTURE_COOK_VERSION, sizeof(TEXTURE_COOK_VERSION), hash);
+    job->cookedFileName_ = job->cacheDir_ + LoaderCache::HashToString(hash) + ".dds";
+    if (job->fileSystem_->FileExists(job->cookedFileName_)){
+        job->upToDate_ = true;
+        return;
+    }
+
+    // BeginLoad only, Load() would touch the profiler
+    MemoryBuffer buffer(fileData.Buffer(), fileData.Size());
+    Image* image = job->image_;
+    if (!image->BeginLoad(buffer) || image->IsCompressed() || image->GetComponents() < 3){
+        job->skipped_ = true;
+        return;
+    }
+
+    unsigned width = image->GetWidth();
+    unsigned height = image->GetHeight();
+    unsigned components = image->GetComponents();
+    const unsigned char* pixels = image->GetData();
+
+    PODVector<unsigned char> rgba(width * height * 4);
+    bool alpha = false;
+    for (unsigned i = 0; i < width * height; i++){
+        rgba[i * 4] = pixels[i * components];
+        rgba[i * 4 + 1] = pixels[i * components + 1];
+        rgba[i * 4 + 2] = pixels[i * components + 2];
+        rgba[i * 4 + 3] = components == 4 ? pixels[i * components + 3] : 255;
+        alpha |= rgba[i * 4 + 3] != 255;
+    }
+
+    Vector<PODVector<unsigned char> > levels;
+    unsigned levelWidth = width;
+    unsigned levelHeight = height;
+    unsigned blockSize = alpha ? 16 : 8;
+    for (;;){
+        unsigned blocksX = (levelWidth + 3) / 4;
+        unsigned blocksY = (levelHeight + 3) / 4;
+        levels.Push(PODVector<unsigned char>(blocksX * blocksY * blockSize));
+        unsigned char* dest = levels.Back().Buffer();
+
+        unsigned char block[64];
+        for (unsigned by = 0; by < blocksY; by++){
+            for (unsigned bx = 0; bx < blocksX; bx++){
+                ReadBlock(rgba.Buffer(), levelWidth, levelHeight, bx, by, block);
+                if (alpha){
+                    EncodeAlphaBlock(block, dest);
+                    dest += 8;
+                }
+                EncodeColorBlock(block, dest);
+                dest += 8;
+            }
+        }
+
+        if (levelWidth == 1 && levelHeight == 1)
+            break;
+
+        PODVector<unsigned char> next;
+        Downsample(rgba, levelWidth, levelHeight, next);
+        rgba.Swap(next);
+        levelWidth = Max(levelWidth / 2, 1U);
+        levelHeight = Max(levelHeight / 2, 1U);
+    }
+
+    WriteDDS(width, height, alpha, levels, job->dds_);
+}
+
+TextureCooker::TextureCooker(Context* context)
+    : Object(context)
+{
+}
+
+TextureCooker::~TextureCooker()
+{
+    SetRoutingEnabled(false);
+}
+
+void TextureCooker::SetRoutingEnabled(bool enable)
+{
+    ResourceCache* cache = GetSubsystem<ResourceCache>();
+    if (!cache)
+        return;
+
+    if (enable && !router_){
+        router_ = new TextureCookRouter(context_, this);
+        cache->AddResourceRouter(router_);
+    }
+    else if (!enable && router_){
+        cache->RemoveResourceRouter(router_);
+        router_.Reset();
+    }
+}
+
+String TextureCooker::GetCookedFileName(const String& resourceName) const
+{
+    // only the material textures are loaded as Texture2D for sure, other users need the pixels of the source
+    if (!materialTextures_.Contains(resourceName))
+        return String::EMPTY;
+
+    auto it = cooked_.Find(resourceName);
+    if (it == cooked_.End())
+        return String::EMPTY;
+
+    // edited after cooking. use the source until it is cooked again
+    const CookedTexture& cooked = it->second_;
+    if (GetSubsystem<FileSystem>()->GetLastModifiedTime(cooked.sourceFileName_) != cooked.sourceModified_)
+        return String::EMPTY;
+    return cooked.cookedFileName_;
+}
+
+void TextureCooker::ScanMaterialFolders(const Vector<String>& folders)
+{
+    ResourceCache* cache = GetSubsystem<ResourceCache>();
+    FileSystem* fs = GetSubsystem<FileSystem>();
+
+    for (const String& resDir : cache->GetResourceDirs()){
+        for (const String& folder : folders){
+            Vector<String> dirFiles;
+            fs->ScanDir(dirFiles,resDir+folder,"*.xml",SCAN_FILES,true);
+            for (const String& file : dirFiles)
+                ScanMaterial(folder+"/"+file);
+        }
+    }
+}
+
+void TextureCooker::ScanMaterial(const String& resourceName)
+{
+    SharedPtr<File> file = GetSubsystem<ResourceCache>()->GetFile(resourceName,false);
+    XMLFile xml(context_);
+    if (!file || !xml.Load(*file))
+        return;
+
+    XMLElement material = xml.GetRoot("material");
+    for (XMLElement texture = material.GetChild("texture"); texture; texture = texture.GetNext("texture"))
+        materialTextures_.Insert(texture.GetAttribute("name"));
+}
+
+void TextureCooker::LoadIndex()
+{
+    indexLoaded_ = true;
+    File file(context_);
+    if (!file.Open(LoaderCache::GetDir(context_,"textures")+INDEX_FILE_NAME,FILE_READ))
+        return;
+    if (file.ReadFileID() != "UTCI" || file.ReadUInt() != TEXTURE_COOK_VERSION)
+        return;
+
+    unsigned numTextures = file.ReadUInt();
+    for (unsigned i = 0; i < numTextures && !file.IsEof(); i++){
+        CookedTexture cooked;
+        cooked.sourceFileName_ = file.ReadString();
+        cooked.sourceModified_ = file.ReadUInt();
+        cooked.sourceSize_ = file.ReadUInt();
+        cooked.cookedFileName_ = file.ReadString();
+        index_[cooked.sourceFileName_] = cooked;
+    }
+}
+
+void TextureCooker::SaveIndex()
+{
+    String fileName = LoaderCache::GetDir(context_,"textures")+INDEX_FILE_NAME;
+    File file(context_);
+    if (!file.Open(fileName,FILE_WRITE)){
+        URHO3D_LOGWARNINGF("[TextureCooker] could not write %s",fileName.CString());
+        return;
+    }
+
+    file.WriteFileID("UTCI");
+    file.WriteUInt(TEXTURE_COOK_VERSION);
+    file.WriteUInt(index_.Size());
+    for (const auto& entry : index_){
+        const CookedTexture& cooked = entry.second_;
+        file.WriteString(cooked.sourceFileName_);
+        file.WriteUInt(cooked.sourceModified_);
+        file.WriteUInt(cooked.sourceSize_);
+        file.WriteString(cooked.cookedFileName_);
+    }
+}
+
+void TextureCooker::CookTextureFolders(const Vector<String>& folders)
+{
+    ResourceCache* cache = GetSubsystem<ResourceCache>();
+    FileSystem* fs = GetSubsystem<FileSystem>();
+
+    static const char* extensions[] = { "*.png", "*.jpg", "*.jpeg" };
+
+    Vector<String> resourceNames;
+    for (const String& resDir : cache->GetResourceDirs()){
+        for (const String& folder : folders){
+            for (const char* extension : extensions){
+                Vector<String> dirFiles;
+                fs->ScanDir(dirFiles,resDir+folder,extension,SCAN_FILES,true);
+                for (const String& file : dirFiles){
+                    String resourceName = folder+"/"+file;
+                    if (!resourceNames.Contains(resourceName))
+                        resourceNames.Push(resourceName);
+                }
+            }
+        }
+    }
+    CookTextures(resourceNames);
+}
+
+void TextureCooker::CookTextures(const Vector<String>& resourceNames)
+{
+    HiresTimer timer;
+    ResourceCache* cache = GetSubsystem<ResourceCache>();
+    FileSystem* fs = GetSubsystem<FileSystem>();
+    WorkQueue* queue = GetSubsystem<WorkQueue>();
+    String cacheDir = LoaderCache::GetDir(context_,"textures");
+    if (!indexLoaded_)
+        LoadIndex();
+
+    unsigned numCooked = 0;
+    unsigned numUpToDate = 0;
+    bool indexChanged = false;
+    for (unsigned start = 0; start < resourceNames.Size(); start += TEXTURES_PER_BATCH){
+        // jobs must not be resized once the work items point into it
+        Vector<TextureCookJob> jobs;
+        for (unsigned i = start; i < resourceNames.Size() && i < start + TEXTURES_PER_BATCH; i++){
+            // cooking only makes sense for loose files, packages can't be routed to
+            String sourceFileName = cache->GetResourceFileName(resourceNames[i]);
+            if (sourceFileName.Empty())
+                continue;
+
+            TextureCookJob job;
+            job.resourceName_ = resourceNames[i];
+            job.sourceFileName_ = sourceFileName;
+            job.sourceModified_ = fs->GetLastModifiedTime(sourceFileName);
+            job.source_ = new File(context_,sourceFileName,FILE_READ);
+            if (!job.source_->IsOpen())
+                continue;
+
+            // unchanged since the last run, neither read nor hash it again
+            auto indexed = index_.Find(sourceFileName);
+            if (indexed != index_.End() && indexed->second_.sourceModified_ == job.sourceModified_ &&
+                    indexed->second_.sourceSize_ == job.source_->GetSize()){
+                const CookedTexture& cooked = indexed->second_;
+                if (cooked.cookedFileName_.Empty())
+                    continue;
+                if (fs->FileExists(cooked.cookedFileName_)){
+                    cooked_[job.resourceName_] = cooked;
+                    numUpToDate++;
+                    continue;
+                }
+            }
+
+            job.image_ = new Image(context_);
+            job.fileSystem_ = fs;
+            job.cacheDir_ = cacheDir;
+            jobs.Push(job);
+        }
+
+        for (TextureCookJob& job : jobs){
+            SharedPtr<WorkItem> item = queue->GetFreeItem();
+            item->workFunction_ = CookTextureWork;
+            item->aux_ = &job;
+            item->priority_ = M_MAX_UNSIGNED;
+            queue->AddWorkItem(item);
+        }
+        queue->Complete(M_MAX_UNSIGNED);
+
+        for (TextureCookJob& job : jobs){
+            CookedTexture cooked;
+            cooked.sourceFileName_ = job.sourceFileName_;
+            cooked.sourceModified_ = job.sourceModified_;
+            cooked.sourceSize_ = job.source_->GetSize();
+
+            // a texture that can't be cooked is not tried again until it changes, one that could not be read is
+            if (job.skipped_){
+                if (!job.readFailed_){
+                    index_[job.sourceFileName_] = cooked;
+                    indexChanged = true;
+                }
+                continue;
+            }
+
+            if (!job.upToDate_){
+                File file(context_,job.cookedFileName_,FILE_WRITE);
+                if (!file.IsOpen() || file.Write(job.dds_.GetData(),job.dds_.GetSize()) != job.dds_.GetSize()){
+                    URHO3D_LOGWARNINGF("[TextureCooker] could not write %s",job.cookedFileName_.CString());
+                    continue;
+                }
+                numCooked++;
+            }
+            else {
+                numUpToDate++;
+            }
+
+            cooked.cookedFileName_ = job.cookedFileName_;
+            cooked_[job.resourceName_] = cooked;
+            index_[job.sourceFileName_] = cooked;
+            indexChanged = true;
+        }
+    }
+    if (indexChanged)
+        SaveIndex();
+
+    URHO3D_LOGINFOF("[TextureCooker] %u textures: %u up to date, %u cooked in %.2fms",resourceNames.Size(),numUpToDate,
+                    numCooked,timer.GetUSec(false)/1000.0f);
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <Urho3D/Core/Object.h>
+#include <Urho3D/Container/HashMap.h>
+#include <Urho3D/Container/HashSet.h>
+#include <Urho3D/Container/Ptr.h>
+#include <Urho3D/Container/Str.h>
+#include <Urho3D/Container/Vector.h>
+
+namespace Urho3D {
+    class Context;
+    class ResourceRouter;
+}
+
+using namespace Urho3D;
+
+/// Converts png/jpg textures into mipmapped, block-compressed dds files (DXT1, or DXT5 if
+/// the image has alpha) kept in the on-disk cache keyed by the hash of the source file.
+/// While routing is enabled the ResourceCache reads the cooked file instead of the source for
+/// the textures the materials reference, as long as the source was not modified since. Other
+/// loads of the same file (Image users like terrains or cube map faces) still get the source.
+/// Grayscale images (heightmaps, masks) are not cooked, their users usually need the
+/// uncompressed pixels. Sources whose modification time and size did not change since the
+/// last run are not read again, see the index file in the textures cache dir.
+class TextureCooker : public Object {
+    URHO3D_OBJECT(TextureCooker, Object);
+public:
+    explicit TextureCooker(Context* context);
+    ~TextureCooker() override;
+
+    /// Cook the png/jpg files in the folders of every resource dir. Up to date textures are only registered.
+    void CookTextureFolders(const Vector<String>& folders);
+    /// Cook textures by resource name on the worker threads.
+    void CookTextures(const Vector<String>& resourceNames);
+
+    /// Collect the textures referenced by the material xml files in the folders of every resource dir.
+    void ScanMaterialFolders(const Vector<String>& folders);
+    /// Collect the textures referenced by one material. Textures a material stops referencing are kept.
+    void ScanMaterial(const String& resourceName);
+
+    /// Let the ResourceCache load the cooked files instead of the sources of the material textures.
+    void SetRoutingEnabled(bool enable);
+    /// Return the absolute name of the cooked file, or empty if there is none, the source changed
+    /// or no material references the texture.
+    String GetCookedFileName(const String& resourceName) const;
+
+private:
+    struct CookedTexture{
+        String sourceFileName_;
+        unsigned sourceModified_;
+        unsigned sourceSize_;
+        /// Empty if the source could not be cooked.
+        String cookedFileName_;
+    };
+
+    void LoadIndex();
+    void SaveIndex();
+
+    HashMap<StringHash, CookedTexture> cooked_;
+    /// The textures of the last run by source file name.
+    HashMap<String, CookedTexture> index_;
+    bool indexLoaded_ = false;
+    HashSet<StringHash> materialTextures_;
+    SharedPtr<ResourceRouter> router_;
+};
@@ -0,0 +1,409 @@
+#include "ThumbnailBuilder.h"
+#include "LoaderCache.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+#include <Urho3D/Core/Context.h>
+#include <Urho3D/Core/Timer.h>
+#include <Urho3D/Core/WorkQueue.h>
+#include <Urho3D/IO/File.h>
+#include <Urho3D/IO/FileSystem.h>
+#include <Urho3D/IO/Log.h>
+#include <Urho3D/IO/MemoryBuffer.h>
+#include <Urho3D/Resource/Image.h>
+#include <Urho3D/Resource/JSONFile.h>
+#include <Urho3D/Resource/ResourceCache.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define THUMBNAIL_SSE2
+#include <emmintrin.h>
+#endif
+
+// bump this whenever the scaling changes its output
+static const unsigned THUMBNAIL_VERSION = 1;
+
+const unsigned ThumbnailBuilder::ICON_SIZE;
+
+/// Size of a cached icon, read with plain stdio as it runs on the workers. 0 if there is none.
+static unsigned GetCachedFileSize(const String& fileName)
+{
+    FILE* file = fopen(GetNativePath(fileName).CString(),"rb");
+    if (!file)
+        return 0;
+    fseek(file,0,SEEK_END);
+    long size = ftell(file);
+    fclose(file);
+    return size > 0 ? (unsigned)size : 0;
+}
+
+/// Half the size with a 2x2 box filter. The average is taken as avg(avg(top, bottom)) per
+/// pair of pixels, rounding up like _mm_avg_epu8, so the sse2 and the plain path give the same result.
+static void Halve(const PODVector<unsigned char>& src, unsigned width, unsigned height, PODVector<unsigned char>& dest)
+{
+    unsigned newWidth = Max(width / 2, 1U);
+    unsigned newHeight = Max(height / 2, 1U);
+    dest.Resize(newWidth * newHeight * 4);
+
+    for (unsigned y = 0; y < newHeight; y++){
+        const unsigned char* row0 = &src[Min(y * 2, height - 1) * width * 4];
+        const unsigned char* row1 = &src[Min(y * 2 + 1, height - 1) * width * 4];
+        unsigned char* out = &dest[y * newWidth * 4];
+
+        unsigned x = 0;
+#ifdef THUMBNAIL_SSE2
+        // 8 source pixels of both rows into 4 pixels
+        for (; x + 4 <= newWidth && x * 2 + 8 <= width; x += 4){
+            __m128i top0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row0 + x * 8));
+            __m128i top1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row0 + x * 8 + 16));
+            __m128i bottom0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row1 + x * 8));
+            __m128i bottom1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row1 + x * 8 + 16));
+            __m128 vertical0 = _mm_castsi128_ps(_mm_avg_epu8(top0,bottom0));
+            __m128 vertical1 = _mm_castsi128_ps(_mm_avg_epu8(top1,bottom1));
+            __m128i even = _mm_castps_si128(_mm_shuffle_ps(vertical0,vertical1,_MM_SHUFFLE(2,0,2,0)));
+            __m128i odd = _mm_castps_si128(_mm_shuffle_ps(vertical0,vertical1,_MM_SHUFFLE(3,1,3,1)));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + x * 4),_mm_avg_epu8(even,odd));
+        }
+#endif
+        for (; x < newWidth; x++){
+            unsigned x0 = Min(x * 2, width - 1) * 4;
+            unsigned x1 = Min(x * 2 + 1, width - 1) * 4;
+            for (unsigned c = 0; c < 4; c++){
+                unsigned left = (row0[x0 + c] + row1[x0 + c] + 1) >> 1;
+                unsigned right = (row0[x1 + c] + row1[x1 + c] + 1) >> 1;
+                out[x * 4 + c] = (unsigned char)((left + right + 1) >> 1);
+            }
+        }
+    }
+}
+
+/// Box filter to any smaller size, every target pixel is the average of the source pixels it covers.
+static void BoxScale(const PODVector<unsigned char>& src, unsigned width, unsigned height, unsigned newWidth, unsigned newHeight, PODVector<unsigned char>& dest)
+{
+    dest.Resize(newWidth * newHeight * 4);
+    for (unsigned y = 0; y < newHeight; y++){
+        unsigned y0 = y * height / newHeight;
+        unsigned y1 = Max((y + 1) * height / newHeight, y0 + 1);
+        for (unsigned x = 0; x < newWidth; x++){
+            unsigned x0 = x * width / newWidth;
+            unsigned x1 = Max((x + 1) * width / newWidth, x0 + 1);
+            unsigned sum[4] = { 0, 0, 0, 0 };
+            for (unsigned sy = y0; sy < y1; sy++){
+                const unsigned char* pixel = &src[(sy * width + x0) * 4];
+                for (unsigned sx = x0; sx < x1; sx++, pixel += 4){
+                    sum[0] += pixel[0];
+                    sum[1] += pixel[1];
+                    sum[2] += pixel[2];
+                    sum[3] += pixel[3];
+                }
+            }
+            unsigned count = (y1 - y0) * (x1 - x0);
+            for (unsigned c = 0; c < 4; c++)
+                dest[(y * newWidth + x) * 4 + c] = (unsigned char)((sum[c] + count / 2) / count);
+        }
+    }
+}
+
+/// Decoded top level of the image as rgba, compressed formats are decompressed.
+static bool GetRGBA(Image* image, PODVector<unsigned char>& rgba)
+{
+    unsigned width = image->GetWidth();
+    unsigned height = image->GetHeight();
+    if (!width || !height)
+        return false;
+    rgba.Resize(width * height * 4);
+
+    if (image->IsCompressed()){
+        CompressedLevel level = image->GetCompressedLevel(0);
+        return level.Decompress(rgba.Buffer());
+    }
+
+    unsigned components = image->GetComponents();
+    const unsigned char* pixels = image->GetData();
+    for (unsigned i = 0; i < width * height; i++){
+        const unsigned char* pixel = pixels + i * components;
+        unsigned char* out = &rgba[i * 4];
+        if (components < 3){
+            // grayscale, with alpha for 2 components
+            out[0] = out[1] = out[2] = pixel[0];
+            out[3] = components == 2 ? pixel[1] : 255;
+        } else {
+            out[0] = pixel[0];
+            out[1] = pixel[1];
+            out[2] = pixel[2];
+            out[3] = components == 4 ? pixel[3] : 255;
+        }
+    }
+    return true;
+}
+
+ThumbnailBuilder::ThumbnailBuilder(Context* context)
+    : Object(context),
+      nextJob_(0),
+      numFinished_(0),
+      hasPending_(false)
+{
+}
+
+ThumbnailBuilder::~ThumbnailBuilder()
+{
+    // the workers still point into jobs_
+    WorkQueue* queue = GetSubsystem<WorkQueue>();
+    if (!jobs_.Empty() && queue){
+        queue->Complete(0);
+    }
+}
+
+String ThumbnailBuilder::GetAtlasFileName() const
+{
+    return LoaderCache::GetDir(context_,"thumbnails") + "atlas.png";
+}
+
+String ThumbnailBuilder::GetIndexFileName() const
+{
+    return LoaderCache::GetDir(context_,"thumbnails") + "atlas.json";
+}
+
+void ThumbnailBuilder::BuildFolders(const Vector<String>& folders)
+{
+    ResourceCache* cache = GetSubsystem<ResourceCache>();
+    FileSystem* fs = GetSubsystem<FileSystem>();
+
+    static const char* extensions[] = { "*.png", "*.jpg", "*.jpeg", "*.dds" };
+
+    Vector<String> resourceNames;
+    for (const String& resDir : cache->GetResourceDirs()){
+        for (const String& folder : folders){
+            for (const char* extension : extensions){
+                Vector<String> dirFiles;
+                fs->ScanDir(dirFiles,resDir+folder,extension,SCAN_FILES,true);
+                for (const String& file : dirFiles){
+                    String resourceName = folder+"/"+file;
+                    if (!resourceNames.Contains(resourceName))
+                        resourceNames.Push(resourceName);
+                }
+            }
+        }
+    }
+    BuildAsync(resourceNames);
+}
+
+void ThumbnailBuilder::BuildAsync(const Vector<String>& resourceNames)
+{
+    if (!jobs_.Empty()){
+        pending_ = resourceNames;
+        hasPending_ = true;
+        return;
+    }
+
+    // only the names, the files are opened once their job is queued. a folder of thousands
+    // of textures would otherwise hold as many open files
+    String cacheDir = LoaderCache::GetDir(context_,"thumbnails");
+    for (const String& resourceName : resourceNames){
+        ThumbnailJob job;
+        job.resourceName_ = resourceName;
+        job.cacheDir_ = cacheDir;
+        jobs_.Push(job);
+    }
+    if (jobs_.Empty()){
+        WriteAtlas();
+        return;
+    }
+
+    nextJob_ = 0;
+    numFinished_ = 0;
+    WorkQueue* queue = GetSubsystem<WorkQueue>();
+    SubscribeToEvent(queue,E_WORKITEMCOMPLETED,URHO3D_HANDLER(ThumbnailBuilder,HandleWorkItemCompleted));
+    unsigned inFlight = Max(queue->GetNumThreads(),1U) * 2;
+    for (unsigned i = 0; i < inFlight; i++){
+        QueueNext();
+    }
+    // none of the files could be opened
+    if (numFinished_ == jobs_.Size())
+        FinishBuild();
+}
+
+void ThumbnailBuilder::QueueNext()
+{
+    ResourceCache* cache = GetSubsystem<ResourceCache>();
+    WorkQueue* queue = GetSubsystem<WorkQueue>();
+    while (nextJob_ < jobs_.Size()){
+        ThumbnailJob& job = jobs_[nextJob_++];
+        // opened here, the workers only read
+        job.source_ = cache->GetFile(job.resourceName_,false);
+        if (!job.source_){
+            numFinished_++;
+            continue;
+        }
+        job.image_ = new Image(context_);
+        job.item_ = queue->GetFreeItem();
+        job.item_->workFunction_ = ThumbnailWork;
+        job.item_->aux_ = &job;
+        // lowest priority, the loaders' Complete() calls don't wait for the thumbnails
+        job.item_->priority_ = 0;
+        job.item_->sendEvent_ = true;
+        queue->AddWorkItem(job.item_);
+        return;
+    }
+}
+
+void ThumbnailBuilder::ThumbnailWork(const WorkItem* item, unsigned threadIndex)
+{
+    auto* job = reinterpret_cast<ThumbnailJob*>(item->aux_);
+
+    PODVector<unsigned char> fileData(job->source_->GetSize());
+    if (fileData.Size() && job->source_->Read(fileData.Buffer(),fileData.Size()) != fileData.Size())
+        return;
+
+    unsigned long long hash = LoaderCache::Hash(fileData.Buffer(),fileData.Size());
+    hash = LoaderCache::Hash(&THUMBNAIL_VERSION,sizeof(THUMBNAIL_VERSION),hash);
+    hash = LoaderCache::Hash(&ICON_SIZE,sizeof(ICON_SIZE),hash);
+    job->hash_ = hash;
+    // read on the main thread
+    if (GetCachedFileSize(job->cacheDir_ + LoaderCache::HashToString(hash) + ".rgba") == ICON_SIZE * ICON_SIZE * 4){
+        job->valid_ = true;
+        return;
+    }
+
+    // BeginLoad only, Load() would touch the profiler
+    MemoryBuffer buffer(fileData.Buffer(),fileData.Size());
+    PODVector<unsigned char> rgba;
+    if (!job->image_->BeginLoad(buffer) || !GetRGBA(job->image_,rgba))
+        return;
+    fileData.Clear();
+
+    // fit into the icon, keeping the aspect ratio
+    unsigned width = job->image_->GetWidth();
+    unsigned height = job->image_->GetHeight();
+    unsigned iconWidth = width >= height ? ICON_SIZE : Max(ICON_SIZE * width / height, 1U);
+    unsigned iconHeight = height >= width ? ICON_SIZE : Max(ICON_SIZE * height / width, 1U);
+
+    // cheap halving while it is at least twice the size, the box filter does the rest
+    PODVector<unsigned char> next;
+    while (width >= iconWidth * 2 && height >= iconHeight * 2){
+        Halve(rgba,width,height,next);
+        rgba.Swap(next);
+        width /= 2;
+        height /= 2;
+    }
+    BoxScale(rgba,width,height,iconWidth,iconHeight,next);
+
+    // centered on a transparent icon
+    job->icon_.Resize(ICON_SIZE * ICON_SIZE * 4);
+    memset(job->icon_.Buffer(),0,job->icon_.Size());
+    unsigned offsetX = (ICON_SIZE - iconWidth) / 2;
+    unsigned offsetY = (ICON_SIZE - iconHeight) / 2;
+    for (unsigned y = 0; y < iconHeight; y++){
+        memcpy(&job->icon_[((offsetY + y) * ICON_SIZE + offsetX) * 4],&next[y * iconWidth * 4],iconWidth * 4);
+    }
+    job->valid_ = true;
+}
+
+void ThumbnailBuilder::HandleWorkItemCompleted(StringHash eventType, VariantMap& eventData)
+{
+    WorkItem* item = static_cast<WorkItem*>(eventData[WorkItemCompleted::P_ITEM].GetPtr());
+    ThumbnailJob* job = nullptr;
+    for (unsigned i = 0; i < nextJob_ && !job; i++){
+        if (jobs_[i].item_ == item)
+            job = &jobs_[i];
+    }
+    if (!job)
+        return;
+
+    // the decoded image is by far the biggest part
+    job->image_.Reset();
+    job->source_.Reset();
+    job->item_.Reset();
+
+    String cacheFileName = job->cacheDir_ + LoaderCache::HashToString(job->hash_) + ".rgba";
+    if (job->valid_ && job->icon_.Empty()){
+        File file(context_,cacheFileName,FILE_READ);
+        job->icon_.Resize(ICON_SIZE * ICON_SIZE * 4);
+        job->valid_ = file.IsOpen() && file.Read(job->icon_.Buffer(),job->icon_.Size()) == job->icon_.Size();
+    }
+    else if (job->valid_){
+        File file(context_,cacheFileName,FILE_WRITE);
+        if (!file.IsOpen() || file.Write(job->icon_.Buffer(),job->icon_.Size()) != job->icon_.Size()){
+            URHO3D_LOGWARNINGF("[ThumbnailBuilder] could not write %s",cacheFileName.CString());
+        }
+    }
+    else {
+        URHO3D_LOGWARNINGF("[ThumbnailBuilder] no thumbnail for %s",job->resourceName_.CString());
+    }
+
+    numFinished_++;
+    QueueNext();
+    if (numFinished_ == jobs_.Size())
+        FinishBuild();
+}
+
+void ThumbnailBuilder::FinishBuild()
+{
+    UnsubscribeFromEvent(GetSubsystem<WorkQueue>(),E_WORKITEMCOMPLETED);
+    WriteAtlas();
+    jobs_.Clear();
+
+    if (hasPending_){
+        hasPending_ = false;
+        Vector<String> pending;
+        pending.Swap(pending_);
+        BuildAsync(pending);
+    }
+}
+
+void ThumbnailBuilder::WriteAtlas()
+{
+    HiresTimer timer;
+    Vector<const ThumbnailJob*> icons;
+    for (const ThumbnailJob& job : jobs_){
+        if (job.valid_)
+            icons.Push(&job);
+    }
+
+    // as square as possible, an empty atlas still gets one (transparent) cell
+    unsigned columns = Max((unsigned)ceilf(sqrtf((float)icons.Size())),1U);
+    unsigned rows = Max((icons.Size() + columns - 1) / columns,1U);
+    unsigned atlasWidth = columns * ICON_SIZE;
+
+    SharedPtr<Image> atlas(new Image(context_));
+    atlas->SetSize(atlasWidth,rows * ICON_SIZE,4);
+    PODVector<unsigned char> pixels(atlasWidth * rows * ICON_SIZE * 4);
+    memset(pixels.Buffer(),0,pixels.Size());
+
+    JSONValue index;
+    index["version"] = THUMBNAIL_VERSION;
+    index["iconSize"] = ICON_SIZE;
+    index["columns"] = columns;
+    JSONValue entries;
+    for (unsigned i = 0; i < icons.Size(); i++){
+        unsigned cellX = (i % columns) * ICON_SIZE;
+        unsigned cellY = (i / columns) * ICON_SIZE;
+        for (unsigned y = 0; y < ICON_SIZE; y++){
+            memcpy(&pixels[((cellY + y) * atlasWidth + cellX) * 4],&icons[i]->icon_[y * ICON_SIZE * 4],ICON_SIZE * 4);
+        }
+
+        JSONValue entry;
+        entry["index"] = i;
+        entry["hash"] = LoaderCache::HashToString(icons[i]->hash_);
+        entries[icons[i]->resourceName_] = entry;
+    }
+    index["icons"] = entries;
+    atlas->SetData(pixels.Buffer());
+
+    String atlasFileName = GetAtlasFileName();
+    String indexFileName = GetIndexFileName();
+    JSONFile indexFile(context_);
+    indexFile.GetRoot() = index;
+    if (!atlas->SavePNG(atlasFileName) || !indexFile.SaveFile(indexFileName)){
+        URHO3D_LOGERRORF("[ThumbnailBuilder] could not write %s",atlasFileName.CString());
+        return;
+    }
+    URHO3D_LOGINFOF("[ThumbnailBuilder] %u thumbnails, atlas written in %.2fms",icons.Size(),timer.GetUSec(false)/1000.0f);
+
+    using namespace ThumbnailsReady;
+    VariantMap& data = GetEventDataMap();
+    data[P_ATLAS] = atlasFileName;
+    data[P_INDEX] = indexFileName;
+    SendEvent(E_THUMBNAILSREADY,data);
+}
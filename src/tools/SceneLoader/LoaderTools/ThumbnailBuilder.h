@@ -0,0 +1,78 @@
+#pragma once
+
+#include <Urho3D/Core/Object.h>
+#include <Urho3D/Container/HashMap.h>
+#include <Urho3D/Container/Ptr.h>
+#include <Urho3D/Container/Str.h>
+#include <Urho3D/Container/Vector.h>
+
+namespace Urho3D {
+    class Context;
+    class File;
+    class Image;
+    class WorkItem;
+}
+
+using namespace Urho3D;
+
+/// Sent when BuildAsync() finished and the atlas is written.
+URHO3D_EVENT(E_THUMBNAILSREADY, ThumbnailsReady)
+{
+    URHO3D_PARAM(P_ATLAS, Atlas); // String, atlas png
+    URHO3D_PARAM(P_INDEX, Index); // String, atlas json
+}
+
+/// Small previews of the textures for the texture dropdowns of the exporter. Textures are
+/// decoded and scaled down on the worker threads, every icon is kept in the loader cache keyed
+/// by the hash of its source file. All icons are then put into one png atlas, the json index
+/// next to it maps each resource name to its cell.
+class ThumbnailBuilder : public Object {
+    URHO3D_OBJECT(ThumbnailBuilder, Object);
+public:
+    /// Width and height of an icon in the atlas.
+    static const unsigned ICON_SIZE = 64;
+
+    explicit ThumbnailBuilder(Context* context);
+    ~ThumbnailBuilder() override;
+
+    /// Thumbnails of all png/jpg/dds files in the folders of every resource dir.
+    void BuildFolders(const Vector<String>& folders);
+    /// Build the thumbnails of these textures and the atlas of them on the workers, E_THUMBNAILSREADY
+    /// is sent when done. A request while building is started after it, only the last one is kept.
+    void BuildAsync(const Vector<String>& resourceNames);
+    bool IsBuilding() const { return !jobs_.Empty(); }
+
+    /// Atlas png and its json index, they only exist after the first build.
+    String GetAtlasFileName() const;
+    String GetIndexFileName() const;
+
+private:
+    struct ThumbnailJob{
+        String resourceName_;
+        // opened by QueueNext(), closed once the job is done
+        SharedPtr<File> source_;
+        SharedPtr<Image> image_;
+        String cacheDir_;
+        SharedPtr<WorkItem> item_;
+
+        // results
+        unsigned long long hash_ = 0;
+        bool valid_ = false;
+        PODVector<unsigned char> icon_;
+    };
+
+    static void ThumbnailWork(const WorkItem* item, unsigned threadIndex);
+    void HandleWorkItemCompleted(StringHash eventType, VariantMap& eventData);
+    /// Queue the next job, decoded images are big, so only a few are in flight.
+    void QueueNext();
+    /// Write the atlas once every job is done and start the pending request.
+    void FinishBuild();
+    void WriteAtlas();
+
+    /// fixed size while building, the work items point into it
+    Vector<ThumbnailJob> jobs_;
+    unsigned nextJob_;
+    unsigned numFinished_;
+    Vector<String> pending_;
+    bool hasPending_;
+};
@@ -27,96 +27,262 @@
 
    René Nyffenegger rene.nyffenegger@adp-gmbh.ch
 
+   Altered for the scene loader: the encoder and decoder work on caller provided
+   buffers with exact size prediction and have SSSE3 and AArch64 NEON paths.
+   The std::string functions are kept on top of them.
+
 */
 
 #include "base64.h"
-#include <iostream>
 
-static const std::string base64_chars = 
+#include <cstring>
+
+#if defined(BASE64_NO_SIMD)
+// scalar only, the checks compare the vector paths with it
+#elif defined(__SSSE3__) || defined(__AVX__)
+#define BASE64_SSSE3
+#include <tmmintrin.h>
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define BASE64_NEON
+#include <arm_neon.h>
+#endif
+
+static const char base64_chars[] =
              "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
              "abcdefghijklmnopqrstuvwxyz"
              "0123456789+/";
 
+static const unsigned char INVALID = 0xff;
 
-static inline bool is_base64(unsigned char c) {
-  return (isalnum(c) || (c == '+') || (c == '/'));
-}
+// character -> 6 bit value, INVALID for everything else (the padding too)
+struct decode_table {
+  unsigned char values[256];
 
-std::string base64_encode(unsigned char const* bytes_to_encode, unsigned int in_len) {
-  std::string ret;
-  int i = 0;
-  int j = 0;
-  unsigned char char_array_3[3];
-  unsigned char char_array_4[4];
-
-  while (in_len--) {
-    char_array_3[i++] = *(bytes_to_encode++);
-    if (i == 3) {
-      char_array_4[0] = (char_array_3[0] & 0xfc) >> 2;
-      char_array_4[1] = ((char_array_3[0] & 0x03) << 4) + ((char_array_3[1] & 0xf0) >> 4);
-      char_array_4[2] = ((char_array_3[1] & 0x0f) << 2) + ((char_array_3[2] & 0xc0) >> 6);
-      char_array_4[3] = char_array_3[2] & 0x3f;
-
-      for(i = 0; (i <4) ; i++)
-        ret += base64_chars[char_array_4[i]];
-      i = 0;
-    }
+  decode_table() {
+    memset(values, INVALID, sizeof(values));
+    for (unsigned char i = 0; i < 64; i++)
+      values[(unsigned char)base64_chars[i]] = i;
   }
+};
+
+static const decode_table decode_lookup;
+
+#if defined(BASE64_SSSE3)
+
+// 12 bytes of the 16 loaded are encoded, see http://0x80.pl/notesen/2016-01-12-sse-base64-encoding.html
+static inline void encode_block(const unsigned char* in, char* out) {
+  __m128i input = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in));
+  input = _mm_shuffle_epi8(input, _mm_setr_epi8(1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10));
+
+  // 6 bit indices, each into its own byte
+  const __m128i t0 = _mm_and_si128(input, _mm_set1_epi32(0x0fc0fc00));
+  const __m128i t1 = _mm_mulhi_epu16(t0, _mm_set1_epi32(0x04000040));
+  const __m128i t2 = _mm_and_si128(input, _mm_set1_epi32(0x003f03f0));
+  const __m128i t3 = _mm_mullo_epi16(t2, _mm_set1_epi32(0x01000010));
+  const __m128i indices = _mm_or_si128(t1, t3);
+
+  // offset to add to each index: 0..25 'A', 26..51 'a', 52..61 '0', 62 '+', 63 '/'
+  __m128i range = _mm_subs_epu8(indices, _mm_set1_epi8(51));
+  const __m128i less = _mm_cmpgt_epi8(_mm_set1_epi8(26), indices);
+  range = _mm_or_si128(range, _mm_and_si128(less, _mm_set1_epi8(13)));
+  const __m128i offsets = _mm_setr_epi8(
+      'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+      '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62,
+      '/' - 63, 'A', 0, 0);
+  const __m128i chars = _mm_add_epi8(_mm_shuffle_epi8(offsets, range), indices);
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(out), chars);
+}
 
-  if (i)
-  {
-    for(j = i; j < 3; j++)
-      char_array_3[j] = '\0';
-
-    char_array_4[0] = ( char_array_3[0] & 0xfc) >> 2;
-    char_array_4[1] = ((char_array_3[0] & 0x03) << 4) + ((char_array_3[1] & 0xf0) >> 4);
-    char_array_4[2] = ((char_array_3[1] & 0x0f) << 2) + ((char_array_3[2] & 0xc0) >> 6);
+static inline __m128i in_range(__m128i input, char first, char last) {
+  return _mm_and_si128(_mm_cmpgt_epi8(input, _mm_set1_epi8(first - 1)),
+                       _mm_cmplt_epi8(input, _mm_set1_epi8(last + 1)));
+}
 
-    for (j = 0; (j < i + 1); j++)
-      ret += base64_chars[char_array_4[j]];
+// 16 characters into 12 bytes, false if one of them is not base64 (that includes padding)
+static inline bool decode_block(const char* in, unsigned char* out) {
+  const __m128i input = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in));
+
+  // bytes >= 0x80 are negative and in none of the ranges
+  const __m128i upper = in_range(input, 'A', 'Z');
+  const __m128i lower = in_range(input, 'a', 'z');
+  const __m128i digit = in_range(input, '0', '9');
+  const __m128i plus = _mm_cmpeq_epi8(input, _mm_set1_epi8('+'));
+  const __m128i slash = _mm_cmpeq_epi8(input, _mm_set1_epi8('/'));
+  const __m128i valid = _mm_or_si128(_mm_or_si128(upper, lower), _mm_or_si128(_mm_or_si128(digit, plus), slash));
+  if (_mm_movemask_epi8(valid) != 0xffff)
+    return false;
+
+  __m128i shift = _mm_and_si128(upper, _mm_set1_epi8(-'A'));
+  shift = _mm_or_si128(shift, _mm_and_si128(lower, _mm_set1_epi8(26 - 'a')));
+  shift = _mm_or_si128(shift, _mm_and_si128(digit, _mm_set1_epi8(52 - '0')));
+  shift = _mm_or_si128(shift, _mm_and_si128(plus, _mm_set1_epi8(62 - '+')));
+  shift = _mm_or_si128(shift, _mm_and_si128(slash, _mm_set1_epi8(63 - '/')));
+  const __m128i values = _mm_add_epi8(input, shift);
+
+  // aabbccdd pairs to 12 bits, then to 24 bits per 32, then the 3 bytes in order
+  const __m128i pairs = _mm_maddubs_epi16(values, _mm_set1_epi32(0x01400140));
+  const __m128i packed = _mm_madd_epi16(pairs, _mm_set1_epi32(0x00011000));
+  const __m128i bytes = _mm_shuffle_epi8(packed, _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+
+  _mm_storel_epi64(reinterpret_cast<__m128i*>(out), bytes);
+  const int tail = _mm_cvtsi128_si32(_mm_srli_si128(bytes, 8));
+  memcpy(out + 8, &tail, 4);
+  return true;
+}
 
-    while((i++ < 3))
-      ret += '=';
+static const size_t ENCODE_BLOCK_IN = 12;
+static const size_t ENCODE_BLOCK_READ = 16;
+static const size_t DECODE_BLOCK_IN = 16;
+
+#elif defined(BASE64_NEON)
+
+// 48 bytes into 64 characters
+static inline void encode_block(const unsigned char* in, char* out) {
+  static const uint8x16x4_t table = vld1q_u8_x4(reinterpret_cast<const uint8_t*>(base64_chars));
+  const uint8x16x3_t input = vld3q_u8(in);
+  uint8x16x4_t indices;
+  indices.val[0] = vshrq_n_u8(input.val[0], 2);
+  indices.val[1] = vorrq_u8(vshlq_n_u8(vandq_u8(input.val[0], vdupq_n_u8(0x03)), 4), vshrq_n_u8(input.val[1], 4));
+  indices.val[2] = vorrq_u8(vshlq_n_u8(vandq_u8(input.val[1], vdupq_n_u8(0x0f)), 2), vshrq_n_u8(input.val[2], 6));
+  indices.val[3] = vandq_u8(input.val[2], vdupq_n_u8(0x3f));
+
+  uint8x16x4_t chars;
+  for (int i = 0; i < 4; i++)
+    chars.val[i] = vqtbl4q_u8(table, indices.val[i]);
+  vst4q_u8(reinterpret_cast<uint8_t*>(out), chars);
+}
 
+// 64 characters into 48 bytes, false if one of them is not base64 (that includes padding)
+static inline bool decode_block(const char* in, unsigned char* out) {
+  static const uint8x16x4_t table_low = vld1q_u8_x4(decode_lookup.values);
+  static const uint8x16x4_t table_high = vld1q_u8_x4(decode_lookup.values + 64);
+  const uint8x16x4_t input = vld4q_u8(reinterpret_cast<const uint8_t*>(in));
+
+  // lookup of 0..63 from the low table, 64..127 from the high one, bytes >= 128 stay INVALID
+  uint8x16x4_t values;
+  uint8x16_t invalid = vdupq_n_u8(0);
+  for (int i = 0; i < 4; i++) {
+    values.val[i] = vqtbx4q_u8(vqtbl4q_u8(table_low, input.val[i]), table_high, vsubq_u8(input.val[i], vdupq_n_u8(64)));
+    values.val[i] = vbslq_u8(vcgeq_u8(input.val[i], vdupq_n_u8(128)), vdupq_n_u8(INVALID), values.val[i]);
+    invalid = vorrq_u8(invalid, values.val[i]);
   }
+  if (vmaxvq_u8(invalid) >= 64)
+    return false;
+
+  uint8x16x3_t bytes;
+  bytes.val[0] = vorrq_u8(vshlq_n_u8(values.val[0], 2), vshrq_n_u8(values.val[1], 4));
+  bytes.val[1] = vorrq_u8(vshlq_n_u8(values.val[1], 4), vshrq_n_u8(values.val[2], 2));
+  bytes.val[2] = vorrq_u8(vshlq_n_u8(values.val[2], 6), values.val[3]);
+  vst3q_u8(out, bytes);
+  return true;
+}
 
-  return ret;
+static const size_t ENCODE_BLOCK_IN = 48;
+static const size_t ENCODE_BLOCK_READ = 48;
+static const size_t DECODE_BLOCK_IN = 64;
+
+#endif
 
+size_t base64_encoded_size(size_t len) {
+  return (len + 2) / 3 * 4;
 }
 
-std::string base64_decode(std::string const& encoded_string) {
-  int in_len = encoded_string.size();
-  int i = 0;
-  int j = 0;
-  int in_ = 0;
-  unsigned char char_array_4[4], char_array_3[3];
-  std::string ret;
-
-  while (in_len-- && ( encoded_string[in_] != '=') && is_base64(encoded_string[in_])) {
-    char_array_4[i++] = encoded_string[in_]; in_++;
-    if (i ==4) {
-      for (i = 0; i <4; i++)
-        char_array_4[i] = base64_chars.find(char_array_4[i]);
-
-      char_array_3[0] = ( char_array_4[0] << 2       ) + ((char_array_4[1] & 0x30) >> 4);
-      char_array_3[1] = ((char_array_4[1] & 0xf) << 4) + ((char_array_4[2] & 0x3c) >> 2);
-      char_array_3[2] = ((char_array_4[2] & 0x3) << 6) +   char_array_4[3];
-
-      for (i = 0; (i < 3); i++)
-        ret += char_array_3[i];
-      i = 0;
-    }
+size_t base64_decoded_size(const char* in, size_t len) {
+  while (len && in[len - 1] == '=')
+    len--;
+  // a single character of a last group doesn't make a byte
+  size_t rest = len % 4;
+  return len / 4 * 3 + (rest ? rest - 1 : 0);
+}
+
+size_t base64_encode(const unsigned char* in, size_t len, char* out) {
+  size_t i = 0;
+  char* start = out;
+
+#if defined(BASE64_SSSE3) || defined(BASE64_NEON)
+  for (; len - i >= ENCODE_BLOCK_READ; i += ENCODE_BLOCK_IN, out += ENCODE_BLOCK_IN / 3 * 4)
+    encode_block(in + i, out);
+#endif
+
+  for (; len - i >= 3; i += 3, out += 4) {
+    unsigned triple = (in[i] << 16) | (in[i + 1] << 8) | in[i + 2];
+    out[0] = base64_chars[(triple >> 18) & 0x3f];
+    out[1] = base64_chars[(triple >> 12) & 0x3f];
+    out[2] = base64_chars[(triple >> 6) & 0x3f];
+    out[3] = base64_chars[triple & 0x3f];
   }
 
-  if (i) {
-    for (j = 0; j < i; j++)
-      char_array_4[j] = base64_chars.find(char_array_4[j]);
+  if (i < len) {
+    unsigned triple = in[i] << 16;
+    if (len - i == 2)
+      triple |= in[i + 1] << 8;
+    out[0] = base64_chars[(triple >> 18) & 0x3f];
+    out[1] = base64_chars[(triple >> 12) & 0x3f];
+    out[2] = len - i == 2 ? base64_chars[(triple >> 6) & 0x3f] : '=';
+    out[3] = '=';
+    out += 4;
+  }
+  return out - start;
+}
 
-    char_array_3[0] = (char_array_4[0] << 2) + ((char_array_4[1] & 0x30) >> 4);
-    char_array_3[1] = ((char_array_4[1] & 0xf) << 4) + ((char_array_4[2] & 0x3c) >> 2);
+size_t base64_decode(const char* in, size_t len, unsigned char* out) {
+  while (len && in[len - 1] == '=')
+    len--;
+
+  size_t i = 0;
+  unsigned char* start = out;
+  const unsigned char* values = decode_lookup.values;
+
+#if defined(BASE64_SSSE3) || defined(BASE64_NEON)
+  // a block that doesn't decode is left to the scalar loop, which finds the bad character
+  for (; len - i >= DECODE_BLOCK_IN; i += DECODE_BLOCK_IN, out += DECODE_BLOCK_IN / 4 * 3) {
+    if (!decode_block(in + i, out))
+      break;
+  }
+#endif
+
+  for (; len - i >= 4; i += 4, out += 3) {
+    unsigned char a = values[(unsigned char)in[i]];
+    unsigned char b = values[(unsigned char)in[i + 1]];
+    unsigned char c = values[(unsigned char)in[i + 2]];
+    unsigned char d = values[(unsigned char)in[i + 3]];
+    // INVALID is the only value with the upper bits set
+    if ((a | b | c | d) & 0xc0)
+      return BASE64_ERROR;
+    out[0] = (unsigned char)((a << 2) | (b >> 4));
+    out[1] = (unsigned char)((b << 4) | (c >> 2));
+    out[2] = (unsigned char)((c << 6) | d);
+  }
 
-    for (j = 0; (j < i - 1); j++) ret += char_array_3[j];
+  size_t rest = len - i;
+  unsigned char group[3] = { 0, 0, 0 };
+  for (size_t j = 0; j < rest; j++) {
+    group[j] = values[(unsigned char)in[i + j]];
+    if (group[j] == INVALID)
+      return BASE64_ERROR;
   }
+  if (rest > 1)
+    *out++ = (unsigned char)((group[0] << 2) | (group[1] >> 4));
+  if (rest > 2)
+    *out++ = (unsigned char)((group[1] << 4) | (group[2] >> 2));
+  return out - start;
+}
 
+std::string base64_encode(unsigned char const* bytes_to_encode, unsigned int in_len) {
+  std::string ret(base64_encoded_size(in_len), '\0');
+  if (in_len)
+    base64_encode(bytes_to_encode, in_len, &ret[0]);
+  return ret;
+}
+
+std::string base64_decode(std::string const& encoded_string) {
+  // everything up to the padding or the first character that isn't base64
+  size_t len = 0;
+  while (len < encoded_string.size() && decode_lookup.values[(unsigned char)encoded_string[len]] != INVALID)
+    len++;
+
+  std::string ret(base64_decoded_size(encoded_string.data(), len), '\0');
+  if (!ret.empty())
+    base64_decode(encoded_string.data(), len, reinterpret_cast<unsigned char*>(&ret[0]));
   return ret;
 }
@@ -27,13 +27,34 @@
 
    René Nyffenegger rene.nyffenegger@adp-gmbh.ch
 
+   Altered for the scene loader: the encoder and decoder work on caller provided
+   buffers with exact size prediction and have SSSE3 and AArch64 NEON paths.
+   The std::string functions are kept on top of them.
+
 */
 #ifndef BASE64_H_C0CE2A47_D10E_42C9_A27C_C883944E704A
 #define BASE64_H_C0CE2A47_D10E_42C9_A27C_C883944E704A
 
+#include <cstddef>
 #include <string>
 
+/// Returned by base64_decode() for input that is not base64.
+static const size_t BASE64_ERROR = (size_t)-1;
+
+/// Exact number of characters base64_encode() writes for len bytes, including the padding.
+size_t base64_encoded_size(size_t len);
+/// Exact number of bytes base64_decode() writes for these len characters, padded or not.
+size_t base64_decoded_size(const char* in, size_t len);
+
+/// Encode len bytes into out, which has room for base64_encoded_size(len) characters. No
+/// terminating zero is written. Return the number of characters written.
+size_t base64_encode(const unsigned char* in, size_t len, char* out);
+/// Decode len characters into out, which has room for base64_decoded_size(in, len) bytes.
+/// Padding is optional. Return the number of bytes written or BASE64_ERROR.
+size_t base64_decode(const char* in, size_t len, unsigned char* out);
+
 std::string base64_encode(unsigned char const* , unsigned int len);
+/// Decodes up to the first character that is not base64, like it always did.
 std::string base64_decode(std::string const& s);
 
 #endif /* BASE64_H_C0CE2A47_D10E_42C9_A27C_C883944E704A */
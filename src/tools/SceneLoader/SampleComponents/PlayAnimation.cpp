@@ -1,5 +1,11 @@
 #include "PlayAnimation.h"
 #include <Urho3D/Urho3DAll.h>
+#include <AttributeTable.h>
+
+static constexpr AttributeDesc PLAYANIMATION_ATTRIBUTES[] = {
+    AttrResourceRef("Animation", "Animation"),
+    AttrFloat("speed", 1.0f, AM_DEFAULT, AST_FACTOR),
+};
 
 PlayAnimation::PlayAnimation(Context *ctx)
     : LogicComponent(ctx),animControl(0),speed(1)
@@ -9,9 +15,10 @@ void PlayAnimation::RegisterObject(Context *context)
 {
     context->RegisterFactory<PlayAnimation>("Sample Component");
 
-    URHO3D_MIXED_ACCESSOR_ATTRIBUTE("Animation", GetAnimation, SetAnimation, ResourceRef, ResourceRef(Animation::GetTypeStatic()), AM_DEFAULT);
+    URHO3D_TABLE_ACCESSOR_ATTRIBUTE(PLAYANIMATION_ATTRIBUTES, "Animation", GetAnimation, SetAnimation, ResourceRef);
     //URHO3D_ACCESSOR_ATTRIBUTE("animationFile", GetAnimationFile, SetAnimationFile, String, String::EMPTY, AM_DEFAULT);
-    URHO3D_ATTRIBUTE("speed", float, speed, 1.0f, AM_DEFAULT);
+    URHO3D_TABLE_ATTRIBUTE(PLAYANIMATION_ATTRIBUTES, "speed", speed);
+    URHO3D_ATTRIBUTE_TABLE(PLAYANIMATION_ATTRIBUTES);
 }
 
 void PlayAnimation::SetAnimationFile(const String &animFile)
@@ -23,6 +23,12 @@
 #include "Rotator.h"
 
 #include <Urho3D/Urho3DAll.h>
+#include <AttributeTable.h>
+
+static constexpr AttributeDesc ROTATOR_ATTRIBUTES[] = {
+    AttrVector3("Axis", 0.0f, 0.0f, 0.0f, AM_FILE),
+    AttrFloat("Speed", DEFAULT_ROTATOR_SPEED, AM_FILE),
+};
 
 
 Rotator::Rotator(Context* context) :
@@ -37,10 +43,10 @@ void Rotator::RegisterObject(Context* context)
 {
     context->RegisterFactory<Rotator>("Sample Component");
 
-    // These macros register the class attributes to the Context for automatic load / save handling.
-    // We specify the Default attribute mode which means it will be used both for saving into file, and network replication
-    URHO3D_ATTRIBUTE("Axis", Vector3, axis_ , Vector3::ZERO, AM_FILE);
-    URHO3D_ATTRIBUTE("Speed", float, speed_, DEFAULT_ROTATOR_SPEED, AM_FILE);
+    // names, defaults and modes are in ROTATOR_ATTRIBUTES
+    URHO3D_TABLE_ATTRIBUTE(ROTATOR_ATTRIBUTES, "Axis", axis_);
+    URHO3D_TABLE_ATTRIBUTE(ROTATOR_ATTRIBUTES, "Speed", speed_);
+    URHO3D_ATTRIBUTE_TABLE(ROTATOR_ATTRIBUTES);
 }
 
 void Rotator::DelayedStart()
@@ -28,7 +28,7 @@
 
 using namespace Urho3D;
 
-const float DEFAULT_ROTATOR_SPEED = 1.0f;
+constexpr float DEFAULT_ROTATOR_SPEED = 1.0f;
 
 /// Rotator component, responsible for physical movement according to controls, as well as animation.
 class Rotator : public LogicComponent
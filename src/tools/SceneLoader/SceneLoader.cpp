@@ -36,7 +36,17 @@
 
 #include "SceneLoader.h"
 
+#include "LoaderTools/CollisionCache.h"
 #include "LoaderTools/ComponentExporter.h"
+#include "LoaderTools/LoaderCache.h"
+#include "LoaderTools/LodBuilder.h"
+#include "LoaderTools/ResourceArchive.h"
+#include "LoaderTools/ResourcePreloader.h"
+#include "LoaderTools/SceneCache.h"
+#include "LoaderTools/StartupProfiler.h"
+#include "LoaderTools/StaticBatcher.h"
+#include "LoaderTools/TextureCooker.h"
+#include "LoaderTools/ThumbnailBuilder.h"
 #include "commonComponents/CommonComponents.h"
 #include "SampleComponents/SampleComponents.h"
 
@@ -52,6 +62,8 @@ SceneLoader::SceneLoader(Context* context) :
     Sample(context)
     ,sceneName("Scene.xml")
     ,exportPath("./urho3d_components.json")
+    ,rpcIdentity("runtime")
+    ,replayFast_(false)
     ,currentCamId(0)
     ,showViewportId(0)
     ,updatedCamera(false)
@@ -64,13 +76,26 @@ SceneLoader::SceneLoader(Context* context) :
     ,surface(0)
     ,jsonfile_(context)
     ,currentViewRenderer(0)
+    ,cookTexturesOnly_(false)
+    ,packOnly_(false)
+    ,exportOnly_(false)
 {
+    // first, so it can follow the other subsystems through startup
+    context->RegisterSubsystem(new StartupProfiler(context));
     // register component exporter
     context->RegisterSubsystem(new Urho3DNodeTreeExporter(context));
+    // keeps the scenes blender asks for within a memory budget
+    context->RegisterSubsystem(new SceneCache(context));
+    context->RegisterSubsystem(new CollisionCache(context));
+    context->RegisterSubsystem(new StaticBatcher(context));
+    context->RegisterSubsystem(new LodBuilder(context));
+    context->RegisterSubsystem(new TextureCooker(context));
+    context->RegisterSubsystem(new ResourcePreloader(context));
+    context->RegisterSubsystem(new ResourceArchive(context));
+    context->RegisterSubsystem(new ThumbnailBuilder(context));
 
-    BlenderNetwork* bN = new BlenderNetwork(context);
-    bN->InitNetwork();
-    context->RegisterSubsystem(bN);
+    // connected in Setup(), the tool modes don't need it
+    context->RegisterSubsystem(new BlenderNetwork(context));
 
 
     // register group instance component
@@ -81,8 +106,70 @@ SceneLoader::SceneLoader(Context* context) :
 }
 
 
+void SceneLoader::Setup()
+{
+    Sample::Setup();
+
+    const Vector<String>& args = GetArguments();
+    for (unsigned i=0;i < args.Size(); i++){
+        const String& arg = args[i];
+        if (arg=="--profile-startup"){
+            // optional report filename
+            String reportFileName = "./startup_profile.json";
+            if ((i+1)<args.Size() && !args[i+1].StartsWith("--")){
+                reportFileName = args[++i];
+            }
+            GetSubsystem<StartupProfiler>()->SetEnabled(true,reportFileName);
+        }
+        else if (arg=="--cook-textures"){
+            cookTexturesOnly_ = true;
+        }
+        else if (arg=="--pack"){
+            packOnly_ = true;
+        }
+        else if (arg=="--export-only"){
+            exportOnly_ = true;
+        }
+        else if (arg=="--rpc-id" && (i+1)<args.Size()){
+            // the name blender sends its requests for this runtime to
+            rpcIdentity = args[++i];
+        }
+        else if (arg=="--record" && (i+1)<args.Size()){
+            recordFileName = args[++i];
+        }
+        else if (arg=="--replay" && (i+1)<args.Size()){
+            replayFileName = args[++i];
+        }
+        else if (arg=="--replay-fast"){
+            replayFast_ = true;
+        }
+    }
+    BlenderNetwork* blenderNetwork = GetSubsystem<BlenderNetwork>();
+    if (cookTexturesOnly_ || packOnly_ || exportOnly_){
+        engineParameters_[EP_HEADLESS]=true;
+        engineParameters_[EP_SOUND]=false;
+    }
+    else if (!replayFileName.Empty()){
+        // no blender, the messages come from the recording and everything sent is dropped
+        if (!blenderNetwork->StartReplay(replayFileName,replayFast_)){
+            ErrorExit("can't replay "+replayFileName);
+            return;
+        }
+    }
+    else {
+        blenderNetwork->InitNetwork(rpcIdentity);
+        if (!recordFileName.Empty()){
+            blenderNetwork->StartRecording(recordFileName);
+        }
+    }
+    GetSubsystem<StartupProfiler>()->BeginPhase("EngineInitialize");
+}
+
 void SceneLoader::Start()
 {
+    StartupProfiler* profiler = GetSubsystem<StartupProfiler>();
+    profiler->BeginPhase("ParseArguments");
+
     ResourceCache* cache = GetSubsystem<ResourceCache>();
     Globals::instance()->cache=cache;
 
@@ -121,20 +208,99 @@ void SceneLoader::Start()
             i++;
             URHO3D_LOGINFOF("[SceneLoader] customui: %s",customUI.CString());
         }
+        else if (args[i]=="--scenecache-budget" && (i+1)<args.Size()){
+            // budget in MB, 0 keeps all scenes resident
+            unsigned budget = ToUInt(args[i+1]);
+            GetSubsystem<SceneCache>()->SetMemoryBudget((unsigned long long)budget * 1024 * 1024);
+            i++;
+            URHO3D_LOGINFOF("[SceneLoader] scene-cache budget: %uMB",budget);
+        }
 
     }
+    LoaderCache::SetRootDir(additionalResourcePath);
+
+    // small messages of a frame go out as one envelope per topic, blender has to unpack them
+    if (GetRuntimeFlag("batchsend")){
+        GetSubsystem<BlenderNetwork>()->SetBatching(true);
+    }
+
+    if (cookTexturesOnly_){
+        SetupExporter();
+        GetSubsystem<TextureCooker>()->CookTextureFolders(GetSubsystem<Urho3DNodeTreeExporter>()->GetTextureFolders());
+        engine_->Exit();
+        return;
+    }
+
+    // the factories are registered in the constructor, that is all the export needs
+    if (exportOnly_){
+        SetupExporter();
+        if (!GetSubsystem<Urho3DNodeTreeExporter>()->Export(exportPath)){
+            exitCode_ = EXIT_FAILURE;
+        }
+        engine_->Exit();
+        return;
+    }
+
+    if (packOnly_){
+        if (additionalResourcePath.Empty()){
+            URHO3D_LOGERROR("[SceneLoader] --pack needs a --workingdir to pack");
+        } else {
+            GetSubsystem<ResourceArchive>()->Pack(additionalResourcePath,ResourceArchive::GetDefaultFileName(context_));
+        }
+        engine_->Exit();
+        return;
+    }
+
+    // serve the working directory from its archive (see --pack), changed files are still read from disk
+    if (GetRuntimeFlag("pack")){
+        String archiveFileName = ResourceArchive::GetDefaultFileName(context_);
+        if (!fs->FileExists(archiveFileName)){
+            URHO3D_LOGWARNINGF("[SceneLoader] no resource archive at %s, run with --pack first",archiveFileName.CString());
+        } else {
+            GetSubsystem<ResourceArchive>()->Mount(archiveFileName);
+        }
+    }
+
     // Execute base class startup
+    profiler->BeginPhase("Sample::Start");
     Sample::Start();
 
+    profiler->BeginPhase("SetupExporter");
+    SetupExporter();
+
+    // textures are read from their cooked dds files from now on
+    if (GetRuntimeFlag("texturecache")){
+        profiler->BeginPhase("CookTextures");
+        TextureCooker* cooker = GetSubsystem<TextureCooker>();
+        Urho3DNodeTreeExporter* exporter = GetSubsystem<Urho3DNodeTreeExporter>();
+        cooker->CookTextureFolders(exporter->GetTextureFolders());
+        cooker->ScanMaterialFolders(exporter->GetMaterialFolders());
+        cooker->SetRoutingEnabled(true);
+    }
+
+    // lod levels have to be in place before the scene loads its models
+    String lodDistances;
+    if (GetRuntimeFlag("lod",&lodDistances)){
+        profiler->BeginPhase("BuildLods");
+        LodBuilder* lodBuilder = GetSubsystem<LodBuilder>();
+        if (!lodDistances.Empty()){
+            lodBuilder->SetLodDistances(lodDistances);
+        }
+        lodBuilder->ProcessModelFolders(GetSubsystem<Urho3DNodeTreeExporter>()->GetModelFolders());
+    }
+
     // Create the scene content
+    profiler->BeginPhase("CreateScene");
     bool foundScene = CreateScene();
     if (!foundScene)
         return;
 
     // Create the UI content
+    profiler->BeginPhase("CreateUI");
     CreateUI();
 
     // Setup the viewport for displaying the scene
+    profiler->BeginPhase("SetupViewport");
     SetupViewport();
 
     // Subscribe to global events for camera movement
@@ -143,9 +309,18 @@ void SceneLoader::Start()
     // Set the mouse mode to use in the sample
     Sample::InitMouseMode(MM_FREE);
 
+    // the export runs on a worker, its task ends in HandleComponentExportFinished
+    profiler->BeginPhase("StartExport");
+    profiler->BeginTask("ExportComponents");
     ExportComponents(exportPath);
 
+    // texture previews are built in the background, blender gets them when they are done
+    if (GetRuntimeFlag("thumbnails")){
+        GetSubsystem<ThumbnailBuilder>()->BuildFolders(GetSubsystem<Urho3DNodeTreeExporter>()->GetTextureFolders());
+    }
 
+    // ends with the first rendered frame, then the report is written and the loader exits
+    profiler->BeginPhase("FirstFrame");
 }
 
 void SceneLoader::Stop()
@@ -156,7 +331,7 @@ void SceneLoader::Stop()
     }
 }
 
-void SceneLoader::ExportComponents(const String& outputPath)
+void SceneLoader::SetupExporter()
 {
     Urho3DNodeTreeExporter* exporter = GetSubsystem<Urho3DNodeTreeExporter>();
     // set whitelist-mode to tell the exporter what components to include for export
@@ -189,11 +364,183 @@ void SceneLoader::ExportComponents(const String& outputPath)
     if (!customUI.Empty()){
         exporter->AddCustomUIFile(customUI);
     }
-    exporter->Export(outputPath);
+    if (GetRuntimeFlag("thumbnails")){
+        ThumbnailBuilder* thumbnails = GetSubsystem<ThumbnailBuilder>();
+        exporter->SetThumbnailAtlas(thumbnails->GetAtlasFileName(),thumbnails->GetIndexFileName());
+    }
+}
+
+void SceneLoader::ExportComponents(const String& outputPath)
+{
+    // runs on a worker, blender is told in HandleComponentExportFinished.
+    // with netexport the export is not written to disk but sent over the network
+    Urho3DNodeTreeExporter* exporter = GetSubsystem<Urho3DNodeTreeExporter>();
+    exporter->ExportAsync(GetRuntimeFlag("netexport") ? String::EMPTY : outputPath);
+}
+
+void SceneLoader::HandleComponentExportFinished(StringHash eventType, VariantMap& eventData)
+{
+    using namespace ComponentExportFinished;
+    bool success = eventData[P_SUCCESS].GetBool();
+    String outputPath = eventData[P_FILENAME].GetString();
+    GetSubsystem<StartupProfiler>()->EndTask("ExportComponents");
+
+    // asked for over rpc, only the requesters get it. the others ask for a resync once
+    // the next patch doesn't fit their version
+    bool requested = !exportRequests_.Empty();
+    ReplyExportRequests(outputPath,success);
+
+    if (!success){
+        URHO3D_LOGERROR("[SceneLoader] component export failed");
+    }
+    else if (!outputPath.Empty()){
+        // blender reading the file has no resync, so it is always told
+        GetSubsystem<BlenderNetwork>()->Send("runtime","component-update",outputPath,"");
+    }
+    else if (!requested){
+        BroadcastComponentExport(eventData[P_UNCHANGED].GetBool());
+    }
+
+    // requests that came in while this export ran, whoever started it. started last, the
+    // worker takes the export data until it is done
+    Urho3DNodeTreeExporter* exporter = GetSubsystem<Urho3DNodeTreeExporter>();
+    if (!queuedExportRequests_.Empty() && !exporter->IsExporting()){
+        exportRequests_.Swap(queuedExportRequests_);
+        ExportComponents(exportPath);
+    }
+}
+
+void SceneLoader::BroadcastComponentExport(bool unchanged)
+{
+    // blender that has the previous version only gets the patch, everyone else asks for a
+    // resync (component-resync) and gets the full export. an unchanged export only sends the meta
+    Urho3DNodeTreeExporter* exporter = GetSubsystem<Urho3DNodeTreeExporter>();
+    if (!unchanged && !exporter->GetPatchData().Empty()){
+        JSONFile meta(context_);
+        JSONValue& metaRoot = meta.GetRoot();
+        metaRoot["version"] = exporter->GetExportVersion();
+        metaRoot["baseVersion"] = exporter->GetExportVersion() - 1;
+        metaRoot["hash"] = LoaderCache::HashToString(exporter->GetExportHash());
+        metaRoot["size"] = exporter->GetPatchDataSize();
+        metaRoot["compression"] = "lz4";
+
+        const PODVector<unsigned char>& patch = exporter->GetPatchData();
+        GetSubsystem<BlenderNetwork>()->Send("runtime","component-patch",const_cast<unsigned char*>(patch.Buffer()),patch.Size(),meta.ToString(""));
+        return;
+    }
+    SendComponentExport(unchanged);
+}
+
+void SceneLoader::SendComponentExport(bool unchanged)
+{
+    // the json as lz4 block. blender can skip parsing it if it already has an export with that hash
+    Urho3DNodeTreeExporter* exporter = GetSubsystem<Urho3DNodeTreeExporter>();
+    if (exporter->GetExportData().Empty())
+        return;
+
+    const PODVector<unsigned char>& data = exporter->GetExportData();
     BlenderNetwork* bN = GetSubsystem<BlenderNetwork>();
-    bN->Send("runtime","component-update",outputPath,"");
+    bN->Send("runtime","component-export",const_cast<unsigned char*>(data.Buffer()),unchanged ? 0 : data.Size(),GetComponentExportMeta(unchanged));
+}
+
+String SceneLoader::GetComponentExportMeta(bool unchanged)
+{
+    Urho3DNodeTreeExporter* exporter = GetSubsystem<Urho3DNodeTreeExporter>();
+    JSONFile meta(context_);
+    JSONValue& metaRoot = meta.GetRoot();
+    metaRoot["version"] = exporter->GetExportVersion();
+    metaRoot["hash"] = LoaderCache::HashToString(exporter->GetExportHash());
+    metaRoot["size"] = exporter->GetExportDataSize();
+    metaRoot["compression"] = "lz4";
+    metaRoot["unchanged"] = unchanged;
+    return meta.ToString("");
+}
+
+void SceneLoader::HandleExportRequest(RpcRequest& request)
+{
+    // an export that already runs might have started before the change the requester wants
+    // to see, so it waits for the next one
+    Urho3DNodeTreeExporter* exporter = GetSubsystem<Urho3DNodeTreeExporter>();
+    if (exporter->IsExporting()){
+        queuedExportRequests_.Push(request.id_);
+        return;
+    }
+    exportRequests_.Push(request.id_);
+    ExportComponents(exportPath);
+}
+
+void SceneLoader::ReplyExportRequests(const String& outputPath, bool success)
+{
+    if (exportRequests_.Empty())
+        return;
+
+    RpcChannel* rpc = GetSubsystem<BlenderNetwork>()->GetRpc();
+    if (!success){
+        for (unsigned id : exportRequests_){
+            rpc->Reply(id,RPC_ERROR,"export failed");
+        }
+        exportRequests_.Clear();
+        return;
+    }
+
+    // the full export, the requester may not have any version of it. with a file only its path
+    Urho3DNodeTreeExporter* exporter = GetSubsystem<Urho3DNodeTreeExporter>();
+    String meta;
+    if (!outputPath.Empty()){
+        JSONFile metaFile(context_);
+        metaFile.GetRoot()["path"] = outputPath;
+        meta = metaFile.ToString("");
+    } else {
+        meta = GetComponentExportMeta(false);
+    }
+    const unsigned char* data = outputPath.Empty() ? exporter->GetExportData().Buffer() : nullptr;
+    unsigned size = outputPath.Empty() ? exporter->GetExportData().Size() : 0;
+    for (unsigned id : exportRequests_){
+        rpc->Reply(id,RPC_OK,meta,data,size);
+    }
+    exportRequests_.Clear();
+}
+
+void SceneLoader::HandleRenderRequest(RpcRequest& request)
+{
+    // the same json as the broadcast view updates, replied to with the next frame of the view
+    RpcChannel* rpc = GetSubsystem<BlenderNetwork>()->GetRpc();
+    JSONFile json(context_);
+    if (!json.FromString(request.meta_) || !json.GetRoot().Contains("view_id")){
+        rpc->Reply(request.id_,RPC_ERROR,"render: view_id missing");
+        return;
+    }
+    const JSONValue& root = json.GetRoot();
+    HandleRequestFromBlender(root.GetObject());
+
+    int viewId = root.Get("view_id").GetInt();
+    ViewRenderer* view = GetViewRenderer(viewId);
+    if (!view){
+        rpc->Reply(request.id_,RPC_ERROR,"render: no view "+String(viewId));
+        return;
+    }
+    UpdateViewRenderer(view);
+    renderRequests_[viewId].Push(MakePair(request.id_,root.Get("seq").GetInt()));
+}
 
+void SceneLoader::HandleThumbnailsReady(StringHash eventType, VariantMap& eventData)
+{
+    // the atlas png as payload, its index (resource name -> cell) as meta
+    using namespace ThumbnailsReady;
+    File atlas(context_,eventData[P_ATLAS].GetString(),FILE_READ);
+    File index(context_,eventData[P_INDEX].GetString(),FILE_READ);
+    if (!atlas.IsOpen() || !index.IsOpen())
+        return;
 
+    PODVector<unsigned char> data(atlas.GetSize());
+    if (data.Size() && atlas.Read(data.Buffer(),data.Size()) != data.Size())
+        return;
+    String meta;
+    meta.Resize(index.GetSize());
+    if (meta.Length() && index.Read(&meta[0],meta.Length()) != meta.Length())
+        return;
+    BlenderNetwork* bN = GetSubsystem<BlenderNetwork>();
+    bN->Send("runtime","thumbnail-atlas",data.Buffer(),data.Size(),meta);
 }
 
 bool SceneLoader::CreateScene()
@@ -208,6 +555,8 @@ bool SceneLoader::CreateScene()
         return false;
     }
     cache->SetAutoReloadResources(true);
+    // load the scene's resources in parallel instead of one by one while the nodes are created
+    GetSubsystem<ResourcePreloader>()->PreloadScene("Scenes/"+sceneName);
     scene_->LoadXML(*file);
     Globals::instance()->scene=scene_;
 
@@ -242,19 +591,13 @@ bool SceneLoader::CreateScene()
 
 
 
-    PODVector<Node*> dest;
-    if (scene_->GetNodesWithTag(dest,"setmesh")){
-        for (Node* node : dest){
-            CollisionShape* shape = node->GetComponent<CollisionShape>();
-            if (shape && shape->GetShapeType() == SHAPE_TRIANGLEMESH){
-                StaticModel* model = node->GetComponent<StaticModel>();
-                shape->SetModel(model->GetModel());
-            }
-        }
-    }
+    ProcessSetMeshNodes(scene_);
+
     File saveFile(context_, "./scene.write.xml",FILE_WRITE);
     scene_->SaveXML(saveFile);
 
+    // after saving, the merged nodes have their StaticModels disabled
+    BatchStaticGeometry(scene_,true);
 
     return true;
 }
@@ -271,6 +614,7 @@ void SceneLoader::ReloadScene()
         URHO3D_LOGERRORF("SceneLoader could not find 'Scenes/%s' in its resource-path",sceneName.CString());
         engine_->Exit();
     }
+    GetSubsystem<StaticBatcher>()->ClearScene(scene_);
     scene_->LoadXML(*file);
 
     // check if the scene has a light
@@ -294,12 +638,61 @@ void SceneLoader::ReloadScene()
 //        light->SetBrightness(2.5f);
 //    }
 
+    ProcessSetMeshNodes(scene_);
+
     UpdateCameras();
 
     File saveFile(context_, "./scene.write.xml",FILE_WRITE);
     scene_->SaveXML(saveFile);
 
+    BatchStaticGeometry(scene_,false);
+
+
+}
+
+void SceneLoader::ProcessSetMeshNodes(Scene* scene)
+{
+    // triangle-mesh shapes of nodes tagged "setmesh" use the node's model.
+    // the bullet data is restored from the collision-cache or built on the worker threads
+    PODVector<Node*> dest;
+    if (scene->GetNodesWithTag(dest,"setmesh")){
+        GetSubsystem<CollisionCache>()->ProcessSetMeshNodes(dest);
+    }
+}
+
+void SceneLoader::BatchStaticGeometry(Scene* scene, bool measure)
+{
+    String cellSize;
+    if (!GetRuntimeFlag("staticbatch",&cellSize))
+        return;
+
+    StaticBatcher* batcher = GetSubsystem<StaticBatcher>();
+    float size = cellSize.Empty() ? StaticBatcher::DEFAULT_CELL_SIZE : ToFloat(cellSize);
+    if (measure){
+        // render some frames unbatched first to report the difference
+        batcher->BatchSceneMeasured(scene,size);
+    } else {
+        batcher->BatchScene(scene,size);
+    }
+}
 
+bool SceneLoader::GetRuntimeFlag(const String& name, String* value) const
+{
+    for (const String& flag : runtimeFlags){
+        String flagName = flag.Trimmed();
+        String flagValue;
+        unsigned colon = flagName.Find(':');
+        if (colon != String::NPOS){
+            flagValue = flagName.Substring(colon+1);
+            flagName = flagName.Substring(0,colon);
+        }
+        if (flagName == name){
+            if (value)
+                *value = flagValue;
+            return true;
+        }
+    }
+    return false;
 }
 
 void SceneLoader::UpdateCameras()
@@ -345,9 +738,25 @@ void SceneLoader::SubscribeToEvents()
     SubscribeToEvent(E_UPDATE, URHO3D_HANDLER(SceneLoader, HandleUpdate));
     using namespace FileChanged;
     SubscribeToEvent(E_FILECHANGED, URHO3D_HANDLER(SceneLoader, HandleFileChanged));
+    SubscribeToEvent(E_COMPONENTEXPORTFINISHED, URHO3D_HANDLER(SceneLoader, HandleComponentExportFinished));
+    SubscribeToEvent(E_THUMBNAILSREADY, URHO3D_HANDLER(SceneLoader, HandleThumbnailsReady));
     SubscribeToEvent(E_ENDALLVIEWSRENDER, URHO3D_HANDLER(SceneLoader, HandleAfterRender));
-    using namespace BlenderConnect;
-    SubscribeToEvent(E_BLENDER_MSG, URHO3D_HANDLER(SceneLoader,HandleBlenderMSG));
+    BlenderNetwork* bN = GetSubsystem<BlenderNetwork>();
+    // a client whose component tree is not at the base version of a patch
+    bN->Subscribe("blender","component-resync",[this](StringHash, VariantMap&){ SendComponentExport(false); });
+    bN->Subscribe("blender","*",[this](StringHash route, VariantMap& data){ HandleBlenderMSG(route,data); });
+    // a viewport in blender was closed, its renderer goes and its scene may be evicted
+    bN->Subscribe("blender","view-closed",[this](StringHash, VariantMap& data){
+        JSONObject json = data[BlenderConnect::P_DATA].GetCustom<JSONObject>();
+        auto viewId = json.Find("view_id");
+        if (viewId != json.End())
+            ReleaseViewRenderer(viewId->second_.GetInt());
+    });
+
+    // requests that blender awaits the reply of
+    RpcChannel* rpc = bN->GetRpc();
+    rpc->SetHandler("export-components",[this](RpcRequest& request){ HandleExportRequest(request); });
+    rpc->SetHandler("render",[this](RpcRequest& request){ HandleRenderRequest(request); });
 }
 
 void SceneLoader::MoveCamera(float timeStep)
@@ -420,14 +829,17 @@ void SceneLoader::HandleFileChanged(StringHash eventType, VariantMap& eventData)
     String filename = eventData[P_FILENAME].GetString();
     String resName = eventData[P_RESOURCENAME].GetString();
     auto cache = GetSubsystem<ResourceCache>();
+    // the loader's own caches live in the resource dir, their writes are no changes of the scene
+    if (resName.StartsWith(".urho3d_cache")){
+        return;
+    }
     if (resName.StartsWith("Scenes")){
         ReloadScene();
-        if (scenes_.Contains(resName)){
-            SharedPtr<File> file = cache->GetFile(resName);
-            Scene* scene =scenes_[resName];
-            scene->LoadXML(*file);
-
+        SceneCache* sceneCache = GetSubsystem<SceneCache>();
+        Scene* scene = sceneCache->ReloadScene(resName);
+        if (scene){
             EnsureLight((scene));
+            BatchStaticGeometry(scene,false);
             for (ViewRenderer* view : viewRenderers.Values()){
                 if (view->GetScene() == scene){
                     view->RequestRender();
@@ -436,11 +848,32 @@ void SceneLoader::HandleFileChanged(StringHash eventType, VariantMap& eventData)
             }
         }
     }
+    if (resName.EndsWith(".mdl") && GetRuntimeFlag("lod")){
+        // the resource-cache reloaded the plain model already, give it its lod levels back
+        Vector<String> models;
+        models.Push(resName);
+        GetSubsystem<LodBuilder>()->ProcessModels(models);
+    }
+    if (resName.EndsWith(".xml") && GetRuntimeFlag("texturecache")){
+        // a changed material can reference textures that were not routed to their cooked file yet
+        for (const String& folder : GetSubsystem<Urho3DNodeTreeExporter>()->GetMaterialFolders()){
+            if (resName.StartsWith(folder+"/")){
+                GetSubsystem<TextureCooker>()->ScanMaterial(resName);
+                break;
+            }
+        }
+    }
     if (resName.EndsWith("png") || resName.EndsWith("jpg") || resName.EndsWith("dds")){
-        Urho3DNodeTreeExporter* exporter = GetSubsystem<Urho3DNodeTreeExporter>();
-        exporter->Export(exportPath);
-        BlenderNetwork* bN = GetSubsystem<BlenderNetwork>();
-        bN->Send("runtime","component-update",exportPath,"");
+        if (GetRuntimeFlag("texturecache") && !resName.EndsWith("dds")){
+            // the texture was reloaded from the source, the next load uses the new cooked file
+            Vector<String> textures;
+            textures.Push(resName);
+            GetSubsystem<TextureCooker>()->CookTextures(textures);
+        }
+        if (GetRuntimeFlag("thumbnails")){
+            GetSubsystem<ThumbnailBuilder>()->BuildFolders(GetSubsystem<Urho3DNodeTreeExporter>()->GetTextureFolders());
+        }
+        ExportComponents(exportPath);
     }
 //    else if (resName=="req2engine.json"){
 //        JSONFile json(context_);
@@ -468,21 +901,27 @@ void SceneLoader::ChangeFov(float delta)
     cam->SetFov(fov);
 }
 
-void SceneLoader::HandleBlenderMSG(StringHash eventType, VariantMap &eventData)
+void SceneLoader::HandleBlenderMSG(StringHash route, VariantMap &eventData)
 {
     using namespace BlenderConnect;
-    auto topic = eventData[P_TOPIC].GetString();
     auto d = eventData[P_DATA];
     JSONObject data  =  d.GetCustom<JSONObject>();
     //*static_cast<JSONObject*>(eventData[P_DATA].GetVoidPtr());
     HandleRequestFromBlender(data);
-    int a=0;
 }
 
 void SceneLoader::HandleUpdate(StringHash eventType, VariantMap& eventData)
 {
     using namespace Update;
 
+    // --replay ends with the recording, once the export it caused is done
+    BlenderNetwork* bN = GetSubsystem<BlenderNetwork>();
+    if (bN->IsReplaying() && bN->IsReplayFinished() && !GetSubsystem<Urho3DNodeTreeExporter>()->IsExporting()){
+        URHO3D_LOGINFOF("[SceneLoader] replayed %u messages in %u frames",bN->GetLog().GetNumReplayed(),GetSubsystem<Time>()->GetFrameNumber());
+        engine_->Exit();
+        return;
+    }
+
     // Take the frame time step, which is stored as a float
     float timeStep = eventData[P_TIMESTEP].GetFloat();
 
@@ -515,7 +954,7 @@ void SceneLoader::HandleUpdate(StringHash eventType, VariantMap& eventData)
     }
     else if (input->GetKeyPress(KEY_V)){
         if (viewRenderers.Size()>0){
-            if (showViewportId>viewRenderers.Size()) {
+            if (showViewportId>=viewRenderers.Size()) {
                 showViewportId = 0;
             }
             auto key = viewRenderers.Keys()[showViewportId];
@@ -535,9 +974,6 @@ void SceneLoader::HandleUpdate(StringHash eventType, VariantMap& eventData)
         if (currentViewRenderer)
             UpdateViewRenderer(currentViewRenderer);
     }
-    else if (input->GetKeyPress(KEY_0)){
-        BlenderNetwork* bN = GetSubsystem<BlenderNetwork>();
-    }
 
     if (!updatedCamera){
         UpdateCameras();
@@ -732,31 +1168,26 @@ Scene* SceneLoader::GetScene(const String &sceneName)
 {
     auto sceneResourceName = "Scenes/"+sceneName+".xml";
 
-    if (scenes_.Contains(sceneResourceName)){
-        return scenes_[sceneResourceName];
+    SceneCache* sceneCache = GetSubsystem<SceneCache>();
+    if (sceneCache->IsResident(sceneResourceName)){
+        return sceneCache->GetScene(sceneResourceName);
     }
 
-    auto cache = GetSubsystem<ResourceCache>();
-    SharedPtr<File> file = cache->GetFile(sceneResourceName);
-    if (file.Null()){
+    bool firstScene = loadedScenes_.Empty();
+    Scene* newScene = sceneCache->GetScene(sceneResourceName);
+    if (!newScene){
         URHO3D_LOGERRORF("Could not load scene:%s",sceneName.CString());
         return nullptr;
     }
-    Scene* newScene = new Scene(context_);
-    newScene->LoadXML(*file);
-    if (scenes_.Size()){
+    if (!firstScene){
         Renderer* renderer = GetSubsystem<Renderer>();
-
-        // Set up a viewport to the Renderer subsystem so that the 3D scene can be seen
-        SharedPtr<Viewport> viewport(new Viewport(context_, scene_, cameraNode_->GetComponent<Camera>()));
         renderer->GetViewport(0)->SetScene(newScene);
     }
-    scenes_[sceneResourceName]=newScene;
-
-    PODVector<Light*> sceneLights;
-    newScene->GetComponents<Light>(sceneLights,true);
+    loadedScenes_.Insert(sceneResourceName);
 
     EnsureLight(newScene);
+    BatchStaticGeometry(newScene,false);
+    sceneCache->UpdateMemoryInfo(sceneResourceName);
 
 
     return newScene;
@@ -803,13 +1234,31 @@ void SceneLoader::HandleRequestFromBlender(const JSONObject &json)
         newRenderer = true;
         String sceneName = json["scene_name"]->GetString();
         Scene* scene = GetScene(sceneName);
+        if (!scene) return;
         viewRenderer = new ViewRenderer(context_,viewId,scene,width,height,fov);
+        viewRenderer->SetSceneName(sceneName);
         viewRenderers[viewId] = viewRenderer;
         UpdateViewRenderer(viewRenderer);
+
+        // the new renderer holds its scene now, so older unused scenes can go
+        GetSubsystem<SceneCache>()->EnforceBudget();
     }
 
     if (!viewRenderer) return;
 
+    if (!newRenderer && json.Contains("scene_name") && json["scene_name"]->GetString() != viewRenderer->GetSceneName()){
+        String sceneName = json["scene_name"]->GetString();
+        Scene* scene = GetScene(sceneName);
+        if (scene){
+            viewRenderer->SetScene(scene);
+            viewRenderer->SetSceneName(sceneName);
+            UpdateViewRenderer(viewRenderer);
+
+            // the view let go of its previous scene
+            GetSubsystem<SceneCache>()->EnforceBudget();
+        }
+    }
+
     if (!newRenderer && json.Contains("resolution")){
         auto resolution = json["resolution"]->GetObject();
         width = resolution["width"].GetInt();
@@ -925,7 +1374,18 @@ void SceneLoader::HandleAfterRender(StringHash eventType, VariantMap& eventData)
         jsonfile_.GetRoot().Set("initial-fov",view->fov_);
 
         BlenderNetwork* bN = GetSubsystem<BlenderNetwork>();
-        bN->Send(view->GetNetId(),"draw",_ImageData,imageSize, jsonfile_.ToString());
+        auto requests = renderRequests_.Find(view->GetId());
+        if (requests != renderRequests_.End()){
+            // requested over rpc, only the requesters get the frame
+            for (const Pair<unsigned,int>& request : requests->second_){
+                jsonfile_.GetRoot().Set("seq",request.second_);
+                bN->GetRpc()->Reply(request.first_,RPC_OK,jsonfile_.ToString(),_ImageData,imageSize);
+            }
+            jsonfile_.GetRoot().Erase("seq");
+            renderRequests_.Erase(requests);
+        } else {
+            bN->Send(view->GetNetId(),"draw",_ImageData,imageSize, jsonfile_.ToString());
+        }
 
         //_pImage->SavePNG(additionalResourcePath+"/Screenshot"+String(view->GetId())+".png");
 
@@ -950,6 +1410,32 @@ void SceneLoader::UpdateViewRenderer(ViewRenderer *renderer)
     updatedRenderers.Insert(renderer);
 }
 
+void SceneLoader::ReleaseViewRenderer(int viewId)
+{
+    auto it = viewRenderers.Find(viewId);
+    if (it == viewRenderers.End())
+        return;
+
+    ViewRenderer* renderer = it->second_;
+    viewRenderers.Erase(it);
+    updatedRenderers.Erase(renderer);
+    if (currentViewRenderer == renderer)
+        currentViewRenderer = nullptr;
+
+    // render requests of the view won't get a frame anymore
+    auto requests = renderRequests_.Find(viewId);
+    if (requests != renderRequests_.End()){
+        RpcChannel* rpc = GetSubsystem<BlenderNetwork>()->GetRpc();
+        for (const Pair<unsigned,int>& request : requests->second_){
+            rpc->Reply(request.first_,RPC_ERROR,"render: view "+String(viewId)+" closed");
+        }
+        renderRequests_.Erase(requests);
+    }
+    delete renderer;
+
+    GetSubsystem<SceneCache>()->EnforceBudget();
+}
+
 ViewRenderer::ViewRenderer(Context* ctx,int id, Scene* initialScene, int width,int height,float fov)
     : fov_(fov),
       viewId_(id),
@@ -976,12 +1462,22 @@ ViewRenderer::ViewRenderer(Context* ctx,int id, Scene* initialScene, int width,i
     SetSize(width,height,fov);
 }
 
+ViewRenderer::~ViewRenderer()
+{
+    // the camera is a child of the scene, which lives on in the SceneCache
+    viewportCameraNode_->Remove();
+}
+
 void ViewRenderer::SetScene(Scene *scene)
 {
     if (scene == currentScene_){
         // nothing to do
         return;
     }
+    // the camera moves along. the previous scene is released, so the SceneCache can evict it
+    scene->AddChild(viewportCameraNode_);
+    currentScene_ = scene;
+    currentScene_->SetUpdateEnabled(false);
     viewport_->SetScene(scene);
     renderSurface_->QueueUpdate();
 }
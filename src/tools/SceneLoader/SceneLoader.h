@@ -35,9 +35,12 @@ class Scene;
 
 }
 
+struct RpcRequest;
+
 class ViewRenderer{
 public:
     ViewRenderer(Context* ctx,int id, Scene* initialScene, int width,int height,float fov);
+    ~ViewRenderer();
     void SetSize(int width,int height,float fov);
     void SetScene(Scene* scene);
     void SetViewMatrix(const Matrix4& vmat);
@@ -48,6 +51,9 @@ public:
     inline SharedPtr<Texture2D> GetRenderTexture(){ return renderTexture_;}
     inline int GetId() { return viewId_;}
     inline SharedPtr<Scene> GetScene() { return currentScene_; }
+    /// the scene_name blender requested for this view
+    const String& GetSceneName() const { return sceneName_; }
+    void SetSceneName(const String& sceneName) { sceneName_ = sceneName; }
     inline SharedPtr<Camera> GetCamera() { return viewportCamera_;}
     inline SharedPtr<Viewport> GetViewport() { return viewport_;}
     const String& GetNetId() { return netId; }
@@ -64,6 +70,7 @@ private:
     bool orthoMode_;
 
     Context* ctx_;
+    String sceneName_;
     SharedPtr<Scene> currentScene_;
     SharedPtr<RenderSurface> renderSurface_;
     SharedPtr<Texture2D> renderTexture_;
@@ -85,6 +92,8 @@ public:
     /// Construct.
     explicit SceneLoader(Context* context);
 
+    /// Setup before engine initialization. Tool modes run headless.
+    void Setup() override;
     /// Setup after engine initialization and before running the main loop.
     void Start() override;
     void Stop() override;
@@ -104,9 +113,30 @@ private:
 
     // reload scene if filewatcher detected this
     void ReloadScene();
-
-    // export components for use in blender
+    // assign the models of "setmesh" nodes to their triangle-mesh collision shapes
+    void ProcessSetMeshNodes(Scene* scene);
+    // merge static geometry if the "staticbatch[:cellsize]" runtime-flag is set
+    void BatchStaticGeometry(Scene* scene, bool measure);
+    // check for a runtime-flag. flags with a value are written as "name:value"
+    bool GetRuntimeFlag(const String& name, String* value = nullptr) const;
+
+    // set the component filters and resource folders of the exporter
+    void SetupExporter();
+    // export components for use in blender. runs in the background, "component-update" is sent when done
     void ExportComponents(const String& outputPaht);
+    void HandleComponentExportFinished(StringHash eventType, VariantMap& eventData);
+    /// The patch to the previous version if there is one, else the full export.
+    void BroadcastComponentExport(bool unchanged);
+    /// Send the current export to memory in full.
+    void SendComponentExport(bool unchanged);
+    /// Meta of a full export: version, hash, size and compression.
+    String GetComponentExportMeta(bool unchanged);
+    /// rpc "export-components": export now, or after the running export, and reply with the result.
+    void HandleExportRequest(RpcRequest& request);
+    void ReplyExportRequests(const String& outputPath, bool success);
+    /// rpc "render": the same json as a view update, replied to with the next frame of the view.
+    void HandleRenderRequest(RpcRequest& request);
+    void HandleThumbnailsReady(StringHash eventType, VariantMap& eventData);
 
     void HandleUpdate(StringHash eventType, VariantMap& eventData);
 
@@ -119,7 +149,8 @@ private:
     void HandleScriptReloadFailed(StringHash eventType, VariantMap& eventData);
     void HandleAfterRender(StringHash eventType, VariantMap& eventData);
 
-    void HandleBlenderMSG(StringHash eventType, VariantMap& eventData);
+    /// Messages from blender that have no route of their own.
+    void HandleBlenderMSG(StringHash route, VariantMap& eventData);
 
 
     void HandleRequestFromBlender(const JSONObject &json);
@@ -130,6 +161,8 @@ private:
     Scene* GetScene(const String& sceneName);
     ViewRenderer* GetViewRenderer(int viewId);
     ViewRenderer* CreateViewRenderer(Context* ctx, Scene* scene, int width, int height);
+    /// Destroy the renderer of a view closed in blender. Its scene can be evicted then.
+    void ReleaseViewRenderer(int viewId);
     void UpdateViewRenderer(ViewRenderer* renderer);
 
     void InitEditor();
@@ -145,6 +178,20 @@ private:
     String exportPath;
     String additionalResourcePath;
     String customUI;
+    /// --rpc-id: name of this runtime for the requests of blender
+    String rpcIdentity;
+    /// --record: write the messages from blender to this file
+    String recordFileName;
+    /// --replay: take the messages from this recording instead of blender and exit at its end
+    String replayFileName;
+    /// --replay-fast: a recorded frame per frame instead of the recorded timing
+    bool replayFast_;
+    /// --cook-textures: cook the textures and exit
+    bool cookTexturesOnly_;
+    /// --pack: pack the working directory into the resource archive and exit
+    bool packOnly_;
+    /// --export-only: write the component export and exit
+    bool exportOnly_;
 
     int currentCamId;
     int showViewportId;
@@ -165,10 +212,18 @@ private:
     RenderSurface* surface;
     SharedPtr<Texture2D> rtTexture;
 
-    HashMap<StringHash,Scene*> scenes_;
+    /// scenes requested by blender so far. the scenes themselves live in the SceneCache
+    HashSet<String> loadedScenes_;
     HashMap<int,ViewRenderer*> viewRenderers;
     HashSet<ViewRenderer*> updatedRenderers;
     ViewRenderer* currentViewRenderer;
 
+    /// rpc requests for the running export
+    PODVector<unsigned> exportRequests_;
+    /// rpc requests that came in while an export ran, they get the next one
+    PODVector<unsigned> queuedExportRequests_;
+    /// rpc requests per view id with their seq, answered after the view rendered
+    HashMap<int, Vector<Pair<unsigned,int> > > renderRequests_;
+
     JSONFile jsonfile_;
 };
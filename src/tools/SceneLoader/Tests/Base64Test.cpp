@@ -0,0 +1,241 @@
+// Checks the buffer based base64 codec against the std::string implementation it replaced:
+// round trips of every length around the block sizes of the vector paths, and input that is
+// no base64 at every position of a block. Built twice, with the vector path of the cpu
+// (SSSE3 or NEON) and with BASE64_NO_SIMD, so both are compared with the same reference.
+//
+// Base64Test [--bench]   --bench also times the old and the new codec on 16MB
+
+#include "TestCheck.h"
+#include "../LoaderTools/base64.h"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#if defined(BASE64_NO_SIMD)
+static const char* CODEC_PATH = "scalar";
+#elif defined(__SSSE3__) || defined(__AVX__)
+static const char* CODEC_PATH = "ssse3";
+#elif defined(__aarch64__) || defined(_M_ARM64)
+static const char* CODEC_PATH = "neon";
+#else
+static const char* CODEC_PATH = "scalar";
+#endif
+
+namespace old {
+
+// the implementation before the buffer based codec, as reference
+
+static const std::string base64_chars =
+             "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
+             "abcdefghijklmnopqrstuvwxyz"
+             "0123456789+/";
+
+static inline bool is_base64(unsigned char c) {
+  return (isalnum(c) || (c == '+') || (c == '/'));
+}
+
+std::string base64_encode(unsigned char const* bytes_to_encode, unsigned int in_len) {
+  std::string ret;
+  int i = 0;
+  int j = 0;
+  unsigned char char_array_3[3];
+  unsigned char char_array_4[4];
+
+  while (in_len--) {
+    char_array_3[i++] = *(bytes_to_encode++);
+    if (i == 3) {
+      char_array_4[0] = (char_array_3[0] & 0xfc) >> 2;
+      char_array_4[1] = ((char_array_3[0] & 0x03) << 4) + ((char_array_3[1] & 0xf0) >> 4);
+      char_array_4[2] = ((char_array_3[1] & 0x0f) << 2) + ((char_array_3[2] & 0xc0) >> 6);
+      char_array_4[3] = char_array_3[2] & 0x3f;
+
+      for(i = 0; (i <4) ; i++)
+        ret += base64_chars[char_array_4[i]];
+      i = 0;
+    }
+  }
+
+  if (i)
+  {
+    for(j = i; j < 3; j++)
+      char_array_3[j] = '\0';
+
+    char_array_4[0] = ( char_array_3[0] & 0xfc) >> 2;
+    char_array_4[1] = ((char_array_3[0] & 0x03) << 4) + ((char_array_3[1] & 0xf0) >> 4);
+    char_array_4[2] = ((char_array_3[1] & 0x0f) << 2) + ((char_array_3[2] & 0xc0) >> 6);
+
+    for (j = 0; (j < i + 1); j++)
+      ret += base64_chars[char_array_4[j]];
+
+    while((i++ < 3))
+      ret += '=';
+
+  }
+
+  return ret;
+
+}
+
+std::string base64_decode(std::string const& encoded_string) {
+  int in_len = encoded_string.size();
+  int i = 0;
+  int j = 0;
+  int in_ = 0;
+  unsigned char char_array_4[4], char_array_3[3];
+  std::string ret;
+
+  while (in_len-- && ( encoded_string[in_] != '=') && is_base64(encoded_string[in_])) {
+    char_array_4[i++] = encoded_string[in_]; in_++;
+    if (i ==4) {
+      for (i = 0; i <4; i++)
+        char_array_4[i] = base64_chars.find(char_array_4[i]);
+
+      char_array_3[0] = ( char_array_4[0] << 2       ) + ((char_array_4[1] & 0x30) >> 4);
+      char_array_3[1] = ((char_array_4[1] & 0xf) << 4) + ((char_array_4[2] & 0x3c) >> 2);
+      char_array_3[2] = ((char_array_4[2] & 0x3) << 6) +   char_array_4[3];
+
+      for (i = 0; (i < 3); i++)
+        ret += char_array_3[i];
+      i = 0;
+    }
+  }
+
+  if (i) {
+    for (j = 0; j < i; j++)
+      char_array_4[j] = base64_chars.find(char_array_4[j]);
+
+    char_array_3[0] = (char_array_4[0] << 2) + ((char_array_4[1] & 0x30) >> 4);
+    char_array_3[1] = ((char_array_4[1] & 0xf) << 4) + ((char_array_4[2] & 0x3c) >> 2);
+
+    for (j = 0; (j < i - 1); j++) ret += char_array_3[j];
+  }
+
+  return ret;
+}
+
+}
+
+static std::vector<unsigned char> RandomBytes(std::mt19937& random, size_t size)
+{
+    std::vector<unsigned char> bytes(size);
+    for (unsigned char& byte : bytes)
+        byte = (unsigned char)random();
+    return bytes;
+}
+
+/// Every length up to a few blocks of both vector paths (12/16 bytes for SSSE3, 48/64 for NEON).
+static void CheckRoundTrips(std::mt19937& random)
+{
+    for (size_t size = 0; size <= 300; ++size){
+        std::vector<unsigned char> bytes = RandomBytes(random, size);
+        std::string expected = old::base64_encode(bytes.data(), (unsigned)size);
+
+        // a guard byte behind the output, the predicted size has to be exact
+        std::vector<char> encoded(base64_encoded_size(size) + 1, '#');
+        size_t encodedSize = base64_encode(bytes.data(), size, encoded.data());
+        CHECK(encodedSize == expected.size(), "size %zu: encoded %zu characters instead of %zu", size, encodedSize, expected.size());
+        CHECK(encoded.back() == '#', "size %zu: wrote past the predicted size", size);
+        CHECK(std::string(encoded.data(), encodedSize) == expected, "size %zu: encoded differently", size);
+        CHECK(base64_encode(bytes.data(), (unsigned)size) == expected, "size %zu: std::string encode differs", size);
+
+        std::vector<unsigned char> decoded(base64_decoded_size(expected.data(), expected.size()) + 1, 0xcd);
+        size_t decodedSize = base64_decode(expected.data(), expected.size(), decoded.data());
+        CHECK(decodedSize == size, "size %zu: decoded %zu bytes", size, decodedSize);
+        CHECK(decoded.back() == 0xcd, "size %zu: wrote past the predicted size", size);
+        CHECK(decodedSize == size && memcmp(decoded.data(), bytes.data(), size) == 0, "size %zu: decoded differently", size);
+        CHECK(base64_decode(expected) == old::base64_decode(expected), "size %zu: std::string decode differs", size);
+
+        // the padding is optional
+        size_t unpadded = expected.find('=');
+        if (unpadded != std::string::npos){
+            decodedSize = base64_decode(expected.data(), unpadded, decoded.data());
+            CHECK(decodedSize == size && memcmp(decoded.data(), bytes.data(), size) == 0, "size %zu: unpadded decoded differently", size);
+        }
+    }
+}
+
+/// A character that is no base64 at every position of a few blocks has to be found, the
+/// vector paths hand such a block to the scalar loop.
+static void CheckInvalidInput(std::mt19937& random)
+{
+    static const char invalid[] = { '=', '-', '_', ' ', '\n', '\0', '@', '[', '`', '{', ':', (char)0x80, (char)0xff };
+
+    std::vector<unsigned char> bytes = RandomBytes(random, 3 * 64);
+    std::string valid = old::base64_encode(bytes.data(), (unsigned)bytes.size());
+    std::vector<unsigned char> decoded(bytes.size());
+
+    for (size_t position = 0; position < valid.size(); ++position){
+        for (char c : invalid){
+            std::string input = valid;
+            input[position] = c;
+            // '=' at the end is padding
+            if (c == '=' && position == input.size() - 1)
+                continue;
+            size_t result = base64_decode(input.data(), input.size(), decoded.data());
+            CHECK(result == BASE64_ERROR, "0x%02x at %zu: decoded %zu bytes", (unsigned char)c, position, result);
+            // the std::string decode stops there like the old one did
+            CHECK(base64_decode(input) == old::base64_decode(input), "0x%02x at %zu: std::string decode differs", (unsigned char)c, position);
+        }
+    }
+
+    // random junk decodes like before through the std::string interface
+    static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/=-_ \n\x80";
+    for (unsigned i = 0; i < 1000; ++i){
+        std::string input(random() % 100, ' ');
+        for (char& c : input)
+            c = alphabet[random() % (sizeof(alphabet) - 1)];
+        CHECK(base64_decode(input) == old::base64_decode(input), "junk '%s' decodes differently", input.c_str());
+    }
+
+    CHECK(base64_decoded_size("", 0) == 0, "empty input");
+    CHECK(base64_decode("", 0, decoded.data()) == 0, "empty input");
+    CHECK(base64_decode("====", 4, decoded.data()) == 0, "only padding");
+}
+
+template <class Function> static double Time(Function function)
+{
+    auto start = std::chrono::steady_clock::now();
+    function();
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+static void Bench(std::mt19937& random)
+{
+    static const size_t SIZE = 16 * 1024 * 1024;
+    std::vector<unsigned char> bytes = RandomBytes(random, SIZE);
+    std::string encoded;
+    std::string decoded;
+
+    printf("%u bytes, best of 5\n", (unsigned)SIZE);
+    double oldEncode = 1e9, newEncode = 1e9, oldDecode = 1e9, newDecode = 1e9;
+    std::vector<char> out(base64_encoded_size(SIZE));
+    std::vector<unsigned char> back(SIZE);
+    for (int run = 0; run < 5; ++run){
+        oldEncode = std::min(oldEncode, Time([&]{ encoded = old::base64_encode(bytes.data(), (unsigned)SIZE); }));
+        newEncode = std::min(newEncode, Time([&]{ base64_encode(bytes.data(), SIZE, out.data()); }));
+        oldDecode = std::min(oldDecode, Time([&]{ decoded = old::base64_decode(encoded); }));
+        newDecode = std::min(newDecode, Time([&]{ base64_decode(encoded.data(), encoded.size(), back.data()); }));
+    }
+    printf("encode old %8.2fms  new %8.2fms\n", oldEncode, newEncode);
+    printf("decode old %8.2fms  new %8.2fms\n", oldDecode, newDecode);
+}
+
+int main(int argc, char** argv)
+{
+    bool bench = ParseBench(argc, argv);
+
+    printf("base64 %s path\n", CODEC_PATH);
+    std::mt19937 random(0x5eed);
+    CheckRoundTrips(random);
+    CheckInvalidInput(random);
+    if (bench)
+        Bench(random);
+
+    return TestResult();
+}
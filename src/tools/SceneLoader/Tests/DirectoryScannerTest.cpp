@@ -0,0 +1,192 @@
+// Checks DirectoryScanner against FileSystem::ScanDir on a synthetic tree, and that links to
+// folders are not followed. --bench builds a tree of 100k files (10 folders of 100 folders of
+// 100 files) and times both walks on it. The trees go to --dir, by default the temp dir. The
+// trees of the checks are removed at the end, the benchmark tree is kept for the next run, so
+// the timings are with a warm file system cache.
+//
+// DirectoryScannerTest [--bench] [--dir <path>]
+
+#include "TestCheck.h"
+#include "../LoaderTools/DirectoryScanner.h"
+
+#include <Urho3D/Container/Sort.h>
+#include <Urho3D/Core/Context.h>
+#include <Urho3D/IO/File.h>
+#include <Urho3D/IO/FileSystem.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#ifndef _WIN32
+#include <ftw.h>
+#include <unistd.h>
+#endif
+
+using namespace Urho3D;
+
+/// FileSystem::CreateDir only creates the last folder of the path.
+static void CreateDirs(FileSystem* fs, const String& path)
+{
+    for (unsigned i = path.Find('/', 1); i != String::NPOS; i = path.Find('/', i + 1))
+        fs->CreateDir(path.Substring(0, i));
+    fs->CreateDir(path);
+}
+
+/// root/dN/sM/fK.png, built once. The marker next to the tree tells that it is complete.
+static String BuildTree(Context* context, const String& root, unsigned numFolders, unsigned numSubFolders, unsigned numFiles)
+{
+    FileSystem* fs = context->GetSubsystem<FileSystem>();
+    String tree = root + "tree/";
+    String marker = root + "complete";
+    if (fs->FileExists(marker))
+        return tree;
+
+    printf("building %u files in %s\n", numFolders * numSubFolders * numFiles, tree.CString());
+    for (unsigned d = 0; d < numFolders; ++d){
+        for (unsigned s = 0; s < numSubFolders; ++s){
+            String folder = tree + "d" + String(d) + "/s" + String(s) + "/";
+            CreateDirs(fs, folder);
+            for (unsigned f = 0; f < numFiles; ++f){
+                File file(context, folder + "f" + String(f) + ".png", FILE_WRITE);
+            }
+        }
+    }
+    File file(context, marker, FILE_WRITE);
+    return tree;
+}
+
+static bool IsHidden(const String& path)
+{
+    return path.StartsWith(".") || path.Contains("/.");
+}
+
+/// The same files and folders as the recursive ScanDir, which also lists hidden ones.
+static void CheckListing(FileSystem* fs, const String& tree)
+{
+    DirectoryListing listing;
+    CHECK(DirectoryScanner::Scan(tree, listing), "could not scan %s", tree.CString());
+
+    Vector<String> scanned;
+    fs->ScanDir(scanned, tree, "*", SCAN_FILES, true);
+    Vector<String> files;
+    for (const String& file : scanned){
+        if (!IsHidden(file))
+            files.Push(file);
+    }
+    Sort(files.Begin(), files.End());
+    CHECK(files == listing.files_, "%u files instead of %u", listing.files_.Size(), files.Size());
+
+    scanned.Clear();
+    fs->ScanDir(scanned, tree, "*", SCAN_DIRS, true);
+    unsigned numDirs = 0;
+    for (const String& dir : scanned){
+        // "." and ".." are listed as well
+        if (IsHidden(dir))
+            continue;
+        numDirs++;
+        CHECK(listing.dirs_.Contains(dir), "folder %s is missing", dir.CString());
+    }
+    CHECK(numDirs == listing.dirs_.Size(), "%u folders instead of %u", listing.dirs_.Size(), numDirs);
+}
+
+/// A link back up the tree would be walked until the path gets too long.
+static void CheckLinks(Context* context, const String& root)
+{
+#ifndef _WIN32
+    FileSystem* fs = context->GetSubsystem<FileSystem>();
+    String tree = root + "links/";
+    CreateDirs(fs, tree + "a");
+    {
+        File file(context, tree + "a/x.png", FILE_WRITE);
+    }
+    // EEXIST from the previous run is fine
+    symlink("..", (tree + "a/up").CString());
+    symlink("a", (tree + "alink").CString());
+    symlink("a/x.png", (tree + "xlink.png").CString());
+    symlink("missing", (tree + "dangling.png").CString());
+
+    DirectoryListing listing;
+    CHECK(DirectoryScanner::Scan(tree, listing), "could not scan %s", tree.CString());
+    Vector<String> expected;
+    expected.Push("a/x.png");
+    expected.Push("xlink.png");
+    CHECK(listing.files_ == expected, "%u files instead of 2", listing.files_.Size());
+    CHECK(listing.dirs_.Size() == 1 && listing.dirs_.Contains("a"), "%u folders instead of 1", listing.dirs_.Size());
+#endif
+}
+
+#ifndef _WIN32
+static int RemoveEntry(const char* path, const struct stat*, int, struct FTW*)
+{
+    return remove(path);
+}
+#endif
+
+/// Remove a tree of the checks. Links are removed, not followed.
+static void RemoveTree(const String& path)
+{
+#ifdef _WIN32
+    system(("rmdir /s /q \"" + GetNativePath(RemoveTrailingSlash(path)) + "\"").CString());
+#else
+    nftw(path.CString(), RemoveEntry, 16, FTW_DEPTH | FTW_PHYS);
+#endif
+}
+
+template <class Function> static double Time(Function function)
+{
+    double best = 1e9;
+    for (int run = 0; run < 3; ++run){
+        auto start = std::chrono::steady_clock::now();
+        function();
+        best = std::min(best, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+    }
+    return best;
+}
+
+static void Bench(Context* context, const String& root)
+{
+    FileSystem* fs = context->GetSubsystem<FileSystem>();
+    String tree = BuildTree(context, root + "bench/", 10, 100, 100);
+    CheckListing(fs, tree);
+
+    DirectoryListing listing;
+    double scanner = Time([&]{ DirectoryScanner::Scan(tree, listing); });
+    double scannerSingle = Time([&]{ DirectoryScanner::Scan(tree, listing, 1); });
+    double scanDir = Time([&]{
+        Vector<String> files;
+        Vector<String> dirs;
+        fs->ScanDir(files, tree, "*", SCAN_FILES, true);
+        fs->ScanDir(dirs, tree, "*", SCAN_DIRS, true);
+    });
+    printf("%u files, %u folders, best of 3\n", listing.files_.Size(), listing.dirs_.Size());
+    printf("DirectoryScanner            %8.2fms\n", scanner);
+    printf("DirectoryScanner 1 thread   %8.2fms\n", scannerSingle);
+    printf("ScanDir files + dirs        %8.2fms\n", scanDir);
+}
+
+int main(int argc, char** argv)
+{
+    SharedPtr<Context> context(new Context());
+    FileSystem* fs = new FileSystem(context);
+    context->RegisterSubsystem(fs);
+
+    bool bench = ParseBench(argc, argv);
+    String root = fs->GetTemporaryDir() + "DirectoryScannerTest/";
+    for (int i = 1; i < argc; ++i){
+        if (!strcmp(argv[i], "--dir") && i + 1 < argc)
+            root = AddTrailingSlash(argv[++i]);
+    }
+    CreateDirs(fs, root);
+
+    CheckListing(fs, BuildTree(context, root + "small/", 3, 4, 10));
+    CheckLinks(context, root);
+    RemoveTree(root + "small");
+    RemoveTree(root + "links");
+    if (bench)
+        Bench(context, root);
+
+    return TestResult();
+}
@@ -0,0 +1,355 @@
+// Checks that JSONStreamWriter writes byte for byte what JSONFile::Save() writes for the same
+// tree: for every value type, with different indentations, once as whole JSONValue and once
+// streamed call by call. --bench writes an export the size of a big component export both
+// ways and compares time and heap use of the JSONValue tree + Save() with streaming it.
+//
+// JSONStreamWriterTest [--bench]
+
+#include "TestCheck.h"
+#include "../LoaderTools/JSONStreamWriter.h"
+
+#include <Urho3D/Core/Context.h>
+#include <Urho3D/IO/VectorBuffer.h>
+#include <Urho3D/Resource/JSONFile.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+using namespace Urho3D;
+
+// heap use for the benchmark, single threaded. every block has its size in front, so the
+// live bytes are known when it is freed
+static size_t liveBytes = 0;
+static size_t peakBytes = 0;
+static size_t numAllocations = 0;
+static const size_t HEADER_SIZE = 16;
+
+static void* Allocate(size_t size) noexcept
+{
+    char* block = static_cast<char*>(malloc(size + HEADER_SIZE));
+    if (!block)
+        return nullptr;
+    memcpy(block, &size, sizeof(size));
+    liveBytes += size;
+    peakBytes = std::max(peakBytes, liveBytes);
+    numAllocations++;
+    return block + HEADER_SIZE;
+}
+
+static void Free(void* ptr) noexcept
+{
+    if (!ptr)
+        return;
+    char* block = static_cast<char*>(ptr) - HEADER_SIZE;
+    size_t size;
+    memcpy(&size, block, sizeof(size));
+    liveBytes -= size;
+    free(block);
+}
+
+void* operator new(size_t size)
+{
+    if (void* ptr = Allocate(size))
+        return ptr;
+    throw std::bad_alloc();
+}
+void* operator new[](size_t size)
+{
+    if (void* ptr = Allocate(size))
+        return ptr;
+    throw std::bad_alloc();
+}
+void* operator new(size_t size, const std::nothrow_t&) noexcept { return Allocate(size); }
+void* operator new[](size_t size, const std::nothrow_t&) noexcept { return Allocate(size); }
+void operator delete(void* ptr) noexcept { Free(ptr); }
+void operator delete[](void* ptr) noexcept { Free(ptr); }
+void operator delete(void* ptr, const std::nothrow_t&) noexcept { Free(ptr); }
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept { Free(ptr); }
+#ifdef __cpp_sized_deallocation
+void operator delete(void* ptr, size_t) noexcept { Free(ptr); }
+void operator delete[](void* ptr, size_t) noexcept { Free(ptr); }
+#endif
+
+static String ToString(const VectorBuffer& buffer)
+{
+    return String(reinterpret_cast<const char*>(buffer.GetData()), buffer.GetSize());
+}
+
+/// Byte position of the first difference, for the failure message.
+static unsigned FirstDifference(const String& a, const String& b)
+{
+    unsigned i = 0;
+    while (i < a.Length() && i < b.Length() && a[i] == b[i])
+        ++i;
+    return i;
+}
+
+static String SaveDOM(Context* context, const JSONValue& root, const String& indentation)
+{
+    JSONFile file(context);
+    file.GetRoot() = root;
+    VectorBuffer buffer;
+    file.Save(buffer, indentation);
+    return ToString(buffer);
+}
+
+static String SaveStream(const JSONValue& root, const String& indentation)
+{
+    VectorBuffer buffer;
+    {
+        JSONStreamWriter writer(buffer, indentation);
+        writer.Value(root);
+        CHECK(writer.IsComplete(), "root not closed");
+    }
+    return ToString(buffer);
+}
+
+/// Every value type, nested, with the strings rapidjson has to escape.
+static JSONValue BuildSample()
+{
+    JSONValue root;
+    root["null"] = JSONValue();
+    root["true"] = true;
+    root["false"] = false;
+    root["int"] = -123456;
+    root["intMin"] = (int)0x80000000;
+    root["uint"] = 4000000000u;
+    root["double"] = 3.25;
+    root["small"] = 1.0e-7;
+    root["fraction"] = 0.1;
+    root["string"] = "plain";
+    root["escaped"] = "quote\" backslash\\ tab\t newline\n slash/ \x01";
+    root["utf8"] = "\xc3\xa4\xe2\x82\xac";
+    root["empty"] = "";
+    root["emptyArray"] = JSONArray();
+    root["emptyObject"] = JSONObject();
+
+    JSONValue array;
+    array.Push(1);
+    array.Push("two");
+    array.Push(3.5);
+    JSONValue inner;
+    inner["deep"] = JSONArray();
+    inner["deep"].Push(JSONObject());
+    array.Push(inner);
+    root["array"] = array;
+    return root;
+}
+
+/// The same as BuildSample() call by call.
+static String StreamSample(const String& indentation)
+{
+    VectorBuffer buffer;
+    {
+        JSONStreamWriter writer(buffer, indentation);
+        writer.StartObject();
+        writer.Member("null", JSONValue());
+        writer.Member("true", true);
+        writer.Member("false", false);
+        writer.Member("int", -123456);
+        writer.Member("intMin", (int)0x80000000);
+        writer.Member("uint", 4000000000u);
+        writer.Member("double", 3.25);
+        writer.Member("small", 1.0e-7);
+        writer.Member("fraction", 0.1);
+        writer.Member("string", "plain");
+        writer.Member("escaped", "quote\" backslash\\ tab\t newline\n slash/ \x01");
+        writer.Member("utf8", "\xc3\xa4\xe2\x82\xac");
+        writer.Member("empty", "");
+        writer.Key("emptyArray");
+        writer.StartArray();
+        writer.EndArray();
+        writer.Key("emptyObject");
+        writer.StartObject();
+        writer.EndObject();
+
+        writer.Key("array");
+        writer.StartArray();
+        writer.Value(1);
+        writer.Value("two");
+        writer.Value(3.5);
+        writer.StartObject();
+        writer.Key("deep");
+        writer.StartArray();
+        writer.StartObject();
+        writer.EndObject();
+        writer.EndArray();
+        writer.EndObject();
+        writer.EndArray();
+        writer.EndObject();
+        CHECK(writer.IsComplete(), "root not closed");
+    }
+    return ToString(buffer);
+}
+
+static void CheckSample(Context* context)
+{
+    static const char* indentations[] = { "\t", "  ", "    ", "" };
+    JSONValue sample = BuildSample();
+    for (const char* indentation : indentations){
+        String dom = SaveDOM(context, sample, indentation);
+        String whole = SaveStream(sample, indentation);
+        String streamed = StreamSample(indentation);
+        CHECK(!dom.Empty(), "indentation '%s': JSONFile wrote nothing", indentation);
+        CHECK(whole == dom, "indentation '%s': JSONValue differs at byte %u", indentation, FirstDifference(whole, dom));
+        CHECK(streamed == dom, "indentation '%s': streamed differs at byte %u", indentation, FirstDifference(streamed, dom));
+    }
+
+    // a bare value as root
+    CHECK(SaveStream(JSONValue(42), "\t") == SaveDOM(context, JSONValue(42), "\t"), "number as root");
+    CHECK(SaveStream(JSONValue("text"), "\t") == SaveDOM(context, JSONValue("text"), "\t"), "string as root");
+}
+
+// shaped like the component export: components with their attributes, then the enum tables
+static const unsigned BENCH_COMPONENTS = 2000;
+static const unsigned BENCH_ATTRIBUTES = 20;
+static const unsigned BENCH_ENUMS = 500;
+static const unsigned BENCH_ENUM_ITEMS = 20;
+
+static JSONValue BuildExport()
+{
+    JSONValue root;
+    JSONValue& components = root["components"];
+    for (unsigned c = 0; c < BENCH_COMPONENTS; ++c){
+        JSONValue component;
+        component["id"] = "urho3dcomponents__Component" + String(c);
+        component["name"] = "Component" + String(c);
+        component["category"] = "Category" + String(c % 10);
+        JSONValue& props = component["props"];
+        for (unsigned a = 0; a < BENCH_ATTRIBUTES; ++a){
+            JSONValue prop;
+            prop["name"] = "Attribute " + String(a);
+            prop["type"] = a % 2 ? "float" : "int";
+            prop["default"] = a % 2 ? JSONValue(a * 0.5) : JSONValue((int)a);
+            prop["precision"] = 3;
+            prop["visible"] = true;
+            props.Push(prop);
+        }
+        components.Push(component);
+    }
+    JSONValue& enums = root["enums"];
+    for (unsigned e = 0; e < BENCH_ENUMS; ++e){
+        JSONValue& items = enums["enum" + String(e)];
+        for (unsigned i = 0; i < BENCH_ENUM_ITEMS; ++i){
+            JSONValue item;
+            item["id"] = "item" + String(i);
+            item["name"] = "Item " + String(i);
+            item["description"] = "";
+            item["icon"] = "NONE";
+            item["number"] = String(i);
+            items.Push(item);
+        }
+    }
+    return root;
+}
+
+static void StreamExport(JSONStreamWriter& writer)
+{
+    writer.StartObject();
+    writer.Key("components");
+    writer.StartArray();
+    for (unsigned c = 0; c < BENCH_COMPONENTS; ++c){
+        writer.StartObject();
+        writer.Member("id", "urho3dcomponents__Component" + String(c));
+        writer.Member("name", "Component" + String(c));
+        writer.Member("category", "Category" + String(c % 10));
+        writer.Key("props");
+        writer.StartArray();
+        for (unsigned a = 0; a < BENCH_ATTRIBUTES; ++a){
+            writer.StartObject();
+            writer.Member("name", "Attribute " + String(a));
+            writer.Member("type", a % 2 ? "float" : "int");
+            if (a % 2)
+                writer.Member("default", a * 0.5);
+            else
+                writer.Member("default", (int)a);
+            writer.Member("precision", 3);
+            writer.Member("visible", true);
+            writer.EndObject();
+        }
+        writer.EndArray();
+        writer.EndObject();
+    }
+    writer.EndArray();
+    writer.Key("enums");
+    writer.StartObject();
+    for (unsigned e = 0; e < BENCH_ENUMS; ++e){
+        writer.Key("enum" + String(e));
+        writer.StartArray();
+        for (unsigned i = 0; i < BENCH_ENUM_ITEMS; ++i){
+            writer.StartObject();
+            writer.Member("id", "item" + String(i));
+            writer.Member("name", "Item " + String(i));
+            writer.Member("description", "");
+            writer.Member("icon", "NONE");
+            writer.Member("number", String(i));
+            writer.EndObject();
+        }
+        writer.EndArray();
+    }
+    writer.EndObject();
+    writer.EndObject();
+}
+
+static double ElapsedMSec(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+static void Bench(Context* context)
+{
+    // the output buffer is the same for both, it is counted in both
+    String dom;
+    size_t base = liveBytes;
+    peakBytes = liveBytes;
+    numAllocations = 0;
+    auto start = std::chrono::steady_clock::now();
+    {
+        JSONFile file(context);
+        file.GetRoot() = BuildExport();
+        VectorBuffer buffer;
+        file.Save(buffer, "\t");
+        dom = ToString(buffer);
+    }
+    double domMSec = ElapsedMSec(start);
+    size_t domPeak = peakBytes - base;
+    size_t domAllocations = numAllocations;
+
+    String streamed;
+    base = liveBytes;
+    peakBytes = liveBytes;
+    numAllocations = 0;
+    start = std::chrono::steady_clock::now();
+    {
+        VectorBuffer buffer;
+        {
+            JSONStreamWriter writer(buffer, "\t");
+            StreamExport(writer);
+        }
+        streamed = ToString(buffer);
+    }
+    double streamMSec = ElapsedMSec(start);
+    size_t streamPeak = peakBytes - base;
+    size_t streamAllocations = numAllocations;
+
+    CHECK(streamed == dom, "benchmark export differs at byte %u", FirstDifference(streamed, dom));
+    printf("export of %u components and %u enums, %uKB of json\n", BENCH_COMPONENTS, BENCH_ENUMS, dom.Length() / 1024);
+    printf("JSONValue + JSONFile::Save %8.2fms  peak %8.2fMB  %8u allocations\n", domMSec, domPeak / (1024.0 * 1024.0), (unsigned)domAllocations);
+    printf("JSONStreamWriter           %8.2fms  peak %8.2fMB  %8u allocations\n", streamMSec, streamPeak / (1024.0 * 1024.0), (unsigned)streamAllocations);
+}
+
+int main(int argc, char** argv)
+{
+    bool bench = ParseBench(argc, argv);
+
+    SharedPtr<Context> context(new Context());
+    CheckSample(context);
+    if (bench)
+        Bench(context);
+
+    return TestResult();
+}
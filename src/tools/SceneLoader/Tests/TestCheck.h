@@ -0,0 +1,45 @@
+#pragma once
+
+// The checks of the loader tool tests. A failed check prints its condition and goes on, so one
+// run shows every failure. main() returns TestResult().
+
+#include <cstdio>
+#include <cstring>
+
+/// Checks that failed so far.
+inline unsigned& NumFailedChecks()
+{
+    static unsigned numFailed = 0;
+    return numFailed;
+}
+
+#define CHECK(condition, ...) \
+    do { \
+        if (!(condition)){ \
+            printf("FAILED %s:%d %s: ",__FILE__,__LINE__,#condition); \
+            printf(__VA_ARGS__); \
+            printf("\n"); \
+            NumFailedChecks()++; \
+        } \
+    } while (0)
+
+/// Whether the test was started with --bench, the timings are only taken then.
+inline bool ParseBench(int argc, char** argv)
+{
+    for (int i = 1; i < argc; ++i){
+        if (!strcmp(argv[i], "--bench"))
+            return true;
+    }
+    return false;
+}
+
+/// Print the outcome of the checks. Return the exit code of the test.
+inline int TestResult()
+{
+    if (NumFailedChecks()){
+        printf("%u checks failed\n", NumFailedChecks());
+        return 1;
+    }
+    printf("all checks passed\n");
+    return 0;
+}